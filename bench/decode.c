@@ -0,0 +1,400 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file decode.c
+ *  \brief Benchmark of the decoding pipeline used for playback
+ *
+ *  Decodes all MP3s within a directory (typically `cache/streams`) using decoder.c into a null sink,
+ *  once for each combination of mpg123 decoder backend, reader mode and equalizer on/off.
+ *  Each combination runs in a child process of its own, such that the growth of the RSS can be attributed.
+ *
+ *  The results are written as JSON, one object per line and combination:
+ *  - `rtf`: real-time factor, the time required for decoding divided by the duration of the audio (lower is better)
+ *  - `us_per_frame`, `us_per_frame_p99`: mean and 99th percentile of the time required per MPEG frame
+ *  - `rss_delta_kb`: the peak resident set size minus the one at the start of the run, the inputs (mapped and
+ *    populated on startup) and the buffers of the benchmark itself are resident already
+ *  - `seek_ms`: distribution of the time required to seek to a random position and decode the first frame
+ */
+
+//\cond
+#include <dirent.h>                     // for opendir, readdir
+#include <errno.h>                      // for errno
+#include <stdint.h>                     // for intptr_t
+#include <stdio.h>                      // for fprintf, fopen, etc
+#include <stdlib.h>                     // for qsort, rand_r
+#include <string.h>                     // for memset, strcmp, strerror
+#include <sys/wait.h>                   // for waitpid
+#include <time.h>                       // for clock_gettime
+#include <unistd.h>                     // for fork, getopt
+//\endcond
+
+#include <mpg123.h>
+
+#include "../src/decoder.h"
+#include "../src/downloader.h"
+#include "../src/helper.h"
+#include "../src/log.h"
+
+#define BENCH_DEFAULT_SEEKS 20
+#define BENCH_MAX_FILES     1024
+#define BENCH_MAX_SAMPLES   (1 << 22)
+
+struct bench_file {
+	char               *name;
+	struct mmapped_file data;
+	double              duration;  ///< the duration in seconds, as determined by the decoding pass
+};
+
+struct bench_samples {
+	double *values;
+	size_t  count;
+};
+
+static struct bench_file files[BENCH_MAX_FILES];
+static size_t            file_count = 0;
+
+static unsigned int seeks_per_file = BENCH_DEFAULT_SEEKS;
+static const char  *label          = "";
+
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/** \brief Returns a value of /proc/self/status in kB (p.x. `VmRSS`, `VmHWM`), -1 if not available
+ */
+static long proc_status_kb(const char *key) {
+	FILE *status = fopen("/proc/self/status", "r");
+	if(!status) {
+		return -1;
+	}
+
+	char line[128];
+	long kb = -1;
+	const size_t len = strlen(key);
+	while(fgets(line, sizeof(line), status)) {
+		if(!strncmp(line, key, len) && ':' == line[len]) {
+			kb = strtol(&line[len + 1], NULL, 10);
+			break;
+		}
+	}
+	fclose(status);
+	return kb;
+}
+
+/** \brief Reset the peak RSS (`VmHWM`) to the current RSS, returns the latter (-1 if not available)
+ */
+static long rss_reset_peak(void) {
+	FILE *clear_refs = fopen("/proc/self/clear_refs", "w");
+	bool reset = clear_refs && EOF != fputs("5", clear_refs);
+	if(clear_refs && fclose(clear_refs)) {
+		reset = false;
+	}
+	if(!reset) {
+		fprintf(stderr, "failed to reset the peak RSS, rss_delta_kb includes the RSS inherited\n");
+	}
+	return proc_status_kb("VmRSS");
+}
+
+static void samples_add(struct bench_samples *samples, double value) {
+	if(samples->count < BENCH_MAX_SAMPLES) {
+		samples->values[samples->count++] = value;
+	}
+}
+
+static int compare_doubles(const void *v1, const void *v2) {
+	double d1 = *(const double*) v1;
+	double d2 = *(const double*) v2;
+	return (d1 > d2) - (d1 < d2);
+}
+
+/** \brief Returns the `p`-th percentile of the (sorted) samples
+ */
+static double samples_percentile(struct bench_samples *samples, double p) {
+	if(!samples->count) {
+		return 0;
+	}
+	size_t idx = (size_t) (p * (samples->count - 1));
+	return samples->values[idx];
+}
+
+/** \brief The null sink: keeps track of the format, discards the samples
+ */
+static size_t sink_frame_size = 0;
+static size_t sink_bytes      = 0;
+static long   sink_rate       = 0;
+
+static void sink_set_format(struct decoder *decoder) {
+	int channels, encoding;
+	mpg123_getformat(decoder->mh, &sink_rate, &channels, &encoding);
+	sink_frame_size = mpg123_encsize(encoding) * channels;
+}
+
+static struct download_state* bench_create_state(struct bench_file *file) {
+	struct download_state *state = downloader_create_state(NULL);
+	if(state) {
+		state->buffer      = (char*) (intptr_t) file->data.data;
+		state->bytes_recvd = file->data.size;
+		state->bytes_total = file->data.size;
+	}
+	return state;
+}
+
+/** \brief Decode a whole file, returns the duration of the audio in seconds
+ */
+static double bench_decode_file(struct bench_file *file, enum decoder_reader reader, const char *backend, bool equalizer, struct bench_samples *frame_times, size_t *frames) {
+	struct download_state *state = bench_create_state(file);
+	struct decoder *decoder = state ? decoder_open(state, reader, backend, equalizer) : NULL;
+	if(!decoder) {
+		fprintf(stderr, "failed to open decoder for `%s`\n", file->name);
+		free(state);
+		return 0;
+	}
+
+	double audio_secs = 0;
+	size_t bytes;
+	unsigned char *audio;
+
+	int err;
+	do {
+		double start = now_us();
+		err = decoder_decode_frame(decoder, &audio, &bytes);
+		double end = now_us();
+
+		switch(err) {
+			case MPG123_NEW_FORMAT: sink_set_format(decoder); break;
+			case MPG123_OK: {
+				samples_add(frame_times, end - start);
+				(*frames)++;
+				sink_bytes += bytes;
+				if(sink_frame_size && sink_rate) {
+					audio_secs += (double) (bytes / sink_frame_size) / sink_rate;
+				}
+				break;
+			}
+			default: break;
+		}
+	} while(MPG123_OK == err || MPG123_NEW_FORMAT == err);
+
+	decoder_close(decoder);
+	free(state);
+	return audio_secs;
+}
+
+/** \brief Seek to random positions within a file, recording the time until the first frame is decoded
+ */
+static void bench_seek_file(struct bench_file *file, enum decoder_reader reader, const char *backend, bool equalizer, double duration, struct bench_samples *seek_times) {
+	if(duration < 1) {
+		return;
+	}
+
+	struct download_state *state = bench_create_state(file);
+	struct decoder *decoder = state ? decoder_open(state, reader, backend, equalizer) : NULL;
+	if(!decoder) {
+		free(state);
+		return;
+	}
+
+	size_t bytes;
+	unsigned char *audio;
+
+	// the format is required prior to seeking
+	int err;
+	while(MPG123_NEW_FORMAT == (err = decoder_decode_frame(decoder, &audio, &bytes)));
+
+	unsigned int seed = 42;
+	for(unsigned int i = 0; i < seeks_per_file && MPG123_OK == err; i++) {
+		unsigned int target = rand_r(&seed) % (unsigned int) duration;
+
+		double start = now_us();
+		if(decoder_seek(decoder, target)) {
+			while(MPG123_NEW_FORMAT == (err = decoder_decode_frame(decoder, &audio, &bytes)));
+			samples_add(seek_times, (now_us() - start) / 1000);
+		}
+	}
+
+	decoder_close(decoder);
+	free(state);
+}
+
+static void bench_run(FILE *out, const char *backend, enum decoder_reader reader, bool equalizer) {
+	struct bench_samples frame_times = { lcalloc(BENCH_MAX_SAMPLES, sizeof(double)), 0 };
+	struct bench_samples seek_times  = { lcalloc(BENCH_MAX_SAMPLES, sizeof(double)), 0 };
+	if(!frame_times.values || !seek_times.values) {
+		return;
+	}
+
+	// the samples are not part of the pipeline measured: make them resident prior to taking the baseline
+	memset(frame_times.values, 0, BENCH_MAX_SAMPLES * sizeof(double));
+	memset(seek_times.values,  0, BENCH_MAX_SAMPLES * sizeof(double));
+	const long rss_baseline = rss_reset_peak();
+
+	size_t frames = 0;
+	double audio_secs = 0;
+
+	double start = now_us();
+	for(size_t i = 0; i < file_count; i++) {
+		files[i].duration = bench_decode_file(&files[i], reader, backend, equalizer, &frame_times, &frames);
+		audio_secs += files[i].duration;
+	}
+	double wall_us = now_us() - start;
+
+	for(size_t i = 0; i < file_count; i++) {
+		bench_seek_file(&files[i], reader, backend, equalizer, files[i].duration, &seek_times);
+	}
+
+	qsort(frame_times.values, frame_times.count, sizeof(double), compare_doubles);
+	qsort(seek_times.values,  seek_times.count,  sizeof(double), compare_doubles);
+
+	const long rss_peak  = proc_status_kb("VmHWM");
+	const long rss_delta = (0 <= rss_baseline && 0 <= rss_peak) ? rss_peak - rss_baseline : -1;
+
+	const char *reader_name = (reader_feed == reader) ? "feed" : "callback";
+
+	fprintf(out, "{\"label\":\"%s\",\"decoder\":\"%s\",\"reader\":\"%s\",\"equalizer\":%s,", label, backend, reader_name, equalizer ? "true" : "false");
+	fprintf(out, "\"files\":%zu,\"frames\":%zu,\"audio_s\":%.3f,\"wall_s\":%.3f,", file_count, frames, audio_secs, wall_us / 1e6);
+	fprintf(out, "\"rtf\":%.6f,\"us_per_frame\":%.3f,\"us_per_frame_p99\":%.3f,", audio_secs > 0 ? wall_us / 1e6 / audio_secs : 0, frames ? wall_us / frames : 0, samples_percentile(&frame_times, 0.99));
+	fprintf(out, "\"rss_delta_kb\":%ld,", rss_delta);
+	fprintf(out, "\"seek_ms\":{\"n\":%zu,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n", seek_times.count,
+		samples_percentile(&seek_times, 0.5), samples_percentile(&seek_times, 0.9), samples_percentile(&seek_times, 0.99), samples_percentile(&seek_times, 1));
+	fflush(out);
+
+	fprintf(stderr, "%-12s %-8s eq:%-3s  rtf: %.4f  %8.2fus/frame  seek p50: %7.2fms  rss: +%ldkB\n", backend, reader_name, equalizer ? "on" : "off",
+		audio_secs > 0 ? wall_us / 1e6 / audio_secs : 0, frames ? wall_us / frames : 0, samples_percentile(&seek_times, 0.5), rss_delta);
+
+	free(frame_times.values);
+	free(seek_times.values);
+}
+
+static bool load_files(const char *dir) {
+	DIR *dh = opendir(dir);
+	if(!dh) {
+		fprintf(stderr, "opendir(%s): %s\n", dir, strerror(errno));
+		return false;
+	}
+
+	struct dirent *entry;
+	while( (entry = readdir(dh)) && file_count < BENCH_MAX_FILES ) {
+		size_t len = strlen(entry->d_name);
+		if(len < 4 || strcmp(entry->d_name + len - 4, ".mp3")) {
+			continue;
+		}
+
+		char *path = smprintf("%s/%s", dir, entry->d_name);
+		if(!path) continue;
+
+		files[file_count].data = file_read_contents(path, file_access_populate);
+		if(files[file_count].data.data) {
+			files[file_count].name = path;
+			file_count++;
+		} else {
+			free(path);
+		}
+	}
+	closedir(dh);
+
+	return 0 != file_count;
+}
+
+static bool is_supported(const char *backend) {
+	const char **supported = mpg123_supported_decoders();
+	for(size_t i = 0; supported[i]; i++) {
+		if(streq(supported[i], backend)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char **argv) {
+	const char *output = NULL;
+
+	int opt;
+	while(-1 != (opt = getopt(argc, argv, "o:l:s:"))) {
+		switch(opt) {
+			case 'o': output = optarg; break;
+			case 'l': label  = optarg; break;
+			case 's': seeks_per_file = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-o results.json] [-l label] [-s seeks per file] <directory of mp3s>\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if(optind >= argc) {
+		fprintf(stderr, "usage: %s [-o results.json] [-l label] [-s seeks per file] <directory of mp3s>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(!log_init("bench_decode.log")) {
+		return EXIT_FAILURE;
+	}
+
+	if(!load_files(argv[optind])) {
+		fprintf(stderr, "no mp3s found in `%s`\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *out = output ? fopen(output, "a") : stdout;
+	if(!out) {
+		fprintf(stderr, "fopen(%s): %s\n", output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	mpg123_init();
+
+	const char **backends = mpg123_decoders();
+	for(size_t b = 0; backends[b]; b++) {
+		if(!is_supported(backends[b])) {
+			fprintf(stderr, "%-12s not supported on this CPU, skipping\n", backends[b]);
+			continue;
+		}
+
+		const enum decoder_reader readers[] = {reader_callback, reader_feed};
+		for(size_t r = 0; r < sizeof(readers) / sizeof(readers[0]); r++) {
+			for(int equalizer = 0; equalizer <= 1; equalizer++) {
+				// run each combination in a process of its own to get the growth of its RSS
+				fflush(out);
+				pid_t pid = fork();
+				if(!pid) {
+					bench_run(out, backends[b], readers[r], equalizer);
+					fflush(out);
+					_exit(EXIT_SUCCESS);
+				} else if(0 < pid) {
+					waitpid(pid, NULL, 0);
+				} else {
+					fprintf(stderr, "fork: %s\n", strerror(errno));
+				}
+			}
+		}
+	}
+
+	mpg123_exit();
+
+	if(output) {
+		fclose(out);
+	}
+
+	for(size_t i = 0; i < file_count; i++) {
+		file_release_contents(files[i].data);
+		free(files[i].name);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,408 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file tracks.c
+ *  \brief Benchmark of building and handling large track_lists
+ *
+ *  Generates a stream of tracks as returned by soundcloud.com (pages of BENCH_PAGE_SIZE tracks, a few hundred users)
+ *  and builds a list from it, once per strategy:
+ *  - `pages`: a list per page, appended to each other and merged with the (empty) cached list afterwards (the way
+ *    lists were built before track_list_builder)
+ *  - `region`: all pages parsed into a single track_list_builder (the way soundcloud_get_entries() builds lists)
+ *
+ *  The results are written as JSON, one object per line and strategy:
+ *  - `mallocs`, `callocs`, `reallocs`, `strdups`: the number of calls to the allocation wrappers (requires a build without `NDEBUG`)
+ *  - `build_ms`: the time required for parsing the pages and building the list
+ *
+ *  Afterwards the list is split into one list per user, which are merged into a stream again, once via
+ *  track_list_merge() followed by track_list_sort() and once via track_list_merge_sorted() (`merge_ms`).
+ *
+ *  Finally a synthetic list of BENCH_DEFAULT_HOT_TRACKS tracks (`-s`, built without parsing any JSON) is sorted,
+ *  once by sorting the tracks themselves (`sort_tracks`, the way track_list_sort() sorted before sorting a hot view) and
+ *  once via track_list_sort() (`sort_hot`, `sort_ms`).
+ *
+ *  Searching is measured on a synthetic list of BENCH_DEFAULT_SEARCH_TRACKS tracks (`-f`) with varying titles: each
+ *  query is searched from the start to the end of the list (repeating search-next), once comparing against each
+ *  track (`search_linear`, the way search_direction() searched before the trigram index) and once via the trigram
+ *  index (`search_trigram`, built synchronously beforehand: `index_ms`). `hits` and `search_ms` are per query.
+ */
+
+//\cond
+#include <errno.h>                      // for errno
+#include <stdio.h>                      // for fprintf, etc
+#include <stdlib.h>                     // for atol, free, qsort
+#include <string.h>                     // for strerror
+#include <time.h>                       // for clock_gettime, difftime, etc
+#include <unistd.h>                     // for getopt
+//\endcond
+
+#include "../src/helper.h"
+#include "../src/log.h"
+#include "../src/soundcloud.h"
+#include "../src/strpool.h"
+#include "../src/track.h"
+#include "../src/trigram.h"
+
+#define BENCH_DEFAULT_TRACKS 10000
+#define BENCH_PAGE_SIZE      200
+#define BENCH_USERS          300
+
+#define BENCH_DEFAULT_HOT_TRACKS 1000000
+
+/** \brief The default number of tracks of the list searched */
+#define BENCH_DEFAULT_SEARCH_TRACKS 100000
+
+/** \brief The maximum number of bytes of the JSON describing a single track */
+#define BENCH_TRACK_JSON_SIZE 512
+
+static const char *label = "";
+
+static double now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/** \brief Generate a page of tracks `first` to `first + count - 1` (newest first), linking the next page unless `last` */
+static char* bench_page(size_t first, size_t count, size_t total, bool last) {
+	const size_t size = (count + 1) * BENCH_TRACK_JSON_SIZE;
+	char *page = lmalloc(size);
+	size_t used = snprintf(page, size, "{\"collection\":[");
+
+	for(size_t i = first; i < first + count; i++) {
+		const size_t user = (i * 7919) % BENCH_USERS;
+		const time_t created_at = 1420070400 + (time_t) (total - i) * 3600;
+
+		char date[64];
+		strftime(date, sizeof(date), "%Y/%m/%d %H:%M:%S +0000", gmtime(&created_at));
+
+		used += snprintf(&page[used], size - used, "%s{\"id\":%zu,\"title\":\"Track %zu\",\"duration\":%zu,\"created_at\":\"%s\","
+			"\"stream_url\":\"https://api.soundcloud.com/tracks/%zu/stream\","
+			"\"permalink_url\":\"https://soundcloud.com/user%zu/track-%zu\",\"download_url\":null,"
+			"\"description\":\"Description of track %zu\",\"user\":{\"id\":%zu,\"username\":\"User %zu\"}}",
+			i > first ? "," : "", 100000 + i, i, 60000 + i % 300000, date, 100000 + i, user, i, i, 1000 + user, user);
+	}
+
+	snprintf(&page[used], size - used, last ? "]}" : "],\"next_href\":\"https://api.soundcloud.com/next\"}");
+	return page;
+}
+
+/** \brief Parse the pages the way lists were built before track_list_builder: a list per page, appended and merged */
+static struct track_list* bench_build_pages(char **pages, size_t page_count) {
+	struct track_list *list = NULL;
+	for(size_t i = 0; i < page_count; i++) {
+		struct track_list_builder builder = { .region = NULL };
+		char *href;
+		soundcloud_parse_response(pages[i], &href, &builder);
+		free(href);
+
+		struct track_list *part = track_list_builder_finish(&builder);
+		if(list) {
+			track_list_append(list, part);
+			track_list_destroy(part, false);
+		} else {
+			list = part;
+		}
+	}
+
+	struct track_list_builder empty = { .region = NULL };
+	struct track_list *cache_tracks = track_list_builder_finish(&empty);
+
+	struct track_list *lists[] = {list, cache_tracks, NULL};
+	struct track_list *result = track_list_merge(lists);
+	track_list_destroy(list, false);
+	track_list_destroy(cache_tracks, false);
+	return result;
+}
+
+/** \brief Parse the pages the way soundcloud_get_entries() does: all into a single region */
+static struct track_list* bench_build_region(char **pages, size_t page_count) {
+	struct track_list_builder builder = { .region = NULL };
+	for(size_t i = 0; i < page_count; i++) {
+		char *href;
+		soundcloud_parse_response(pages[i], &href, &builder);
+		free(href);
+	}
+
+	struct track_list_builder empty = { .region = NULL };
+	struct track_list *cache_tracks = track_list_builder_finish(&empty);
+
+	track_list_builder_append(&builder, cache_tracks);
+	track_list_destroy(cache_tracks, false);
+	return track_list_builder_finish(&builder);
+}
+
+static void bench_run(FILE *out, const char *strategy, struct track_list* (*build)(char**, size_t), char **pages, size_t page_count) {
+	struct alloc_counter before = { .mallocs = 0 }, after = { .mallocs = 0 };
+	ONLY_DEBUG( get_alloc_counter(&before); )
+
+	const double start = now_us();
+	struct track_list *list = build(pages, page_count);
+	const double build_us = now_us() - start;
+
+	ONLY_DEBUG( get_alloc_counter(&after); )
+
+	fprintf(out, "{\"label\":\"%s\",\"strategy\":\"%s\",\"tracks\":%zu,", label, strategy, list ? list->count : 0);
+	fprintf(out, "\"mallocs\":%u,\"callocs\":%u,\"reallocs\":%u,\"strdups\":%u,", after.mallocs - before.mallocs,
+		after.callocs - before.callocs, after.reallocs - before.reallocs, after.strdups - before.strdups);
+	fprintf(out, "\"build_ms\":%.3f}\n", build_us / 1e3);
+
+	track_list_destroy(list, true);
+}
+
+static void bench_merge_run(FILE *out, const char *strategy, struct track_list **lists, bool sorted) {
+	const double start = now_us();
+	struct track_list *list;
+	if(sorted) {
+		list = track_list_merge_sorted(lists);
+	} else {
+		list = track_list_merge(lists);
+		track_list_sort(list);
+	}
+	const double merge_us = now_us() - start;
+
+	fprintf(out, "{\"label\":\"%s\",\"strategy\":\"%s\",\"tracks\":%zu,\"merge_ms\":%.3f}\n", label, strategy, list ? list->count : 0, merge_us / 1e3);
+	track_list_destroy(list, false);
+}
+
+/** \brief Split the stream into one (sorted) list per user and merge these lists again */
+static void bench_merge(FILE *out, char **pages, size_t page_count) {
+	struct track_list *stream = bench_build_region(pages, page_count);
+
+	struct track_list *lists[BENCH_USERS + 1] = { NULL };
+	for(size_t i = 0; i < BENCH_USERS; i++) {
+		lists[i] = track_list_create("user");
+	}
+	for(size_t i = 0; i < stream->count; i++) {
+		track_list_add(lists[(stream->entries[i].user_id - 1000) % BENCH_USERS], &stream->entries[i]);
+	}
+
+	bench_merge_run(out, "merge_qsort",  lists, false);
+	bench_merge_run(out, "merge_sorted", lists, true);
+
+	for(size_t i = 0; i < BENCH_USERS; i++) {
+		track_list_destroy(lists[i], false);
+	}
+	track_list_destroy(stream, true);
+}
+
+/** \brief Build a list of `count` tracks, created in (pseudo) random order, each one an hour after another */
+static struct track_list* bench_synthetic_list(size_t count) {
+	struct track_list_builder builder = { .region = NULL };
+	for(size_t i = 0; i < count; i++) {
+		struct track *track = track_list_builder_add(&builder);
+		if(!track) {
+			track_list_builder_discard(&builder);
+			return NULL;
+		}
+
+		track->name          = strpool_intern("Track");
+		track->stream_url    = strpool_intern("https://api.soundcloud.com/tracks/0/stream");
+		track->permalink_url = strpool_intern("https://soundcloud.com/user/track");
+		track->username      = strpool_intern("User");
+		track->created_at    = 1420070400 + (time_t) ((i * 2654435761u) % count) * 3600;
+		track->duration      = 60 + (int) (i % 600);
+		track->user_id       = 1000 + (int) (i % BENCH_USERS);
+		track->track_id      = 100000 + (int) i;
+		track->url_count     = URL_COUNT_UNINITIALIZED;
+	}
+	return track_list_builder_finish(&builder);
+}
+
+/** \brief Compare two tracks by creation time, the way track_list_sort() did before sorting a hot view */
+static int bench_track_compare(const void *v1, const void *v2) {
+	const struct track *e1 = (const struct track*)v1;
+	if(!e1->name) e1 = e1->href;
+
+	const struct track *e2 = (const struct track*)v2;
+	if(!e2->name) e2 = e2->href;
+
+	return difftime(e2->created_at, e1->created_at);
+}
+
+static void bench_sort_run(FILE *out, const char *strategy, struct track_list *list, bool hot) {
+	const double start = now_us();
+	if(hot) {
+		track_list_sort(list);
+	} else {
+		qsort(list->entries, list->count, sizeof(struct track), bench_track_compare);
+	}
+	const double sort_us = now_us() - start;
+
+	fprintf(out, "{\"label\":\"%s\",\"strategy\":\"%s\",\"tracks\":%zu,\"sort_ms\":%.3f}\n", label, strategy, list->count, sort_us / 1e3);
+}
+
+/** \brief Sort a large list by sorting the tracks and by sorting a hot view */
+static void bench_hot(FILE *out, size_t track_count) {
+	struct track_list *list = bench_synthetic_list(track_count);
+	struct track_list *lists[] = {list, NULL};
+	struct track_list *copy = list ? track_list_merge(lists) : NULL;
+	if(!copy) {
+		fprintf(stderr, "failed to build a list of %zu tracks\n", track_count);
+		track_list_destroy(list, false);
+		return;
+	}
+
+	bench_sort_run(out, "sort_tracks", copy, false);
+	bench_sort_run(out, "sort_hot",    list, true);
+
+	track_list_destroy(copy, false);
+	track_list_destroy(list, false);
+}
+
+/** \brief The words the titles of the list searched are made of */
+static const char *bench_words[] = { "deep", "house", "mix", "live", "remix", "edit", "session", "radio", "summer", "night",
+                                     "techno", "set", "original", "dub", "ambient", "podcast", "episode", "vocal", "club", "tape" };
+#define BENCH_WORD_COUNT (sizeof(bench_words) / sizeof(bench_words[0]))
+
+/** \brief The queries searched for: frequent, rare and unique ones, a part of a username and one without any match */
+static const char *bench_queries[] = { "Remix", "summer night", "dub tape #4", "#54321 ", "user17", "no match", NULL };
+
+/** \brief Build a list of `count` tracks titled by three words and a number */
+static struct track_list* bench_search_list(size_t count) {
+	struct track_list_builder builder = { .region = NULL };
+	for(size_t i = 0; i < count; i++) {
+		struct track *track = track_list_builder_add(&builder);
+		if(!track) {
+			track_list_builder_discard(&builder);
+			return NULL;
+		}
+
+		const size_t hash = (i * 2654435761u) >> 4;
+		char *name     = smprintf("%s %s %s #%zu ", bench_words[hash % BENCH_WORD_COUNT], bench_words[(hash / BENCH_WORD_COUNT) % BENCH_WORD_COUNT],
+		                          bench_words[(hash / (BENCH_WORD_COUNT * BENCH_WORD_COUNT)) % BENCH_WORD_COUNT], i);
+		char *username = smprintf("user%zu", i % BENCH_USERS);
+		track->name      = strpool_intern(name);
+		track->username  = strpool_intern(username);
+		track->track_id  = 100000 + (int) i;
+		track->url_count = URL_COUNT_UNINITIALIZED;
+		free(name);
+		free(username);
+	}
+	return track_list_builder_finish(&builder);
+}
+
+/** \brief Find the next track containing `query` in its title or username, comparing against each track */
+static bool bench_find_linear(struct track_list *list, const char *query, size_t start, bool down UNUSED, size_t *pos) {
+	for(size_t i = start; i < list->count; i++) {
+		if(strcasestr(TRACK(list, i)->name, query) || strcasestr(TRACK(list, i)->username, query)) {
+			*pos = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void bench_search_run(FILE *out, const char *strategy, struct track_list *list, bool (*find)(struct track_list*, const char*, size_t, bool, size_t*)) {
+	size_t hits = 0;
+	size_t queries = 0;
+	const double start = now_us();
+	for(size_t q = 0; bench_queries[q]; q++, queries++) {
+		size_t pos = 0;
+		while(find(list, bench_queries[q], pos, true, &pos)) {
+			hits++;
+			pos++;
+		}
+	}
+	const double search_us = (now_us() - start) / queries;
+
+	fprintf(out, "{\"label\":\"%s\",\"strategy\":\"%s\",\"tracks\":%zu,\"hits\":%zu,\"search_ms\":%.3f}\n",
+		label, strategy, list->count, hits / queries, search_us / 1e3);
+}
+
+/** \brief Search a list by comparing against each track and via the trigram index */
+static void bench_search(FILE *out, size_t track_count) {
+	struct track_list *list = bench_search_list(track_count);
+	if(!list) {
+		fprintf(stderr, "failed to build a list of %zu tracks\n", track_count);
+		return;
+	}
+
+	bench_search_run(out, "search_linear", list, bench_find_linear);
+
+	// no background thread running: the index is built synchronously
+	const double start = now_us();
+	const bool indexed = trigram_index_create(list);
+	const double index_us = now_us() - start;
+	if(indexed) {
+		fprintf(out, "{\"label\":\"%s\",\"strategy\":\"trigram_index\",\"tracks\":%zu,\"index_ms\":%.3f}\n", label, list->count, index_us / 1e3);
+		bench_search_run(out, "search_trigram", list, trigram_index_find);
+	}
+
+	track_list_destroy(list, false);
+}
+
+int main(int argc, char **argv) {
+	const char *output = NULL;
+	size_t track_count = BENCH_DEFAULT_TRACKS;
+	size_t hot_count   = BENCH_DEFAULT_HOT_TRACKS;
+	size_t search_count = BENCH_DEFAULT_SEARCH_TRACKS;
+
+	int opt;
+	while(-1 != (opt = getopt(argc, argv, "o:l:n:s:f:"))) {
+		switch(opt) {
+			case 'o': output = optarg; break;
+			case 'l': label  = optarg; break;
+			case 'n': track_count = (size_t) atol(optarg); break;
+			case 's': hot_count   = (size_t) atol(optarg); break;
+			case 'f': search_count = (size_t) atol(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-o results.json] [-l label] [-n number of tracks] [-s number of tracks sorted] [-f number of tracks searched]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if(!log_init("bench_tracks.log")) {
+		return EXIT_FAILURE;
+	}
+
+	FILE *out = output ? fopen(output, "a") : stdout;
+	if(!out) {
+		fprintf(stderr, "fopen(%s): %s\n", output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	const size_t page_count = (track_count + BENCH_PAGE_SIZE - 1) / BENCH_PAGE_SIZE;
+	char **pages = lcalloc(page_count, sizeof(char*));
+	for(size_t i = 0; i < page_count; i++) {
+		const size_t first = i * BENCH_PAGE_SIZE;
+		const size_t count = (first + BENCH_PAGE_SIZE < track_count) ? BENCH_PAGE_SIZE : track_count - first;
+		pages[i] = bench_page(first, count, track_count, i + 1 == page_count);
+	}
+
+	// warm up the string pool: both strategies intern the very same strings
+	struct track_list *warmup = bench_build_region(pages, page_count);
+	track_list_destroy(warmup, true);
+
+	bench_run(out, "pages",  bench_build_pages,  pages, page_count);
+	bench_run(out, "region", bench_build_region, pages, page_count);
+
+	bench_merge(out, pages, page_count);
+	bench_hot(out, hot_count);
+	bench_search(out, search_count);
+
+	for(size_t i = 0; i < page_count; i++) {
+		free(pages[i]);
+	}
+	free(pages);
+
+	if(out != stdout) {
+		fclose(out);
+	}
+	return EXIT_SUCCESS;
+}
@@ -39,6 +39,14 @@
 
 	#define MAX_LISTS 16
 
+	/** \brief The number of tracks that may be inserted into the stream (see cmd_pl_refresh()) without moving its tracks
+	 *
+	 *  The tracks are inserted in front of the stream without moving the tracks within: the room is allocated
+	 *  on startup, but does not occupy any memory until used. Once used up, the tracks are moved to make room for
+	 *  as many tracks again (see state_prepend_list()).
+	 */
+	#define STREAM_REFRESH_HEADROOM 65536
+
 	/** \brief Wrapper for __attribute__
 	 *
 	 *  Simple wrapper for __attribute__, may be used to get rid of attributes in a simple manner
@@ -77,6 +85,32 @@
 	 */
 	#define CACHE_DEFAULT_PATH "./cache/"
 
+	/** \brief The default ALSA period size (in frames) used in mmap mode
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`alsa_period_size`).
+	 *  1024 frames translate to ~23ms at 44.1kHz.
+	 */
+	#define ALSA_DEFAULT_PERIOD_SIZE 1024
+
+	/** \brief The default ALSA buffer size (in frames) used in mmap mode
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`alsa_buffer_size`).
+	 *  8192 frames translate to ~186ms at 44.1kHz, which is plenty to survive a busy system.
+	 */
+	#define ALSA_DEFAULT_BUFFER_SIZE 8192
+
+	/** \brief The default file written by the `wav` AO module
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`wav_file`).
+	 */
+	#define WAV_DEFAULT_FILE "sctc.wav"
+
+	/** \brief File (within the cache) holding the fastest mpg123 decoder per CPU model
+	 *
+	 *  Each line contains the decoder and the CPU model, separated by a tab.
+	 */
+	#define CACHE_DECODER_FILE "decoder.cache"
+
 	/** \brief Folder holding the cached streams
 	 *
 	 */
@@ -89,6 +123,59 @@
 	 */
 	#define CACHE_STREAM_EXT ".mp3"
 
+	/** \brief The file extension used for the loudness of cached streams.
+	 *
+	 *  The file is stored next to the stream and contains the integrated loudness (EBU R128) in LUFS.
+	 */
+	#define CACHE_LOUDNESS_EXT ".r128"
+
+	/** \brief The default target loudness (in LUFS) used for normalization
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`normalize_target`).
+	 */
+	#define NORMALIZE_DEFAULT_TARGET -16.0
+
+	/** \brief The default sample rate (in Hz) of the output
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`output_rate`).
+	 */
+	#define OUTPUT_DEFAULT_RATE 44100
+
+	/** \brief The default number of seconds buffered before playback starts (or resumes after a stall)
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`jitter_preroll`).
+	 *  The value is the lower bound, it is increased if the download is slow or its throughput varies.
+	 */
+	#define JITTER_DEFAULT_PREROLL 2.0
+
+	/** \brief The default budget (in MiB) of the in-memory tier of the cache
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`memory_cache_size`).
+	 */
+	#define MEMORY_CACHE_DEFAULT_SIZE 64
+
+	/** \brief The default realtime priority of the playback thread (`SCHED_FIFO` and `SCHED_RR` only)
+	 *
+	 *  Keep in mind: this is a default value, which can be modified by the user (`playback_priority`).
+	 */
+	#define PLAYBACK_DEFAULT_PRIORITY 10
+
+	/** \brief The size of the stack of the playback thread, if it is locked in memory (`playback_mlock`)
+	 */
+	#define PLAYBACK_STACK_SIZE ( 512 * 1024 )
+
+	/** \brief The number of bytes read ahead right after mapping a file accessed sequentially (a cached track)
+	 */
+	#define FILE_READAHEAD_SIZE ( 4 * 1024 * 1024 )
+
+	/** \brief The number of bytes read ahead after seeking within a mapped file
+	 */
+	#define FILE_WILLNEED_SIZE ( 1024 * 1024 )
+
+	/** \brief The number of seconds the page faults of the playback thread are logged for, starting with each track
+	 */
+	#define PLAYBACK_START_SECS 5
+
 	/** \brief Folder holding the cached lists
 	 *
 	 *  The folder specified here is *relative* to the config option `cache_path`
@@ -103,6 +190,12 @@
 	 */
 	#define CACHE_LIST_EXT ".jspf"
 
+	/** \brief File (within the cache) holding the descriptions of tracks (see descstore.h) */
+	#define CACHE_DESCRIPTION_DATA "descriptions.dat"
+
+	/** \brief File (within the cache) holding the index of the descriptions (see descstore.h) */
+	#define CACHE_DESCRIPTION_INDEX "descriptions.idx"
+
 	/** \brief Maximum download size for tracks
 	 *
 	 *  Limits the maximum size of track.
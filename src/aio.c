@@ -0,0 +1,640 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file aio.c
+ *  \brief Implementation of the asynchronous disk I/O
+ *
+ *  Submitted requests are appended to a single queue (protected by `queue_mutex`).
+ *  Using io_uring, the queue only holds requests not fitting into the ring: the submitting thread moves as
+ *  many requests as possible into the ring and submits them using a single syscall. A dedicated thread
+ *  reaps the completions, refills the ring and invokes the callbacks.
+ *  Using the fallback, a pool of threads takes the requests from the queue and executes them synchronously.
+ */
+
+#include "_hard_config.h"
+#include "aio.h"
+
+//\cond
+#include <errno.h>                      // for errno, EINTR, etc
+#include <fcntl.h>                      // for posix_fadvise, fcntl, etc
+#include <pthread.h>                    // for pthread_create, pthread_mutex_lock, etc
+#include <stdint.h>                     // for uintptr_t
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for memset, strerror
+#include <unistd.h>                     // for pread, pwrite, fdatasync, close
+#ifdef HAVE_IO_URING
+	#include <linux/io_uring.h>             // for io_uring_params, io_uring_sqe, etc
+	#include <sys/mman.h>                   // for mmap, munmap
+	#include <sys/syscall.h>                // for __NR_io_uring_setup, etc
+#endif
+//\endcond
+
+#include "helper.h"                     // for lcalloc
+#include "log.h"                        // for _log, _err
+
+/** \brief The number of threads executing requests (fallback only) */
+#define AIO_THREADS 2
+
+/** \brief The maximum number of requests submitted to the kernel at once (io_uring only) */
+#define AIO_QUEUE_DEPTH 64
+
+/** \brief The maximum number of bytes read or written by a single request (io_uring only, due to the size of `io_uring_sqe.len`) */
+#define AIO_MAX_SIZE ( 1024 * 1024 * 1024 )
+
+struct aio_batch {
+	size_t          pending; ///< The number of requests not completed yet
+	bool            success; ///< `false` if any of the requests failed
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+};
+
+/** \brief State of aio_write_file() */
+struct aio_file_write {
+	struct aio_request request;
+	void (*done)(void *ctx, bool success);
+	void *ctx;
+};
+
+static enum {
+	backend_none,
+	backend_io_uring,
+	backend_threads
+} backend = backend_none;
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_cond   = PTHREAD_COND_INITIALIZER; ///< Signalled on new requests (fallback only)
+static pthread_cond_t  idle_cond   = PTHREAD_COND_INITIALIZER; ///< Signalled once no request is outstanding
+
+static struct aio_request *queue_head = NULL;
+static struct aio_request *queue_tail = NULL;
+
+static size_t outstanding = 0;  ///< The number of requests submitted, but not completed yet
+static bool   terminate = false;
+
+static pthread_t threads[AIO_THREADS];
+static size_t    thread_count = 0;
+
+static void aio_finalize(void);
+
+/** \brief Complete a request: call its callback and notify the batch it belongs to */
+static void aio_complete(struct aio_request *request) {
+	// the request may be freed (or submitted again) by its callback
+	struct aio_batch *batch = request->batch;
+	const bool success = (0 <= request->result);
+
+	request->batch = NULL;
+	if(request->done) {
+		request->done(request);
+	}
+
+	if(batch) {
+		pthread_mutex_lock(&batch->mutex);
+		batch->success &= success;
+		if(!--batch->pending) {
+			pthread_cond_signal(&batch->cond);
+		}
+		pthread_mutex_unlock(&batch->mutex);
+	}
+
+	pthread_mutex_lock(&queue_mutex);
+	if(!--outstanding) {
+		pthread_cond_broadcast(&idle_cond);
+	}
+	pthread_mutex_unlock(&queue_mutex);
+}
+
+/** \brief Append a request to the queue (requires `queue_mutex`) */
+static void aio_queue_append(struct aio_request *request) {
+	request->next = NULL;
+	if(queue_tail) queue_tail->next = request;
+	else           queue_head = request;
+	queue_tail = request;
+}
+
+/** \brief Remove the first request from the queue (requires `queue_mutex`) */
+static struct aio_request* aio_queue_pop(void) {
+	struct aio_request *request = queue_head;
+	if(request) {
+		queue_head = request->next;
+		if(!queue_head) queue_tail = NULL;
+	}
+	return request;
+}
+
+#ifdef HAVE_IO_URING
+static int ring_fd = -1;
+
+static struct {
+	unsigned            *head;
+	unsigned            *tail;
+	unsigned            *mask;
+	unsigned            *array;
+	struct io_uring_sqe *sqes;
+	void                *ring;
+	size_t               ring_size;
+	size_t               sqes_size;
+} sq;
+
+static struct {
+	unsigned            *head;
+	unsigned            *tail;
+	unsigned            *mask;
+	struct io_uring_cqe *cqes;
+	void                *ring;
+	size_t               ring_size;
+} cq;
+
+static size_t inflight = 0; ///< The number of requests within the ring (protected by `queue_mutex`)
+
+/** \brief Submitted as IORING_OP_NOP to stop the thread reaping completions */
+static struct aio_request ring_terminate;
+
+static void ring_destroy(void) {
+	if(sq.sqes && MAP_FAILED != sq.sqes) munmap(sq.sqes, sq.sqes_size);
+	if(cq.ring && MAP_FAILED != cq.ring && cq.ring != sq.ring) munmap(cq.ring, cq.ring_size);
+	if(sq.ring && MAP_FAILED != sq.ring) munmap(sq.ring, sq.ring_size);
+
+	memset(&sq, 0, sizeof(sq));
+	memset(&cq, 0, sizeof(cq));
+
+	close(ring_fd);
+	ring_fd = -1;
+}
+
+/** \brief Check the kernel supports all opcodes required */
+static bool ring_probe(void) {
+	const __u8 required[] = { IORING_OP_NOP, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_FADVISE };
+
+	struct io_uring_probe *probe = lcalloc(1, sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+	if(!probe) {
+		return false;
+	}
+
+	bool supported = !syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST);
+	for(size_t i = 0; supported && i < sizeof(required) / sizeof(required[0]); i++) {
+		supported = (required[i] <= probe->last_op) && (probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED);
+	}
+
+	free(probe);
+	return supported;
+}
+
+static bool ring_init(void) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring_fd = (int) syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &params);
+	if(0 > ring_fd) {
+		_log("io_uring_setup: %s", strerror(errno));
+		return false;
+	}
+
+	if(!ring_probe()) {
+		_log("io_uring does not support all operations required");
+		ring_destroy();
+		return false;
+	}
+
+	sq.ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cq.ring_size = params.cq_off.cqes  + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		if(cq.ring_size > sq.ring_size) sq.ring_size = cq.ring_size;
+		cq.ring_size = sq.ring_size;
+	}
+
+	sq.ring = mmap(NULL, sq.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq.ring = sq.ring;
+	} else {
+		cq.ring = mmap(NULL, cq.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	}
+	sq.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	sq.sqes = mmap(NULL, sq.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+	if(MAP_FAILED == sq.ring || MAP_FAILED == cq.ring || MAP_FAILED == sq.sqes) {
+		_err("mmap: %s", strerror(errno));
+		ring_destroy();
+		return false;
+	}
+
+	char *sq_ring = sq.ring;
+	sq.head  = (unsigned*) (void*) &sq_ring[params.sq_off.head];
+	sq.tail  = (unsigned*) (void*) &sq_ring[params.sq_off.tail];
+	sq.mask  = (unsigned*) (void*) &sq_ring[params.sq_off.ring_mask];
+	sq.array = (unsigned*) (void*) &sq_ring[params.sq_off.array];
+
+	char *cq_ring = cq.ring;
+	cq.head = (unsigned*) (void*) &cq_ring[params.cq_off.head];
+	cq.tail = (unsigned*) (void*) &cq_ring[params.cq_off.tail];
+	cq.mask = (unsigned*) (void*) &cq_ring[params.cq_off.ring_mask];
+	cq.cqes = (struct io_uring_cqe*) (void*) &cq_ring[params.cq_off.cqes];
+
+	return true;
+}
+
+/** \brief Fill the next submission queue entry (requires `queue_mutex`) */
+static void ring_prep(struct aio_request *request) {
+	const unsigned tail  = *sq.tail;
+	const unsigned index = tail & *sq.mask;
+
+	struct io_uring_sqe *sqe = &sq.sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+	sqe->fd        = request->fd;
+	sqe->off       = (__u64) request->offset;
+	sqe->len       = (__u32) (request->size > AIO_MAX_SIZE ? AIO_MAX_SIZE : request->size);
+	sqe->user_data = (__u64) (uintptr_t) request;
+
+	if(&ring_terminate == request) {
+		sqe->opcode = IORING_OP_NOP;
+	} else {
+		switch(request->op) {
+			case aio_op_read:
+				sqe->opcode = IORING_OP_READ;
+				sqe->addr   = (__u64) (uintptr_t) request->buffer;
+				break;
+
+			case aio_op_write:
+				sqe->opcode = IORING_OP_WRITE;
+				sqe->addr   = (__u64) (uintptr_t) request->data;
+				break;
+
+			case aio_op_fdatasync:
+				sqe->opcode      = IORING_OP_FSYNC;
+				sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+				sqe->len         = 0;
+				break;
+
+			case aio_op_readahead:
+				sqe->opcode         = IORING_OP_FADVISE;
+				sqe->fadvise_advice = POSIX_FADV_WILLNEED;
+				break;
+
+			default:
+				sqe->opcode = IORING_OP_NOP;
+		}
+	}
+
+	sq.array[index] = index;
+	__atomic_store_n(sq.tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/** \brief Move as many queued requests as possible into the ring and submit them (requires `queue_mutex`)
+ *
+ *  The number of requests within the ring is limited to the size of the submission queue, so neither
+ *  the submission nor the completion queue (twice the size) may overflow.
+ */
+static void ring_flush(void) {
+	unsigned count = 0;
+	while(queue_head && inflight < AIO_QUEUE_DEPTH) {
+		ring_prep(aio_queue_pop());
+		inflight++;
+		count++;
+	}
+
+	while(count) {
+		long ret = syscall(__NR_io_uring_enter, ring_fd, count, 0, 0, NULL, 0);
+		if(0 > ret) {
+			if(EINTR == errno || EAGAIN == errno) {
+				continue;
+			}
+			_err("io_uring_enter: %s", strerror(errno));
+			break;
+		}
+		count -= (unsigned) ret;
+	}
+}
+
+static void* _thread_ring_function(void *unused UNUSED) {
+	bool running = true;
+	while(running) {
+		if(0 > syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) && EINTR != errno) {
+			_err("io_uring_enter: %s", strerror(errno));
+			break;
+		}
+
+		// reap all completions, the callbacks are invoked after the ring is refilled
+		struct aio_request *completed = NULL;
+		size_t reaped = 0;
+
+		unsigned head = *cq.head;
+		const unsigned tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+		for(; head != tail; head++) {
+			const struct io_uring_cqe *cqe = &cq.cqes[head & *cq.mask];
+			struct aio_request *request = (struct aio_request*) (uintptr_t) cqe->user_data;
+
+			if(&ring_terminate == request) {
+				running = false;
+			} else {
+				request->result = cqe->res;
+				request->next   = completed;
+				completed       = request;
+			}
+			reaped++;
+		}
+		__atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+
+		pthread_mutex_lock(&queue_mutex);
+		inflight -= reaped;
+		ring_flush();
+		pthread_mutex_unlock(&queue_mutex);
+
+		while(completed) {
+			struct aio_request *next = completed->next;
+			aio_complete(completed);
+			completed = next;
+		}
+	}
+
+	return NULL;
+}
+#endif /* HAVE_IO_URING */
+
+/** \brief Execute a request synchronously (fallback only) */
+static void aio_execute(struct aio_request *request) {
+	ssize_t ret;
+	int err;
+
+	switch(request->op) {
+		case aio_op_read:
+			do {
+				ret = pread(request->fd, request->buffer, request->size, request->offset);
+			} while(0 > ret && EINTR == errno);
+			request->result = (0 > ret) ? -errno : ret;
+			break;
+
+		case aio_op_write:
+			do {
+				ret = pwrite(request->fd, request->data, request->size, request->offset);
+			} while(0 > ret && EINTR == errno);
+			request->result = (0 > ret) ? -errno : ret;
+			break;
+
+		case aio_op_fdatasync:
+			request->result = fdatasync(request->fd) ? -errno : 0;
+			break;
+
+		case aio_op_readahead:
+			err = posix_fadvise(request->fd, request->offset, (off_t) request->size, POSIX_FADV_WILLNEED);
+			request->result = -err;
+			break;
+
+		default:
+			request->result = -EINVAL;
+	}
+}
+
+static void* _thread_worker_function(void *unused UNUSED) {
+	pthread_mutex_lock(&queue_mutex);
+	while(true) {
+		struct aio_request *request = aio_queue_pop();
+		if(!request) {
+			if(terminate) {
+				break;
+			}
+			pthread_cond_wait(&work_cond, &queue_mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&queue_mutex);
+
+		aio_execute(request);
+		aio_complete(request);
+
+		pthread_mutex_lock(&queue_mutex);
+	}
+	pthread_mutex_unlock(&queue_mutex);
+
+	return NULL;
+}
+
+bool aio_init(void) {
+#ifdef HAVE_IO_URING
+	if(ring_init()) {
+		int err = pthread_create(&threads[0], NULL, _thread_ring_function, NULL);
+		if(!err) {
+			thread_count = 1;
+			backend = backend_io_uring;
+		} else {
+			_err("pthread_create: %s", strerror(err));
+			ring_destroy();
+		}
+	}
+#endif
+
+	if(backend_none == backend) {
+		for(size_t i = 0; i < AIO_THREADS; i++) {
+			int err = pthread_create(&threads[thread_count], NULL, _thread_worker_function, NULL);
+			if(err) {
+				_err("pthread_create: %s", strerror(err));
+			} else {
+				thread_count++;
+			}
+		}
+
+		if(!thread_count) {
+			return false;
+		}
+		backend = backend_threads;
+	}
+
+	if(atexit(aio_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	_log("using %s for disk I/O", aio_backend());
+	return true;
+}
+
+const char* aio_backend(void) {
+	switch(backend) {
+		case backend_io_uring: return "io_uring";
+		case backend_threads:  return "threads";
+		case backend_none:     return "none";
+		default:               return "unknown";
+	}
+}
+
+/** \brief Submit requests, assigning them to a batch (may be `NULL`) */
+static void aio_enqueue(struct aio_request **requests, size_t count, struct aio_batch *batch) {
+	for(size_t i = 0; i < count; i++) {
+		requests[i]->batch  = batch;
+		requests[i]->result = 0;
+	}
+
+	pthread_mutex_lock(&queue_mutex);
+	outstanding += count;
+
+	// not initialized (or finalized already): execute the requests on the calling thread
+	const bool synchronous = (backend_none == backend || terminate);
+	if(!synchronous) {
+		for(size_t i = 0; i < count; i++) {
+			aio_queue_append(requests[i]);
+		}
+
+#ifdef HAVE_IO_URING
+		if(backend_io_uring == backend) {
+			ring_flush();
+		}
+#endif
+		if(backend_threads == backend) {
+			pthread_cond_broadcast(&work_cond);
+		}
+	}
+	pthread_mutex_unlock(&queue_mutex);
+
+	if(synchronous) {
+		for(size_t i = 0; i < count; i++) {
+			aio_execute(requests[i]);
+			aio_complete(requests[i]);
+		}
+	}
+}
+
+void aio_submit(struct aio_request **requests, size_t count) {
+	aio_enqueue(requests, count, NULL);
+}
+
+bool aio_submit_wait(struct aio_request **requests, size_t count) {
+	struct aio_batch batch = {
+		.pending = count,
+		.success = true,
+		.mutex   = PTHREAD_MUTEX_INITIALIZER,
+		.cond    = PTHREAD_COND_INITIALIZER
+	};
+
+	if(!count) {
+		return true;
+	}
+
+	aio_enqueue(requests, count, &batch);
+
+	pthread_mutex_lock(&batch.mutex);
+	while(batch.pending) {
+		pthread_cond_wait(&batch.cond, &batch.mutex);
+	}
+	pthread_mutex_unlock(&batch.mutex);
+
+	return batch.success;
+}
+
+static void aio_file_readahead_done(struct aio_request *request) {
+	close(request->fd);
+	free(request);
+}
+
+bool aio_file_readahead(int fd, off_t offset, size_t size) {
+	struct aio_request *request = lcalloc(1, sizeof(struct aio_request));
+	if(!request) {
+		return false;
+	}
+
+	request->op     = aio_op_readahead;
+	request->offset = offset;
+	request->size   = size;
+	request->done   = aio_file_readahead_done;
+	request->fd     = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if(0 > request->fd) {
+		_err("fcntl: %s", strerror(errno));
+		free(request);
+		return false;
+	}
+
+	aio_submit(&request, 1);
+	return true;
+}
+
+static void aio_write_file_done(struct aio_request *request) {
+	struct aio_file_write *file_write = request->ctx;
+
+	// short write: continue with the remaining data
+	if(0 < request->result && (size_t) request->result < request->size) {
+		request->data    = (const char*) request->data + request->result;
+		request->size   -= (size_t) request->result;
+		request->offset += request->result;
+
+		aio_submit(&request, 1);
+		return;
+	}
+
+	bool success = (0 <= request->result) && ((size_t) request->result == request->size);
+	if(!success) {
+		_err("failed to write file: %s", strerror(0 > request->result ? (int) -request->result : EIO));
+	}
+
+	if(close(request->fd)) {
+		_err("close: %s", strerror(errno));
+		success = false;
+	}
+
+	if(file_write->done) {
+		file_write->done(file_write->ctx, success);
+	}
+	free(file_write);
+}
+
+bool aio_write_file(int fd, off_t offset, const void *data, size_t size, void (*done)(void *ctx, bool success), void *ctx) {
+	struct aio_file_write *file_write = lcalloc(1, sizeof(struct aio_file_write));
+	if(!file_write) {
+		close(fd);
+		return false;
+	}
+
+	file_write->done = done;
+	file_write->ctx  = ctx;
+
+	file_write->request.op     = aio_op_write;
+	file_write->request.fd     = fd;
+	file_write->request.data   = data;
+	file_write->request.size   = size;
+	file_write->request.offset = offset;
+	file_write->request.done   = aio_write_file_done;
+	file_write->request.ctx    = file_write;
+
+	struct aio_request *request = &file_write->request;
+	aio_submit(&request, 1);
+	return true;
+}
+
+static void aio_finalize(void) {
+	pthread_mutex_lock(&queue_mutex);
+	while(outstanding) {
+		pthread_cond_wait(&idle_cond, &queue_mutex);
+	}
+	terminate = true;
+
+#ifdef HAVE_IO_URING
+	if(backend_io_uring == backend) {
+		aio_queue_append(&ring_terminate);
+		ring_flush();
+	}
+#endif
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&queue_mutex);
+
+	for(size_t i = 0; i < thread_count; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	thread_count = 0;
+
+#ifdef HAVE_IO_URING
+	if(backend_io_uring == backend) {
+		ring_destroy();
+	}
+#endif
+	backend = backend_none;
+}
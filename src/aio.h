@@ -0,0 +1,122 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file aio.h
+ *  \brief Asynchronous disk I/O
+ *
+ *  Requests are submitted in batches and completed by dedicated threads, such that the threads doing
+ *  networking, decoding or UI work never block on the disk.
+ *
+ *  If built with `IO_URING=yes` (see makefile), the requests are submitted via io_uring. If io_uring is not
+ *  available at runtime, or SCTC is built without it, a small pool of threads executes the requests instead.
+ *  Before aio_init() (and after finalization) requests are executed synchronously by the submitting thread.
+ */
+
+#ifndef _AIO_H
+	#define _AIO_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	#include <sys/types.h>                  // for off_t, ssize_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+
+	/** \brief The operations supported */
+	enum aio_op {
+		aio_op_read,      ///< Read `size` bytes at `offset` into `buffer`
+		aio_op_write,     ///< Write `size` bytes from `data` to `offset`
+		aio_op_fdatasync, ///< Flush the data written to `fd` (`fdatasync`)
+		aio_op_readahead  ///< Read `size` bytes at `offset` into the page cache (`size` 0: up to the end of the file)
+	};
+
+	struct aio_batch;
+
+	/** \brief A single request
+	 *
+	 *  The request (and its buffer) is owned by the caller and needs to stay valid until it is completed.
+	 */
+	struct aio_request {
+		enum aio_op op;
+		int         fd;
+		union {
+			void       *buffer;  ///< The buffer to read into (aio_op_read)
+			const void *data;    ///< The data to write (aio_op_write)
+		};
+		size_t      size;
+		off_t       offset;
+
+		ssize_t     result;      ///< The number of bytes transferred (or 0), `-errno` in case of failure
+
+		/** \brief Called (by an I/O thread) once the request is completed, may be `NULL`
+		 *
+		 *  The request may be freed or submitted again from within the callback.
+		 */
+		void (*done)(struct aio_request *request);
+		void       *ctx;         ///< Passed to `done` as part of the request
+
+		struct aio_request *next;  ///< Used internally
+		struct aio_batch   *batch; ///< Used internally
+	};
+
+	/** \brief Initialize the I/O engine: set up io_uring, falling back to a pool of threads
+	 *
+	 *  \return `true` on success, `false` otherwise
+	 */
+	bool aio_init(void);
+
+	/** \brief Returns the name of the backend in use ("io_uring" or "threads") */
+	const char* aio_backend(void);
+
+	/** \brief Submit a batch of requests, without waiting for their completion
+	 *
+	 *  \param requests  The requests
+	 *  \param count     The number of requests
+	 */
+	void aio_submit(struct aio_request **requests, size_t count) ATTR(nonnull);
+
+	/** \brief Submit a batch of requests and wait for all of them to complete
+	 *
+	 *  \param requests  The requests
+	 *  \param count     The number of requests
+	 *  \return          `true` if all requests succeeded, `false` otherwise (see aio_request.result)
+	 */
+	bool aio_submit_wait(struct aio_request **requests, size_t count) ATTR(nonnull);
+
+	/** \brief Asynchronously read (a range of) a file into the page cache
+	 *
+	 *  \param fd      The file, duplicated: `fd` may be closed immediately
+	 *  \param offset  The offset to start at
+	 *  \param size    The number of bytes, 0 up to the end of the file
+	 *  \return        `true` on success, `false` otherwise
+	 */
+	bool aio_file_readahead(int fd, off_t offset, size_t size);
+
+	/** \brief Asynchronously write a whole buffer to a file (starting at `offset`) and close it
+	 *
+	 *  \param fd      The file, owned (and closed) by the I/O engine from now on
+	 *  \param offset  The offset to write the data to, 0 for writing a file from scratch
+	 *  \param data    The data, needs to stay valid until `done` is called
+	 *  \param size    The number of bytes to write
+	 *  \param done    Called (by an I/O thread) once the file is written and closed, may be `NULL`
+	 *  \param ctx     Passed to `done`
+	 *  \return        `true` on success, `false` in case of a failing malloc (`fd` is closed, `done` is not called)
+	 */
+	bool aio_write_file(int fd, off_t offset, const void *data, size_t size, void (*done)(void *ctx, bool success), void *ctx) ATTR(nonnull(3));
+#endif /* _AIO_H */
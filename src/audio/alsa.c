@@ -22,12 +22,15 @@
 //\cond
 #include <assert.h>
 #include <errno.h>                      // for errno
+#include <poll.h>                       // for poll, pollfd
 #include <stddef.h>                     // for NULL, size_t
 #include <stdlib.h>                     // for atexit
-#include <string.h>                     // for strerror
+#include <string.h>                     // for strerror, memcpy
 #include <pthread.h>
 //\endcond
 
+#include "ao_module.h"                  // for audio_stats
+#include "../config.h"                  // for config_get_alsa_*
 #include "../log.h"
 #include "../state.h"
 
@@ -49,6 +52,14 @@ static snd_mixer_elem_t *elem;
 static long              min;
 static long              range;
 
+static bool              use_mmap;       ///< `true` if the PCM was set up for SND_PCM_ACCESS_MMAP_INTERLEAVED
+static snd_pcm_uframes_t period_size;    ///< the period size (in frames) negotiated with the hardware
+static snd_pcm_uframes_t buffer_size;    ///< the buffer size (in frames) negotiated with the hardware
+static unsigned int      current_rate;   ///< the rate set by the latest call to audio_set_format
+static snd_pcm_format_t  current_format = SND_PCM_FORMAT_UNKNOWN; ///< the format set by the latest successful call to audio_set_format
+static unsigned int      current_channels; ///< the number of channels set by the latest successful call to audio_set_format
+static volatile unsigned int xruns = 0;  ///< the number of underruns (and suspends) recovered from
+
 static bool alsa_recover(int err) {
 
 	if(-ESTRPIPE == err) {
@@ -62,6 +73,8 @@ static bool alsa_recover(int err) {
 	}
 
 	if(-EPIPE == err) {
+		xruns++;
+
 		// recover from underrun (or from failed `snd_pcm_resume`)
 		if( (err = snd_pcm_prepare(pcm)) < 0 ) {
 			_log("libalsa: snd_pcm_prepare failed: %s", snd_strerror(err));
@@ -72,10 +85,119 @@ static bool alsa_recover(int err) {
 	return true;
 }
 
+/** \brief Wait for the PCM to accept (at least) one more period
+ *
+ *  The software parameters set `avail_min` to one period, therefore the PCM's descriptors
+ *  become writable once per period and the writer sleeps in between.
+ *
+ *  \return  `true` if the PCM is ready for writing, `false` if an error occured (the caller is expected to recover)
+ */
+static bool alsa_wait_period(void) {
+	int pdc = snd_pcm_poll_descriptors_count(pcm);
+	if(0 >= pdc) {
+		_log("libalsa: failed to get number of poll descriptors");
+		return false;
+	}
+
+	struct pollfd pfds[pdc];
+	if(0 >= (pdc = snd_pcm_poll_descriptors(pcm, pfds, pdc))) {
+		_log("libalsa: failed to get pfds");
+		return false;
+	}
+
+	// wait at most the duration of the whole buffer, there is something wrong otherwise
+	int timeout = current_rate ? (int) ((1000 * buffer_size) / current_rate) + 1 : -1;
+
+	while(true) {
+		int ret = poll(pfds, pdc, timeout);
+		if(0 > ret) {
+			if(EINTR == errno) continue;
+			_log("poll returned: %i - %s", ret, strerror(errno));
+			return false;
+		}
+
+		if(!ret) {
+			_log("libalsa: timeout waiting for pcm");
+			return false;
+		}
+
+		unsigned short revents;
+		snd_pcm_poll_descriptors_revents(pcm, pfds, pdc, &revents);
+		if(revents & POLLERR) return false;
+		if(revents & POLLOUT) return true;
+	}
+}
+
+/** \brief Write interleaved frames directly to the mmapped ring buffer
+ *
+ *  \param buffer  The buffer containing the data
+ *  \param frames  The number of frames in `buffer`
+ *  \return        The number of frames actually written
+ */
+static snd_pcm_uframes_t alsa_write_mmap(const char *buffer, snd_pcm_uframes_t frames) {
+	const size_t frame_bytes = snd_pcm_frames_to_bytes(pcm, 1);
+
+	snd_pcm_uframes_t frames_done = 0;
+	while(frames_done < frames) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+		if(0 > avail) {
+			if(!alsa_recover(avail)) break;
+			continue;
+		}
+
+		// do not wake up for less than a period (unless there is less than a period left to write)
+		snd_pcm_uframes_t remaining = frames - frames_done;
+		snd_pcm_uframes_t required  = remaining < period_size ? remaining : period_size;
+		if((snd_pcm_uframes_t) avail < required) {
+			// the ring buffer is full, but the start threshold was not reached (yet)
+			if(SND_PCM_STATE_PREPARED == snd_pcm_state(pcm)) {
+				int err = snd_pcm_start(pcm);
+				if(0 > err && !alsa_recover(err)) break;
+			}
+
+			if(!alsa_wait_period()) {
+				snd_pcm_state_t pcm_state = snd_pcm_state(pcm);
+				int err = (SND_PCM_STATE_SUSPENDED == pcm_state) ? -ESTRPIPE : -EPIPE;
+				if(SND_PCM_STATE_XRUN != pcm_state && SND_PCM_STATE_SUSPENDED != pcm_state) break;
+				if(!alsa_recover(err)) break;
+			}
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t chunk = remaining < (snd_pcm_uframes_t) avail ? remaining : (snd_pcm_uframes_t) avail;
+
+		int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &chunk);
+		if(0 > err) {
+			if(!alsa_recover(err)) break;
+			continue;
+		}
+
+		// interleaved access: all channels share the first area
+		char *dst = (char*) areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+		memcpy(dst, buffer + frames_done * frame_bytes, chunk * frame_bytes);
+
+		snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm, offset, chunk);
+		if(0 > committed || (snd_pcm_uframes_t) committed != chunk) {
+			if(!alsa_recover(0 > committed ? committed : -EPIPE)) break;
+			continue;
+		}
+
+		frames_done += chunk;
+	}
+
+	return frames_done;
+}
+
 size_t audio_play(void *buffer, size_t size) {
 
 	snd_pcm_uframes_t frames = snd_pcm_bytes_to_frames(pcm, size);
 
+	if(use_mmap) {
+		return snd_pcm_frames_to_bytes(pcm, alsa_write_mmap(buffer, frames));
+	}
+
 	snd_pcm_sframes_t frames_played = snd_pcm_writei(pcm, buffer, frames);;
 	if(frames_played < 0) {
 		alsa_recover(frames_played);
@@ -84,6 +206,28 @@ size_t audio_play(void *buffer, size_t size) {
 	return frames_played < 0 ? 0 : snd_pcm_frames_to_bytes(pcm, frames_played);
 }
 
+void audio_drop(void) {
+	snd_pcm_drop(pcm);
+	snd_pcm_prepare(pcm);
+}
+
+bool audio_get_stats(struct audio_stats *stats) {
+	stats->xruns       = xruns;
+	stats->delay_ms    = 0;
+	stats->period_size = period_size;
+	stats->buffer_size = buffer_size;
+
+	snd_pcm_sframes_t delay;
+	if(!current_rate || 0 > snd_pcm_delay(pcm, &delay)) {
+		return false;
+	}
+
+	if(0 < delay) {
+		stats->delay_ms = (unsigned int) ((1000 * delay) / current_rate);
+	}
+	return true;
+}
+
 static snd_pcm_format_t mpg123_to_alsa_encoding(unsigned int mpg123_encoding) {
 	switch(mpg123_encoding) {
 		case MPG123_ENC_SIGNED_8:    return SND_PCM_FORMAT_S8;
@@ -95,16 +239,85 @@ static snd_pcm_format_t mpg123_to_alsa_encoding(unsigned int mpg123_encoding) {
 	return 0;
 }
 
+/** \brief Set up the PCM for mmapped access using explicit period and buffer sizes
+ *
+ *  \param format    The sample format
+ *  \param rate      The rate
+ *  \param channels  The number of channels
+ *  \return          `true` on success, `false` otherwise (the caller may fall back to snd_pcm_set_params)
+ */
+static bool alsa_set_params_mmap(snd_pcm_format_t format, unsigned int rate, unsigned int channels) {
+	int err;
+	snd_pcm_hw_params_t *hwp;
+	snd_pcm_sw_params_t *swp;
+	snd_pcm_hw_params_alloca(&hwp);
+	snd_pcm_sw_params_alloca(&swp);
+
+	#define ALSA_PARAM_CHECK(FUN) if( 0 > (err = FUN) ) {_log("libalsa: "#FUN" failed: %s", snd_strerror(err)); return false;}
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_any(pcm, hwp) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_access(pcm, hwp, SND_PCM_ACCESS_MMAP_INTERLEAVED) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_format(pcm, hwp, format) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_channels(pcm, hwp, channels) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_rate(pcm, hwp, rate, 0) );
+
+	period_size = config_get_alsa_period_size();
+	buffer_size = config_get_alsa_buffer_size();
+	if(buffer_size < 2 * period_size) {
+		buffer_size = 2 * period_size;
+	}
+
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_period_size_near(pcm, hwp, &period_size, NULL) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params_set_buffer_size_near(pcm, hwp, &buffer_size) );
+	ALSA_PARAM_CHECK( snd_pcm_hw_params(pcm, hwp) );
+
+	// the values actually chosen by the hardware
+	snd_pcm_hw_params_get_period_size(hwp, &period_size, NULL);
+	snd_pcm_hw_params_get_buffer_size(hwp, &buffer_size);
+
+	// wake up once per period, start as soon as all but one period are filled
+	ALSA_PARAM_CHECK( snd_pcm_sw_params_current(pcm, swp) );
+	ALSA_PARAM_CHECK( snd_pcm_sw_params_set_avail_min(pcm, swp, period_size) );
+	ALSA_PARAM_CHECK( snd_pcm_sw_params_set_start_threshold(pcm, swp, buffer_size - period_size) );
+	ALSA_PARAM_CHECK( snd_pcm_sw_params(pcm, swp) );
+	#undef ALSA_PARAM_CHECK
+
+	_log("libalsa: mmap access, period: %lu frames, buffer: %lu frames (%u Hz)", period_size, buffer_size, rate);
+	return true;
+}
+
 bool audio_set_format(unsigned int encoding, unsigned int rate, unsigned int channels) {
 	int err;
 	snd_pcm_format_t format = mpg123_to_alsa_encoding(encoding);
 
+	// the samples queued already are played in the format set, do not cut them off
+	if(format == current_format && rate == current_rate && channels == current_channels) {
+		return true;
+	}
+
+	// hw params can only be changed if the PCM is not running: only drop the samples queued in another format
+	snd_pcm_drop(pcm);
+	current_format = SND_PCM_FORMAT_UNKNOWN;
+	current_rate   = rate;
+
+	if(config_get_alsa_mmap()) {
+		use_mmap = alsa_set_params_mmap(format, rate, channels);
+		if(use_mmap) {
+			current_format   = format;
+			current_channels = channels;
+			return true;
+		}
+		_log("libalsa: mmap access not available, falling back to SND_PCM_ACCESS_RW_INTERLEAVED");
+	}
+
 	_log("snd_pcm_set_params(pcm, %x, SND_PCM_ACCESS_RW_INTERLEAVED, %i, %i, 1, 0)", format, channels, rate);
 	if( (err = snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED, channels, rate, 1, 0)) ) {
 		_log("libalsa: snd_pcm_set_params failed: %s", snd_strerror(err));
 		return false;
 	}
+	snd_pcm_get_params(pcm, &buffer_size, &period_size);
 
+	current_format   = format;
+	current_channels = channels;
 	return true;
 }
 
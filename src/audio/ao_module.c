@@ -3,13 +3,14 @@
 //\cond
 #include <dlfcn.h>
 #include <stdint.h>
+#include <string.h>                     // for memset
 //\endcond
 
 #include "../log.h"
 
 static void *dl_ao = NULL;
 
-bool ao_module_load(char *lib, audio_init_t *audio_init, audio_play_t *audio_play, audio_set_format_t *audio_set_format, audio_get_volume_t *audio_get_volume, audio_change_volume_t *audio_change_volume) {
+bool ao_module_load(char *lib, struct ao_module *module) {
 	dl_ao = dlopen(lib, RTLD_NOW | RTLD_GLOBAL);
 	if(!dl_ao) {
 		_log("Not using %s: %s", lib, dlerror());
@@ -17,18 +18,18 @@ bool ao_module_load(char *lib, audio_init_t *audio_init, audio_play_t *audio_pla
 	}
 
 	// ofc this is ugly, but things will not work otherwise
-	*audio_init          = (audio_init_t)          (intptr_t) dlsym(dl_ao, "audio_init");
-	*audio_play          = (audio_play_t)          (intptr_t) dlsym(dl_ao, "audio_play");
-	*audio_get_volume    = (audio_get_volume_t)    (intptr_t) dlsym(dl_ao, "audio_get_volume");
-	*audio_change_volume = (audio_change_volume_t) (intptr_t) dlsym(dl_ao, "audio_change_volume");
-	*audio_set_format    = (audio_set_format_t)    (intptr_t) dlsym(dl_ao, "audio_set_format");
-
-	if(!*audio_init || !*audio_play || !*audio_set_format) {
-		*audio_init          = NULL;
-		*audio_play          = NULL;
-		*audio_get_volume    = NULL;
-		*audio_change_volume = NULL;
-		*audio_set_format    = NULL;
+	module->audio_init          = (audio_init_t)          (intptr_t) dlsym(dl_ao, "audio_init");
+	module->audio_play          = (audio_play_t)          (intptr_t) dlsym(dl_ao, "audio_play");
+	module->audio_get_volume    = (audio_get_volume_t)    (intptr_t) dlsym(dl_ao, "audio_get_volume");
+	module->audio_change_volume = (audio_change_volume_t) (intptr_t) dlsym(dl_ao, "audio_change_volume");
+	module->audio_set_format    = (audio_set_format_t)    (intptr_t) dlsym(dl_ao, "audio_set_format");
+	module->audio_drop          = (audio_drop_t)          (intptr_t) dlsym(dl_ao, "audio_drop");
+	module->audio_get_stats     = (audio_get_stats_t)     (intptr_t) dlsym(dl_ao, "audio_get_stats");
+
+	if(!module->audio_init || !module->audio_play || !module->audio_set_format) {
+		memset(module, 0, sizeof(*module));
+		dlclose(dl_ao);
+		dl_ao = NULL;
 		return false;
 	}
 
@@ -36,5 +37,5 @@ bool ao_module_load(char *lib, audio_init_t *audio_init, audio_play_t *audio_pla
 }
 
 void ao_module_unload(void) {
-	dlclose(dl_ao);
+	if(dl_ao) dlclose(dl_ao);
 }
@@ -73,7 +73,56 @@
 	 */
 	typedef bool (*audio_init_t)(void);
 
-	bool ao_module_load(char *lib, audio_init_t *audio_init, audio_play_t *audio_play, audio_set_format_t *audio_set_format, audio_get_volume_t *audio_get_volume, audio_change_volume_t *audio_change_volume);
+	/** \brief The type of the function used to discard all samples queued, but not yet played.
+	 *
+	 *  The corresponding function is expected to be exported as *audio_drop* in the final module.
+	 *  It is called after stopping and seeking, so the change is audible immediately.
+	 *
+	 *  \remark This function is *optional*.
+	 */
+	typedef void (*audio_drop_t)(void);
+
+	/** \brief Statistics of the output, as reported by *audio_get_stats*
+	 */
+	struct audio_stats {
+		unsigned int  xruns;        ///< The number of underruns recovered from since initialization
+		unsigned int  delay_ms;     ///< The measured delay (in ms) until a sample written now is audible
+		unsigned long period_size;  ///< The period size (in frames) currently used
+		unsigned long buffer_size;  ///< The buffer size (in frames) currently used
+	};
+
+	/** \brief The type of the function used to get the output's statistics.
+	 *
+	 *  The corresponding function is expected to be exported as *audio_get_stats* in the final module.
+	 *
+	 *  \remark This function is *optional*.
+	 *
+	 *  \param stats  The struct to write the statistics to
+	 *  \returns      `true` on success, `false` otherwise
+	 */
+	typedef bool (*audio_get_stats_t)(struct audio_stats *stats);
+
+	/** \brief The functions exported by an AO module
+	 *
+	 *  Optional functions not exported by the module are set to `NULL`.
+	 */
+	struct ao_module {
+		audio_init_t          audio_init;           ///< *required*, see audio_init_t
+		audio_play_t          audio_play;           ///< *required*, see audio_play_t
+		audio_set_format_t    audio_set_format;     ///< *required*, see audio_set_format_t
+		audio_get_volume_t    audio_get_volume;     ///< *optional*, see audio_get_volume_t
+		audio_change_volume_t audio_change_volume;  ///< *optional*, see audio_change_volume_t
+		audio_drop_t          audio_drop;           ///< *optional*, see audio_drop_t
+		audio_get_stats_t     audio_get_stats;      ///< *optional*, see audio_get_stats_t
+	};
+
+	/** \brief Load an AO module
+	 *
+	 *  \param lib     The path of the module to load
+	 *  \param module  The struct to store the module's functions in
+	 *  \return        `true` if the module was loaded and exports all required functions, `false` otherwise
+	 */
+	bool ao_module_load(char *lib, struct ao_module *module);
 
 	void ao_module_unload(void);
 #endif
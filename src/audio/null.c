@@ -0,0 +1,126 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file null.c
+ *  \brief AO module discarding all samples, while keeping the time.
+ *
+ *  Depending on the option `null_realtime` the samples are consumed either in real-time
+ *  (as a sound card would do) or as fast as possible (useful for measuring decoding throughput).
+ */
+
+#include <mpg123.h>                     // for mpg123_encsize
+
+//\cond
+#include <stdbool.h>                    // for bool
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for uint64_t
+#include <time.h>                       // for clock_gettime, clock_nanosleep
+//\endcond
+
+#include "ao_module.h"                  // for audio_stats
+#include "../config.h"                  // for config_get_null_realtime
+#include "../log.h"
+
+/** \brief The amount of audio (in ms) the sink is allowed to lag behind before counting an underrun */
+#define NULL_BUFFER_MS 200
+
+static bool         realtime;
+static unsigned int frame_size;         ///< size of a single frame in bytes
+static unsigned int current_rate;
+static uint64_t     frames_played;      ///< frames played since `start`
+static uint64_t     start_ns;           ///< the time (CLOCK_MONOTONIC, in ns) playback of the current format started
+static unsigned int xruns;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** \brief Returns the point in time (in ns) the last sample written becomes audible
+ */
+static uint64_t stream_end_ns(void) {
+	return start_ns + (frames_played * 1000000000) / current_rate;
+}
+
+static void reset_clock(void) {
+	frames_played = 0;
+	start_ns      = now_ns();
+}
+
+size_t audio_play(void *buffer UNUSED, size_t size) {
+	if(!frame_size || !current_rate) {
+		return 0;
+	}
+
+	if(realtime) {
+		uint64_t now = now_ns();
+
+		// the producer was too slow: the virtual buffer ran empty
+		if(now > stream_end_ns() + (uint64_t) NULL_BUFFER_MS * 1000000) {
+			xruns++;
+			reset_clock();
+		}
+
+		// block until all but NULL_BUFFER_MS of the samples are played
+		uint64_t wakeup = stream_end_ns();
+		if(wakeup > now + (uint64_t) NULL_BUFFER_MS * 1000000) {
+			wakeup -= (uint64_t) NULL_BUFFER_MS * 1000000;
+			struct timespec ts = { .tv_sec = wakeup / 1000000000, .tv_nsec = wakeup % 1000000000 };
+			while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL));
+		}
+	}
+
+	frames_played += size / frame_size;
+	return size;
+}
+
+bool audio_set_format(unsigned int encoding, unsigned int rate, unsigned int channels) {
+	frame_size   = mpg123_encsize(encoding) * channels;
+	current_rate = rate;
+	reset_clock();
+
+	_log("null: discarding samples %s, rate: %u, %u channels, %u bytes per frame", realtime ? "in real-time" : "as fast as possible", rate, channels, frame_size);
+	return 0 != frame_size;
+}
+
+void audio_drop(void) {
+	reset_clock();
+}
+
+bool audio_get_stats(struct audio_stats *stats) {
+	stats->xruns       = xruns;
+	stats->delay_ms    = 0;
+	stats->period_size = 0;
+	stats->buffer_size = current_rate ? (current_rate * NULL_BUFFER_MS) / 1000 : 0;
+
+	if(realtime && current_rate) {
+		uint64_t now = now_ns();
+		uint64_t end = stream_end_ns();
+		if(end > now) {
+			stats->delay_ms = (end - now) / 1000000;
+		}
+	}
+	return true;
+}
+
+bool audio_init(void) {
+	realtime = config_get_null_realtime();
+	_log("initializing null output (%s)...", realtime ? "real-time" : "as fast as possible");
+	return true;
+}
@@ -0,0 +1,150 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file wav.c
+ *  \brief AO module writing the PCM stream to a WAV file (option `wav_file`).
+ *
+ *  Subsequent tracks using the same format are appended to the same file, which allows
+ *  checking gapless playback and seek accuracy offline.
+ *  A change of the format starts a new file, suffixed by a sequence number.
+ */
+
+#include <mpg123.h>                     // for mpg123_encsize
+
+//\cond
+#include <errno.h>                      // for errno
+#include <stdbool.h>                    // for bool
+#include <stddef.h>                     // for size_t
+#include <stdint.h>                     // for uint16_t, uint32_t
+#include <stdio.h>                      // for fopen, fwrite, etc
+#include <stdlib.h>                     // for atexit
+#include <string.h>                     // for strerror
+//\endcond
+
+#include "../config.h"                  // for config_get_wav_file
+#include "../log.h"
+
+#define WAV_HEADER_SIZE 44
+#define WAVE_FORMAT_PCM        1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+
+static void finalize(void);
+
+static FILE        *wav = NULL;
+static unsigned int file_count = 0;
+static uint32_t     data_size;
+
+static unsigned int current_encoding;
+static unsigned int current_rate;
+static unsigned int current_channels;
+
+static void write_le(FILE *fh, uint32_t value, size_t bytes) {
+	for(size_t i = 0; i < bytes; i++) {
+		fputc((value >> (8 * i)) & 0xff, fh);
+	}
+}
+
+/** \brief Write the (RIFF) header of the WAV file, using the sizes written so far
+ */
+static void wav_write_header(void) {
+	const unsigned int sample_size = mpg123_encsize(current_encoding);
+	const bool is_float = (MPG123_ENC_FLOAT_32 == current_encoding || MPG123_ENC_FLOAT_64 == current_encoding);
+
+	rewind(wav);
+	fwrite("RIFF", 1, 4, wav);
+	write_le(wav, WAV_HEADER_SIZE - 8 + data_size, 4);
+	fwrite("WAVEfmt ", 1, 8, wav);
+	write_le(wav, 16, 4);
+	write_le(wav, is_float ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM, 2);
+	write_le(wav, current_channels, 2);
+	write_le(wav, current_rate, 4);
+	write_le(wav, current_rate * current_channels * sample_size, 4);
+	write_le(wav, current_channels * sample_size, 2);
+	write_le(wav, 8 * sample_size, 2);
+	fwrite("data", 1, 4, wav);
+	write_le(wav, data_size, 4);
+	fseek(wav, 0, SEEK_END);
+}
+
+/** \brief Finish the current WAV file (if any), updating the header's sizes
+ */
+static void wav_close(void) {
+	if(wav) {
+		wav_write_header();
+		fclose(wav);
+		wav = NULL;
+	}
+}
+
+size_t audio_play(void *buffer, size_t size) {
+	if(!wav) {
+		return 0;
+	}
+
+	size_t written = fwrite(buffer, 1, size, wav);
+	data_size += written;
+	return written;
+}
+
+bool audio_set_format(unsigned int encoding, unsigned int rate, unsigned int channels) {
+	// continue writing the current file, if the format did not change
+	if(wav && encoding == current_encoding && rate == current_rate && channels == current_channels) {
+		return true;
+	}
+
+	wav_close();
+
+	current_encoding = encoding;
+	current_rate     = rate;
+	current_channels = channels;
+	data_size        = 0;
+
+	char file[1024];
+	if(!file_count) {
+		snprintf(file, sizeof(file), "%s", config_get_wav_file());
+	} else {
+		snprintf(file, sizeof(file), "%s.%u", config_get_wav_file(), file_count);
+	}
+	file_count++;
+
+	wav = fopen(file, "w");
+	if(!wav) {
+		_err("fopen(%s): %s", file, strerror(errno));
+		return false;
+	}
+
+	_log("wav: writing to `%s`, rate: %u, %u channels, %u bits per sample", file, rate, channels, 8 * mpg123_encsize(encoding));
+
+	wav_write_header();
+	return true;
+}
+
+bool audio_init(void) {
+	_log("initializing wav output...");
+
+	if(atexit(finalize)) {
+		_log("atexit: %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+static void finalize(void) {
+	wav_close();
+}
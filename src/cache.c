@@ -30,17 +30,56 @@
 
 //\cond
 #include <errno.h>                      // for errno, ENOENT
-#include <stdio.h>                      // for fclose, fopen, snprintf, etc
+#include <fcntl.h>                      // for open, O_WRONLY, etc
+#include <pthread.h>                    // for pthread_create, pthread_mutex_lock, etc
+#include <stdio.h>                      // for fclose, fopen, snprintf, rename, etc
+#include <stdlib.h>                     // for free, atexit
 #include <string.h>                     // for strlen, strerror
 #include <sys/stat.h>                   // for stat, fstat, mkdir
-#include <unistd.h>
+#include <unistd.h>                     // for close, fdatasync, unlink, etc
 //\endcond
 
+#include "aio.h"                        // for aio_submit_wait, aio_request, etc
 #include "config.h"
 #include "helper.h"
 #include "log.h"                        // for _log
 #include "track.h"                      // for track
 
+/** \brief The extension of a track written by the cache writer, renamed once the track is complete */
+#define CACHE_PART_EXT ".part"
+
+/** \brief The maximum number of bytes written per request, such that concurrent writers progress evenly */
+#define CACHE_WRITE_CHUNK ( 1024 * 1024 )
+
+/** \brief The maximum number of writers served by a single batch of requests */
+#define CACHE_WRITE_BATCH 8
+
+struct cache_writer {
+	struct track *track;
+	const char   *buffer;
+	size_t        size;      ///< The size of the whole track
+	size_t        available; ///< The number of bytes available in `buffer` (set via cache_writer_append())
+	size_t        written;   ///< The number of bytes written to the file (accessed by the writer thread only)
+	int           fd;        ///< The file descriptor of the `.part` file, -1 if writing failed
+	bool          aborted;   ///< Set via cache_writer_abort(): the track will never be complete
+	char         *file;      ///< The path of the file the track is stored to once complete
+
+	void (*done)(struct track *track, const char *buffer, size_t size, bool success);
+
+	struct cache_writer *next;
+};
+
+static pthread_t       thread_writer;
+static bool            thread_writer_valid = false;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  writer_cond  = PTHREAD_COND_INITIALIZER;
+static bool            writer_terminate = false;
+
+/** \brief The active writers (protected by `writer_mutex`) */
+static struct cache_writer *writers = NULL;
+
+static void cache_finalize(void);
+
 bool cache_track_exists(struct track *track) {
 	char *cache_path = config_get_cache_path();
 	const size_t buffer_size = strlen(cache_path) + 1 + strlen(CACHE_STREAM_FOLDER) + 1 + 64 + strlen(CACHE_STREAM_EXT);
@@ -56,37 +95,285 @@ struct mmapped_file cache_track_get(struct track *track) {
 	char cache_file[buffer_size];
 	snprintf(cache_file, buffer_size, "%s/"CACHE_STREAM_FOLDER"/%d_%d"CACHE_STREAM_EXT, cache_path, track->user_id, track->track_id);
 
-	return file_read_contents(cache_file);
+	// tracks are read from start to end (playing or analysing them)
+	return file_read_contents(cache_file, file_access_sequential);
 }
 
-bool cache_track_save(struct track *track, void *buffer, size_t size) {
+bool cache_track_get_loudness(struct track *track, double *loudness) {
 	char *cache_path = config_get_cache_path();
-	const size_t buffer_size = strlen(cache_path) + 1 + strlen(CACHE_STREAM_FOLDER) + 1 + 64 + strlen(CACHE_STREAM_EXT);
+	const size_t buffer_size = strlen(cache_path) + 1 + strlen(CACHE_STREAM_FOLDER) + 1 + 64 + strlen(CACHE_LOUDNESS_EXT);
 	char cache_file[buffer_size];
-	snprintf(cache_file, buffer_size, "%s/"CACHE_STREAM_FOLDER"/%d_%d"CACHE_STREAM_EXT, cache_path, track->user_id, track->track_id);
+	snprintf(cache_file, buffer_size, "%s/"CACHE_STREAM_FOLDER"/%d_%d"CACHE_LOUDNESS_EXT, cache_path, track->user_id, track->track_id);
+
+	if(!loudness) {
+		return (0 == access(cache_file, F_OK));
+	}
+
+	FILE *fh = fopen(cache_file, "r");
+	if(!fh) {
+		return false;
+	}
+
+	bool success = (1 == fscanf(fh, "%lf", loudness));
+	fclose(fh);
+
+	return success;
+}
+
+bool cache_track_save_loudness(struct track *track, double loudness) {
+	char *cache_path = config_get_cache_path();
+	const size_t buffer_size = strlen(cache_path) + 1 + strlen(CACHE_STREAM_FOLDER) + 1 + 64 + strlen(CACHE_LOUDNESS_EXT);
+	char cache_file[buffer_size];
+	snprintf(cache_file, buffer_size, "%s/"CACHE_STREAM_FOLDER"/%d_%d"CACHE_LOUDNESS_EXT, cache_path, track->user_id, track->track_id);
 
 	FILE *fh = fopen(cache_file, "w");
+	if(!fh) {
+		_log("failed to open file '%s': %s", cache_file, strerror(errno));
+		return false;
+	}
+
+	fprintf(fh, "%.2f\n", loudness);
+	fclose(fh);
+
+	return true;
+}
+
+/** \brief Open the `.part` file of a track, creating the folder of the cache if required
+ *
+ *  \return The file descriptor, -1 in case of failure
+ */
+static int cache_writer_open_part(const char *file) {
+	char part[strlen(file) + strlen(CACHE_PART_EXT) + 1];
+	sprintf(part, "%s"CACHE_PART_EXT, file);
+
+	int fd = open(part, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+	if(0 > fd && ENOENT == errno) {
+		char *cache_path = config_get_cache_path();
+		char folder[strlen(cache_path) + 1 + strlen(CACHE_STREAM_FOLDER) + 1];
+		sprintf(folder, "%s/"CACHE_STREAM_FOLDER, cache_path);
+
+		if(!mkdir(folder, 0770)) {
+			_log("created `%s`", folder);
+			fd = open(part, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+		}
+	}
+
+	if(0 > fd) {
+		_err("failed to open file '%s': %s", part, strerror(errno));
+	}
+	return fd;
+}
+
+/** \brief Give up writing the track, removing the `.part` file */
+static void cache_writer_fail(struct cache_writer *writer) {
+	char part[strlen(writer->file) + strlen(CACHE_PART_EXT) + 1];
+	sprintf(part, "%s"CACHE_PART_EXT, writer->file);
+
+	if(0 <= writer->fd) {
+		close(writer->fd);
+		writer->fd = -1;
+		unlink(part);
+	}
+}
+
+/** \brief Sync and rename the `.part` file of a complete track
+ *
+ *  \return `true` on success, `false` otherwise
+ */
+static bool cache_writer_commit(struct cache_writer *writer) {
+	char part[strlen(writer->file) + strlen(CACHE_PART_EXT) + 1];
+	sprintf(part, "%s"CACHE_PART_EXT, writer->file);
+
+	if(fdatasync(writer->fd)) {
+		_err("fdatasync: %s", strerror(errno));
+		cache_writer_fail(writer);
+		return false;
+	}
+	close(writer->fd);
+	writer->fd = -1;
+
+	if(rename(part, writer->file)) {
+		_err("failed to rename '%s': %s", part, strerror(errno));
+		unlink(part);
+		return false;
+	}
 
-	if(fh) {
-		fwrite((void *) buffer, 1, size, fh);
-		fclose(fh);
-
-		return true;
-	} else {
-		if(ENOENT == errno) {
-			// create the cache folder if it does not exist
-			// and retry saving the track to cache
-			if(!mkdir(CACHE_STREAM_FOLDER, 0770)) {
-				_log("created "CACHE_STREAM_FOLDER", now saving track to cache");
-				return cache_track_save(track, buffer, size);
+	return true;
+}
+
+static void cache_writer_remove(struct cache_writer *writer) {
+	struct cache_writer **prev = &writers;
+	while(*prev != writer) prev = &(*prev)->next;
+	*prev = writer->next;
+}
+
+static void* _thread_writer_function(void *unused UNUSED) {
+	pthread_mutex_lock(&writer_mutex);
+	while(!writer_terminate) {
+		// collect (at most CACHE_WRITE_CHUNK bytes of) the data available of each writer
+		struct aio_request  requests[CACHE_WRITE_BATCH];
+		struct aio_request *batch[CACHE_WRITE_BATCH];
+		size_t count    = 0;
+		bool   complete = false;
+
+		for(struct cache_writer *writer = writers; writer && count < CACHE_WRITE_BATCH; writer = writer->next) {
+			if(writer->aborted) {
+				complete = true;
+			} else if(0 <= writer->fd && writer->available > writer->written) {
+				size_t bytes = writer->available - writer->written;
+				if(bytes > CACHE_WRITE_CHUNK) {
+					bytes = CACHE_WRITE_CHUNK;
+				}
+
+				requests[count] = (struct aio_request) {
+					.op     = aio_op_write,
+					.fd     = writer->fd,
+					.data   = &writer->buffer[writer->written],
+					.size   = bytes,
+					.offset = (off_t) writer->written,
+					.ctx    = writer
+				};
+				batch[count] = &requests[count];
+				count++;
+			} else if(writer->available == writer->size) {
+				complete = true;
+			}
+		}
+
+		if(!count && !complete) {
+			pthread_cond_wait(&writer_cond, &writer_mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&writer_mutex);
+
+		// submit the writes as a single batch, not holding the lock
+		aio_submit_wait(batch, count);
+		for(size_t i = 0; i < count; i++) {
+			struct cache_writer *writer = requests[i].ctx;
+			if(0 > requests[i].result) {
+				if(-EINTR != requests[i].result) {
+					_err("write: %s", strerror((int) -requests[i].result));
+					cache_writer_fail(writer);
+				}
 			} else {
-				_log("failed to create "CACHE_STREAM_FOLDER": %s", strerror(errno));
+				writer->written += (size_t) requests[i].result;
 			}
-		} else {
-			_log("failed to open file '%s': %s", cache_file, strerror(errno));
+		}
+
+		pthread_mutex_lock(&writer_mutex);
+
+		// finish the writers being complete (or failed and the download is complete) and the ones aborted
+		struct cache_writer *writer = writers;
+		while(writer) {
+			// only this thread removes writers: `next` stays valid while not holding the lock
+			struct cache_writer *next = writer->next;
+
+			if(writer->aborted || (writer->size == writer->available && (writer->size == writer->written || 0 > writer->fd))) {
+				cache_writer_remove(writer);
+				pthread_mutex_unlock(&writer_mutex);
+
+				if(writer->aborted) {
+					cache_writer_fail(writer);
+				}
+				bool success = (0 <= writer->fd) && cache_writer_commit(writer);
+				_log("%s `%s` to cache", success ? "saved" : "failed to save", writer->track->name);
+				if(writer->done) {
+					writer->done(writer->track, writer->aborted ? NULL : writer->buffer, writer->size, success);
+				}
+
+				free(writer->file);
+				free(writer);
+
+				pthread_mutex_lock(&writer_mutex);
+			}
+			writer = next;
 		}
 	}
+	pthread_mutex_unlock(&writer_mutex);
 
-	return false;
+	return NULL;
 }
 
+bool cache_init(void) {
+	int err = pthread_create(&thread_writer, NULL, _thread_writer_function, NULL);
+	if(err) {
+		_err("pthread_create: %s", strerror(err));
+		return false;
+	}
+	thread_writer_valid = true;
+
+	if(atexit(cache_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	return true;
+}
+
+struct cache_writer* cache_writer_open(struct track *track, const char *buffer, size_t size, void (*done)(struct track *track, const char *buffer, size_t size, bool success)) {
+	if(!thread_writer_valid) {
+		return NULL;
+	}
+
+	struct cache_writer *writer = lcalloc(1, sizeof(struct cache_writer));
+	if(!writer) {
+		return NULL;
+	}
+
+	writer->file = smprintf("%s/"CACHE_STREAM_FOLDER"/%d_%d"CACHE_STREAM_EXT, config_get_cache_path(), track->user_id, track->track_id);
+	if(!writer->file) {
+		free(writer);
+		return NULL;
+	}
+
+	writer->fd = cache_writer_open_part(writer->file);
+	if(0 > writer->fd) {
+		free(writer->file);
+		free(writer);
+		return NULL;
+	}
+
+	writer->track  = track;
+	writer->buffer = buffer;
+	writer->size   = size;
+	writer->done   = done;
+
+	pthread_mutex_lock(&writer_mutex);
+	writer->next = writers;
+	writers      = writer;
+	pthread_mutex_unlock(&writer_mutex);
+
+	return writer;
+}
+
+void cache_writer_append(struct cache_writer *writer, size_t available) {
+	pthread_mutex_lock(&writer_mutex);
+	writer->available = available;
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(&writer_mutex);
+}
+
+void cache_writer_abort(struct cache_writer *writer) {
+	pthread_mutex_lock(&writer_mutex);
+	writer->aborted = true;
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(&writer_mutex);
+}
+
+static void cache_finalize(void) {
+	pthread_mutex_lock(&writer_mutex);
+	writer_terminate = true;
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(&writer_mutex);
+
+	pthread_join(thread_writer, NULL);
+	thread_writer_valid = false;
+
+	// incomplete tracks: remove the `.part` files
+	while(writers) {
+		struct cache_writer *next = writers->next;
+		cache_writer_fail(writers);
+		free(writers->file);
+		free(writers);
+		writers = next;
+	}
+}
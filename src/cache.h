@@ -39,12 +39,59 @@
 	 */
 	struct mmapped_file cache_track_get(struct track *track);
 
-	/** \brief Save data for a specific track to cache
+	/** \brief Get the integrated loudness (EBU R128) stored for a cached track
 	 *
-	 *  \param track   The track to save data for
-	 *  \param buffer  The data to save
-	 *  \param size    The number of Bytes to save
-	 *  \return true if saving to cache was successfull, otherwise false 
+	 *  \param track     The track to get the loudness for
+	 *  \param loudness  Receives the loudness in LUFS, may be `NULL` to check for existence only
+	 *  \return          `true` if the loudness of the track was analysed, `false` otherwise
 	 */
-	bool cache_track_save(struct track *track, void *buffer, size_t size);
+	bool cache_track_get_loudness(struct track *track, double *loudness);
+
+	/** \brief Store the integrated loudness (EBU R128) of a cached track
+	 *
+	 *  \param track     The track the loudness was measured for
+	 *  \param loudness  The loudness in LUFS
+	 *  \return          `true` on success, `false` otherwise
+	 */
+	bool cache_track_save_loudness(struct track *track, double loudness);
+
+	/** \brief Initialize the cache: start the thread writing tracks to the cache (see cache_writer_open())
+	 *
+	 *  \return `true` on success, `false` otherwise
+	 */
+	bool cache_init(void);
+
+	struct cache_writer;
+
+	/** \brief Start writing a track to the cache, while it is still downloaded (write-through)
+	 *
+	 *  The data is written by a dedicated thread to a temporary file, which is synced and renamed
+	 *  once the track is complete. Neither opening nor appending blocks on writing the data.
+	 *
+	 *  \param track   The track to write
+	 *  \param buffer  The buffer the track is downloaded to, needs to stay valid until `done` returns
+	 *  \param size    The size of the whole track
+	 *  \param done    Called (by the writer thread) once the track is stored (or storing it failed), may be `NULL`.
+	 *                 Receives `buffer` if the track is complete (whether stored or not), `NULL` if aborted.
+	 *  \return        The writer, `NULL` in case of failure. Freed automatically once complete.
+	 */
+	struct cache_writer* cache_writer_open(struct track *track, const char *buffer, size_t size, void (*done)(struct track *track, const char *buffer, size_t size, bool success)) ATTR(nonnull(1, 2));
+
+	/** \brief Announce the data available to the writer
+	 *
+	 *  Announcing the whole track completes the writer: it must not be used afterwards.
+	 *
+	 *  \param writer     The writer
+	 *  \param available  The number of bytes (from the start of the buffer) available
+	 */
+	void cache_writer_append(struct cache_writer *writer, size_t available) ATTR(nonnull);
+
+	/** \brief Give up writing a track, p.x. as its download failed
+	 *
+	 *  The writer removes the `.part` file and calls `done` (see cache_writer_open()) with `success` set to `false`.
+	 *  The writer must not be used afterwards.
+	 *
+	 *  \param writer  The writer
+	 */
+	void cache_writer_abort(struct cache_writer *writer) ATTR(nonnull);
 #endif
@@ -51,6 +51,8 @@ const struct command commands[] = {
 	{"del",           cmd_pl_del,            scope_playlist, "<none/ignored>",                "Delete currently selected track from current playlist"},
 	{"details",       cmd_pl_details,        scope_playlist, "<none/ignored>",                "Show details for currently selected track"},
 	{"download",      cmd_pl_download,       scope_playlist, "<none/ignored>",                "Download the currently selected entry to file"},
+	{"eq",            cmd_gl_equalizer,      scope_global,   "<band> <factor>",               "Set a band of the equalizer"},
+	{"eq-preset",     cmd_gl_equalizer_preset, scope_global, "<name of preset>",              "Switch the equalizer to a preset (none: configured equalizer)"},
 	{"exit",          cmd_pl_exit,           scope_playlist, "<none/ignored>",                "Terminate SCTC"},
 	{"subscriptions", cmd_pl_subscriptions,  scope_playlist, "<username>",                    "MISSING"},
 	{"goto",          cmd_pl_goto,           scope_playlist, "<relative or absolute offset>", "Set selection to specific entry"},
@@ -62,6 +64,7 @@ const struct command commands[] = {
 	{"pause",         cmd_gl_pause,          scope_global,   "<none/ignored>",                "Pause playback of current track"},
 	{"play",          cmd_pl_play,           scope_playlist, "<none/ignored>",                "Start playback of currently selected track"},
 	{"redraw",        cmd_gl_redraw,         scope_global,   "<none/ignored>",                "Redraw the screen"},
+	{"refresh",       cmd_pl_refresh,        scope_playlist, "<none/ignored>",                "Retrieve new tracks and insert them into the stream"},
 	{"repeat",        cmd_gl_repeat,         scope_global,   "{,none,one,all}",               "Set/Toggle repeat"},
 	{"scroll",        cmd_tb_scroll,         scope_textbox,  "<relative or absolute offset>", "Scroll a textbox up/down"},
 	{"search-start",  cmd_pl_search_start,   scope_playlist, "<none/ignored>",                "Start searching (open input field)"},
@@ -70,6 +73,7 @@ const struct command commands[] = {
 	{"seek",          cmd_gl_seek,           scope_global,   "<time to seek to>",             "Seek to specified time in current track"},
 	{"stop",          cmd_gl_stop,           scope_global,   "<none/ignored>",                "Stop playback of current track"},
 	{"toggle",        cmd_tb_toggle,         scope_textbox,  "<none/ignored>",                "MISSING"},
+	{"view",          cmd_pl_view,           scope_playlist, "<filter>",                      "Show the tracks of the current list matching a filter in a new tab"},
 	{"vol",           cmd_gl_volume,         scope_global,   "<delta (in percent)>",          "modify playback volume by given percentage"},
 	{"write",         cmd_pl_write_playlist, scope_playlist, "<filename>",                    "Write current playlist to file (.jspf)"},
 	{"yank",          cmd_tb_yank,           scope_textbox,  "<none/ignored>",                "MISSING"},
@@ -27,6 +27,7 @@
 #include <string.h>
 //\endcond
 
+#include "../config.h"                  // for config_get_equalizer_preset, etc
 #include "../helper.h"                  // for smprintf, streq, strstrp, etc
 #include "../log.h"                     // for _log
 #include "../sound.h"                   // for sound_change_volume, etc
@@ -65,10 +66,9 @@ static void stop_playback(bool reset) {
 			_log("failed to stop playback: %s", sound_error());
 		}
 
+		// the playback thread only publishes the time, keep it in the track to continue from there
 		struct track_list *list = state_get_list(state_get_current_playback_list());
-		if(reset) {
-			TRACK(list, playing)->current_position = 0;
-		}
+		TRACK(list, playing)->current_position = reset ? 0 : state_get_current_playback_time();
 		update_flags_stop_playback(list, playing);
 
 		tui_submit_action(update_list);
@@ -153,3 +153,38 @@ void cmd_gl_seek(const char *_time) {
 	}
 }
 
+
+void cmd_gl_equalizer(const char *_band_value) {
+	astrdup(band_value, _band_value);
+	char *param = strstrp(band_value);
+
+	unsigned int band;
+	double value;
+	if(2 != sscanf(param, " %2u %16lf ", &band, &value) || band >= EQUALIZER_SIZE || value < 0) {
+		state_set_status(cline_warning, smprintf("Error: expected "F_BOLD"<band> <factor>"F_RESET", band in [0; %i), factor >= 0", EQUALIZER_SIZE));
+		return;
+	}
+
+	if(!sound_set_equalizer_band(band, value)) {
+		state_set_status(cline_warning, smprintf("Error: failed to set band %u of the equalizer", band));
+		return;
+	}
+	state_set_status(cline_default, smprintf("Info: Set band %u of the equalizer to %.2f", band, value));
+}
+
+void cmd_gl_equalizer_preset(const char *_name) {
+	astrdup(tname, _name);
+	char *name = strstrp(tname);
+
+	const double *bands = config_get_equalizer_preset(name);
+	if(!bands) {
+		state_set_status(cline_warning, smprintf("Error: There is no equalizer preset "F_BOLD"%s"F_RESET, name));
+		return;
+	}
+
+	if(!sound_set_equalizer(bands)) {
+		state_set_status(cline_warning, smprintf("Error: failed to set the equalizer"));
+		return;
+	}
+	state_set_status(cline_default, smprintf("Info: Switched equalizer to '%s'", streq("", name) ? "<configured>" : name));
+}
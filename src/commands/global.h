@@ -36,4 +36,16 @@
 	 *  \param rep  The type of repeat to use (one in {none,one,all})
 	 */
 	void cmd_gl_repeat(const char *_rep);
+
+	/** \brief Set a single band of the equalizer (while playing)
+	 *
+	 *  \param band_value  The band and its new factor, separated by whitespace (e.g. "3 1.5")
+	 */
+	void cmd_gl_equalizer(const char *band_value) ATTR(nonnull);
+
+	/** \brief Switch the equalizer to a preset (while playing)
+	 *
+	 *  \param name  The name of the preset, the empty string switches back to the configured equalizer
+	 */
+	void cmd_gl_equalizer_preset(const char *name) ATTR(nonnull);
 #endif
@@ -31,9 +31,12 @@
 #include <string.h>                     // for strlen, strncmp, memcpy, etc
 //\endcond
 #include "textbox.h"
+#include "../cache.h"                   // for cache_track_exists
 #include "../command.h"                 // for command, commands, etc
+#include "../descstore.h"               // for descstore_get
 #include "../jspf.h"                    // for jspf_write, jspf_error
 #include "../log.h"                     // for _log
+#include "../loudness.h"                // for loudness_queue
 #include "../network/network.h"         // for network_conn
 #include "../network/tls.h"             // for tls_connect
 #include "../sound.h"                   // for sound_play, sound_seek
@@ -41,8 +44,11 @@
 #include "../state.h"                   // for state_set_status, etc
 #include "../config.h"                  // for config_get_cache_path
 #include "../helper.h"                  // for smprintf, strstrp, astrdup, etc
+#include "../isearch.h"                 // for isearch_start, isearch_update, etc
 #include "../track.h"                   // for track, track_list, TRACK, etc
+#include "../trigram.h"                 // for trigram_index_find
 #include "../tui.h"                     // for tui_submit_action, F_BOLD, etc
+#include "../view.h"                    // for view_create, view_filter_parse, etc
 #include "../generic/rc_string.h"
 
 #define NONE ((unsigned int) ~0)
@@ -97,6 +103,11 @@ void cmd_pl_exit(const char *unused UNUSED) {
 	char *cache_path = config_get_cache_path();
 	struct track_list *list;
 	for(size_t list_id = 2; (list = state_get_list(list_id)); list_id++) {
+		// views do not hold any tracks of their own
+		if(list->view) {
+			continue;
+		}
+
 		char target_file[strlen(cache_path) + 1 + strlen(USERLIST_FOLDER) + 1 + strlen(list->name) + strlen(USERLIST_EXT) + 1];
 		sprintf(target_file, "%s/"USERLIST_FOLDER"/%s"USERLIST_EXT, cache_path, list->name);
 
@@ -142,6 +153,9 @@ static void switch_to_list(unsigned int id) {
 	struct track_list *list = state_get_list(id);
 
 	if(list) {
+		// views are updated lazily, once shown
+		state_update_view(id);
+
 		if(list->count) {
 			state_set_current_list(id);
 		} else {
@@ -184,6 +198,11 @@ void cmd_pl_add(const char *_list) {
 		return;
 	}
 
+	if(list->view) {
+		state_set_status(cline_warning, smprintf("Error: Cannot add tracks to the view "F_BOLD"%s"F_RESET, list->name));
+		return;
+	}
+
 	struct track_list *clist = state_get_list(state_get_current_list());
 	if(2 == list_id) {
 		TRACK(clist, state_get_current_selected())->flags |= FLAG_BOOKMARKED;
@@ -203,6 +222,55 @@ void cmd_pl_add(const char *_list) {
 	state_set_status(cline_default, smprintf("Info: Added "F_BOLD"%s"F_RESET" to %s", TRACK(clist, state_get_current_selected())->name, list->name));
 }
 
+/** \brief Add a view of the current list (or of the base of the current view) matching a filter and switch to it
+ *
+ *  \param _spec  The filter (see view_filter_parse())
+ */
+void cmd_pl_view(const char *_spec) {
+	astrdup(tspec, _spec);
+	char *spec = strstrp(tspec);
+
+	struct track_list *current = state_get_list(state_get_current_list());
+	const char *base_name = current->view && current->view->base ? current->view->base->name : current->name;
+	char *name = streq("", spec) ? smprintf("%s (view)", base_name) : smprintf("%s: %s", base_name, spec);
+
+	struct view_filter filter;
+	char *invalid = view_filter_parse(spec, &filter);
+	if(invalid) {
+		state_set_status(cline_warning, smprintf("Error: Not creating view: Invalid filter "F_BOLD"%s"F_RESET, invalid));
+		view_filter_clear(&filter);
+		free(name);
+		return;
+	}
+
+	struct track_list *view = name ? view_create(current, &filter, name) : NULL;
+	view_filter_clear(&filter);
+	free(name);
+	if(!view) {
+		state_set_status(cline_warning, "Error: Failed to allocate memory for new view!");
+		return;
+	}
+
+	if(!view->count) {
+		state_set_status(cline_warning, smprintf("Info: Not creating view "F_BOLD"%s"F_RESET": No matching tracks", view->name));
+		track_list_destroy(view, false);
+		return;
+	}
+
+	// state_add_list() fails silently if there is no room for another list
+	state_add_list(view);
+	for(size_t id = 0; id < MAX_LISTS; id++) {
+		if(view == state_get_list(id)) {
+			state_set_current_list(id);
+			state_set_status(cline_default, smprintf("Info: "F_BOLD"%zu tracks"F_RESET" in view "F_BOLD"%s"F_RESET, view->count, view->name));
+			return;
+		}
+	}
+
+	state_set_status(cline_warning, smprintf("Error: Not creating view "F_BOLD"%s"F_RESET": Too many lists", view->name));
+	track_list_destroy(view, false);
+}
+
 void cmd_pl_open_user(const char *_user) {
 	astrdup(tuser, _user);
 	char *user = strstrp(tuser);
@@ -221,6 +289,49 @@ void cmd_pl_open_user(const char *_user) {
 	}
 }
 
+void cmd_pl_refresh(const char *unused UNUSED) {
+	state_set_status(cline_default, "Info: Retrieving new tracks from soundcloud.com");
+
+	struct track_list *update = soundcloud_get_stream_update();
+	if(!update) {
+		state_set_status(cline_warning, "Error: Failed to retrieve new tracks from soundcloud.com");
+		return;
+	}
+
+	// flag the new tracks just like the ones retrieved on startup (see main()), before publishing them
+	struct track_list *bookmarks = state_get_list(LIST_BOOKMARKS);
+	for(size_t i = 0; i < update->count; i++) {
+		if(bookmarks && track_list_get(bookmarks, update->entries[i].permalink_url)) {
+			update->entries[i].flags |= FLAG_BOOKMARKED;
+		}
+		if(cache_track_exists(&update->entries[i])) {
+			update->entries[i].flags |= FLAG_CACHED;
+		}
+	}
+
+	// the tracks are inserted along with shifting the selection and the playback: the tui never draws one without the other
+	struct track_list *stream = state_get_list(LIST_STREAM);
+	if(!state_prepend_list(LIST_STREAM, update)) {
+		state_set_status(cline_warning, smprintf("Error: Failed to insert "F_BOLD"%zu new tracks"F_RESET" into the stream", update->count));
+		track_list_destroy(update, true);
+		return;
+	}
+
+	if(config_get_normalize()) {
+		for(size_t i = 0; i < update->count; i++) {
+			if(stream->entries[i].flags & FLAG_CACHED) {
+				loudness_queue(&stream->entries[i]);
+			}
+		}
+	}
+
+	state_update_view(state_get_current_list());
+	tui_submit_action(update_list);
+
+	state_set_status(cline_default, smprintf("Info: "F_BOLD"%zu new tracks"F_RESET" from soundcloud.com", update->count));
+	track_list_destroy(update, false);
+}
+
 /** \brief Initiate a command input
  *
  *  \param unused  Unused parameter, required due to interface of cmd_* functions
@@ -241,6 +352,10 @@ void cmd_pl_command_input(const char *unused UNUSED) {
 // TODO
 static void update_flags_stop_playback(struct track_list *list, size_t tid) {
 	if(list && NO_TRACK != tid) {
+		// keep the time published by the playback thread to continue from there
+		if(TRACK(list, tid)->flags & FLAG_PLAYING) {
+			TRACK(list, tid)->current_position = state_get_current_playback_time();
+		}
 		TRACK(list, tid)->flags &= (uint8_t)~FLAG_PLAYING;
 		if(TRACK(list, tid)->current_position) {
 			TRACK(list, tid)->flags |= FLAG_PAUSED;
@@ -298,6 +413,11 @@ void cmd_pl_del(const char *unused UNUSED) {
 	size_t current_selected = state_get_current_selected();
 	struct track_list *list = state_get_list(state_get_current_list());
 
+	if(list->view) {
+		state_set_status(cline_warning, smprintf("Error: Cannot delete tracks from the view "F_BOLD"%s"F_RESET, list->name));
+		return;
+	}
+
 	if(1 == list->count) {
 		state_set_current_list(LIST_STREAM);
 	} else if(current_selected >= list->count - 1) {
@@ -325,7 +445,7 @@ void cmd_pl_play(const char *unused UNUSED) {
 		state_set_title(new_title);
 		rcs_unref(new_title);
 
-		track->flags = (uint8_t) ( (track->flags & ~FLAG_PAUSED) | FLAG_PLAYING );
+		track->flags = (uint8_t) ( (track->flags & ~FLAG_PAUSED) | FLAG_PLAYING | FLAG_PLAYED );
 
 		tui_submit_action(update_list);
 
@@ -339,23 +459,23 @@ static void search_direction(bool down) {
 	struct track_list *list = state_get_list(state_get_current_list());
 	const int step = down ? 1 : -1;
 
+	// search the titles, usernames (and descriptions) via the trigram index of the list
 	size_t current = state_get_current_selected();
-	while( (down && current < list->count - 1) || (!down && current > 0) ) {
-		current += step;
-
-		if(strcasestr(TRACK(list, current)->name, state_get_input())) {
-			state_set_current_selected(current);
-			return;
-		}
+	size_t found;
+	if((down || current > 0) && trigram_index_find(list, state_get_input(), current + step, down, &found)) {
+		state_set_current_selected(found);
+		return;
 	}
 	state_set_status(cline_warning, smprintf("search hit %s", down ? "BOTTOM" : "TOP"));
 }
 
 static bool handle_search(char *buffer, size_t buffer_size) {
+	// the query is shown (and matched) by the incremental search, the input is never waiting for either
+	isearch_start(state_get_list(state_get_current_list()), state_get_current_selected());
+
 	// `clear` the buffer on starting search
 	buffer[0] = '\0';
-
-	tui_submit_action(input_modify_text);
+	isearch_update(buffer);
 
 	size_t pos = 0;
 	int c;
@@ -363,18 +483,21 @@ static bool handle_search(char *buffer, size_t buffer_size) {
 		switch(c) {
 			case KEY_EXIT: // ESC
 			case 0x1B:
+				isearch_finish(false);
 				return false;
 
 			case 0x0A: // LF (aka 'enter')
 			case KEY_ENTER:
+				isearch_finish(true);
 				return true;
 
 			case KEY_BACKSPACE:
 				if(pos) {
 					pos--;
 					buffer[pos] = '\0';
-					tui_submit_action(input_modify_text);
+					isearch_update(buffer);
 				} else {
+					isearch_finish(false);
 					return false;
 				}
 				break;
@@ -382,10 +505,11 @@ static bool handle_search(char *buffer, size_t buffer_size) {
 			default: {
 				buffer[pos] = c;
 				buffer[pos + 1] = '\0';
-				tui_submit_action(input_modify_text);
+				isearch_update(buffer);
 				pos++;
 
 				if(pos == buffer_size) {
+					isearch_finish(true);
 					return true;
 				}
 			}
@@ -399,10 +523,14 @@ void cmd_pl_search_next(const char *unused UNUSED) { search_direction(true);  }
 void cmd_pl_search_prev(const char *unused UNUSED) { search_direction(false); }
 
 void cmd_pl_search_start(const char *unused UNUSED) {
-	state_set_status(cline_cmd_char, F_BOLD"/"F_RESET);
-	handle_search(state_get_input(), 127);
+	char query[128];
 
-	cmd_pl_search_next(NULL);
+	// the first hit is selected while typing already
+	state_set_status(cline_cmd_char, F_BOLD"/"F_RESET);
+	if(handle_search(query, sizeof(query) - 1)) {
+		// search-next and search-prev continue searching for the query shown
+		strcpy(state_get_input(), query);
+	}
 }
 
 static size_t description_prepare_urls(char *string, char **new_desc, char ***urls_out) {
@@ -471,25 +599,33 @@ void cmd_pl_details(const char *unused UNUSED) {
 	struct track_list *list = state_get_list(state_get_current_list());
 	size_t current_selected = state_get_current_selected();
 
-	size_t url_count = TRACK(list, current_selected)->url_count;
-	char **urls      = TRACK(list, current_selected)->urls;
-
-	if(URL_COUNT_UNINITIALIZED == url_count) {
-		char *new_desc;
-		char *old_desc = TRACK(list, current_selected)->description;
-		url_count = description_prepare_urls(old_desc, &new_desc, &urls);
+	// the description is read from the store (see descstore.h) and dropped again once the textbox is closed
+	char *desc = descstore_get(TRACK(list, current_selected));
+	if(!desc) {
+		desc = lstrdup("");
+	}
 
-		TRACK(list, current_selected)->url_count   = url_count;
-		TRACK(list, current_selected)->urls        = urls;
-		TRACK(list, current_selected)->description = new_desc;
+	char  *new_desc = NULL;
+	char **urls     = NULL;
+	size_t url_count = description_prepare_urls(desc, &new_desc, &urls);
 
-		free(old_desc);
+	if(URL_COUNT_UNINITIALIZED == TRACK(list, current_selected)->url_count) {
+		TRACK(list, current_selected)->url_count = url_count;
+		TRACK(list, current_selected)->urls      = urls;
+	} else {
+		// the URLs of the track are extracted already (and equal the ones just extracted)
+		for(size_t i = 0; i < url_count; i++) {
+			free(urls[i]);
+		}
+		free(urls);
 	}
 
 	char *title = smprintf("%s by %s", TRACK(list, current_selected)->name, TRACK(list, current_selected)->username);
-	state_set_tb(title, TRACK(list, current_selected)->description);
+	state_set_tb(title, new_desc ? new_desc : desc);
 	handle_textbox();
 	free(title);
+	free(new_desc);
+	free(desc);
 }
 
 /** \brief Generate a new list of commands using the filter `filter`.
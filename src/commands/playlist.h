@@ -31,6 +31,8 @@
 	void cmd_pl_search_prev   (const char *unused UNUSED);
 	void cmd_pl_search_start  (const char *unused UNUSED);
 	void cmd_pl_open_user     (const char *_user) ATTR(nonnull);
+	void cmd_pl_refresh       (const char *unused UNUSED);
+	void cmd_pl_view          (const char *_spec) ATTR(nonnull);
 
 	void cmd_pl_list_new      (const char *_name) ATTR(nonnull);
 	void cmd_pl_write_playlist(const char *_file) ATTR(nonnull);
@@ -22,10 +22,12 @@
 #include <ncurses.h>                    // for LINES
 //\cond
 #include <stddef.h>                     // for NULL
+#include <stdlib.h>                     // for free
 #include <string.h>                     // for strchr
 //\endcond
 
 #include "../config.h"
+#include "../descstore.h"               // for descstore_get
 #include "../helper.h"                  // for strstrp, astrdup
 #include "../log.h"
 #include "../state.h"                   // for state_set_tb, etc
@@ -40,7 +42,11 @@ void cmd_tb_yank(const char *_hint) {
 
 	if(streq("", selection)) {
 		// copy the whole textbox if no parameter is supplied
-		yank(TRACK(list, playing)->description);
+		char *description = descstore_get(TRACK(list, playing));
+		if(description) {
+			yank(description);
+			free(description);
+		}
 	} else {
 		_err("NYI");
 	}
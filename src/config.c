@@ -28,6 +28,7 @@
 #include <stddef.h>                     // for size_t
 #include <stdlib.h>                     // for free, NULL
 #include <string.h>                     // for strcmp, strlen, strncmp
+#include <sched.h>                      // for SCHED_OTHER, SCHED_FIFO, SCHED_RR
 #include <search.h>
 //\endcond
 
@@ -40,19 +41,75 @@
 
 #define OPTION_CERT_PATH   "cert_path"
 #define OPTION_EQUALIZER   "equalizer"
+#define OPTION_EQUALIZER_PRESET "equalizer_preset"
+#define OPTION_PRESET_BANDS     "bands"
 #define OPTION_SUBSCRIBE   "subscribe"
 #define OPTION_CACHE_PATH  "cache_path"
 #define OPTION_CACHE_LIMIT "cache_limit"
+#define OPTION_ALSA_MMAP        "alsa_mmap"
+#define OPTION_ALSA_PERIOD_SIZE "alsa_period_size"
+#define OPTION_ALSA_BUFFER_SIZE "alsa_buffer_size"
+#define OPTION_AUDIO_MODULE     "audio_module"
+#define OPTION_NULL_REALTIME    "null_realtime"
+#define OPTION_WAV_FILE         "wav_file"
+#define OPTION_DECODER           "decoder"
+#define OPTION_DECODER_CALIBRATE "decoder_calibrate"
+#define OPTION_NORMALIZE        "normalize"
+#define OPTION_NORMALIZE_TARGET "normalize_target"
+#define OPTION_OUTPUT_RATE      "output_rate"
+#define OPTION_JITTER_PREROLL   "jitter_preroll"
+#define OPTION_HLS              "hls"
+#define OPTION_SEARCH_DESCRIPTIONS "search_descriptions"
+#define OPTION_PLAYBACK_SCHEDULER "playback_scheduler"
+#define OPTION_PLAYBACK_PRIORITY  "playback_priority"
+#define OPTION_PLAYBACK_CPUS      "playback_cpus"
+#define OPTION_PLAYBACK_MLOCK     "playback_mlock"
+#define OPTION_MEMORY_CACHE_SIZE  "memory_cache_size"
 
 static char** config_subscribe = NULL;
 static size_t config_subscribe_count = 0;
 
 static double config_equalizer[EQUALIZER_SIZE] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
 
+/** \brief The equalizer presets, read from the sections `equalizer_preset <name> { bands = {...} }` */
+static struct equalizer_preset {
+	char  *name;
+	double bands[EQUALIZER_SIZE];
+} *equalizer_presets = NULL;
+static size_t equalizer_preset_count = 0;
+
 static char* cert_path;
 static char* cache_path;
 static int   cache_limit;
 
+static cfg_bool_t alsa_mmap;
+static int        alsa_period_size;
+static int        alsa_buffer_size;
+
+static char*      audio_module;
+static cfg_bool_t null_realtime;
+static char*      wav_file;
+
+static char*      decoder;
+static cfg_bool_t decoder_calibrate;
+
+static cfg_bool_t normalize;
+static double     normalize_target;
+
+static int        output_rate;
+static double     jitter_preroll;
+static cfg_bool_t hls;
+static cfg_bool_t search_descriptions;
+
+static char*      playback_scheduler;
+static int        playback_policy;
+static int        playback_priority;
+static cfg_bool_t playback_mlock;
+static int       *playback_cpus = NULL;
+static size_t     playback_cpu_count = 0;
+
+static int        memory_cache_size;
+
 static cfg_t *dynamic_cfg = NULL;
 
 static void config_finalize(void);
@@ -160,15 +217,73 @@ void config_error_function(cfg_t *unused UNUSED, const char *fmt, va_list ap) {
 	_err("%s", buffer);
 }
 
+/** \brief Read the equalizer presets from the (parsed) configuration
+ *
+ *  Presets not containing exactly EQUALIZER_SIZE bands are skipped.
+ *
+ *  \param cfg  The parsed configuration
+ */
+static void config_read_equalizer_presets(cfg_t *cfg) {
+	unsigned int count = cfg_size(cfg, OPTION_EQUALIZER_PRESET);
+	if(!count) return;
+
+	equalizer_presets = lcalloc(count, sizeof(struct equalizer_preset));
+	if(!equalizer_presets) return;
+
+	for(unsigned int i = 0; i < count; i++) {
+		cfg_t *sec = cfg_getnsec(cfg, OPTION_EQUALIZER_PRESET, i);
+		const char *name = cfg_title(sec);
+
+		if(EQUALIZER_SIZE != cfg_size(sec, OPTION_PRESET_BANDS)) {
+			_log("equalizer preset `%s` does not have %i bands, ignoring it", name, EQUALIZER_SIZE);
+			continue;
+		}
+
+		struct equalizer_preset *preset = &equalizer_presets[equalizer_preset_count];
+		preset->name = lstrdup(name);
+		if(!preset->name) continue;
+
+		for(unsigned int band = 0; band < EQUALIZER_SIZE; band++) {
+			preset->bands[band] = cfg_getnfloat(sec, OPTION_PRESET_BANDS, band);
+		}
+		equalizer_preset_count++;
+	}
+}
+
 bool config_init(void) {
 	// read the static configuration:
 	//  - mappings
 	//  - system config (TLS certs)
+	cfg_opt_t preset_opts[] = {
+		CFG_FLOAT_LIST(OPTION_PRESET_BANDS, "{}", CFGF_NONE),
+		CFG_END()
+	};
+
 	cfg_opt_t opts[] = {
 		CFG_FLOAT_LIST(OPTION_EQUALIZER, "{}", CFGF_NONE),
+		CFG_SEC(OPTION_EQUALIZER_PRESET, preset_opts, CFGF_MULTI | CFGF_TITLE),
 		CFG_SIMPLE_STR(OPTION_CERT_PATH,   &cert_path),
 		CFG_SIMPLE_STR(OPTION_CACHE_PATH,  &cache_path),
 		CFG_SIMPLE_INT(OPTION_CACHE_LIMIT, &cache_limit),
+		CFG_SIMPLE_BOOL(OPTION_ALSA_MMAP,       &alsa_mmap),
+		CFG_SIMPLE_INT(OPTION_ALSA_PERIOD_SIZE, &alsa_period_size),
+		CFG_SIMPLE_INT(OPTION_ALSA_BUFFER_SIZE, &alsa_buffer_size),
+		CFG_SIMPLE_STR(OPTION_AUDIO_MODULE,     &audio_module),
+		CFG_SIMPLE_BOOL(OPTION_NULL_REALTIME,   &null_realtime),
+		CFG_SIMPLE_STR(OPTION_WAV_FILE,         &wav_file),
+		CFG_SIMPLE_STR(OPTION_DECODER,          &decoder),
+		CFG_SIMPLE_BOOL(OPTION_DECODER_CALIBRATE, &decoder_calibrate),
+		CFG_SIMPLE_BOOL(OPTION_NORMALIZE,        &normalize),
+		CFG_SIMPLE_FLOAT(OPTION_NORMALIZE_TARGET, &normalize_target),
+		CFG_SIMPLE_INT(OPTION_OUTPUT_RATE,      &output_rate),
+		CFG_SIMPLE_FLOAT(OPTION_JITTER_PREROLL, &jitter_preroll),
+		CFG_SIMPLE_BOOL(OPTION_HLS,             &hls),
+		CFG_SIMPLE_BOOL(OPTION_SEARCH_DESCRIPTIONS, &search_descriptions),
+		CFG_SIMPLE_STR(OPTION_PLAYBACK_SCHEDULER, &playback_scheduler),
+		CFG_SIMPLE_INT(OPTION_PLAYBACK_PRIORITY,  &playback_priority),
+		CFG_INT_LIST(OPTION_PLAYBACK_CPUS, "{}", CFGF_NONE),
+		CFG_SIMPLE_BOOL(OPTION_PLAYBACK_MLOCK,    &playback_mlock),
+		CFG_SIMPLE_INT(OPTION_MEMORY_CACHE_SIZE,  &memory_cache_size),
 		CFG_FUNC("map", config_map_command),
 		CFG_END()
 	};
@@ -176,14 +291,41 @@ bool config_init(void) {
 	/* set default values for options */
 	cert_path   = lstrdup(CERT_DEFAULT_PATH);
 	cache_path  = lstrdup(CACHE_DEFAULT_PATH); // default subdir 'cache' in bin
-	if(!cert_path || !cache_path) {
+	wav_file    = lstrdup(WAV_DEFAULT_FILE);
+	if(!cert_path || !cache_path || !wav_file) {
 		free(cert_path);
 		free(cache_path);
+		free(wav_file);
 		return false;
 	}
 
+	audio_module  = NULL;      // default: probe the available modules
+	null_realtime = cfg_true;
+
+	decoder           = NULL;      // default: libmpg123's choice
+	decoder_calibrate = cfg_false;
+
+	normalize        = cfg_false;
+	normalize_target = NORMALIZE_DEFAULT_TARGET;
+
+	output_rate    = OUTPUT_DEFAULT_RATE;
+	jitter_preroll = JITTER_DEFAULT_PREROLL;
+	hls            = cfg_false;
+
+	search_descriptions = cfg_false;
+
+	playback_scheduler = NULL;      // default: SCHED_OTHER
+	playback_priority  = PLAYBACK_DEFAULT_PRIORITY;
+	playback_mlock     = cfg_false;
+
+	memory_cache_size = MEMORY_CACHE_DEFAULT_SIZE;
+
 	cache_limit = -1; // default: no limit
 
+	alsa_mmap        = cfg_false;
+	alsa_period_size = ALSA_DEFAULT_PERIOD_SIZE;
+	alsa_buffer_size = ALSA_DEFAULT_BUFFER_SIZE;
+
 	cfg_t *cfg = cfg_init(opts, CFGF_NOCASE);
 	cfg_set_error_function(cfg, config_error_function);
 
@@ -207,6 +349,10 @@ bool config_init(void) {
 		_log("Have 0 keymappings, by default you want to have quite a bunch of keymappings...");
 		free(cert_path);
 		free(cache_path);
+		free(wav_file);
+		free(audio_module);
+		free(decoder);
+		free(playback_scheduler);
 		cfg_free(cfg);
 		return false;
 	}
@@ -220,6 +366,17 @@ bool config_init(void) {
 		_log("invalid values for equalizer!");
 	}
 
+	config_read_equalizer_presets(cfg);
+
+	playback_cpu_count = cfg_size(cfg, OPTION_PLAYBACK_CPUS);
+	playback_cpus      = lcalloc(playback_cpu_count, sizeof(int));
+	if(!playback_cpus) {
+		playback_cpu_count = 0;
+	}
+	for(size_t i = 0; i < playback_cpu_count; i++) {
+		playback_cpus[i] = cfg_getnint(cfg, OPTION_PLAYBACK_CPUS, i);
+	}
+
 	cfg_free(cfg);
 
 	// read the dynamic configuration:
@@ -246,7 +403,51 @@ bool config_init(void) {
 	for(size_t i = 0; i < config_subscribe_count; i++) {
 		_log("| * %s", config_subscribe[i]);
 	}
-	_log("| cache: `%s`, limit: %i", cache_path, cache_limit);
+	_log("| cache: `%s`, limit: %i, memory: %i MiB", cache_path, cache_limit, memory_cache_size);
+	for(size_t i = 0; i < equalizer_preset_count; i++) {
+		_log("| equalizer preset: `%s`", equalizer_presets[i].name);
+	}
+	_log("| audio module: %s", audio_module ? audio_module : "<auto>");
+	_log("| normalize: %s, target: %.1f LUFS", normalize ? "yes" : "no", normalize_target);
+	_log("| decoder: %s, calibrate: %s", decoder ? decoder : "<default>", decoder_calibrate ? "yes" : "no");
+	_log("| output rate: %i Hz", output_rate);
+	_log("| jitter buffer: %.1fs pre-roll", jitter_preroll);
+	_log("| hls: %s", hls ? "yes" : "no");
+	_log("| search descriptions: %s", search_descriptions ? "yes" : "no");
+	_log("| playback thread: scheduler: %s, priority: %i, %zu cpus, mlock: %s", playback_scheduler ? playback_scheduler : "<default>", playback_priority, playback_cpu_count, playback_mlock ? "yes" : "no");
+	_log("| alsa: mmap: %s, period: %i frames, buffer: %i frames", alsa_mmap ? "yes" : "no", alsa_period_size, alsa_buffer_size);
+
+	if(0 >= alsa_period_size || 0 >= alsa_buffer_size) {
+		_log("invalid values for alsa period/buffer size, using defaults");
+		alsa_period_size = ALSA_DEFAULT_PERIOD_SIZE;
+		alsa_buffer_size = ALSA_DEFAULT_BUFFER_SIZE;
+	}
+
+	if(0 > output_rate) {
+		_log("invalid output rate, using default");
+		output_rate = OUTPUT_DEFAULT_RATE;
+	}
+
+	playback_policy = SCHED_OTHER;
+	if(playback_scheduler) {
+		if(streq("fifo", playback_scheduler)) {
+			playback_policy = SCHED_FIFO;
+		} else if(streq("rr", playback_scheduler)) {
+			playback_policy = SCHED_RR;
+		} else if(!streq("other", playback_scheduler)) {
+			_log("invalid scheduler `%s` for playback thread, using default", playback_scheduler);
+		}
+	}
+
+	if(0 > memory_cache_size) {
+		_log("invalid size of the memory cache, using default");
+		memory_cache_size = MEMORY_CACHE_DEFAULT_SIZE;
+	}
+
+	if(0 > jitter_preroll) {
+		_log("invalid jitter buffer pre-roll, using default");
+		jitter_preroll = JITTER_DEFAULT_PREROLL;
+	}
 
 	if(atexit(config_finalize)) {
 		_log("atexit: %s", strerror(errno));
@@ -268,8 +469,19 @@ static void config_finalize(void) {
 		free(config_subscribe[i]);
 	}
 	free(config_subscribe);
+
+	for(size_t i = 0; i < equalizer_preset_count; i++) {
+		free(equalizer_presets[i].name);
+	}
+	free(equalizer_presets);
+
 	free(cache_path);
 	free(cert_path);
+	free(audio_module);
+	free(wav_file);
+	free(decoder);
+	free(playback_scheduler);
+	free(playback_cpus);
 
 	cfg_free(dynamic_cfg);
 }
@@ -312,6 +524,43 @@ size_t config_get_subscribe_count(void) { return config_subscribe_count; }
 char*  config_get_cert_path(void)       { return cert_path; }
 char*  config_get_cache_path(void)      { return cache_path; }
 double config_get_equalizer(int band)   { return config_equalizer[band]; }
+const double* config_get_equalizer_preset(const char *name) {
+	if(streq("", name)) {
+		return config_equalizer;
+	}
+
+	for(size_t i = 0; i < equalizer_preset_count; i++) {
+		if(streq(name, equalizer_presets[i].name)) {
+			return equalizer_presets[i].bands;
+		}
+	}
+	return NULL;
+}
+
+bool   config_get_alsa_mmap(void)        { return alsa_mmap; }
+size_t config_get_alsa_period_size(void) { return alsa_period_size; }
+size_t config_get_alsa_buffer_size(void) { return alsa_buffer_size; }
+char*  config_get_audio_module(void)     { return audio_module; }
+bool   config_get_null_realtime(void)    { return null_realtime; }
+char*  config_get_wav_file(void)         { return wav_file; }
+char*  config_get_decoder(void)          { return decoder; }
+bool   config_get_decoder_calibrate(void) { return decoder_calibrate; }
+bool   config_get_normalize(void)        { return normalize; }
+double config_get_normalize_target(void) { return normalize_target; }
+unsigned int config_get_output_rate(void) { return output_rate; }
+double config_get_jitter_preroll(void)   { return jitter_preroll; }
+bool   config_get_hls(void)              { return hls; }
+bool   config_get_search_descriptions(void) { return search_descriptions; }
+int    config_get_playback_policy(void)  { return playback_policy; }
+int    config_get_playback_priority(void) { return playback_priority; }
+bool   config_get_playback_mlock(void)   { return playback_mlock; }
+size_t config_get_playback_cpu_count(void) { return playback_cpu_count; }
+size_t config_get_memory_cache_size(void) { return (size_t) memory_cache_size * 1024 * 1024; }
+
+int config_get_playback_cpu(size_t id) {
+	assert(id < playback_cpu_count && "ERROR: id >= playback_cpu_count");
+	return playback_cpus[id];
+}
 
 void config_add_subscription(char *user) {
 	cfg_addlist(dynamic_cfg, OPTION_SUBSCRIBE, 1, user);
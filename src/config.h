@@ -100,6 +100,138 @@
 	 */
 	double config_get_equalizer(int band);
 
+	/** \brief Returns the bands of an equalizer preset
+	 *
+	 *  The presets are read from the configuration once, on initialization.
+	 *
+	 *  \param name  The name of the preset, the empty string denotes the equalizer configured via `equalizer`
+	 *  \return      The EQUALIZER_SIZE values of the preset, `NULL` if there is no such preset
+	 */
+	const double* config_get_equalizer_preset(const char *name) ATTR(nonnull);
+
+	/** \brief Returns whether the ALSA output should use mmapped access
+	 *
+	 *  \return `true` if SND_PCM_ACCESS_MMAP_INTERLEAVED should be used, `false` for SND_PCM_ACCESS_RW_INTERLEAVED
+	 */
+	bool config_get_alsa_mmap(void);
+
+	/** \brief Returns the period size (in frames) requested from ALSA in mmap mode
+	 *
+	 *  \return The period size in frames
+	 */
+	size_t config_get_alsa_period_size(void);
+
+	/** \brief Returns the buffer size (in frames) requested from ALSA in mmap mode
+	 *
+	 *  \return The buffer size in frames
+	 */
+	size_t config_get_alsa_buffer_size(void);
+
+	/** \brief Returns the name of the AO module to use (e.g. `alsa`, `ao`, `null` or `wav`)
+	 *
+	 *  \return The name of the module, `NULL` if the available modules should be probed
+	 */
+	char* config_get_audio_module(void);
+
+	/** \brief Returns whether the `null` AO module consumes samples in real-time
+	 *
+	 *  \return `true` if samples are consumed in real-time, `false` if as fast as possible
+	 */
+	bool config_get_null_realtime(void);
+
+	/** \brief Returns the file the `wav` AO module writes to
+	 *
+	 *  \return The path to the WAV file (guaranteed to be non-`NULL`)
+	 */
+	char* config_get_wav_file(void) ATTR(returns_nonnull);
+
+	/** \brief Returns the mpg123 decoder to use (e.g. `x86-64`, `AVX`, `NEON`)
+	 *
+	 *  \return The name of the decoder, `NULL` if not configured
+	 */
+	char* config_get_decoder(void);
+
+	/** \brief Returns whether the fastest mpg123 decoder should be determined on startup
+	 *
+	 *  \return `true` if the decoders should be calibrated (unless a decoder is configured explicitly)
+	 */
+	bool config_get_decoder_calibrate(void);
+
+	/** \brief Returns whether the loudness of tracks should be normalized
+	 *
+	 *  \return `true` if tracks should be analysed and normalized, `false` otherwise
+	 */
+	bool config_get_normalize(void);
+
+	/** \brief Returns the target loudness (in LUFS) for normalization
+	 *
+	 *  \return The target loudness in LUFS
+	 */
+	double config_get_normalize_target(void);
+
+	/** \brief Returns the sample rate (in Hz) of the output
+	 *
+	 *  The output device is configured once, the samples of all tracks are resampled to this rate.
+	 *
+	 *  \return The sample rate of the output, 0 to use the rate of the first track played
+	 */
+	unsigned int config_get_output_rate(void);
+
+	/** \brief Returns the budget of the in-memory tier of the cache (configured in MiB via `memory_cache_size`)
+	 *
+	 *  \return The budget in bytes, 0 if the memory cache is disabled
+	 */
+	size_t config_get_memory_cache_size(void);
+
+	/** \brief Returns the number of seconds to buffer before playback of a download starts (or resumes after a stall)
+	 *
+	 *  \return The minimum pre-roll in seconds, 0 if the jitter buffer is disabled
+	 */
+	double config_get_jitter_preroll(void);
+
+	/** \brief Returns whether tracks not within the cache should be streamed via HLS
+	 *
+	 *  \return `true` to use the HLS playlist of a track, `false` to download its `stream_url`
+	 */
+	bool config_get_hls(void);
+
+	/** \brief Returns whether searching includes the descriptions of tracks (see trigram.h)
+	 *
+	 *  \return `true` if the descriptions are indexed and searched, `false` to search titles and usernames only
+	 */
+	bool config_get_search_descriptions(void);
+
+	/** \brief Returns the scheduling policy of the playback thread, which writes to the output as well (configured via `playback_scheduler`)
+	 *
+	 *  \return `SCHED_OTHER` (default), `SCHED_FIFO` or `SCHED_RR`
+	 */
+	int config_get_playback_policy(void);
+
+	/** \brief Returns the realtime priority of the playback thread (`SCHED_FIFO` and `SCHED_RR` only)
+	 *
+	 *  \return The priority, clamped to the range of the policy by the caller
+	 */
+	int config_get_playback_priority(void);
+
+	/** \brief Returns whether the stack and the buffers of the playback thread should be locked in memory
+	 *
+	 *  \return `true` if `mlock` should be used, `false` otherwise
+	 */
+	bool config_get_playback_mlock(void);
+
+	/** \brief Returns the number of CPUs the playback thread is pinned to
+	 *
+	 *  \return The number of CPUs, 0 if the playback thread may run on any CPU
+	 */
+	size_t config_get_playback_cpu_count(void);
+
+	/** \brief Returns a CPU the playback thread is pinned to
+	 *
+	 *  \param id  The index, in [0; config_get_playback_cpu_count())
+	 *  \return    The number of the CPU
+	 */
+	int config_get_playback_cpu(size_t id);
+
 	/** \brief Add subscription to configuration file
 	 *
 	 *  \param user  The user to be added to the configuration
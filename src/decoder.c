@@ -0,0 +1,639 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file decoder.c
+ *  \brief Implements decoding of (partially) downloaded MP3s using libmpg123
+ */
+
+#include "_hard_config.h"
+#include "decoder.h"
+
+//\cond
+#include <assert.h>
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <stdio.h>                      // for fopen, fgets, etc
+#include <stdlib.h>                     // for free
+#include <string.h>                     // for memcpy, strncmp
+#include <sys/types.h>                  // for off_t, ssize_t
+#include <sys/utsname.h>                // for uname
+#include <time.h>                       // for clock_gettime
+#include <unistd.h>                     // for SEEK_SET, SEEK_CUR, etc
+//\endcond
+
+#include "config.h"                     // for config_get_equalizer_preset
+#include "helper.h"                     // for lmalloc
+#include "hls.h"                        // for hls_stream_read, hls_stream_seek, etc
+#include "log.h"                        // for _log
+
+/** \brief The maximum number of bytes passed to a single call of `mpg123_feed` */
+#define DECODER_FEED_SIZE 16384
+
+/** \brief The number of MPEG frames decoded per decoder during calibration (~26ms each) */
+#define CALIBRATION_FRAMES 1000
+
+/** \brief The number of runs per decoder during calibration, the fastest one counts */
+#define CALIBRATION_RUNS 3
+
+/** \brief The size of a single frame of the calibration snippet (MPEG 1 Layer III, 128kbit/s, 44.1kHz) */
+#define CALIBRATION_FRAME_SIZE 417
+
+/** \brief The header of each frame of the calibration snippet
+ *
+ *  MPEG 1 Layer III, no CRC, 128kbit/s, 44.1kHz, no padding, joint stereo.
+ *  The (zeroed) side info and main data following the header decode to silence, but still
+ *  pass the synthesis filterbank, which is what the decoders provided by libmpg123 differ in.
+ */
+static const unsigned char calibration_header[] = { 0xff, 0xfb, 0x90, 0x44 };
+
+/** \brief The decoder used for every new handle (`NULL` for libmpg123's default) */
+static char *default_backend = NULL;
+
+struct io_handle {
+	size_t                 position;       //< the current position
+	struct download_state *download_state; //< contains the maximum (currently possible) position
+};
+
+static void _io_await_recvd_size(struct download_state *dlstat, size_t recvd) {
+	bool io_have_data = false;
+	do {
+		pthread_mutex_lock(&dlstat->io_mutex);
+		io_have_data = (recvd < dlstat->bytes_recvd);
+		if(!io_have_data) {
+			pthread_cond_wait(&dlstat->io_cond, &dlstat->io_mutex);
+			io_have_data = (recvd < dlstat->bytes_recvd);
+		}
+		pthread_mutex_unlock(&dlstat->io_mutex);
+	} while(!io_have_data);
+}
+
+static ssize_t _io_read(void *_iohandle, void *mpg123buffer, size_t count) {
+	struct io_handle *iohandle    = (struct io_handle*) _iohandle;
+	struct download_state *dlstat = iohandle->download_state;
+
+	size_t bytes_copied = 0;
+	if(iohandle->position >= dlstat->bytes_total - 4096) {
+		size_t bytes_available = dlstat->bytes_total - iohandle->position;
+		bytes_copied = count < bytes_available ? count : bytes_available;
+
+		memcpy(mpg123buffer, &dlstat->buffer[iohandle->position], bytes_copied);
+		iohandle->position += bytes_copied;
+	} else {
+		_io_await_recvd_size(dlstat, iohandle->position + count);
+
+		size_t bytes_available = 0;
+		if(dlstat->bytes_recvd > iohandle->position) {
+			bytes_available = dlstat->bytes_recvd - iohandle->position;
+		}
+		bytes_copied = count < bytes_available ? count : bytes_available;
+
+		memcpy(mpg123buffer, &dlstat->buffer[iohandle->position], bytes_copied);
+		iohandle->position += bytes_copied;
+	}
+
+	if(bytes_copied < count) {
+		_log("WARNING: %zu bytes at position %zu requested, but can only deliver %zu bytes", count, iohandle->position, bytes_copied);
+	}
+
+	return bytes_copied;
+}
+
+static off_t _io_seek(void *_iohandle, off_t offset, int whence) {
+	struct io_handle *iohandle    = (struct io_handle*) _iohandle;
+	struct download_state *dlstat = iohandle->download_state;
+
+	// downloading needs to be started at least, as we need to know the bytes available in total
+	_io_await_recvd_size(dlstat, 0);
+
+	size_t abs_offset = 0;
+	switch(whence) {
+		case SEEK_SET: assert(offset >= 0);  abs_offset = offset; break;
+		case SEEK_CUR: abs_offset = iohandle->position  + offset; break;
+		case SEEK_END: abs_offset = dlstat->bytes_total + offset; break;
+		default: {
+			_err("invalid value for whence: %i", whence);
+			return (off_t) -1;
+		}
+	}
+
+	if(abs_offset > dlstat->bytes_total) {
+		_err("cannot seek to %zu, only have at max. %zu bytes", abs_offset, dlstat->bytes_total);
+		return (off_t) -1;
+	}
+
+	iohandle->position = abs_offset;
+	return abs_offset;
+}
+
+static void _io_cleanup(void *iohandle) {
+	free(iohandle);
+	_log("cleanup called");
+}
+
+/** \brief Make libmpg123 pull its input from `decoder->state` using the reader callbacks
+ *
+ *  \return  `true` on success, `false` otherwise
+ */
+static bool decoder_open_callback(struct decoder *decoder) {
+	mpg123_handle *mh = decoder->mh;
+
+	if(MPG123_OK != mpg123_replace_reader_handle(mh, _io_read, _io_seek, _io_cleanup)) {
+		_err("mpg123_replace_reader_handle: %s", mpg123_strerror(mh));
+		return false;
+	}
+
+	struct io_handle *iohandle = lmalloc( sizeof(struct io_handle) );
+	if(!iohandle) {
+		return false;
+	}
+	iohandle->position       = 0;
+	iohandle->download_state = decoder->state;
+
+	if(MPG123_OK != mpg123_open_handle(mh, iohandle)) {
+		_err("mpg123_open_handle: %s", mpg123_strerror(mh));
+		free(iohandle);
+		return false;
+	}
+	decoder->io = iohandle;
+
+	return true;
+}
+
+/** \brief Feed the next chunk of data read from the hls_stream to libmpg123 (`reader_hls` only)
+ *
+ *  \return  `true` if data was fed, `false` if the end of the stream was reached (or reading failed)
+ */
+static bool decoder_feed_hls(struct decoder *decoder) {
+	unsigned char buffer[DECODER_FEED_SIZE];
+
+	ssize_t bytes = hls_stream_read(decoder->hls, buffer, sizeof(buffer));
+	if(0 >= bytes) {
+		return false;
+	}
+
+	if(MPG123_OK != mpg123_feed(decoder->mh, buffer, bytes)) {
+		_err("mpg123_feed: %s", mpg123_strerror(decoder->mh));
+		return false;
+	}
+	decoder->feed_position += bytes;
+
+	return true;
+}
+
+/** \brief Feed the next chunk of data available to libmpg123 (`reader_feed` and `reader_hls` only)
+ *
+ *  \return  `true` if data was fed, `false` if the end of the stream was reached
+ */
+static bool decoder_feed(struct decoder *decoder) {
+	if(reader_hls == decoder->reader) {
+		return decoder_feed_hls(decoder);
+	}
+
+	struct download_state *dlstat = decoder->state;
+
+	if(dlstat->bytes_total && decoder->feed_position >= dlstat->bytes_total) {
+		return false;
+	}
+
+	_io_await_recvd_size(dlstat, decoder->feed_position);
+
+	size_t bytes = dlstat->bytes_recvd - decoder->feed_position;
+	if(bytes > DECODER_FEED_SIZE) {
+		bytes = DECODER_FEED_SIZE;
+	}
+
+	if(MPG123_OK != mpg123_feed(decoder->mh, (const unsigned char*) &dlstat->buffer[decoder->feed_position], bytes)) {
+		_err("mpg123_feed: %s", mpg123_strerror(decoder->mh));
+		return false;
+	}
+	decoder->feed_position += bytes;
+
+	return true;
+}
+
+/** \brief Returns `true` if `backend` is supported on this machine
+ */
+static bool decoder_is_supported(const char *backend) {
+	const char **supported = mpg123_supported_decoders();
+	for(size_t i = 0; supported[i]; i++) {
+		if(streq(supported[i], backend)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** \brief Get the model of the CPU as reported by /proc/cpuinfo
+ *
+ *  On x86 `model name` is used, on ARM `Hardware` or `CPU part`; the machine as returned by `uname()` otherwise.
+ *
+ *  \param buffer  The buffer to write the model to
+ *  \param size    The size of `buffer`
+ */
+static void decoder_cpu_model(char *buffer, size_t size) {
+	static const char *keys[] = { "model name", "Hardware", "CPU part", NULL };
+
+	buffer[0] = '\0';
+
+	FILE *fh = fopen("/proc/cpuinfo", "r");
+	if(fh) {
+		char line[256];
+		for(size_t k = 0; keys[k] && !buffer[0]; k++) {
+			rewind(fh);
+			while(fgets(line, sizeof(line), fh)) {
+				if(!strncmp(line, keys[k], strlen(keys[k]))) {
+					char *value = strchr(line, ':');
+					if(value) {
+						value += strspn(value, ": \t");
+						value[strcspn(value, "\n")] = '\0';
+						snprintf(buffer, size, "%s", value);
+					}
+					break;
+				}
+			}
+		}
+		fclose(fh);
+	}
+
+	if(!buffer[0]) {
+		struct utsname uts;
+		snprintf(buffer, size, "%s", uname(&uts) ? "unknown" : uts.machine);
+	}
+
+	// the model is stored as the second column of a tab-separated file
+	for(char *c = buffer; *c; c++) {
+		if('\t' == *c) *c = ' ';
+	}
+}
+
+/** \brief Time decoding the calibration snippet using `backend`
+ *
+ *  \param snippet  The snippet
+ *  \param size     The size of the snippet
+ *  \param backend  The decoder to time
+ *  \return         The time (in µs) of the fastest run, or `-1` in case of failure
+ */
+static double decoder_time_backend(const unsigned char *snippet, size_t size, const char *backend) {
+	double best = -1;
+
+	for(unsigned int run = 0; run < CALIBRATION_RUNS; run++) {
+		mpg123_handle *mh = mpg123_new(backend, NULL);
+		if(!mh) {
+			return -1;
+		}
+		mpg123_param(mh, MPG123_FLAGS, MPG123_QUIET, 0.0);
+
+		if(MPG123_OK != mpg123_open_feed(mh) || MPG123_OK != mpg123_feed(mh, snippet, size)) {
+			mpg123_delete(mh);
+			return -1;
+		}
+
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		off_t frame_offset;
+		unsigned char *audio;
+		size_t bytes;
+		int err;
+		while(MPG123_OK == (err = mpg123_decode_frame(mh, &frame_offset, &audio, &bytes)) || MPG123_NEW_FORMAT == err);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		mpg123_close(mh);
+		mpg123_delete(mh);
+
+		double elapsed = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+		if(0 > best || elapsed < best) {
+			best = elapsed;
+		}
+	}
+
+	return best;
+}
+
+/** \brief Time each supported decoder and return the fastest one
+ *
+ *  \return The name of the fastest decoder (static, provided by libmpg123), `NULL` in case of failure
+ */
+static const char* decoder_calibrate(void) {
+	const size_t size = CALIBRATION_FRAMES * CALIBRATION_FRAME_SIZE;
+	unsigned char *snippet = lcalloc(size, 1);
+	if(!snippet) {
+		return NULL;
+	}
+
+	for(size_t i = 0; i < CALIBRATION_FRAMES; i++) {
+		memcpy(&snippet[i * CALIBRATION_FRAME_SIZE], calibration_header, sizeof(calibration_header));
+	}
+
+	const char *fastest = NULL;
+	double fastest_time = -1;
+
+	const char **supported = mpg123_supported_decoders();
+	for(size_t i = 0; supported[i]; i++) {
+		double elapsed = decoder_time_backend(snippet, size, supported[i]);
+		_log("| * %-16s %10.0fus", supported[i], elapsed);
+
+		if(0 <= elapsed && (0 > fastest_time || elapsed < fastest_time)) {
+			fastest      = supported[i];
+			fastest_time = elapsed;
+		}
+	}
+
+	free(snippet);
+	return fastest;
+}
+
+/** \brief Search the calibration cache for the result for `cpu_model`
+ *
+ *  \return The decoder (to be freed by the caller), `NULL` if there is no (usable) result
+ */
+static char* decoder_cache_lookup(const char *file, const char *cpu_model) {
+	FILE *fh = fopen(file, "r");
+	if(!fh) {
+		return NULL;
+	}
+
+	char *result = NULL;
+
+	char line[512];
+	while(!result && fgets(line, sizeof(line), fh)) {
+		line[strcspn(line, "\n")] = '\0';
+
+		char *model = strchr(line, '\t');
+		if(model) {
+			*model = '\0';
+			if(streq(model + 1, cpu_model) && decoder_is_supported(line)) {
+				result = lstrdup(line);
+			}
+		}
+	}
+
+	fclose(fh);
+	return result;
+}
+
+bool decoder_init(void) {
+	char *backend = config_get_decoder();
+	if(backend) {
+		if(decoder_is_supported(backend)) {
+			default_backend = lstrdup(backend);
+			_log("using configured decoder `%s`", backend);
+			return true;
+		}
+		_err("configured decoder `%s` is not supported", backend);
+	}
+
+	if(!config_get_decoder_calibrate()) {
+		return true;
+	}
+
+	char cpu_model[256];
+	decoder_cpu_model(cpu_model, sizeof(cpu_model));
+
+	char *cache_file = smprintf("%s/"CACHE_DECODER_FILE, config_get_cache_path());
+	if(!cache_file) {
+		return false;
+	}
+
+	default_backend = decoder_cache_lookup(cache_file, cpu_model);
+	if(default_backend) {
+		_log("using decoder `%s` (calibrated for `%s`)", default_backend, cpu_model);
+		free(cache_file);
+		return true;
+	}
+
+	_log("calibrating decoders for `%s`:", cpu_model);
+	const char *fastest = decoder_calibrate();
+	if(fastest) {
+		_log("using decoder `%s` (fastest on `%s`)", fastest, cpu_model);
+		default_backend = lstrdup(fastest);
+
+		FILE *fh = fopen(cache_file, "a");
+		if(fh) {
+			fprintf(fh, "%s\t%s\n", fastest, cpu_model);
+			fclose(fh);
+		} else {
+			_err("failed to open `%s`: %s", cache_file, strerror(errno));
+		}
+	}
+
+	free(cache_file);
+	return true;
+}
+
+void decoder_finalize(void) {
+	free(default_backend);
+	default_backend = NULL;
+}
+
+struct decoder* decoder_open(struct download_state *state, enum decoder_reader reader, const char *backend, bool equalizer) {
+	struct decoder *decoder = lmalloc(sizeof(struct decoder));
+	if(!decoder) {
+		return NULL;
+	}
+
+	decoder->reader        = reader;
+	decoder->state         = state;
+	decoder->feed_position = 0;
+	decoder->io            = NULL;
+	decoder->hls           = NULL;
+	decoder->time_offset   = 0;
+	decoder->skip_until    = 0;
+
+	int err;
+	decoder->mh = mpg123_new(NULL, &err);
+	if(!decoder->mh) {
+		_err("mpg123_new: %s", mpg123_plain_strerror(err));
+		free(decoder);
+		return NULL;
+	}
+
+	if(!backend) {
+		backend = default_backend;
+	}
+
+	if(backend && MPG123_OK != mpg123_decoder(decoder->mh, backend)) {
+		_err("mpg123_decoder(%s): %s", backend, mpg123_strerror(decoder->mh));
+	}
+
+	if(MPG123_OK != mpg123_param(decoder->mh, MPG123_FLAGS, MPG123_QUIET, 0.0)) {
+		_err("mpg123_param: %s", mpg123_strerror(decoder->mh));
+		mpg123_delete(decoder->mh);
+		free(decoder);
+		return NULL;
+	}
+
+	bool success = false;
+	switch(reader) {
+		case reader_callback: success = decoder_open_callback(decoder); break;
+		case reader_feed:
+		case reader_hls: {
+			success = (MPG123_OK == mpg123_open_feed(decoder->mh));
+			if(!success) {
+				_err("mpg123_open_feed: %s", mpg123_strerror(decoder->mh));
+			}
+			break;
+		}
+		default: _err("invalid reader mode: %i", reader);
+	}
+
+	if(!success) {
+		mpg123_delete(decoder->mh);
+		free(decoder);
+		return NULL;
+	}
+
+	// set the new values for the equalizer obtained from configuration
+	if(equalizer) {
+		decoder_set_equalizer(decoder, config_get_equalizer_preset(""));
+	}
+
+	return decoder;
+}
+
+struct decoder* decoder_open_hls(struct hls_stream *stream, const char *backend) {
+	struct decoder *decoder = decoder_open(NULL, reader_hls, backend, false);
+	if(decoder) {
+		decoder->hls = stream;
+	}
+	return decoder;
+}
+
+size_t decoder_input_position(struct decoder *decoder) {
+	if(reader_callback == decoder->reader) {
+		return decoder->io ? decoder->io->position : 0;
+	}
+	return decoder->feed_position;
+}
+
+void decoder_set_equalizer(struct decoder *decoder, const double *bands) {
+	for(int i = 0; i < EQUALIZER_SIZE; i++) {
+		mpg123_eq(decoder->mh, MPG123_LR, i, bands[i]);
+	}
+}
+
+bool decoder_set_encoding(struct decoder *decoder, int encoding) {
+	const long *rates;
+	size_t rate_count;
+	mpg123_rates(&rates, &rate_count);
+
+	mpg123_format_none(decoder->mh);
+	for(size_t i = 0; i < rate_count; i++) {
+		if(MPG123_OK != mpg123_format(decoder->mh, rates[i], MPG123_MONO | MPG123_STEREO, encoding)) {
+			_err("mpg123_format: %s", mpg123_strerror(decoder->mh));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int decoder_decode_frame(struct decoder *decoder, unsigned char **audio, size_t *bytes) {
+	off_t frame_offset;
+
+	// after seeking within a hls_stream: skip the frames between the start of the segment and the target
+	int err;
+	do {
+		err = mpg123_decode_frame(decoder->mh, &frame_offset, audio, bytes);
+		while(MPG123_NEED_MORE == err && reader_callback != decoder->reader) {
+			if(!decoder_feed(decoder)) {
+				return MPG123_DONE;
+			}
+			err = mpg123_decode_frame(decoder->mh, &frame_offset, audio, bytes);
+		}
+	} while(MPG123_OK == err && decoder_position(decoder) < decoder->skip_until);
+
+	return err;
+}
+
+/** \brief Seek to the segment containing `secs`, restarting the decoder at its beginning (`reader_hls` only)
+ */
+static bool decoder_seek_hls(struct decoder *decoder, unsigned int secs) {
+	const struct hls_playlist *playlist = hls_stream_playlist(decoder->hls);
+	const size_t segment = hls_playlist_segment_at(playlist, secs);
+
+	if(!hls_stream_seek(decoder->hls, segment)) {
+		return false;
+	}
+
+	// the data fed so far is discarded, each segment starts with a complete frame
+	mpg123_close(decoder->mh);
+	if(MPG123_OK != mpg123_open_feed(decoder->mh)) {
+		_err("mpg123_open_feed: %s", mpg123_strerror(decoder->mh));
+		return false;
+	}
+
+	_log("requested seek to %us, segment %zu at %.1fs", secs, segment, playlist->segments[segment].start);
+	decoder->time_offset = playlist->segments[segment].start;
+	decoder->skip_until  = secs;
+	return true;
+}
+
+bool decoder_seek(struct decoder *decoder, unsigned int secs) {
+	mpg123_handle *mh = decoder->mh;
+
+	if(reader_hls == decoder->reader) {
+		return decoder_seek_hls(decoder, secs);
+	}
+
+	if(reader_feed == decoder->reader) {
+		long rate;
+		int channels, encoding;
+		if(MPG123_OK != mpg123_getformat(mh, &rate, &channels, &encoding)) {
+			_err("mpg123_getformat: %s", mpg123_strerror(mh));
+			return false;
+		}
+
+		off_t input_offset;
+		if(0 > mpg123_feedseek(mh, (off_t) secs * rate, SEEK_SET, &input_offset)) {
+			_err("mpg123_feedseek: %s", mpg123_strerror(mh));
+			return false;
+		}
+
+		// continue feeding at the offset requested by libmpg123
+		decoder->feed_position = input_offset;
+		return true;
+	}
+
+	off_t target_frame_off = mpg123_timeframe(mh, secs);
+	if(0 > target_frame_off) {
+		_err("cannot get offset for time %us: %s", secs, mpg123_strerror(mh));
+		return false;
+	}
+
+	_log("requested seek to %us, frame at %zi", secs, target_frame_off);
+	if(0 > mpg123_seek_frame(mh, target_frame_off, SEEK_SET)) {
+		_err("mpg123_seek_frame: %s", mpg123_strerror(mh));
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int decoder_position(struct decoder *decoder) {
+	return (unsigned int) (decoder->time_offset + mpg123_tpf(decoder->mh) * mpg123_tellframe(decoder->mh));
+}
+
+void decoder_close(struct decoder *decoder) {
+	if(decoder) {
+		mpg123_close(decoder->mh);
+		mpg123_delete(decoder->mh);
+		free(decoder);
+	}
+}
@@ -0,0 +1,151 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file decoder.h
+ *  \brief Decoding of (partially) downloaded MP3s using libmpg123
+ *
+ *  The decoder reads from a download_state, waiting for the downloader if required.
+ *  It is used by the playback thread (see sound.c) and by the benchmarks in `bench/`,
+ *  such that both run the very same code path.
+ */
+
+#ifndef _DECODER_H
+	#define _DECODER_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	#include <mpg123.h>                     // for mpg123_handle
+
+	#include "downloader.h"                 // for download_state
+
+	/** \brief The way libmpg123 obtains its input */
+	enum decoder_reader {
+		reader_callback, ///< libmpg123 pulls the data using custom reader callbacks (default)
+		reader_feed,     ///< the data is pushed to libmpg123 using `mpg123_feed`
+		reader_hls       ///< the data is read from a hls_stream and pushed to libmpg123 using `mpg123_feed`
+	};
+
+	struct io_handle;
+	struct hls_stream;
+
+	struct decoder {
+		mpg123_handle         *mh;             ///< The handle used for decoding
+		enum decoder_reader    reader;         ///< The reader mode used by `mh`
+		struct download_state *state;          ///< The download_state to read the data from
+		size_t                 feed_position;  ///< The position of the next byte to feed (`reader_feed` only)
+		struct io_handle      *io;             ///< The state of the reader callbacks (`reader_callback` only)
+		struct hls_stream     *hls;            ///< The stream to read the data from (`reader_hls` only)
+		double                 time_offset;    ///< The time (in seconds) the data fed starts at (`reader_hls` only)
+		unsigned int           skip_until;     ///< Frames before this position (in seconds) are skipped (`reader_hls` only)
+	};
+
+	/** \brief Initialize the decoder used for new handles
+	 *
+	 *  Uses the decoder configured by `decoder`. If `decoder_calibrate` is enabled instead, the
+	 *  fastest decoder for this CPU model is used: it is either read from the calibration cache (within
+	 *  the cache directory) or determined by timing each supported decoder on a short snippet.
+	 *
+	 *  Requires `mpg123_init()` to be called before.
+	 *
+	 *  \return `true` on success, `false` otherwise
+	 */
+	bool decoder_init(void);
+
+	/** \brief Release the resources allocated by decoder_init()
+	 */
+	void decoder_finalize(void);
+
+	/** \brief Create a new decoder reading from `state`
+	 *
+	 *  \param state      The download_state containing the (possibly still downloading) data
+	 *  \param reader     The reader mode to use
+	 *  \param backend    The name of the mpg123 decoder to use (`NULL` for the one chosen by decoder_init())
+	 *  \param equalizer  `true` if the equalizer from the configuration should be applied
+	 *  \return           The newly created decoder, `NULL` in case of failure
+	 */
+	struct decoder* decoder_open(struct download_state *state, enum decoder_reader reader, const char *backend, bool equalizer);
+
+	/** \brief Create a new decoder reading from a hls_stream
+	 *
+	 *  Seeking maps to the segments of the stream, only the segment containing the target is downloaded.
+	 *
+	 *  \param stream   The stream to read the data from (still owned by the caller)
+	 *  \param backend  The name of the mpg123 decoder to use (`NULL` for the one chosen by decoder_init())
+	 *  \return         The newly created decoder, `NULL` in case of failure
+	 */
+	struct decoder* decoder_open_hls(struct hls_stream *stream, const char *backend) ATTR(nonnull(1));
+
+	/** \brief Restrict the output of the decoder to a single encoding
+	 *
+	 *  Needs to be called prior to decoding the first frame.
+	 *
+	 *  \param decoder   The decoder
+	 *  \param encoding  The encoding (e.g. `MPG123_ENC_SIGNED_16`)
+	 *  \return          `true` on success, `false` otherwise
+	 */
+	bool decoder_set_encoding(struct decoder *decoder, int encoding);
+
+	/** \brief Get the position of the next byte of the input read by the decoder
+	 *
+	 *  \param decoder  The decoder
+	 *  \return         The offset (in bytes) within the download_state's buffer
+	 */
+	size_t decoder_input_position(struct decoder *decoder);
+
+	/** \brief Set the bands of the equalizer
+	 *
+	 *  May be called between any two frames, the new values apply to the next frame decoded.
+	 *
+	 *  \param decoder  The decoder
+	 *  \param bands    The EQUALIZER_SIZE factors, `1.0` denotes `no change in volume`
+	 */
+	void decoder_set_equalizer(struct decoder *decoder, const double *bands);
+
+	/** \brief Decode the next frame
+	 *
+	 *  \param decoder  The decoder
+	 *  \param audio    Set to the buffer holding the decoded samples
+	 *  \param bytes    Set to the number of bytes in `audio`
+	 *  \return         `MPG123_OK`, `MPG123_NEW_FORMAT`, `MPG123_DONE` or an error as returned by `mpg123_decode_frame`
+	 */
+	int decoder_decode_frame(struct decoder *decoder, unsigned char **audio, size_t *bytes);
+
+	/** \brief Seek to a specific position
+	 *
+	 *  \param decoder  The decoder
+	 *  \param secs     The position (in seconds) to seek to
+	 *  \return         `true` on success, `false` otherwise
+	 */
+	bool decoder_seek(struct decoder *decoder, unsigned int secs);
+
+	/** \brief Returns the current position of the decoder
+	 *
+	 *  \param decoder  The decoder
+	 *  \return         The position in seconds
+	 */
+	unsigned int decoder_position(struct decoder *decoder);
+
+	/** \brief Close the decoder and release all associated resources (except the download_state)
+	 *
+	 *  \param decoder  The decoder to close (may be `NULL`)
+	 */
+	void decoder_close(struct decoder *decoder);
+#endif /* _DECODER_H */
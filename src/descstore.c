@@ -0,0 +1,533 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file descstore.c
+ *  \brief Implementation of the store of descriptions
+ *
+ *  The store consists of two files: the descriptions, one after another (without terminating null bytes), and the
+ *  index, an array of struct descstore_record. Both are only appended to: descriptions are buffered and written
+ *  via the I/O engine once DESCSTORE_BUFFER_SIZE bytes are pending. The records of the descriptions are written
+ *  once the descriptions are written and synced: a record found on startup never refers to a description not
+ *  written. Descriptions not written yet are read from memory, all others via pread(). The index is held by an
+ *  open-addressing hash table (linear probing) keyed on the track_id.
+ */
+
+#include "_hard_config.h"
+#include "descstore.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <fcntl.h>                      // for open, O_RDWR, etc
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <stdint.h>                     // for uint32_t, uint64_t
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for memcpy, strlen, strerror
+#include <sys/mman.h>                   // for mmap, munmap
+#include <sys/stat.h>                   // for fstat
+#include <unistd.h>                     // for close, dup, pread, etc
+//\endcond
+
+#include "aio.h"                        // for aio_write_file
+#include "helper.h"                     // for lmalloc, lcalloc, smprintf
+#include "log.h"                        // for _log, _err
+
+/** \brief The number of bytes of descriptions buffered before writing them */
+#define DESCSTORE_BUFFER_SIZE ( 256 * 1024 )
+
+/** \brief The minimum number of slots of the hash table */
+#define DESCSTORE_MIN_CAPACITY 1024
+
+/** \brief An entry of the index, stored as is within the index file */
+struct descstore_record {
+	int32_t  track_id; ///< The track_id, 0 marks an empty slot of the hash table
+	uint32_t size;     ///< The number of bytes of the description
+	uint64_t offset;   ///< The offset of the description within the file of descriptions
+};
+
+/** \brief Descriptions submitted to be written, along with the records to be written afterwards
+ *
+ *  A batch is linked into `inflight` until its descriptions are written, reads of these are served from `data`.
+ *  If writing fails, the batch is kept (without its records) until the store is finalized.
+ */
+struct descstore_batch {
+	struct descstore_batch *next;
+	int    data_fd;         ///< The file of descriptions (not owned), synced before writing the records
+	off_t  data_offset;
+	char  *data;
+	size_t data_size;
+	int    records_fd;      ///< The index (owned, closed once the records are written)
+	off_t  records_offset;
+	char  *records;
+	size_t records_size;
+};
+
+/** \brief Data to be appended to one of the files */
+struct descstore_buffer {
+	int    fd;
+	off_t  offset;     ///< The offset to write `data` to, the size of the file once written
+	char  *data;
+	size_t used;
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* writes may complete synchronously (see aio.h), therefore `pending` is guarded by a mutex of its own */
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pending_cond  = PTHREAD_COND_INITIALIZER;
+static size_t pending = 0; ///< The number of writes submitted, but not completed yet
+static struct descstore_batch *inflight = NULL; ///< The batches whose descriptions are not written (see `pending_mutex`)
+
+static bool initialized = false;
+
+static struct descstore_buffer data_buffer    = { .fd = -1 };
+static struct descstore_buffer records_buffer = { .fd = -1 };
+
+static struct descstore_record *slots = NULL;
+static size_t capacity = 0;  ///< The number of slots (a power of two, at least twice the number of descriptions)
+
+static struct descstore_stats stats = { .descriptions = 0 };
+
+static void descstore_finalize(void);
+
+/** \brief Find the slot holding `track_id` or the empty slot it belongs to (requires `mutex`) */
+static struct descstore_record* descstore_find(struct descstore_record *table, size_t table_capacity, int32_t track_id) {
+	uint32_t key = (uint32_t) track_id;
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+
+	size_t slot = key & (table_capacity - 1);
+	while(table[slot].track_id && track_id != table[slot].track_id) {
+		slot = (slot + 1) & (table_capacity - 1);
+	}
+	return &table[slot];
+}
+
+/** \brief Double the capacity of the hash table, allocating it initially (requires `mutex`)
+ *
+ *  \return `true` on success, `false` otherwise (the table is left unmodified)
+ */
+static bool descstore_grow(void) {
+	const size_t new_capacity = capacity ? 2 * capacity : DESCSTORE_MIN_CAPACITY;
+	struct descstore_record *new_slots = lcalloc(new_capacity, sizeof(struct descstore_record));
+	if(!new_slots) {
+		return false;
+	}
+
+	for(size_t i = 0; i < capacity; i++) {
+		if(slots[i].track_id) {
+			*descstore_find(new_slots, new_capacity, slots[i].track_id) = slots[i];
+		}
+	}
+
+	free(slots);
+	slots    = new_slots;
+	capacity = new_capacity;
+	return true;
+}
+
+/** \brief Add a record to the hash table (requires `mutex`)
+ *
+ *  \return `true` on success, `false` if the table cannot grow or holds `track_id` already
+ */
+static bool descstore_insert(const struct descstore_record *record) {
+	if(2 * (stats.descriptions + 1) > capacity && !descstore_grow()) {
+		return false;
+	}
+
+	struct descstore_record *slot = descstore_find(slots, capacity, record->track_id);
+	if(slot->track_id) {
+		return false;
+	}
+
+	*slot = *record;
+	stats.descriptions++;
+	stats.bytes += record->size;
+	return true;
+}
+
+/** \brief Called once a buffer is written: free it and wake up anyone waiting (see descstore_wait()) */
+static void descstore_write_done(void *ctx, bool success) {
+	if(!success) {
+		_err("failed to write to the store of descriptions");
+	}
+	free(ctx);
+
+	pthread_mutex_lock(&pending_mutex);
+	if(!--pending) {
+		pthread_cond_broadcast(&pending_cond);
+	}
+	pthread_mutex_unlock(&pending_mutex);
+}
+
+/** \brief Wait for all writes submitted to complete */
+static void descstore_wait(void) {
+	pthread_mutex_lock(&pending_mutex);
+	while(pending) {
+		pthread_cond_wait(&pending_cond, &pending_mutex);
+	}
+	pthread_mutex_unlock(&pending_mutex);
+}
+
+/** \brief Called once the descriptions of a batch are written: sync them and write the records */
+static void descstore_data_done(void *ctx, bool success) {
+	struct descstore_batch *batch = ctx;
+
+	// once written, the descriptions are read from the file
+	if(success) {
+		pthread_mutex_lock(&pending_mutex);
+		struct descstore_batch **link = &inflight;
+		while(batch != *link) {
+			link = &(*link)->next;
+		}
+		*link = batch->next;
+		pthread_mutex_unlock(&pending_mutex);
+
+		free(batch->data);
+		batch->data = NULL;
+		if(fdatasync(batch->data_fd)) {
+			_err("fdatasync: %s", strerror(errno));
+			success = false;
+		}
+	}
+
+	// without the descriptions, the records are dropped: the descriptions are lost on restarting SCTC
+	if(!success || !aio_write_file(batch->records_fd, batch->records_offset, batch->records, batch->records_size, descstore_write_done, batch->records)) {
+		if(success) {
+			_err("failed to submit %zu bytes to be written to the store of descriptions", batch->records_size);
+		} else {
+			close(batch->records_fd);
+		}
+		descstore_write_done(batch->records, false);
+	}
+
+	if(!batch->data) {
+		free(batch);
+	}
+}
+
+/** \brief Submit all data buffered, the records being written once the descriptions are (requires `mutex`) */
+static void descstore_flush(void) {
+	if(!records_buffer.used) {
+		return;
+	}
+
+	// the I/O engine closes the files once written
+	struct descstore_batch *batch = lmalloc(sizeof(struct descstore_batch));
+	int data_fd    = dup(data_buffer.fd);
+	int records_fd = dup(records_buffer.fd);
+	if(!batch || 0 > data_fd || 0 > records_fd) {
+		_err("failed to submit %zu bytes to be written to the store of descriptions", data_buffer.used);
+		free(batch);
+		if(0 <= data_fd) {
+			close(data_fd);
+		}
+		if(0 <= records_fd) {
+			close(records_fd);
+		}
+		return;
+	}
+
+	*batch = (struct descstore_batch) {
+		.next           = NULL,
+		.data_fd        = data_buffer.fd,
+		.data_offset    = data_buffer.offset,
+		.data           = data_buffer.data,
+		.data_size      = data_buffer.used,
+		.records_fd     = records_fd,
+		.records_offset = records_buffer.offset,
+		.records        = records_buffer.data,
+		.records_size   = records_buffer.used
+	};
+
+	pthread_mutex_lock(&pending_mutex);
+	pending++;
+	batch->next = inflight;
+	inflight    = batch;
+	pthread_mutex_unlock(&pending_mutex);
+
+	// the batch is handled by descstore_data_done() (even if submitting fails)
+	data_buffer.offset    += (off_t) data_buffer.used;
+	data_buffer.data       = NULL;
+	data_buffer.used       = 0;
+	records_buffer.offset += (off_t) records_buffer.used;
+	records_buffer.data    = NULL;
+	records_buffer.used    = 0;
+
+	if(!aio_write_file(data_fd, batch->data_offset, batch->data, batch->data_size, descstore_data_done, batch)) {
+		_err("failed to submit %zu bytes to be written to the store of descriptions", batch->data_size);
+		descstore_data_done(batch, false);
+	}
+}
+
+/** \brief Append to a buffer (requires `mutex`)
+ *
+ *  \return `true` on success, `false` in case of a failing malloc (the buffer is left unmodified)
+ */
+static bool descstore_append(struct descstore_buffer *buffer, const void *src, size_t size) {
+	if(!buffer->data) {
+		buffer->data = lmalloc(DESCSTORE_BUFFER_SIZE > size ? DESCSTORE_BUFFER_SIZE : size);
+		if(!buffer->data) {
+			return false;
+		}
+	} else if(buffer->used + size > DESCSTORE_BUFFER_SIZE) {
+		char *grown = lrealloc(buffer->data, buffer->used + size);
+		if(!grown) {
+			return false;
+		}
+		buffer->data = grown;
+	}
+
+	memcpy(&buffer->data[buffer->used], src, size);
+	buffer->used += size;
+	return true;
+}
+
+/** \brief Open one of the files of the store, creating it if required
+ *
+ *  \return The file descriptor, `-1` on failure
+ */
+static int descstore_open(const char *folder, const char *name, struct stat *st) {
+	char *path = smprintf("%s/%s", folder, name);
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	if(0 > fd) {
+		_err("failed to open `%s`: %s", path, strerror(errno));
+	} else if(fstat(fd, st)) {
+		_err("fstat: %s", strerror(errno));
+		close(fd);
+		fd = -1;
+	}
+	free(path);
+	return fd;
+}
+
+bool descstore_init(const char *folder) {
+	struct stat data_st, index_st;
+	data_buffer.fd    = descstore_open(folder, CACHE_DESCRIPTION_DATA,  &data_st);
+	records_buffer.fd = descstore_open(folder, CACHE_DESCRIPTION_INDEX, &index_st);
+	if(0 > data_buffer.fd || 0 > records_buffer.fd || !descstore_grow()) {
+		descstore_finalize();
+		return false;
+	}
+
+	// a record written only partially (p.x. SCTC being killed) is overwritten by the next one
+	const size_t record_count = (size_t) index_st.st_size / sizeof(struct descstore_record);
+	data_buffer.offset    = data_st.st_size;
+	records_buffer.offset = (off_t) (record_count * sizeof(struct descstore_record));
+
+	if(record_count) {
+		const size_t size = (size_t) records_buffer.offset;
+		struct descstore_record *records = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, records_buffer.fd, 0);
+		if(MAP_FAILED == records) {
+			_err("mmap: %s", strerror(errno));
+			descstore_finalize();
+			return false;
+		}
+
+		// the records are ordered by offset: once a description is not written completely, neither are the following
+		size_t valid = 0;
+		while(valid < record_count && records[valid].offset + records[valid].size <= (uint64_t) data_buffer.offset) {
+			if(records[valid].track_id) {
+				descstore_insert(&records[valid]);
+			}
+			valid++;
+		}
+		munmap(records, size);
+
+		// drop the records, as their offsets are reused by the next descriptions
+		if(valid < record_count) {
+			_log("dropping %zu records of descriptions not written completely", record_count - valid);
+			records_buffer.offset = (off_t) (valid * sizeof(struct descstore_record));
+			if(ftruncate(records_buffer.fd, records_buffer.offset)) {
+				_err("ftruncate: %s", strerror(errno));
+			}
+		}
+	}
+
+	if(atexit(descstore_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	_log("store of descriptions: %zu descriptions (%zukB)", stats.descriptions, stats.bytes / 1024);
+	initialized = true;
+	return true;
+}
+
+bool descstore_put(int track_id, const char *description) {
+	if(!track_id || !description) {
+		return false;
+	}
+
+	const size_t size = strlen(description);
+	if(size > UINT32_MAX) {
+		return false;
+	}
+
+	pthread_mutex_lock(&mutex);
+	bool success = initialized;
+	if(success && !descstore_find(slots, capacity, track_id)->track_id) {
+		const struct descstore_record record = {
+			.track_id = track_id,
+			.size     = (uint32_t) size,
+			.offset   = (uint64_t) data_buffer.offset + data_buffer.used
+		};
+
+		// roll back the buffers if any step fails, nothing is written partially
+		const size_t data_used    = data_buffer.used;
+		const size_t records_used = records_buffer.used;
+		success = descstore_append(&data_buffer, description, size)
+		       && descstore_append(&records_buffer, &record, sizeof(record))
+		       && descstore_insert(&record);
+		if(!success) {
+			data_buffer.used    = data_used;
+			records_buffer.used = records_used;
+		}
+
+		if(data_buffer.used >= DESCSTORE_BUFFER_SIZE) {
+			descstore_flush();
+		}
+	}
+	// a description stored previously is kept (the description of a track does not change that often)
+	pthread_mutex_unlock(&mutex);
+
+	return success;
+}
+
+const char* descstore_read(struct track *track, char **buffer, size_t *size) {
+	if(track->description) {
+		return track->description;
+	}
+
+	pthread_mutex_lock(&mutex);
+	if(!initialized || !track->track_id) {
+		pthread_mutex_unlock(&mutex);
+		return NULL;
+	}
+
+	const struct descstore_record record = *descstore_find(slots, capacity, track->track_id);
+	if(!record.track_id) {
+		pthread_mutex_unlock(&mutex);
+		return NULL;
+	}
+
+	stats.reads++;
+
+	if(record.size + 1 > *size) {
+		char *grown = lrealloc(*buffer, record.size + 1);
+		if(!grown) {
+			pthread_mutex_unlock(&mutex);
+			return NULL;
+		}
+		*buffer = grown;
+		*size   = record.size + 1;
+	}
+	char *description = *buffer;
+	description[record.size] = '\0';
+
+	// the description may still be buffered or being written
+	if(!record.size) {
+		pthread_mutex_unlock(&mutex);
+		return description;
+	}
+
+	if((off_t) record.offset >= data_buffer.offset) {
+		memcpy(description, &data_buffer.data[(off_t) record.offset - data_buffer.offset], record.size);
+		pthread_mutex_unlock(&mutex);
+		return description;
+	}
+
+	pthread_mutex_lock(&pending_mutex);
+	for(struct descstore_batch *batch = inflight; batch; batch = batch->next) {
+		if((off_t) record.offset >= batch->data_offset && (off_t) record.offset < batch->data_offset + (off_t) batch->data_size) {
+			memcpy(description, &batch->data[(off_t) record.offset - batch->data_offset], record.size);
+			pthread_mutex_unlock(&pending_mutex);
+			pthread_mutex_unlock(&mutex);
+			return description;
+		}
+	}
+	pthread_mutex_unlock(&pending_mutex);
+	pthread_mutex_unlock(&mutex);
+
+	size_t done = 0;
+	while(done < record.size) {
+		const ssize_t ret = pread(data_buffer.fd, &description[done], record.size - done, (off_t) (record.offset + done));
+		if(0 >= ret) {
+			if(0 > ret && EINTR == errno) {
+				continue;
+			}
+			_err("failed to read description of track %d: %s", track->track_id, ret ? strerror(errno) : "unexpected end of file");
+			return NULL;
+		}
+		done += (size_t) ret;
+	}
+
+	return description;
+}
+
+char* descstore_get(struct track *track) {
+	char  *buffer = NULL;
+	size_t size   = 0;
+
+	const char *description = descstore_read(track, &buffer, &size);
+	if(description != buffer) {
+		free(buffer);
+		return description ? lstrdup(description) : NULL;
+	}
+	return buffer;
+}
+
+void descstore_get_stats(struct descstore_stats *out) {
+	pthread_mutex_lock(&mutex);
+	*out = stats;
+	pthread_mutex_unlock(&mutex);
+}
+
+/** \brief Write any data buffered, wait for all writes and close the files */
+static void descstore_finalize(void) {
+	pthread_mutex_lock(&mutex);
+	if(initialized) {
+		descstore_flush();
+		descstore_wait();
+		_log("store of descriptions: %zu descriptions (%zukB), %zu read", stats.descriptions, stats.bytes / 1024, stats.reads);
+	}
+	initialized = false;
+
+	if(0 <= data_buffer.fd) {
+		close(data_buffer.fd);
+	}
+	if(0 <= records_buffer.fd) {
+		close(records_buffer.fd);
+	}
+	free(data_buffer.data);
+	free(records_buffer.data);
+	data_buffer    = (struct descstore_buffer) { .fd = -1 };
+	records_buffer = (struct descstore_buffer) { .fd = -1 };
+
+	// batches failed to be written
+	while(inflight) {
+		struct descstore_batch *next = inflight->next;
+		free(inflight->data);
+		free(inflight);
+		inflight = next;
+	}
+
+	free(slots);
+	slots    = NULL;
+	capacity = 0;
+	pthread_mutex_unlock(&mutex);
+}
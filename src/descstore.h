@@ -0,0 +1,88 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file descstore.h
+ *  \brief On-disk store of the descriptions of tracks
+ *
+ *  Descriptions may take several kB per track, but are only shown on request (see cmd_pl_details()). Instead of
+ *  keeping them in memory (and within each cached list), they are appended to a file, keyed on the track_id.
+ *  Only the index (the offset and size of each description) is kept in memory; a description is read from the
+ *  file when requested.
+ */
+
+#ifndef _DESCSTORE_H
+	#define _DESCSTORE_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+	#include "track.h"                      // for track
+
+	struct descstore_stats {
+		size_t descriptions; ///< The number of descriptions stored
+		size_t bytes;        ///< The number of bytes occupied by the descriptions
+		size_t reads;        ///< The number of descriptions read from the store
+	};
+
+	/** \brief Open (or create) the store within a folder and read its index
+	 *
+	 *  \param folder  The folder holding the store (see CACHE_DESCRIPTION_DATA and CACHE_DESCRIPTION_INDEX)
+	 *  \return        `true` on success, `false` otherwise (descriptions are not stored, but kept in memory)
+	 */
+	bool descstore_init(const char *folder) ATTR(nonnull);
+
+	/** \brief Store the description of a track
+	 *
+	 *  The description is written asynchronously (see aio.h). If a description is stored for `track_id` already, the
+	 *  one stored is kept.
+	 *
+	 *  \param track_id     The track_id of the track, 0 (an unknown track_id) is not stored
+	 *  \param description  The description, `NULL` is not stored
+	 *  \return             `true` if the description is stored, `false` if it needs to be kept in memory
+	 */
+	bool descstore_put(int track_id, const char *description);
+
+	/** \brief Get the description of a track, either the one kept in memory or the one stored
+	 *
+	 *  \param track  The track
+	 *  \return       A copy of the description (pass to free() once no longer required), `NULL` if there is none
+	 */
+	char* descstore_get(struct track *track) ATTR(nonnull);
+
+	/** \brief Get the description of a track without allocating a copy per call
+	 *
+	 *  Intended for reading many descriptions, p.x. on indexing a list: the buffer is reused (and grown if required)
+	 *  across calls.
+	 *
+	 *  \param track   The track
+	 *  \param buffer  The buffer to read the description into, `NULL` initially (pass to free() once done)
+	 *  \param size    The size of `*buffer`, 0 initially
+	 *  \return        The description of the track (either `track->description` or `*buffer`, valid until the next
+	 *                 call), `NULL` if there is none
+	 */
+	const char* descstore_read(struct track *track, char **buffer, size_t *size) ATTR(nonnull);
+
+	/** \brief Get the statistics of the store
+	 *
+	 *  \param stats  The struct to write the statistics to
+	 */
+	void descstore_get_stats(struct descstore_stats *stats) ATTR(nonnull);
+#endif /* _DESCSTORE_H */
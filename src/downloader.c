@@ -140,26 +140,38 @@ static void* _download_thread(void *unused UNUSED) {
 				size_t request_size = remaining > CHUNK_SIZE ? CHUNK_SIZE : remaining;
 				if(my->target_file) {
 					int ret = nwc->recv(nwc, buffer, request_size);
-					if(ret > 0) {
-						remaining -= (unsigned int) ret;
-						fwrite(buffer, 1, request_size, fh);
-						__sync_add_and_fetch(&my->state->bytes_recvd, ret);
+					if(ret <= 0) {
+						break;
 					}
+					if((size_t) ret != fwrite(buffer, 1, (size_t) ret, fh)) {
+						_err("fwrite: %s", strerror(errno));
+						break;
+					}
+					remaining -= (unsigned int) ret;
+					__sync_add_and_fetch(&my->state->bytes_recvd, ret);
 				} else {
+					// the connection is closed (or failed) once nothing is received
 					int ret = nwc->recv(nwc, &((char*)my->buffer)[my->state->bytes_recvd], request_size);
-					if(ret > 0) {
-						remaining -= (unsigned int) ret;
+					if(ret <= 0) {
+						break;
+					}
+					remaining -= (unsigned int) ret;
 
-						pthread_mutex_lock(&my->state->io_mutex);
-						my->state->bytes_recvd += (unsigned int) ret;
-						pthread_cond_signal(&my->state->io_cond);
-						pthread_mutex_unlock(&my->state->io_mutex);
+					pthread_mutex_lock(&my->state->io_mutex);
+					my->state->bytes_recvd += (unsigned int) ret;
+					pthread_cond_signal(&my->state->io_cond);
+					pthread_mutex_unlock(&my->state->io_mutex);
 
-						if(my->callback) my->callback(my->state);
-					}
+					if(my->callback) my->callback(my->state);
 				}
 			}
 
+			if(remaining && !terminate) {
+				_err("download of `%s` failed after %zu/%zu bytes", my->state->track->name, resp->content_length - remaining, resp->content_length);
+				my->state->failed = true;
+				if(!my->target_file && my->callback) my->callback(my->state);
+			}
+
 			nwc->disconnect(nwc);
 			http_response_destroy(resp);
 
@@ -24,6 +24,8 @@
 	//\endcond
 	#include "track.h"
 
+	struct cache_writer;
+
 	struct download_state {
 		struct track *track;      ///< Pointer to the track whose data is being downloaded
 		char  *buffer;            ///< The buffer containing the actual data
@@ -31,6 +33,11 @@
 		size_t bytes_total;       ///< The total number of Bytes (total size, as announced by server)
 		pthread_mutex_t io_mutex; ///< The mutex to lock on in case of `buffer-underruns`
 		pthread_cond_t  io_cond;  ///< The corresponding condition
+
+		bool failed;              ///< `true` if the connection ended before receiving `bytes_total` Bytes (the callback is called once more)
+
+		struct cache_writer *cache_writer; ///< The writer storing the data to the cache while downloading (if any)
+		bool cache_writer_opened;          ///< `true` if opening `cache_writer` was attempted already
 	};
 
 	/** \brief Initialize the downloader
@@ -28,16 +28,18 @@
 #include <polarssl/sha512.h>            // for sha512
 #include <stdarg.h>                     // for va_end, va_list, va_start
 #include <stdbool.h>                    // for true, false, bool
+#include <stdint.h>                     // for intptr_t
 #include <stdio.h>                      // for snprintf, sscanf, vsnprintf, etc
 #include <stdlib.h>                     // for exit, EXIT_FAILURE, calloc, etc
 #include <string.h>                     // for strerror, strlen, strdup, etc
-#include <sys/mman.h>                   // for mmap, munmap, MAP_FAILED, etc
+#include <sys/mman.h>                   // for mmap, madvise, munmap, MAP_FAILED, etc
 #include <sys/stat.h>                   // for stat, fstat
 #include <unistd.h>                     // for close, execlp, fork, dup2, etc
 #include <regex.h>
 //\endcond
 
-#include "log.h"                        // for __log, _err, _log
+#include "aio.h"                        // for aio_file_readahead
+#include "log.h"                        // for log_write, _err, _log
 #include "tui.h"                        // for F_RESET, F_UNDERLINE
 
 char* smprintf(char *fmt, ...) {
@@ -143,7 +145,7 @@ void* _lmalloc(char *srcfile, int srcline, const char *srcfunc, size_t size) {
 	void *ptr = malloc(size);
 	ONLY_DEBUG( __sync_fetch_and_add(&_lmalloc_count, 1); )
 	if(!ptr) {
-		__log(srcfile, srcline, srcfunc, true, "malloc(%zu) failed: %s", size, strerror(errno));
+		log_write(srcfile, srcline, srcfunc, true, "malloc(%zu) failed: %s", size, strerror(errno));
 	}
 
 	return ptr;
@@ -153,7 +155,7 @@ void* _lcalloc(char *srcfile, int srcline, const char *srcfunc, size_t nmemb, si
 	void *ptr = calloc(nmemb, size);
 	ONLY_DEBUG( __sync_fetch_and_add(&_lcalloc_count, 1); )
 	if(!ptr) {
-		__log(srcfile, srcline, srcfunc, true, "calloc(%zu, %zu) failed: %s", nmemb, size, strerror(errno));
+		log_write(srcfile, srcline, srcfunc, true, "calloc(%zu, %zu) failed: %s", nmemb, size, strerror(errno));
 	}
 
 	return ptr;
@@ -163,7 +165,7 @@ void* _lrealloc(char *srcfile, int srcline, const char *srcfunc, void *ptr, size
 	void *new_ptr = realloc(ptr, size);
 	ONLY_DEBUG( __sync_fetch_and_add(&_lrealloc_count, 1); )
 	if(!new_ptr) {
-		__log(srcfile, srcline, srcfunc, true, "realloc(%p, %zu) failed: %s", ptr, size, strerror(errno));
+		log_write(srcfile, srcline, srcfunc, true, "realloc(%p, %zu) failed: %s", ptr, size, strerror(errno));
 	}
 
 	return new_ptr;
@@ -173,7 +175,7 @@ char *_lstrdup(char *srcfile, int srcline, const char *srcfunc, const char *s) {
 	void *d = strdup(s);
 	ONLY_DEBUG( __sync_fetch_and_add(&_lstrdup_count, 1); )
 	if(!d) {
-		__log(srcfile, srcline, srcfunc, true, "strdup(\"%s\") failed: %s", s, strerror(errno));
+		log_write(srcfile, srcline, srcfunc, true, "strdup(\"%s\") failed: %s", s, strerror(errno));
 	}
 
 	return d;
@@ -183,6 +185,13 @@ char *_lstrdup(char *srcfile, int srcline, const char *srcfunc, const char *s) {
 void dump_alloc_counter(void) {
 	_log("#{m,c,re}alloc/strdup: %u %u %u %u", _lmalloc_count, _lcalloc_count, _lrealloc_count, _lstrdup_count);
 }
+
+void get_alloc_counter(struct alloc_counter *counter) {
+	counter->mallocs  = __sync_fetch_and_add(&_lmalloc_count,  0);
+	counter->callocs  = __sync_fetch_and_add(&_lcalloc_count,  0);
+	counter->reallocs = __sync_fetch_and_add(&_lrealloc_count, 0);
+	counter->strdups  = __sync_fetch_and_add(&_lstrdup_count,  0);
+}
 #endif
 
 unsigned int parse_time_to_sec(char *str) {
@@ -231,7 +240,7 @@ int lregcomp(regex_t *preg, const char *regex, int cflags) {
 	return err;
 }
 
-struct mmapped_file file_read_contents(char *path) {
+struct mmapped_file file_read_contents(char *path, enum file_access access) {
 	struct mmapped_file file = { .data = NULL, .size = 0 };
 
 	int fd = open(path, O_NOFOLLOW);
@@ -244,11 +253,22 @@ struct mmapped_file file_read_contents(char *path) {
 	if(!fstat(fd, &fdstat)) {
 		if(fdstat.st_size >= 0) {
 			size_t fsize = (size_t) fdstat.st_size;
-			file.data = mmap(NULL, fsize, PROT_READ, MAP_SHARED, fd, 0);
-			if(MAP_FAILED != file.data) {
+			const int flags = MAP_SHARED | (file_access_populate == access ? MAP_POPULATE : 0);
+
+			void *data = mmap(NULL, fsize, PROT_READ, flags, fd, 0);
+			if(MAP_FAILED != data) {
+				file.data = data;
 				file.size = fsize;
+
+				if(file_access_sequential == access) {
+					// double the kernel's read-ahead window and read the first few MB in the background,
+					// instead of faulting page by page on a cold page cache
+					if(madvise(data, fsize, MADV_SEQUENTIAL)) {
+						_err("madvise: %s", strerror(errno));
+					}
+					aio_file_readahead(fd, 0, fsize < FILE_READAHEAD_SIZE ? fsize : FILE_READAHEAD_SIZE);
+				}
 			} else {
-				file.data = NULL;
 				_err("mmap: %s", strerror(errno));
 			}
 		} else {
@@ -262,6 +282,21 @@ struct mmapped_file file_read_contents(char *path) {
 	return file;
 }
 
+void file_advise_willneed(struct mmapped_file file, size_t offset, size_t size) {
+	if(!file.data || offset >= file.size) {
+		return;
+	}
+
+	// madvise requires the address to be aligned to a page
+	const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	const size_t start     = offset - offset % page_size;
+	const size_t end       = (file.size - offset < size) ? file.size : offset + size;
+
+	if(madvise((char*) (intptr_t) file.data + start, end - start, MADV_WILLNEED)) {
+		_err("madvise: %s", strerror(errno));
+	}
+}
+
 size_t add_delta_within_limits(size_t base, int delta, size_t upper_limit) {
 	if(delta < 0) {
 		unsigned int udelta = (unsigned int) -delta;
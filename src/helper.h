@@ -200,14 +200,47 @@
 	 */
 	char *_lstrdup(char *srcfile, int srcline, const char *srcfunc, const char *s) ATTR(nonnull, warn_unused_result);
 
+	/** \brief The number of calls to lmalloc(), lcalloc(), lrealloc() and lstrdup() (only counted if built without `NDEBUG`) */
+	struct alloc_counter {
+		unsigned int mallocs;
+		unsigned int callocs;
+		unsigned int reallocs;
+		unsigned int strdups;
+	};
+
 	ONLY_DEBUG( void dump_alloc_counter(void); )
+	ONLY_DEBUG( void get_alloc_counter(struct alloc_counter *counter); )
 
 	struct mmapped_file {
 		const void *data;
 		size_t      size;
 	};
 
-	struct mmapped_file file_read_contents(char *file);
+	/** \brief The way a file is accessed, used to advise the kernel when mapping it */
+	enum file_access {
+		file_access_default,    ///< No particular order, no advice
+		file_access_sequential, ///< Read once from start to end (playback, analysis): read ahead aggressively, starting right away
+		file_access_populate    ///< Read as a whole right away (small files, such as lists): map all pages at once
+	};
+
+	/** \brief Map a whole file (read-only)
+	 *
+	 *  \param file    The path of the file
+	 *  \param access  The way the data is accessed
+	 *  \return        The mapping, `data` is `NULL` in case of failure
+	 */
+	struct mmapped_file file_read_contents(char *file, enum file_access access);
+
+	/** \brief Advise the kernel a range of a mapped file is read soon, for instance right after seeking
+	 *
+	 *  The pages are read in the background, starting at the page containing `offset`.
+	 *
+	 *  \param file    The mapping, as returned by file_read_contents()
+	 *  \param offset  The offset (within the file) the range starts at
+	 *  \param size    The size of the range, limited to the end of the file
+	 */
+	void file_advise_willneed(struct mmapped_file file, size_t offset, size_t size);
+
 	void file_release_contents(struct mmapped_file file);
 
 	int lregcomp(regex_t *preg, const char *regex, int cflags);
@@ -0,0 +1,605 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file hls.c
+ *  \brief Implementation of HTTP Live Streaming (HLS)
+ *
+ *  Each stream runs HLS_WORKERS threads, fetching the segments within the prefetch window (the segment
+ *  currently read and the following HLS_PREFETCH - 1 segments). The connections are kept alive and
+ *  reused for the next segment on the same host.
+ */
+
+#include "_hard_config.h"
+#include "hls.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_create, pthread_mutex_lock, etc
+#include <stdint.h>                     // for SIZE_MAX
+#include <stdlib.h>                     // for free, strtod
+#include <string.h>                     // for strlen, strncmp, strchr, etc
+//\endcond
+
+#include "helper.h"                     // for lmalloc, lcalloc, lstrdup, streq
+#include "http.h"                       // for http_request_get_only_header, etc
+#include "log.h"                        // for _log, _err
+#include "network/network.h"            // for network_conn
+#include "url.h"                        // for url_parse_string, url_connect, etc
+
+/** \brief The number of threads fetching segments (per stream) */
+#define HLS_WORKERS 4
+
+/** \brief The number of segments fetched ahead, including the segment currently read */
+#define HLS_PREFETCH 4
+
+/** \brief The number of idle connections kept for reuse (per stream) */
+#define HLS_POOL_SIZE (HLS_WORKERS + 1)
+
+/** \brief The number of attempts to fetch a single segment */
+#define HLS_ATTEMPTS 3
+
+/** \brief The maximum size of a playlist or a segment */
+#define HLS_MAX_SIZE ( 64 * 1024 * 1024 )
+
+enum segment_status {
+	seg_empty,   ///< not (or no longer) downloaded
+	seg_loading, ///< currently downloaded by a worker
+	seg_done,    ///< downloaded, data is valid
+	seg_failed   ///< downloading failed (HLS_ATTEMPTS times)
+};
+
+struct segment_data {
+	enum segment_status status;
+	bool   discard; ///< `true` if the segment left the prefetch window while loading: dropped once downloaded
+	char  *data;
+	size_t size;
+};
+
+/** \brief An idle connection, kept for reuse */
+struct hls_connection {
+	char *scheme;
+	char *host;
+	int   port;
+	struct network_conn *nwc; ///< the connection, `NULL` if this slot is unused
+};
+
+struct hls_stream {
+	struct hls_playlist *playlist;
+	struct segment_data *segments;    ///< the data of each segment of the playlist
+
+	pthread_mutex_t mutex;            ///< protects everything below
+	pthread_cond_t  cond;             ///< signalled on any change of a segment's status, the read position or `terminate`
+	size_t          read_segment;     ///< the segment currently read
+	size_t          read_offset;      ///< the offset within `read_segment`
+	bool            terminate;        ///< `true` if the stream is closed (or interrupted)
+
+	pthread_t workers[HLS_WORKERS];
+	bool      worker_valid[HLS_WORKERS];
+
+	pthread_mutex_t       pool_mutex;
+	struct hls_connection pool[HLS_POOL_SIZE];
+};
+
+/*************
+* PLAYLISTS *
+*************/
+
+/** \brief Resolve a (possibly relative) URL found within a playlist
+ *
+ *  \param base  The URL of the playlist
+ *  \param ref   The URL found within the playlist (not NUL-terminated)
+ *  \param len   The length of `ref`
+ *  \return      The absolute URL (allocated via malloc), `NULL` if malloc failed
+ */
+static char* hls_resolve_url(const char *base, const char *ref, size_t len) {
+	// absolute URL: `scheme://...`
+	const char *colon = memchr(ref, ':', len);
+	if(colon && colon + 2 < ref + len && !strncmp(colon, "://", 3)) {
+		return strndup(ref, len);
+	}
+
+	// `/path`: relative to the host, `path`: relative to the directory of the playlist
+	const char *host   = strstr(base, "://");
+	size_t      prefix = strlen(base);
+	if('/' == ref[0]) {
+		const char *path = host ? strchr(host + 3, '/') : NULL;
+		prefix = path ? (size_t) (path - base) : prefix;
+	} else {
+		const char *query = strchr(base, '?');
+		const char *end   = query ? query : base + prefix;
+		while(end > base && '/' != end[-1]) end--;
+		prefix = end - base;
+	}
+
+	char *url = lmalloc(prefix + len + 1);
+	if(url) {
+		memcpy(url, base, prefix);
+		memcpy(&url[prefix], ref, len);
+		url[prefix + len] = '\0';
+	}
+	return url;
+}
+
+struct hls_playlist* hls_playlist_parse(const char *url, const char *data) {
+	if(strncmp("#EXTM3U", data, 7)) {
+		_err("not a m3u8 playlist");
+		return NULL;
+	}
+
+	struct hls_playlist *playlist = lcalloc(1, sizeof(struct hls_playlist));
+	if(!playlist) return NULL;
+
+	size_t capacity = 0;
+	double duration = 0;   // the duration announced by the last #EXTINF
+	bool   variant  = false;
+
+	const char *line = data;
+	while(*line) {
+		size_t len = strcspn(line, "\r\n");
+
+		if(!strncmp("#EXTINF:", line, 8)) {
+			duration = strtod(line + 8, NULL);
+		} else if(!strncmp("#EXT-X-STREAM-INF", line, 17)) {
+			variant = true;
+		} else if(len && '#' != line[0]) {
+			char *segment_url = hls_resolve_url(url, line, len);
+			if(!segment_url) {
+				hls_playlist_destroy(playlist);
+				return NULL;
+			}
+
+			if(variant) {
+				// master playlist: only the first variant is used
+				if(!playlist->variant) {
+					playlist->variant = segment_url;
+				} else {
+					free(segment_url);
+				}
+				variant = false;
+			} else {
+				if(playlist->count == capacity) {
+					capacity = capacity ? 2 * capacity : 64;
+					struct hls_segment *segments = lrealloc(playlist->segments, capacity * sizeof(struct hls_segment));
+					if(!segments) {
+						free(segment_url);
+						hls_playlist_destroy(playlist);
+						return NULL;
+					}
+					playlist->segments = segments;
+				}
+
+				struct hls_segment *segment = &playlist->segments[playlist->count++];
+				segment->url       = segment_url;
+				segment->duration  = duration;
+				segment->start     = playlist->duration;
+				playlist->duration += duration;
+
+				duration = 0;
+			}
+		}
+
+		line += len;
+		while('\r' == *line || '\n' == *line) line++;
+	}
+
+	return playlist;
+}
+
+size_t hls_playlist_segment_at(const struct hls_playlist *playlist, double secs) {
+	if(!playlist->count) return 0;
+
+	// binary search for the last segment starting at (or before) `secs`
+	size_t lo = 0;
+	size_t hi = playlist->count - 1;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo + 1) / 2;
+		if(playlist->segments[mid].start <= secs) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return lo;
+}
+
+void hls_playlist_destroy(struct hls_playlist *playlist) {
+	if(!playlist) return;
+
+	for(size_t i = 0; i < playlist->count; i++) {
+		free(playlist->segments[i].url);
+	}
+	free(playlist->segments);
+	free(playlist->variant);
+	free(playlist);
+}
+
+/*******************
+* CONNECTION POOL *
+*******************/
+
+/** \brief Get a connection to the host of `u`, reusing an idle connection if possible */
+static struct network_conn* hls_pool_acquire(struct hls_stream *stream, struct url *u) {
+	pthread_mutex_lock(&stream->pool_mutex);
+	for(size_t i = 0; i < HLS_POOL_SIZE; i++) {
+		struct hls_connection *conn = &stream->pool[i];
+		if(conn->nwc && conn->port == u->port && streq(conn->scheme, u->scheme) && streq(conn->host, u->host)) {
+			struct network_conn *nwc = conn->nwc;
+			conn->nwc = NULL;
+			free(conn->scheme);
+			free(conn->host);
+			pthread_mutex_unlock(&stream->pool_mutex);
+
+			return nwc;
+		}
+	}
+	pthread_mutex_unlock(&stream->pool_mutex);
+
+	return url_connect(u) ? u->nwc : NULL;
+}
+
+/** \brief Return a connection (still usable) to the pool, disconnects it if the pool is full */
+static void hls_pool_release(struct hls_stream *stream, struct url *u, struct network_conn *nwc) {
+	pthread_mutex_lock(&stream->pool_mutex);
+	for(size_t i = 0; i < HLS_POOL_SIZE; i++) {
+		struct hls_connection *conn = &stream->pool[i];
+		if(!conn->nwc) {
+			conn->scheme = lstrdup(u->scheme);
+			conn->host   = lstrdup(u->host);
+			if(conn->scheme && conn->host) {
+				conn->port = u->port;
+				conn->nwc  = nwc;
+				pthread_mutex_unlock(&stream->pool_mutex);
+				return;
+			}
+			free(conn->scheme);
+			free(conn->host);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&stream->pool_mutex);
+
+	nwc->disconnect(nwc);
+}
+
+static void hls_pool_clear(struct hls_stream *stream) {
+	for(size_t i = 0; i < HLS_POOL_SIZE; i++) {
+		struct hls_connection *conn = &stream->pool[i];
+		if(conn->nwc) {
+			conn->nwc->disconnect(conn->nwc);
+			conn->nwc = NULL;
+			free(conn->scheme);
+			free(conn->host);
+		}
+	}
+}
+
+/** \brief Fetch a whole resource (playlist or segment) using a pooled connection
+ *
+ *  The connection is kept alive (and returned to the pool) on success.
+ *
+ *  \param stream     The stream (providing the connection pool)
+ *  \param url        The URL to fetch
+ *  \param data       Set to the data received (allocated via malloc, NUL-terminated)
+ *  \param size       Set to the number of bytes received
+ *  \param redirects  The number of redirects allowed
+ *  \return           `true` on success, `false` otherwise
+ */
+static bool hls_fetch(struct hls_stream *stream, char *url, char **data, size_t *size, size_t redirects) {
+	struct url *u = url_parse_string(url);
+	if(!u) return false;
+
+	struct network_conn *nwc = hls_pool_acquire(stream, u);
+	if(!nwc) {
+		url_destroy(u);
+		return false;
+	}
+
+	bool success  = false;
+	char *location = NULL;
+	struct http_response *resp = http_request_get_only_header(nwc, u->request, u->host, NULL, 0);
+	if(resp && 200 == resp->http_status && resp->content_length <= HLS_MAX_SIZE) {
+		char *buffer = lmalloc(resp->content_length + 1);
+		if(buffer) {
+			size_t received = 0;
+			while(received < resp->content_length) {
+				int ret = nwc->recv(nwc, &buffer[received], resp->content_length - received);
+				if(ret <= 0) break;
+				received += ret;
+			}
+
+			if(received == resp->content_length) {
+				buffer[received] = '\0';
+				*data   = buffer;
+				*size   = received;
+				success = true;
+			} else {
+				_err("connection lost after %zu of %zu bytes of `%s`", received, resp->content_length, url);
+				free(buffer);
+			}
+		}
+	} else if(resp && 300 <= resp->http_status && resp->http_status < 400 && resp->location && redirects) {
+		location = lstrdup(resp->location);
+	} else if(resp) {
+		_err("server returned http status %i for `%s`", resp->http_status, url);
+	}
+	http_response_destroy(resp);
+
+	// the connection is in a defined state (ready for the next request) only after a complete response
+	if(success) {
+		hls_pool_release(stream, u, nwc);
+	} else {
+		nwc->disconnect(nwc);
+	}
+
+	url_destroy(u);
+
+	if(location) {
+		success = hls_fetch(stream, location, data, size, redirects - 1);
+		free(location);
+	}
+	return success;
+}
+
+/***********
+* STREAMS *
+***********/
+
+/** \brief Returns the index of the next segment to fetch, or `SIZE_MAX` if there is none (requires `stream->mutex`) */
+static size_t hls_next_segment(struct hls_stream *stream) {
+	const size_t end = stream->read_segment + HLS_PREFETCH < stream->playlist->count
+	                 ? stream->read_segment + HLS_PREFETCH
+	                 : stream->playlist->count;
+
+	for(size_t i = stream->read_segment; i < end; i++) {
+		if(seg_empty == stream->segments[i].status) {
+			return i;
+		}
+	}
+	return SIZE_MAX;
+}
+
+static void* _hls_worker(void *_stream) {
+	struct hls_stream *stream = _stream;
+
+	pthread_mutex_lock(&stream->mutex);
+	while(!stream->terminate) {
+		size_t index = hls_next_segment(stream);
+		if(SIZE_MAX == index) {
+			pthread_cond_wait(&stream->cond, &stream->mutex);
+			continue;
+		}
+
+		struct segment_data *segment = &stream->segments[index];
+		segment->status = seg_loading;
+		pthread_mutex_unlock(&stream->mutex);
+
+		char  *data = NULL;
+		size_t size = 0;
+		bool success = false;
+		for(unsigned int attempt = 0; attempt < HLS_ATTEMPTS && !success && !__atomic_load_n(&stream->terminate, __ATOMIC_RELAXED); attempt++) {
+			success = hls_fetch(stream, stream->playlist->segments[index].url, &data, &size, MAX_REDIRECT_STEPS);
+		}
+
+		pthread_mutex_lock(&stream->mutex);
+		if(segment->discard) {
+			free(data);
+			segment->discard = false;
+			segment->status  = seg_empty;
+		} else if(success) {
+			segment->data   = data;
+			segment->size   = size;
+			segment->status = seg_done;
+		} else {
+			_err("failed to fetch segment %zu", index);
+			segment->status = seg_failed;
+		}
+		pthread_cond_broadcast(&stream->cond);
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	return NULL;
+}
+
+/** \brief Retrieve and parse the playlist, following a master playlist to its first variant */
+static struct hls_playlist* hls_stream_get_playlist(struct hls_stream *stream, const char *url) {
+	char *url_copy = lstrdup(url);
+	if(!url_copy) return NULL;
+
+	struct hls_playlist *playlist = NULL;
+	for(unsigned int level = 0; level < 2 && url_copy; level++) {
+		char  *data;
+		size_t size;
+		if(!hls_fetch(stream, url_copy, &data, &size, MAX_REDIRECT_STEPS)) {
+			break;
+		}
+
+		playlist = hls_playlist_parse(url_copy, data);
+		free(data);
+		free(url_copy);
+		url_copy = NULL;
+
+		if(playlist && !playlist->count && playlist->variant) {
+			_log("master playlist, using variant `%s`", playlist->variant);
+			url_copy = playlist->variant;
+			playlist->variant = NULL;
+			hls_playlist_destroy(playlist);
+			playlist = NULL;
+		}
+	}
+	free(url_copy);
+
+	if(playlist && !playlist->count) {
+		_err("playlist does not contain any segments");
+		hls_playlist_destroy(playlist);
+		playlist = NULL;
+	}
+
+	return playlist;
+}
+
+struct hls_stream* hls_stream_open(const char *url) {
+	struct hls_stream *stream = lcalloc(1, sizeof(struct hls_stream));
+	if(!stream) return NULL;
+
+	pthread_mutex_init(&stream->mutex, NULL);
+	pthread_mutex_init(&stream->pool_mutex, NULL);
+	pthread_cond_init(&stream->cond, NULL);
+
+	stream->playlist = hls_stream_get_playlist(stream, url);
+	if(!stream->playlist) {
+		hls_stream_close(stream);
+		return NULL;
+	}
+
+	stream->segments = lcalloc(stream->playlist->count, sizeof(struct segment_data));
+	if(!stream->segments) {
+		hls_stream_close(stream);
+		return NULL;
+	}
+
+	_log("hls: %zu segments, %.1fs", stream->playlist->count, stream->playlist->duration);
+
+	size_t valid_worker_count = 0;
+	for(size_t i = 0; i < HLS_WORKERS; i++) {
+		int err = pthread_create(&stream->workers[i], NULL, _hls_worker, stream);
+		if(!err) {
+			stream->worker_valid[i] = true;
+			valid_worker_count++;
+		} else {
+			_err("pthread_create: %s", strerror(err));
+		}
+	}
+
+	if(!valid_worker_count) {
+		_err("failed to start any threads...");
+		hls_stream_close(stream);
+		return NULL;
+	}
+
+	return stream;
+}
+
+const struct hls_playlist* hls_stream_playlist(struct hls_stream *stream) {
+	return stream->playlist;
+}
+
+ssize_t hls_stream_read(struct hls_stream *stream, void *buffer, size_t count) {
+	ssize_t copied = 0;
+
+	pthread_mutex_lock(&stream->mutex);
+	while((size_t) copied < count && !stream->terminate && stream->read_segment < stream->playlist->count) {
+		struct segment_data *segment = &stream->segments[stream->read_segment];
+
+		if(seg_failed == segment->status) {
+			if(!copied) copied = -1;
+			break;
+		}
+
+		if(seg_done != segment->status) {
+			// deliver what we have, rather than waiting for the next segment
+			if(copied) break;
+
+			pthread_cond_wait(&stream->cond, &stream->mutex);
+			continue;
+		}
+
+		size_t bytes = segment->size - stream->read_offset;
+		if(bytes > count - copied) {
+			bytes = count - copied;
+		}
+		memcpy(&((char*) buffer)[copied], &segment->data[stream->read_offset], bytes);
+		copied              += bytes;
+		stream->read_offset += bytes;
+
+		// segment consumed: free it and move the prefetch window
+		if(stream->read_offset == segment->size) {
+			free(segment->data);
+			segment->data   = NULL;
+			segment->size   = 0;
+			segment->status = seg_empty;
+
+			stream->read_segment++;
+			stream->read_offset = 0;
+			pthread_cond_broadcast(&stream->cond);
+		}
+	}
+	pthread_mutex_unlock(&stream->mutex);
+
+	return copied;
+}
+
+bool hls_stream_seek(struct hls_stream *stream, size_t index) {
+	if(index >= stream->playlist->count) {
+		return false;
+	}
+
+	pthread_mutex_lock(&stream->mutex);
+	stream->read_segment = index;
+	stream->read_offset  = 0;
+
+	// discard anything outside of the new prefetch window (once downloaded, if loading), retry failed segments
+	for(size_t i = 0; i < stream->playlist->count; i++) {
+		struct segment_data *segment = &stream->segments[i];
+		const bool in_window = (i >= index && i < index + HLS_PREFETCH);
+
+		if(seg_loading == segment->status) {
+			segment->discard = !in_window;
+		} else if((seg_done == segment->status && !in_window) || seg_failed == segment->status) {
+			free(segment->data);
+			segment->data   = NULL;
+			segment->size   = 0;
+			segment->status = seg_empty;
+		}
+	}
+	pthread_cond_broadcast(&stream->cond);
+	pthread_mutex_unlock(&stream->mutex);
+
+	return true;
+}
+
+void hls_stream_interrupt(struct hls_stream *stream) {
+	pthread_mutex_lock(&stream->mutex);
+	__atomic_store_n(&stream->terminate, true, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&stream->cond);
+	pthread_mutex_unlock(&stream->mutex);
+}
+
+void hls_stream_close(struct hls_stream *stream) {
+	if(!stream) return;
+
+	hls_stream_interrupt(stream);
+	for(size_t i = 0; i < HLS_WORKERS; i++) {
+		if(stream->worker_valid[i]) {
+			pthread_join(stream->workers[i], NULL);
+		}
+	}
+
+	if(stream->segments) {
+		for(size_t i = 0; i < stream->playlist->count; i++) {
+			free(stream->segments[i].data);
+		}
+		free(stream->segments);
+	}
+	hls_playlist_destroy(stream->playlist);
+	hls_pool_clear(stream);
+
+	pthread_cond_destroy(&stream->cond);
+	pthread_mutex_destroy(&stream->pool_mutex);
+	pthread_mutex_destroy(&stream->mutex);
+	free(stream);
+}
@@ -0,0 +1,129 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file hls.h
+ *  \brief HTTP Live Streaming (HLS): playlist parsing and segmented download
+ *
+ *  A hls_stream fetches the segments listed in a (m3u8) playlist in parallel, using a small pool of
+ *  keep-alive connections, and presents them as one continuous stream via hls_stream_read().
+ */
+
+#ifndef _HLS_H
+	#define _HLS_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	#include <sys/types.h>                  // for ssize_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+
+	/** \brief A single segment of a playlist */
+	struct hls_segment {
+		char  *url;      ///< The (absolute) URL of the segment
+		double duration; ///< The duration of the segment (in seconds), as announced by `#EXTINF`
+		double start;    ///< The time (in seconds) the segment starts at within the stream
+	};
+
+	/** \brief A parsed (media) playlist */
+	struct hls_playlist {
+		struct hls_segment *segments; ///< The segments, in order of playback
+		size_t              count;    ///< The number of segments
+		double              duration; ///< The duration of the whole stream (in seconds)
+		char               *variant;  ///< The URL of the first variant stream (master playlists only, `NULL` otherwise)
+	};
+
+	/** \brief Parse a m3u8 playlist
+	 *
+	 *  Relative URLs within the playlist are resolved against `url`.
+	 *
+	 *  \param url   The URL the playlist was retrieved from
+	 *  \param data  The (NUL-terminated) content of the playlist
+	 *  \return      The playlist, `NULL` if `data` is not a valid playlist (or in case of a failing malloc)
+	 */
+	struct hls_playlist* hls_playlist_parse(const char *url, const char *data) ATTR(nonnull);
+
+	/** \brief Find the segment containing a specific time
+	 *
+	 *  \param playlist  The playlist
+	 *  \param secs      The time (in seconds)
+	 *  \return          The index of the segment (the last one, if `secs` is beyond the end)
+	 */
+	size_t hls_playlist_segment_at(const struct hls_playlist *playlist, double secs) ATTR(nonnull);
+
+	/** \brief Free a playlist and all its segments
+	 *
+	 *  \param playlist  The playlist to free (may be `NULL`)
+	 */
+	void hls_playlist_destroy(struct hls_playlist *playlist);
+
+	struct hls_stream;
+
+	/** \brief Open a stream: retrieve its playlist and start prefetching the first segments
+	 *
+	 *  If `url` points to a master playlist, the first variant stream is used.
+	 *
+	 *  \param url  The URL of the playlist
+	 *  \return     The stream, `NULL` in case of failure
+	 */
+	struct hls_stream* hls_stream_open(const char *url) ATTR(nonnull);
+
+	/** \brief Returns the playlist of a stream
+	 *
+	 *  \param stream  The stream
+	 *  \return        The playlist, valid until hls_stream_close()
+	 */
+	const struct hls_playlist* hls_stream_playlist(struct hls_stream *stream) ATTR(nonnull);
+
+	/** \brief Read from a stream
+	 *
+	 *  Blocks until the segment to read from is available.
+	 *
+	 *  \param stream  The stream
+	 *  \param buffer  The buffer to read into
+	 *  \param count   The maximum number of bytes to read
+	 *  \return        The number of bytes read, 0 at the end of the stream (or if interrupted), -1 in case of failure
+	 */
+	ssize_t hls_stream_read(struct hls_stream *stream, void *buffer, size_t count) ATTR(nonnull);
+
+	/** \brief Continue reading at the beginning of a segment
+	 *
+	 *  Only the segments from `segment` onwards are downloaded (again), segments outside of the
+	 *  prefetch window are discarded.
+	 *
+	 *  \param stream   The stream
+	 *  \param segment  The index of the segment
+	 *  \return         `true` on success, `false` if there is no such segment
+	 */
+	bool hls_stream_seek(struct hls_stream *stream, size_t segment) ATTR(nonnull);
+
+	/** \brief Interrupt any reader blocked in hls_stream_read() (may be called by any thread)
+	 *
+	 *  Any subsequent read returns 0.
+	 *
+	 *  \param stream  The stream
+	 */
+	void hls_stream_interrupt(struct hls_stream *stream) ATTR(nonnull);
+
+	/** \brief Close a stream, stop the downloads and free all associated data
+	 *
+	 *  \param stream  The stream to close (may be `NULL`)
+	 */
+	void hls_stream_close(struct hls_stream *stream);
+#endif /* _HLS_H */
@@ -0,0 +1,303 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file isearch.c
+ *  \brief Implementation of the incremental search
+ *
+ *  Tracks match just like they do for search-next (see trigram_index_find()). The first query of a search is
+ *  matched via the trigram index of the list, the hits of the last query matched completely are kept (sorted by
+ *  position): a query extending it only needs to check these. Matching checks for a newer query (or the search
+ *  being finished) every ISEARCH_CHECK_INTERVAL tracks (or hits) and is cancelled if there is one.
+ */
+
+#include "_hard_config.h"
+#include "isearch.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <stdio.h>                      // for snprintf
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for strncasecmp, strcpy, etc
+//\endcond
+
+#include "helper.h"                     // for lrealloc
+#include "log.h"                        // for _err
+#include "state.h"                      // for state_set_current_selected, state_set_input
+#include "trigram.h"                    // for trigram_index_find, trigram_track_matches
+
+/** \brief The size of a query (including the terminating null byte), matching the size of the input (see state.c) */
+#define ISEARCH_QUERY_SIZE 128
+
+/** \brief The number of tracks checked between two checks for a newer query */
+#define ISEARCH_CHECK_INTERVAL 1024
+
+static void isearch_finalize(void);
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  have_query = PTHREAD_COND_INITIALIZER; ///< Signalled on submitting a query (or terminating)
+static pthread_cond_t  idle       = PTHREAD_COND_INITIALIZER; ///< Signalled once a query is matched (or cancelled)
+
+/* guarded by mutex */
+static struct track_list *list = NULL;  ///< The list searched, `NULL` if not searching
+static size_t       origin     = 0;     ///< The track selected before the search
+static unsigned int session    = 0;     ///< Incremented on starting a search: the hits of another search are not reused
+static unsigned int generation = 0;     ///< Incremented on submitting a query or finishing: cancels matching
+static char         query[ISEARCH_QUERY_SIZE];
+static bool         pending    = false; ///< A query was submitted, but matching it did not start yet
+static bool         busy       = false; ///< A query is being matched
+
+/* owned by the thread matching the queries */
+static size_t      *hits       = NULL;  ///< The positions of the tracks matching `hits_query`
+static size_t       hit_count  = 0;
+static size_t       hit_capacity = 0;
+static bool         hits_valid = false;
+static unsigned int hits_session;
+static char         hits_query[ISEARCH_QUERY_SIZE];
+
+static pthread_t thread_isearch;
+static bool      thread_isearch_valid = false;
+
+static volatile bool terminate = false;
+
+/** \brief `true` if matching the query of generation `gen` is to be cancelled */
+static bool isearch_cancelled(unsigned int gen) {
+	pthread_mutex_lock(&mutex);
+	const bool cancelled = (gen != generation);
+	pthread_mutex_unlock(&mutex);
+	return cancelled;
+}
+
+/** \brief Add a hit
+ *
+ *  \return `true` on success, `false` in case of a failing malloc
+ */
+static bool isearch_hit_add(size_t pos) {
+	if(hit_count == hit_capacity) {
+		const size_t capacity = hit_capacity ? 2 * hit_capacity : 1024;
+		size_t *grown = lrealloc(hits, capacity * sizeof(size_t));
+		if(!grown) {
+			return false;
+		}
+		hits         = grown;
+		hit_capacity = capacity;
+	}
+
+	hits[hit_count++] = pos;
+	return true;
+}
+
+/** \brief Select the first hit at (or following) `start`, unless one was selected already */
+static void isearch_select(size_t pos, size_t start, bool *selected) {
+	if(!*selected && pos >= start) {
+		state_set_current_selected(pos);
+		*selected = true;
+	}
+}
+
+/** \brief Collect the hits within all tracks of a list via its trigram index
+ *
+ *  The input thread waits for the search meanwhile (see isearch_finish()): searching the list from this thread
+ *  does not race with searching it via search-next.
+ *
+ *  \return `true` if the query was matched completely, `false` if cancelled (or in case of a failing malloc)
+ */
+static bool isearch_match_all(struct track_list *_list, const char *str, size_t start, unsigned int gen, bool *selected) {
+	hit_count = 0;
+
+	size_t pos;
+	for(size_t next = 0; trigram_index_find(_list, str, next, true, &pos); next = pos + 1) {
+		if(!(hit_count % ISEARCH_CHECK_INTERVAL) && isearch_cancelled(gen)) {
+			return false;
+		}
+
+		if(!isearch_hit_add(pos)) {
+			_err("failed to allocate memory for the hits of `%s`", str);
+			return false;
+		}
+
+		// select the first hit right away, the remaining ones are only kept for the next query
+		isearch_select(pos, start, selected);
+	}
+	return true;
+}
+
+/** \brief Keep the hits of the previous query matching `str` as well
+ *
+ *  \return `true` if the query was matched completely, `false` if cancelled
+ */
+static bool isearch_match_hits(struct track_list *_list, const char *str, size_t start, unsigned int gen, bool *selected) {
+	char  *buffer      = NULL;
+	size_t buffer_size = 0;
+
+	size_t kept = 0;
+	for(size_t i = 0; i < hit_count; i++) {
+		if(!(i % ISEARCH_CHECK_INTERVAL) && isearch_cancelled(gen)) {
+			free(buffer);
+			return false;
+		}
+
+		if(trigram_track_matches(TRACK(_list, hits[i]), str, &buffer, &buffer_size)) {
+			hits[kept++] = hits[i];
+			isearch_select(hits[i], start, selected);
+		}
+	}
+	free(buffer);
+
+	hit_count = kept;
+	return true;
+}
+
+/** \brief Show the query and select its first hit following `start`
+ *
+ *  \return `true` if the query was matched completely, `false` if cancelled
+ */
+static bool isearch_match(struct track_list *_list, const char *str, size_t start, size_t _origin, unsigned int gen, unsigned int _session) {
+	state_set_input(str);
+
+	if(!*str) {
+		hits_valid = false;
+		state_set_current_selected(_origin);
+		return true;
+	}
+
+	// a query extending the previous one matches a subset of its hits
+	const bool reuse = hits_valid && _session == hits_session && !strncasecmp(str, hits_query, strlen(hits_query));
+	hits_valid = false;
+
+	bool selected = false;
+	const bool matched = reuse ? isearch_match_hits(_list, str, start, gen, &selected)
+	                           : isearch_match_all(_list, str, start, gen, &selected);
+	if(!matched) {
+		return false;
+	}
+
+	hits_valid   = true;
+	hits_session = _session;
+	strcpy(hits_query, str);
+
+	if(!selected) {
+		state_set_current_selected(_origin);
+	}
+	return true;
+}
+
+/** \brief Match the query submitted last (requires `mutex`, which is released while matching) */
+static void isearch_run(void) {
+	char str[ISEARCH_QUERY_SIZE];
+	strcpy(str, query);
+
+	struct track_list *_list = list;
+	const size_t       _origin  = origin;
+	const unsigned int gen      = generation;
+	const unsigned int _session = session;
+	pending = false;
+	busy    = true;
+	pthread_mutex_unlock(&mutex);
+
+	if(!isearch_match(_list, str, _origin + 1, _origin, gen, _session)) {
+		hit_count = 0;
+	}
+
+	pthread_mutex_lock(&mutex);
+	busy = false;
+	pthread_cond_broadcast(&idle);
+}
+
+static void* _thread_isearch_function(void *unused UNUSED) {
+	pthread_mutex_lock(&mutex);
+	while(!terminate) {
+		if(pending) {
+			isearch_run();
+		} else {
+			pthread_cond_wait(&have_query, &mutex);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return NULL;
+}
+
+void isearch_start(struct track_list *_list, size_t selected) {
+	pthread_mutex_lock(&mutex);
+	list   = _list;
+	origin = selected;
+	session++;
+	pthread_mutex_unlock(&mutex);
+}
+
+void isearch_update(const char *str) {
+	pthread_mutex_lock(&mutex);
+	if(list) {
+		snprintf(query, sizeof(query), "%s", str);
+		generation++;
+		pending = true;
+
+		if(thread_isearch_valid) {
+			pthread_cond_signal(&have_query);
+		} else {
+			isearch_run();
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void isearch_finish(bool accept) {
+	pthread_mutex_lock(&mutex);
+	if(!accept) {
+		generation++;
+		pending = false;
+	}
+	while(pending || busy) {
+		pthread_cond_wait(&idle, &mutex);
+	}
+
+	const size_t _origin = origin;
+	list = NULL;
+	pthread_mutex_unlock(&mutex);
+
+	if(!accept) {
+		state_set_current_selected(_origin);
+	}
+}
+
+bool isearch_init(void) {
+	int err = pthread_create(&thread_isearch, NULL, _thread_isearch_function, NULL);
+	if(err) {
+		_err("pthread_create: %s", strerror(err));
+		return false;
+	}
+	thread_isearch_valid = true;
+
+	if(atexit(isearch_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	return true;
+}
+
+static void isearch_finalize(void) {
+	pthread_mutex_lock(&mutex);
+	terminate = true;
+	generation++;
+	pthread_cond_broadcast(&have_query);
+	pthread_mutex_unlock(&mutex);
+
+	pthread_join(thread_isearch, NULL);
+	free(hits);
+}
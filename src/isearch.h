@@ -0,0 +1,67 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file isearch.h
+ *  \brief Incremental search (search-as-you-type)
+ *
+ *  While the query is typed, a background thread matches it against the titles and usernames of the current list
+ *  and selects the first hit. Each query extending the previous one only re-checks the tracks matching the previous
+ *  one; a query submitted while another one is being matched cancels the latter. Submitting a query never waits.
+ *
+ *  The list searched must not be modified during a search (the input is handled by the thread modifying lists).
+ */
+
+#ifndef _ISEARCH_H
+	#define _ISEARCH_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+	#include "track.h"                      // for track_list
+
+	/** \brief Start the background thread matching the queries
+	 *
+	 *  Until started, queries are matched synchronously by isearch_update().
+	 *
+	 *  \return `true` on success, `false` otherwise
+	 */
+	bool isearch_init(void);
+
+	/** \brief Start a search within a list
+	 *
+	 *  \param list      The list to search in, needs to be the current list
+	 *  \param selected  The track selected: the hits following it are selected, it is selected again if none
+	 */
+	void isearch_start(struct track_list *list, size_t selected) ATTR(nonnull);
+
+	/** \brief Submit the (modified) query, shown as input and matched in the background
+	 *
+	 *  \param query  The query, copied
+	 */
+	void isearch_update(const char *query) ATTR(nonnull);
+
+	/** \brief Finish the search
+	 *
+	 *  \param accept  `true` to keep the hit of the last query selected (waits for it to be matched),
+	 *                 `false` to cancel matching and to select the track selected before the search again
+	 */
+	void isearch_finish(bool accept);
+#endif /* _ISEARCH_H */
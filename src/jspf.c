@@ -34,6 +34,8 @@
 
 //\cond
 #include <errno.h>                      // for errno
+#include <fcntl.h>                      // for open, O_WRONLY, etc
+#include <pthread.h>                    // for pthread_mutex_lock, etc
 #include <stdbool.h>                    // for bool, false, true
 #include <stddef.h>                     // for size_t
 #include <stdio.h>                      // for NULL, fclose, FILE, fopen, etc
@@ -41,15 +43,18 @@
 #include <string.h>                     // for strlen, strerror
 #include <sys/stat.h>                   // for stat, fstat
 #include <time.h>                       // for strftime, strptime
+#include <unistd.h>                     // for close, pread
 //\endcond
 
 #include <yajl/yajl_gen.h>              // for yajl_gen_string, etc
 #include <yajl/yajl_tree.h>             // for yajl_val_s, etc
 
+#include "aio.h"                        // for aio_write_file
+#include "descstore.h"                  // for descstore_put
 #include "helper.h"                     // for lcalloc, lmalloc
 #include "log.h"                        // for _log
 #include "track.h"                      // for track, etc
-#include "yajl_helper.h"                // for yajl_helper_get_string, etc
+#include "yajl_helper.h"                // for yajl_helper_get_interned, etc
 
 #define YAJL_GEN_STRING(hand, str) yajl_gen_string(hand, (unsigned char*)str, strlen(str))
 
@@ -77,17 +82,61 @@
 	yajl_gen_map_close(hand); \
 }
 
+/** \brief The end of a document written by jspf_write(): closing the array of tracks, the playlist and the document */
+#define JSPF_TAIL "]}}"
+
 static char* last_error = NULL;
 
-/** \brief YAJL print callback function for writing JSPF.
+static pthread_mutex_t pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  pending_cond  = PTHREAD_COND_INITIALIZER;
+static size_t pending = 0; ///< The number of writes submitted, but not completed yet
+
+/** \brief Register a write about to be submitted
+ *
+ *  \param exclusive  Wait for all writes submitted before to complete (required for reading or truncating the file being written to)
+ */
+static void jspf_write_begin(bool exclusive) {
+	pthread_mutex_lock(&pending_mutex);
+	while(exclusive && pending) {
+		pthread_cond_wait(&pending_cond, &pending_mutex);
+	}
+	pending++;
+	pthread_mutex_unlock(&pending_mutex);
+}
+
+/** \brief Unregister a write, once completed (or not submitted at all) */
+static void jspf_write_end(void) {
+	pthread_mutex_lock(&pending_mutex);
+	if(!--pending) {
+		pthread_cond_broadcast(&pending_cond);
+	}
+	pthread_mutex_unlock(&pending_mutex);
+}
+
+/** \brief Called once the JSPF is written to file: free the generator holding the data
  *
- *  \param ctx  A context, here: a `FILE*` receiving the JSPF
- *  \param str  The string to write to file
- *  \param len  The length of `str`
+ *  \param ctx      The YAJL handle
+ *  \param success  `true` if writing to file was successful, `false` otherwise
  */
-static void jspf_filewriter(void *ctx, const char *str, size_t len) {
-	FILE *fh = (FILE*) ctx;
-	fwrite(str, sizeof(char), len, fh);
+static void jspf_write_done(void *ctx, bool success) {
+	if(!success) {
+		_err("failed to write JSPF");
+	}
+	yajl_gen_free((yajl_gen) ctx);
+	jspf_write_end();
+}
+
+/** \brief Called once the tracks are appended to file: free the buffer holding the data
+ *
+ *  \param ctx      The buffer
+ *  \param success  `true` if writing to file was successful, `false` otherwise
+ */
+static void jspf_append_done(void *ctx, bool success) {
+	if(!success) {
+		_err("failed to append to JSPF");
+	}
+	free(ctx);
+	jspf_write_end();
 }
 
 /** \brief Write a single track to file.
@@ -119,17 +168,13 @@ static void write_jspf_track(yajl_gen hand, struct track *track) {
 }
 
 bool jspf_write(char *file, struct track_list *list) {
-	FILE *fh = fopen(file, "w");
-	if(!fh) {
-		last_error = strerror(errno);
-		_log("failed to open '%s': %s", file, last_error);
+	// generate the whole document in memory, written to file by the I/O engine
+	yajl_gen hand = yajl_gen_alloc(NULL);
+	if(!hand) {
+		last_error = "failed to allocate memory";
 		return false;
 	}
 
-	yajl_gen hand = yajl_gen_alloc(NULL);
-
-	yajl_gen_config(hand, yajl_gen_print_callback, jspf_filewriter, fh);
-
 	yajl_gen_map_open(hand);
 	YAJL_GEN_STRING(hand, "playlist");
 	yajl_gen_map_open(hand);
@@ -144,23 +189,117 @@ bool jspf_write(char *file, struct track_list *list) {
 	yajl_gen_map_close(hand);
 	yajl_gen_map_close(hand);
 
+	const unsigned char *data;
+	size_t size;
+	yajl_gen_get_buf(hand, &data, &size);
+
+	// truncating the file is only valid once any write to the file submitted before is completed
+	jspf_write_begin(true);
+
+	int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(0 > fd) {
+		last_error = strerror(errno);
+		_log("failed to open '%s': %s", file, last_error);
+		yajl_gen_free(hand);
+		jspf_write_end();
+		return false;
+	}
+
+	if(!aio_write_file(fd, 0, data, size, jspf_write_done, hand)) {
+		last_error = "failed to allocate memory";
+		yajl_gen_free(hand);
+		jspf_write_end();
+		return false;
+	}
+
+	return true;
+}
+
+bool jspf_append(char *file, struct track_list *list) {
+	if(!list->count) {
+		return true;
+	}
+
+	// the tail read below is only valid once any write to the file submitted before is completed
+	jspf_write_begin(true);
+
+	int fd = open(file, O_RDWR | O_CLOEXEC);
+	if(0 > fd) {
+		last_error = strerror(errno);
+		_log("failed to open '%s': %s", file, last_error);
+		jspf_write_end();
+		return false;
+	}
+
+	// the tracks replace the tail, the byte preceding it tells whether the array of tracks is empty
+	char tail[sizeof(JSPF_TAIL)];
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < (off_t) sizeof(tail)
+	|| (ssize_t) sizeof(tail) != pread(fd, tail, sizeof(tail), st.st_size - (off_t) sizeof(tail))
+	|| memcmp(&tail[1], JSPF_TAIL, strlen(JSPF_TAIL))) {
+		last_error = "not a document written by jspf_write()";
+		_log("cannot append to '%s': %s", file, last_error);
+		close(fd);
+		jspf_write_end();
+		return false;
+	}
+	const bool empty = ('[' == tail[0]);
+
+	yajl_gen hand = yajl_gen_alloc(NULL);
+	if(!hand) {
+		last_error = "failed to allocate memory";
+		close(fd);
+		jspf_write_end();
+		return false;
+	}
+
+	yajl_gen_array_open(hand);
+	for(size_t i = 0; i < list->count; i++) {
+		write_jspf_track(hand, TRACK(list, i));
+	}
+	yajl_gen_array_close(hand);
+
+	const unsigned char *data;
+	size_t size;
+	yajl_gen_get_buf(hand, &data, &size);
+
+	// drop the brackets of the array generated: the tracks continue the array within the file
+	char *buffer = lmalloc(1 + size - 2 + strlen(JSPF_TAIL));
+	size_t used = 0;
+	if(buffer) {
+		if(!empty) {
+			buffer[used++] = ',';
+		}
+		memcpy(&buffer[used], &data[1], size - 2);
+		used += size - 2;
+		memcpy(&buffer[used], JSPF_TAIL, strlen(JSPF_TAIL));
+		used += strlen(JSPF_TAIL);
+	}
 	yajl_gen_free(hand);
-	fclose(fh);
+
+	if(!buffer || !aio_write_file(fd, st.st_size - (off_t) strlen(JSPF_TAIL), buffer, used, jspf_append_done, buffer)) {
+		last_error = "failed to allocate memory";
+		if(!buffer) {
+			close(fd);
+		}
+		free(buffer);
+		jspf_write_end();
+		return false;
+	}
 
 	return true;
 }
 
 static void yajl_to_track(yajl_val parent, struct track *track) {
-	track->name          = yajl_helper_get_string(parent, "title",      NULL);
-	track->stream_url    = yajl_helper_get_string(parent, "location",   NULL);
-	track->username      = yajl_helper_get_string(parent, "creator",    NULL);
-	track->permalink_url = yajl_helper_get_string(parent, "identifier", NULL);
-	track->description   = yajl_helper_get_string(parent, "annotation", NULL);
-	track->duration      = yajl_helper_get_int   (parent, "duration",   NULL);
+	track->name          = yajl_helper_get_interned(parent, "title",      NULL);
+	track->stream_url    = yajl_helper_get_interned(parent, "location",   NULL);
+	track->username      = yajl_helper_get_interned(parent, "creator",    NULL);
+	track->permalink_url = yajl_helper_get_interned(parent, "identifier", NULL);
+	track->duration      = yajl_helper_get_int     (parent, "duration",   NULL);
 	track->url_count     = URL_COUNT_UNINITIALIZED;
 
 	// TODO \todo download_url not part of cached data
-	// track->download_url  = yajl_helper_get_string(parent, "download_url",  NULL);
+	// track->download_url  = yajl_helper_get_interned(parent, "download_url",  NULL);
 
 	yajl_val node_meta = yajl_helper_get_array(parent, "meta", NULL);
 	for(size_t j = 0; j < node_meta->u.array.len; j++) {
@@ -172,27 +311,30 @@ static void yajl_to_track(yajl_val parent, struct track *track) {
 		if(val_track_id)   track->track_id   = val_track_id;
 		if(val_created_at) track->created_at = val_created_at;
 	}
+
+	// the description is kept in memory only if it cannot be stored (and is dropped from the list once written)
+	if(!descstore_put(track->track_id, yajl_helper_peek_string(parent, "annotation", NULL))) {
+		track->description = yajl_helper_get_interned(parent, "annotation", NULL);
+	}
 }
 
 struct track_list* jspf_read(char *path) {
-	struct track_list *list = lcalloc(1, sizeof(struct track_list));
-	if(!list) {
-		last_error = "*alloc failed";
-		return NULL;
-	}
+	struct track_list_builder builder = { .region = NULL };
 
 	// allocate buffer and read whole .jspf-file into the buffer
-	struct mmapped_file file = file_read_contents(path);
+	struct mmapped_file file = file_read_contents(path, file_access_populate);
 	if(file.data) {
 		yajl_val node_root = yajl_helper_parse(file.data);
 		yajl_val array = yajl_helper_get_array(node_root, "playlist", "track");
 
 		if(array) {
-			list->entries = lcalloc(array->u.array.len + 1, sizeof(struct track));
-			list->count   = array->u.array.len;
-
 			for(size_t i = 0; i < array->u.array.len; i++) {
-				yajl_to_track(array->u.array.values[i], &list->entries[i]);
+				struct track *track = track_list_builder_add(&builder);
+				if(!track) {
+					last_error = "*alloc failed";
+					break;
+				}
+				yajl_to_track(array->u.array.values[i], track);
 			}
 		}
 
@@ -200,6 +342,10 @@ struct track_list* jspf_read(char *path) {
 		file_release_contents(file);
 	}
 
+	struct track_list *list = track_list_builder_finish(&builder);
+	if(!list) {
+		last_error = "*alloc failed";
+	}
 	return list;
 }
 
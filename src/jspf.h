@@ -23,6 +23,10 @@
 	#include "track.h"
 
 	/** \brief Write a whole tracklist to file.
+	 *
+	 *  The document is generated immediately, but written to file asynchronously (see aio.h):
+	 *  `list` may be modified (or destroyed) as soon as jspf_write() returns. Writes to a file submitted before
+	 *  (via jspf_write() or jspf_append()) are completed before the file is truncated.
 	 *
 	 *  \param file  The name of the file to write to
 	 *  \param list  The tracklist to be written to `file`
@@ -30,6 +34,17 @@
 	 */
 	bool jspf_write(char *file, struct track_list *list);
 
+	/** \brief Append the tracks of a tracklist to a file written by jspf_write()
+	 *
+	 *  Only the tracks appended are generated and written (asynchronously, see jspf_write()), the file is not
+	 *  rewritten: tracks appended are read (see jspf_read()) after the ones written before.
+	 *
+	 *  \param file  The name of the file to append to
+	 *  \param list  The tracks to be appended to `file`
+	 *  \return      `true` in case of success, `false` otherwise (p.x. if `file` is missing or not written by jspf_write())
+	 */
+	bool jspf_append(char *file, struct track_list *list) ATTR(nonnull);
+
 	/** \brief Read a JSPF playlist to a track_list.
 	 *
 	 *  \param file  The file to read from
@@ -63,7 +63,7 @@ bool log_init(char *file) {
 }
 
 /* log to file using fmt, just as known from printf */
-void __log(const char *srcfile, int srcline, const char *srcfunc, bool is_error, const char *fmt, ...) {
+void log_write(const char *srcfile, int srcline, const char *srcfunc, bool is_error, const char *fmt, ...) {
 	assert(log_fh && "logging not yet initialized");
 
 	sem_wait(&log_sem);
@@ -43,11 +43,11 @@
 	 *  Format of the location: "{ in function_name (file_name.c:line_number) }"\n
 	 *  Calling _log() prior to log_init() or after log_close() does not have any effect.
 	 *
-	 *  Due to the synchronisation of __log(), _log() may be called by several threads 'at once' as well.
+	 *  Due to the synchronisation of log_write(), _log() may be called by several threads 'at once' as well.
 	 *
-	 *  Always use _log() instead of __log().
+	 *  Always use _log() instead of log_write().
 	 */
-	#define _log(...) __log(__FILE__, __LINE__, __func__, false, __VA_ARGS__)
+	#define _log(...) log_write(__FILE__, __LINE__, __func__, false, __VA_ARGS__)
 
 	/** Write an error to the logfile.
 	 *
@@ -56,24 +56,24 @@
 	 *  Format of the location: "{ in function_name (file_name.c:line_number) }"\n
 	 *  Calling _log() prior to log_init() or after log_close() does not have any effect.
 	 *
-	 *  Due to the synchronisation of __log(), _log() may be called by several threads 'at once' as well.
+	 *  Due to the synchronisation of log_write(), _log() may be called by several threads 'at once' as well.
 	 *
-	 *  Always use _log() instead of __log().
+	 *  Always use _log() instead of log_write().
 	 */
-	#define _err(...) __log(__FILE__, __LINE__, __func__, true, __VA_ARGS__)
+	#define _err(...) log_write(__FILE__, __LINE__, __func__, true, __VA_ARGS__)
 
 	/** The internal implementation for logging.
 	 *
 	 *  \warning This function is not intended to be called directly by the user.
-	 *  Use _log() instead, as this macro inserts the correct position of the call to __log().
+	 *  Use _log() instead, as this macro inserts the correct position of the call to log_write().
 	 *
 	 *  This function is synchronized internally and therefore may be called by several threads 'at once'.
 	 *
-	 *  \param srcfile   The file executing the call to __log(); filled by macro _log(), do not use "by hand"
-	 *  \param srcline   The line in the file executing the call to __log(); filled by macro _log(), do not use "by hand"
-	 *  \param srcfunc   The function callint __log(); filled by macro _log(), do not use "by hand"
+	 *  \param srcfile   The file executing the call to log_write(); filled by macro _log(), do not use "by hand"
+	 *  \param srcline   The line in the file executing the call to log_write(); filled by macro _log(), do not use "by hand"
+	 *  \param srcfunc   The function callint log_write(); filled by macro _log(), do not use "by hand"
 	 *  \param is_error  If set to true, the message will be printed in red
 	 *  \param fmt       The format used format the line, see man 3 printf for usage.
 	 */
-	void __log(const char *srcfile, int srcline, const char *srcfunc, bool is_error, const char *fmt, ...) ATTR(format (printf, 5, 6));
+	void log_write(const char *srcfile, int srcline, const char *srcfunc, bool is_error, const char *fmt, ...) ATTR(format (printf, 5, 6));
 #endif /* _LOG_H */
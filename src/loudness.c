@@ -0,0 +1,410 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file loudness.c
+ *  \brief Implements loudness analysis according to EBU R128 (ITU-R BS.1770)
+ *
+ *  The samples are K-weighted (a high shelf followed by a high pass, both designed for the actual
+ *  sample rate), the mean square is computed for blocks of 400ms overlapping by 75% and
+ *  the blocks are gated twice: absolute at -70 LUFS and relative at 10 LU below the mean of the
+ *  remaining blocks.
+ */
+
+#include "_hard_config.h"
+#include "loudness.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <math.h>                       // for tan, pow, log10
+#include <pthread.h>                    // for pthread_create, etc
+#include <sched.h>                      // for SCHED_IDLE
+#include <semaphore.h>                  // for sem_post, sem_wait, etc
+#include <stdint.h>                     // for intptr_t
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for strerror
+#include <sys/resource.h>               // for setpriority
+#include <sys/syscall.h>                // for SYS_gettid
+#include <unistd.h>                     // for syscall
+//\endcond
+
+#include <mpg123.h>                     // for MPG123_OK, etc
+
+#include "cache.h"                      // for cache_track_get, etc
+#include "decoder.h"                    // for decoder_open, etc
+#include "downloader.h"                 // for downloader_create_state
+#include "helper.h"                     // for lcalloc, lmalloc
+#include "log.h"                        // for _log
+
+/** \brief The maximum number of channels supported */
+#define LOUDNESS_MAX_CHANNELS 2
+
+/** \brief The gating blocks overlap by 75%, therefore the energy is accumulated in quarter-blocks of 100ms */
+#define LOUDNESS_SUBBLOCKS 4
+
+#define LOUDNESS_ABSOLUTE_GATE -70.0
+#define LOUDNESS_RELATIVE_GATE -10.0
+
+/** \brief A biquad filter (transposed direct form II) */
+struct biquad {
+	double b0, b1, b2, a1, a2;
+	double z1[LOUDNESS_MAX_CHANNELS];
+	double z2[LOUDNESS_MAX_CHANNELS];
+};
+
+struct loudness_meter {
+	unsigned int channels;
+
+	struct biquad shelf;      ///< stage 1 of the K-weighting: models the acoustic effect of the head
+	struct biquad highpass;   ///< stage 2 of the K-weighting: the RLB weighting curve
+
+	size_t subblock_frames;   ///< the number of frames per quarter-block (100ms)
+	size_t subblock_fill;     ///< the number of frames in the current quarter-block
+	double subblock_energy;   ///< the sum of squares of the current quarter-block
+
+	double subblocks[LOUDNESS_SUBBLOCKS];  ///< the energy of the last quarter-blocks
+	size_t subblock_count;                 ///< the number of quarter-blocks completed
+
+	double *blocks;           ///< the mean square of each (overlapping) 400ms block
+	size_t  block_count;
+	size_t  block_capacity;
+};
+
+static inline double biquad_process(struct biquad *bq, unsigned int channel, double in) {
+	double out = bq->b0 * in + bq->z1[channel];
+	bq->z1[channel] = bq->b1 * in - bq->a1 * out + bq->z2[channel];
+	bq->z2[channel] = bq->b2 * in - bq->a2 * out;
+	return out;
+}
+
+struct loudness_meter* loudness_meter_create(unsigned int rate, unsigned int channels) {
+	if(!rate || !channels || channels > LOUDNESS_MAX_CHANNELS) {
+		_err("unsupported format: rate: %u, %u channels", rate, channels);
+		return NULL;
+	}
+
+	struct loudness_meter *meter = lcalloc(1, sizeof(struct loudness_meter));
+	if(!meter) {
+		return NULL;
+	}
+
+	meter->channels        = channels;
+	meter->subblock_frames = rate / 10;
+
+	// the coefficients of ITU-R BS.1770 are given for 48kHz only, derive them from the analog prototypes
+	double f0 = 1681.974450955533;
+	double gain_db = 3.999843853973347;
+	double q  = 0.7071752369554196;
+	double k  = tan(M_PI * f0 / rate);
+	double vh = pow(10.0, gain_db / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+
+	meter->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+	meter->shelf.b1 = 2.0 * (k * k - vh) / a0;
+	meter->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+	meter->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	meter->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q  = 0.5003270373238773;
+	k  = tan(M_PI * f0 / rate);
+	a0 = 1.0 + k / q + k * k;
+
+	meter->highpass.b0 =  1.0;
+	meter->highpass.b1 = -2.0;
+	meter->highpass.b2 =  1.0;
+	meter->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+	meter->highpass.a2 = (1.0 - k / q + k * k) / a0;
+
+	return meter;
+}
+
+/** \brief Store the mean square of the 400ms block ending with the current quarter-block
+ */
+static void loudness_meter_complete_block(struct loudness_meter *meter) {
+	meter->subblocks[meter->subblock_count % LOUDNESS_SUBBLOCKS] = meter->subblock_energy;
+	meter->subblock_count++;
+
+	meter->subblock_energy = 0;
+	meter->subblock_fill   = 0;
+
+	if(meter->subblock_count < LOUDNESS_SUBBLOCKS) {
+		return;
+	}
+
+	if(meter->block_count == meter->block_capacity) {
+		size_t new_capacity = meter->block_capacity ? 2 * meter->block_capacity : 1024;
+		double *new_blocks = lrealloc(meter->blocks, new_capacity * sizeof(double));
+		if(!new_blocks) {
+			return;
+		}
+		meter->blocks         = new_blocks;
+		meter->block_capacity = new_capacity;
+	}
+
+	double energy = 0;
+	for(size_t i = 0; i < LOUDNESS_SUBBLOCKS; i++) {
+		energy += meter->subblocks[i];
+	}
+	meter->blocks[meter->block_count++] = energy / (LOUDNESS_SUBBLOCKS * meter->subblock_frames);
+}
+
+void loudness_meter_add_s16(struct loudness_meter *meter, const int16_t *samples, size_t frames) {
+	for(size_t f = 0; f < frames; f++) {
+		for(unsigned int c = 0; c < meter->channels; c++) {
+			double in = samples[f * meter->channels + c] / 32768.0;
+			double out = biquad_process(&meter->highpass, c, biquad_process(&meter->shelf, c, in));
+
+			// the weights of the left and the right channel are 1.0
+			meter->subblock_energy += out * out;
+		}
+
+		if(++meter->subblock_fill == meter->subblock_frames) {
+			loudness_meter_complete_block(meter);
+		}
+	}
+}
+
+static inline double energy_to_lufs(double energy) {
+	return -0.691 + 10.0 * log10(energy);
+}
+
+double loudness_meter_integrated(struct loudness_meter *meter) {
+	const double absolute_threshold = pow(10.0, (LOUDNESS_ABSOLUTE_GATE + 0.691) / 10.0);
+
+	double sum = 0;
+	size_t count = 0;
+	for(size_t i = 0; i < meter->block_count; i++) {
+		if(meter->blocks[i] > absolute_threshold) {
+			sum += meter->blocks[i];
+			count++;
+		}
+	}
+
+	if(!count) {
+		return LOUDNESS_SILENCE;
+	}
+
+	const double relative_threshold = (sum / count) * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+
+	sum   = 0;
+	count = 0;
+	for(size_t i = 0; i < meter->block_count; i++) {
+		if(meter->blocks[i] > absolute_threshold && meter->blocks[i] > relative_threshold) {
+			sum += meter->blocks[i];
+			count++;
+		}
+	}
+
+	return count ? energy_to_lufs(sum / count) : LOUDNESS_SILENCE;
+}
+
+void loudness_meter_destroy(struct loudness_meter *meter) {
+	if(meter) {
+		free(meter->blocks);
+		free(meter);
+	}
+}
+
+// the background thread analysing cached tracks
+
+struct loudness_job {
+	int user_id;
+	int track_id;
+	struct loudness_job *next;
+};
+
+static void loudness_finalize(void);
+
+static pthread_t thread_loudness;
+static bool      thread_loudness_valid = false;
+
+static sem_t have_job;
+static sem_t sem_job_queue;
+
+static struct loudness_job *head = NULL;
+static struct loudness_job *tail = NULL;
+
+static volatile bool terminate = false;
+
+static struct loudness_job* loudness_dequeue(void) {
+	sem_wait(&sem_job_queue);
+	struct loudness_job *job = head;
+	head = job->next;
+
+	if(job == tail) {
+		tail = NULL;
+	}
+	sem_post(&sem_job_queue);
+
+	return job;
+}
+
+void loudness_queue(struct track *track) {
+	if(!thread_loudness_valid || cache_track_get_loudness(track, NULL)) {
+		return;
+	}
+
+	struct loudness_job *job = lmalloc(sizeof(struct loudness_job));
+	if(!job) {
+		return;
+	}
+
+	job->user_id  = track->user_id;
+	job->track_id = track->track_id;
+	job->next     = NULL;
+
+	sem_wait(&sem_job_queue);
+	if(tail) {
+		tail->next = job;
+	} else {
+		head = job;
+	}
+	tail = job;
+	sem_post(&sem_job_queue);
+
+	sem_post(&have_job);
+}
+
+/** \brief Decode a cached track and measure its integrated loudness
+ *
+ *  \param track     The track to analyse
+ *  \param loudness  Receives the integrated loudness in LUFS
+ *  \return          `true` on success, `false` otherwise
+ */
+static bool loudness_analyse(struct track *track, double *loudness) {
+	struct mmapped_file file = cache_track_get(track);
+	if(!file.data) {
+		return false;
+	}
+
+	bool success = false;
+
+	struct download_state *state = downloader_create_state(track);
+	struct decoder *decoder = NULL;
+	if(state) {
+		state->buffer      = (char*) (intptr_t) file.data;
+		state->bytes_recvd = file.size;
+		state->bytes_total = file.size;
+
+		decoder = decoder_open(state, reader_callback, NULL, false);
+	}
+
+	if(decoder && decoder_set_encoding(decoder, MPG123_ENC_SIGNED_16)) {
+		struct loudness_meter *meter = NULL;
+
+		unsigned char *audio;
+		size_t bytes;
+		int err;
+		while(!terminate && (MPG123_OK == (err = decoder_decode_frame(decoder, &audio, &bytes)) || MPG123_NEW_FORMAT == err)) {
+			if(MPG123_NEW_FORMAT == err) {
+				long rate;
+				int channels, encoding;
+				mpg123_getformat(decoder->mh, &rate, &channels, &encoding);
+
+				// a change of the format within a single track is not supported
+				if(meter) break;
+				meter = loudness_meter_create(rate, channels);
+				if(!meter) break;
+			} else if(meter) {
+				loudness_meter_add_s16(meter, (const int16_t*) audio, bytes / (sizeof(int16_t) * meter->channels));
+			}
+		}
+
+		if(meter && MPG123_DONE == err) {
+			*loudness = loudness_meter_integrated(meter);
+			success   = true;
+		}
+		loudness_meter_destroy(meter);
+	}
+
+	decoder_close(decoder);
+	free(state);
+	file_release_contents(file);
+
+	return success;
+}
+
+static void* _thread_loudness_function(void *unused UNUSED) {
+	// analysing is a mere nice-to-have: never compete with playback or the UI
+	struct sched_param param = { .sched_priority = 0 };
+	int err = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+	if(err) {
+		_log("pthread_setschedparam(SCHED_IDLE): %s, using nice value instead", strerror(err));
+		setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+	}
+
+	while(!terminate) {
+		sem_wait(&have_job);
+		if(terminate) return NULL;
+
+		struct loudness_job *job = loudness_dequeue();
+
+		struct track track = { .name = NULL };
+		track.user_id  = job->user_id;
+		track.track_id = job->track_id;
+		free(job);
+
+		// the track might have been analysed after being enqueued (e.g. enqueued twice)
+		if(cache_track_get_loudness(&track, NULL)) {
+			continue;
+		}
+
+		double loudness;
+		if(loudness_analyse(&track, &loudness)) {
+			_log("loudness of %d_%d: %.2f LUFS", track.user_id, track.track_id, loudness);
+			cache_track_save_loudness(&track, loudness);
+		}
+	}
+
+	return NULL;
+}
+
+bool loudness_init(void) {
+	if(sem_init(&have_job, 0, 0) || sem_init(&sem_job_queue, 0, 1)) {
+		_err("sem_init: %s", strerror(errno));
+		return false;
+	}
+
+	int err = pthread_create(&thread_loudness, NULL, _thread_loudness_function, NULL);
+	if(err) {
+		_err("pthread_create: %s", strerror(err));
+		return false;
+	}
+	thread_loudness_valid = true;
+
+	if(atexit(loudness_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	return true;
+}
+
+static void loudness_finalize(void) {
+	terminate = true;
+
+	sem_post(&have_job);
+	pthread_join(thread_loudness, NULL);
+
+	while(head) {
+		free(loudness_dequeue());
+	}
+
+	sem_destroy(&have_job);
+	sem_destroy(&sem_job_queue);
+}
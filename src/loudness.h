@@ -0,0 +1,85 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file loudness.h
+ *  \brief Loudness analysis according to EBU R128 (ITU-R BS.1770)
+ *
+ *  Cached tracks are analysed by a background thread running at idle priority.
+ *  The resulting integrated loudness is stored along with the track in the cache
+ *  (see cache_track_get_loudness()) and used for normalization during playback.
+ */
+
+#ifndef _LOUDNESS_H
+	#define _LOUDNESS_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	#include <stdint.h>                     // for int16_t
+	//\endcond
+
+	#include "track.h"                      // for track
+
+	/** \brief The loudness returned for silence, that is if no block passes the absolute gate */
+	#define LOUDNESS_SILENCE -70.0
+
+	struct loudness_meter;
+
+	/** \brief Create a new meter measuring the integrated loudness
+	 *
+	 *  \param rate      The sample rate
+	 *  \param channels  The number of (interleaved) channels
+	 *  \return          The new meter, `NULL` in case of failure
+	 */
+	struct loudness_meter* loudness_meter_create(unsigned int rate, unsigned int channels);
+
+	/** \brief Feed interleaved signed 16 bit samples to the meter
+	 *
+	 *  \param meter    The meter
+	 *  \param samples  The samples
+	 *  \param frames   The number of frames in `samples`
+	 */
+	void loudness_meter_add_s16(struct loudness_meter *meter, const int16_t *samples, size_t frames);
+
+	/** \brief Returns the integrated (gated) loudness of all samples fed so far
+	 *
+	 *  \param meter  The meter
+	 *  \return       The integrated loudness in LUFS (LOUDNESS_SILENCE if all blocks were gated)
+	 */
+	double loudness_meter_integrated(struct loudness_meter *meter);
+
+	/** \brief Destroy the meter
+	 *
+	 *  \param meter  The meter to destroy
+	 */
+	void loudness_meter_destroy(struct loudness_meter *meter);
+
+	/** \brief Start the background thread analysing cached tracks
+	 *
+	 *  \return `true` on success, `false` otherwise
+	 */
+	bool loudness_init(void);
+
+	/** \brief Enqueue a cached track for analysis
+	 *
+	 *  Does nothing if the track was already analysed.
+	 *
+	 *  \param track  The track to analyse (only `user_id` and `track_id` are used)
+	 */
+	void loudness_queue(struct track *track);
+#endif /* _LOUDNESS_H */
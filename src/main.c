@@ -36,7 +36,7 @@
  *  This project is released under the GNU General Public License version 3.
  */
 
-#include "_hard_config.h"               // for SCTC_LOG_FILE, etc
+#include "_hard_config.h"               // for SCTC_LOG_FILE, STREAM_REFRESH_HEADROOM, etc
 
 //\cond
 #include <dirent.h>                     // for dirent, closedir, opendir, etc
@@ -51,75 +51,78 @@
 #include <time.h>                       // for timespec
 //\endcond
 
-#include "cache.h"                      // for cache_track_exists
+#include "aio.h"                        // for aio_init
+#include "cache.h"                      // for cache_init, cache_track_exists
 #include "command.h"                    // for command_func_ptr
 #include "config.h"                     // for config_get_cache_path, etc
+#include "descstore.h"                  // for descstore_init
 #include "downloader.h"                 // for downloader_init
 #include "helper.h"                     // for smprintf, snprint_ftime, etc
+#include "isearch.h"                    // for isearch_init
 #include "jspf.h"                       // for jspf_read
 #include "log.h"                        // for _log, log_init, _err
+#include "loudness.h"                   // for loudness_queue
 #include "network/tls.h"                // for tls_init
 #include "sound.h"                      // for sound_init, sound_play
 #include "soundcloud.h"                 // for soundcloud_get_stream
 #include "state.h"                      // for state_add_list, etc
 #include "track.h"                      // for track, track_list, etc
+#include "trigram.h"                    // for trigram_init
 #include "tui.h"                        // for tui_submit_action, F_BOLD, etc
 
 #define TIME_BUFFER_SIZE 64
 
-/** \brief Update the current playback time.
+/** \brief Select the next track (if any) and initiate its playback.
  *
- *  If time equals -1, then the next track is selected (if any) and playback initiated.
- *
- *  \param time  The time in seconds to print to the screen
+ *  Called by the playback thread once playback of the current track is done.
  */
-static void tui_update_time(int time) {
+static void play_next_track(void) {
+	// the stream may be refreshed meanwhile: switch to the next track without tracks inserted in between
+	state_lock_lists();
+
 	struct track_list *list = state_get_list(state_get_current_playback_list());
 	size_t playing = state_get_current_playback_track();
 
-	if(-1 != time) {
-		TRACK(list, playing)->current_position = time;
+	_log("playback of current track done, switching to next one...");
+	TRACK(list, playing)->current_position = 0;
+	TRACK(list, playing)->flags &= ~(FLAG_PAUSED | FLAG_PLAYING);
 
-		state_set_current_time(time);
-		tui_submit_action(set_sbar_time);
+	// select track based on `repeat` state
+	enum repeat rep = state_get_repeat();
+	if(playing >= list->count - 1 && rep_none == rep) {
+		state_unlock_lists();
 
+		// stop at end of list if repeat is set to `none`
 		tui_submit_action(update_list);
-	} else {
-		_log("playback of current track done, switching to next one...");
-		TRACK(list, playing)->current_position = 0;
-		TRACK(list, playing)->flags &= ~(FLAG_PAUSED | FLAG_PLAYING);
-
-		// select track based on `repeat` state
-		enum repeat rep = state_get_repeat();
-		if(playing >= list->count - 1 && rep_none == rep) {
-			// stop at end of list if repeat is set to `none`
-			tui_submit_action(update_list);
-			_log("stopping playback (end of list)");
-			return;
-		}
+		_log("stopping playback (end of list)");
+		return;
+	}
 
-		if(rep_one != rep) {
-			if(playing >= list->count) {
-				playing = 0;
-				_log("continuing playback at top of list");
-			} else {
-				playing++;
-			}
+	if(rep_one != rep) {
+		if(playing >= list->count) {
+			playing = 0;
+			_log("continuing playback at top of list");
+		} else {
+			playing++;
 		}
+	}
 
-		TRACK(list, playing)->flags = (TRACK(list, playing)->flags & ~FLAG_PAUSED) | FLAG_PLAYING;
+	// the track itself is not released, even if the entries of the list are moved (see state_prepend_list())
+	struct track *track = TRACK(list, playing);
+	track->flags = (track->flags & ~FLAG_PAUSED) | FLAG_PLAYING | FLAG_PLAYED;
 
-		char time_buffer[TIME_BUFFER_SIZE];
-		snprint_ftime(time_buffer, TIME_BUFFER_SIZE, TRACK(list, playing)->duration);
+	state_set_current_playback(state_get_current_playback_list(), playing);
+	state_unlock_lists();
 
-		struct rc_string *new_title = rcs_format("Now playing "F_BOLD"%s"F_RESET" by "F_BOLD"%s"F_RESET" (%s)", TRACK(list, playing)->name, TRACK(list, playing)->username, time_buffer);
-		state_set_title(new_title);
-		rcs_unref(new_title);
+	char time_buffer[TIME_BUFFER_SIZE];
+	snprint_ftime(time_buffer, TIME_BUFFER_SIZE, track->duration);
 
-		state_set_current_playback(state_get_current_playback_list(), playing);
-		tui_submit_action(update_list);
-		sound_play(TRACK(list, playing));
-	}
+	struct rc_string *new_title = rcs_format("Now playing "F_BOLD"%s"F_RESET" by "F_BOLD"%s"F_RESET" (%s)", track->name, track->username, time_buffer);
+	state_set_title(new_title);
+	rcs_unref(new_title);
+
+	tui_submit_action(update_list);
+	sound_play(track);
 }
 
 static void signal_handler(int signo) {
@@ -148,8 +151,15 @@ int main(int argc UNUSED, char **argv) {
 
 	tls_init();
 	tui_init();
+	isearch_init();
+	aio_init();
+	cache_init();
+	if(!descstore_init(config_get_cache_path())) {
+		_err("failed to open the store of descriptions, keeping descriptions in memory");
+	}
+	trigram_init(config_get_search_descriptions());
 	downloader_init();
-	sound_init(tui_update_time);
+	sound_init(play_next_track);
 
 	// start drawing on screen
 	state_set_status(cline_default, "");
@@ -160,12 +170,19 @@ int main(int argc UNUSED, char **argv) {
 
 	struct track_list *list_stream = soundcloud_get_stream();
 	list_stream->name = strdup("Stream");
+
+	// tracks retrieved later on (see cmd_pl_refresh()) are inserted in front: make room before pointing to any track
+	if(!track_list_reserve_front(list_stream, STREAM_REFRESH_HEADROOM, NULL)) {
+		_err("failed to reserve room for refreshing the stream");
+	}
 	state_add_list(list_stream);
 
 	ONLY_DEBUG( track_list_dump_mem_usage(list_stream); )
 
+	// the bookmarks and user lists are searched once per track of the stream: index them
 	struct track_list *list_bookmark = jspf_read(BOOKMARK_FILE);
 	list_bookmark->name = strdup("Bookmarks");
+	track_list_index(list_bookmark);
 	track_list_href_to(list_bookmark, list_stream);
 
 	BENCH_START(SB)
@@ -175,6 +192,10 @@ int main(int argc UNUSED, char **argv) {
 
 		if(cache_track_exists(&list_stream->entries[i])) {
 			list_stream->entries[i].flags |= FLAG_CACHED;
+
+			if(config_get_normalize()) {
+				loudness_queue(&list_stream->entries[i]);
+			}
 		}
 	}
 	BENCH_STOP(SB, "Searching for bookmarks")
@@ -197,6 +218,7 @@ int main(int argc UNUSED, char **argv) {
 			e->d_name[strlen(e->d_name) - 5] = '\0';
 			list->name = strdup(e->d_name);
 
+			track_list_index(list);
 			track_list_href_to(list, list_stream);
 			state_add_list(list);
 		}
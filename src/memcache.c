@@ -0,0 +1,235 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file memcache.c
+ *  \brief Implementation of the in-memory tier of the cache
+ *
+ *  The entries form a doubly linked list, ordered from the most to the least recently used one.
+ *  As the budget allows for a few dozen tracks at most, lookups simply walk the list.
+ */
+
+#include "_hard_config.h"
+#include "memcache.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for memcpy, strerror
+//\endcond
+
+#include "helper.h"                     // for lmalloc
+#include "log.h"                        // for _log
+
+struct memcache_entry {
+	int    user_id;
+	int    track_id;
+	char  *data;
+	size_t size;
+	unsigned int refs;            ///< The number of references obtained via memcache_get(), never evicted if > 0
+
+	struct memcache_entry *prev;  ///< The next more recently used entry
+	struct memcache_entry *next;  ///< The next less recently used entry
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct memcache_entry *head = NULL; ///< The most recently used entry
+static struct memcache_entry *tail = NULL; ///< The least recently used entry
+
+static size_t budget = 0;
+static struct memcache_stats stats = { .hits = 0 };
+
+static void memcache_finalize(void);
+
+static void memcache_unlink(struct memcache_entry *entry) {
+	if(entry->prev) entry->prev->next = entry->next;
+	else            head = entry->next;
+
+	if(entry->next) entry->next->prev = entry->prev;
+	else            tail = entry->prev;
+}
+
+static void memcache_link_head(struct memcache_entry *entry) {
+	entry->prev = NULL;
+	entry->next = head;
+
+	if(head) head->prev = entry;
+	else     tail = entry;
+	head = entry;
+}
+
+/** \brief Find the entry of `track` and mark it as the most recently used one (requires `mutex`) */
+static struct memcache_entry* memcache_find(struct track *track) {
+	for(struct memcache_entry *entry = head; entry; entry = entry->next) {
+		if(entry->track_id == track->track_id && entry->user_id == track->user_id) {
+			memcache_unlink(entry);
+			memcache_link_head(entry);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/** \brief Evict unreferenced entries, least recently used first, until `size` more bytes fit (requires `mutex`)
+ *
+ *  The entries evicted are unlinked only: they are to be freed via memcache_free() once `mutex` is released.
+ *
+ *  \param size     The number of bytes to fit
+ *  \param evicted  Set to the entries evicted (linked via `next`), `NULL` if none
+ *  \return         `true` if `size` more bytes fit into the budget
+ */
+static bool memcache_make_room(size_t size, struct memcache_entry **evicted) {
+	*evicted = NULL;
+
+	// do not evict anything if referenced entries prevent `size` bytes from fitting anyway
+	size_t referenced = 0;
+	for(struct memcache_entry *entry = head; entry; entry = entry->next) {
+		if(entry->refs) referenced += entry->size;
+	}
+	if(referenced + size > budget) {
+		return false;
+	}
+
+	struct memcache_entry *entry = tail;
+	while(entry && stats.bytes + size > budget) {
+		struct memcache_entry *prev = entry->prev;
+		if(!entry->refs) {
+			memcache_unlink(entry);
+			stats.bytes -= entry->size;
+			stats.entries--;
+			stats.evictions++;
+
+			entry->next = *evicted;
+			*evicted = entry;
+		}
+		entry = prev;
+	}
+
+	return stats.bytes + size <= budget;
+}
+
+/** \brief Free a list of entries (linked via `next`) */
+static void memcache_free(struct memcache_entry *entry) {
+	while(entry) {
+		struct memcache_entry *next = entry->next;
+		free(entry->data);
+		free(entry);
+		entry = next;
+	}
+}
+
+void memcache_init(size_t _budget) {
+	budget = _budget;
+
+	if(atexit(memcache_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+}
+
+bool memcache_put(struct track *track, const void *data, size_t size) {
+	if(size > budget) {
+		return false;
+	}
+
+	pthread_mutex_lock(&mutex);
+	const bool held = (NULL != memcache_find(track));
+	pthread_mutex_unlock(&mutex);
+	if(held) {
+		return true;
+	}
+
+	// allocate and copy without holding `mutex`: memcache_get() (p.x. by sound_play()) never waits for a copy
+	struct memcache_entry *entry = lmalloc(sizeof(struct memcache_entry));
+	char *copy = lmalloc(size);
+	if(!entry || !copy) {
+		free(entry);
+		free(copy);
+		return false;
+	}
+	memcpy(copy, data, size);
+
+	entry->user_id  = track->user_id;
+	entry->track_id = track->track_id;
+	entry->data     = copy;
+	entry->size     = size;
+	entry->refs     = 0;
+
+	// the track may have been put meanwhile: do not evict anything for a duplicate
+	struct memcache_entry *evicted = NULL;
+	pthread_mutex_lock(&mutex);
+	const bool duplicate = (NULL != memcache_find(track));
+	const bool linked    = !duplicate && memcache_make_room(size, &evicted);
+	if(linked) {
+		memcache_link_head(entry);
+		stats.bytes += size;
+		stats.entries++;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	memcache_free(evicted);
+	if(!linked) {
+		free(copy);
+		free(entry);
+	}
+
+	return duplicate || linked;
+}
+
+char* memcache_get(struct track *track, size_t *size) {
+	char *data = NULL;
+
+	pthread_mutex_lock(&mutex);
+	struct memcache_entry *entry = memcache_find(track);
+	if(entry) {
+		entry->refs++;
+		data  = entry->data;
+		*size = entry->size;
+		stats.hits++;
+	} else {
+		stats.misses++;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return data;
+}
+
+void memcache_release(const char *data) {
+	pthread_mutex_lock(&mutex);
+	for(struct memcache_entry *entry = head; entry; entry = entry->next) {
+		if(entry->data == data) {
+			entry->refs--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void memcache_get_stats(struct memcache_stats *_stats) {
+	pthread_mutex_lock(&mutex);
+	*_stats = stats;
+	pthread_mutex_unlock(&mutex);
+}
+
+static void memcache_finalize(void) {
+	_log("memory cache: %zu hits, %zu misses, %zu evictions", stats.hits, stats.misses, stats.evictions);
+
+	memcache_free(head);
+	head = NULL;
+	tail = NULL;
+}
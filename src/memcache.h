@@ -0,0 +1,89 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file memcache.h
+ *  \brief In-memory tier of the cache, holding the encoded data of recently played tracks
+ *
+ *  The tracks are kept under a byte budget, evicting the least recently used track first.
+ *  A track currently played is referenced (see memcache_get()) and never evicted.
+ *
+ *  Tracks are put by the cache writer once downloaded (never by the playback thread). A track played from the
+ *  cache on disk is not copied: its pages stay in the page cache, which serves a replay just as well.
+ *  Tracks are never prefetched as a whole (a hls_stream only prefetches the segments of the track played),
+ *  so there are no prefetched tracks to hold.
+ */
+
+#ifndef _MEMCACHE_H
+	#define _MEMCACHE_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	#include "track.h"                      // for track
+
+	struct memcache_stats {
+		size_t hits;      ///< The number of lookups served from memory
+		size_t misses;    ///< The number of lookups not served from memory
+		size_t evictions; ///< The number of tracks evicted to stay within the budget
+		size_t entries;   ///< The number of tracks currently held
+		size_t bytes;     ///< The number of bytes currently held
+	};
+
+	/** \brief Initialize the memory cache
+	 *
+	 *  \param budget  The maximum number of bytes to hold, 0 disables the memory cache
+	 */
+	void memcache_init(size_t budget);
+
+	/** \brief Store (a copy of) the encoded data of a track
+	 *
+	 *  Evicts the least recently used tracks (which are not referenced) to make room for `size` bytes.
+	 *  If the track is already held it is marked as the most recently used one.
+	 *  The data is copied before evicting anything, without blocking memcache_get() meanwhile.
+	 *
+	 *  \param track  The track the data belongs to
+	 *  \param data   The data
+	 *  \param size   The number of bytes in `data`
+	 *  \return       `true` if the track is held afterwards, `false` if it does not fit into the budget
+	 */
+	bool memcache_put(struct track *track, const void *data, size_t size) ATTR(nonnull);
+
+	/** \brief Look up the data of a track, counting a hit or a miss
+	 *
+	 *  The data returned is referenced (and thereby not evicted) until passed to memcache_release().
+	 *
+	 *  \param track  The track to look up
+	 *  \param size   Set to the number of bytes returned
+	 *  \return       The data (not to be modified), `NULL` if the track is not held
+	 */
+	char* memcache_get(struct track *track, size_t *size) ATTR(nonnull);
+
+	/** \brief Release the reference obtained via memcache_get()
+	 *
+	 *  \param data  The data returned by memcache_get()
+	 */
+	void memcache_release(const char *data) ATTR(nonnull);
+
+	/** \brief Get the statistics of the memory cache
+	 *
+	 *  \param stats  The struct to write the statistics to
+	 */
+	void memcache_get_stats(struct memcache_stats *stats) ATTR(nonnull);
+#endif /* _MEMCACHE_H */
@@ -0,0 +1,577 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file pcm.c
+ *  \brief Implements processing of decoded PCM samples
+ */
+
+#include "_hard_config.h"
+#include "pcm.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <math.h>                       // for sin, sqrt, M_PI
+#include <stdlib.h>                     // for free, posix_memalign
+#include <string.h>                     // for memcpy, memmove, memset
+#include <sys/mman.h>                   // for mlock, munlock
+#include <unistd.h>                     // for sysconf, _SC_PAGESIZE
+//\endcond
+
+#include "log.h"                        // for _log, _err
+
+/** \brief The number of fractional bits of the fixed point gain used for int16_t samples
+ *
+ *  Q12 allows gains up to PCM_GAIN_MAX without overflowing the int32_t intermediate results.
+ */
+#define GAIN_FRAC_BITS 12
+
+/** \brief The number of taps of each phase of the resampling filter (has to be a multiple of 8) */
+#define RESAMPLER_TAPS 32
+
+/** \brief The maximum number of phases of the resampling filter
+ *
+ *  The number of phases equals the interpolation factor of the reduced ratio between output and input rate,
+ *  for instance 160 for 44.1kHz to 48kHz or 441 for 32kHz to 44.1kHz.
+ */
+#define RESAMPLER_MAX_PHASES 1024
+
+/** \brief The cutoff frequency of the resampling filter, relative to the nyquist frequency of the lower rate */
+#define RESAMPLER_CUTOFF 0.95
+
+/** \brief The parameter of the kaiser window, controls the stopband attenuation (~80dB) */
+#define RESAMPLER_KAISER_BETA 8.0
+
+typedef int16_t  v8s16 __attribute__((vector_size(16)));
+typedef int32_t  v8s32 __attribute__((vector_size(32)));
+typedef uint16_t v8u16 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+typedef float    v8f32 __attribute__((vector_size(32)));
+
+struct pcm_converter {
+	unsigned int in_channels;
+	float gain;
+
+	/** \brief The interpolation factor of the resampler (0 if in- and output rate match) */
+	unsigned int phases;
+	/** \brief The decimation factor of the resampler */
+	unsigned int step;
+	/** \brief The current phase, in [0; phases) */
+	unsigned int phase;
+	/** \brief The filter coefficients, RESAMPLER_TAPS per phase */
+	float *coeffs;
+
+	/** \brief The planar input samples not yet consumed by the resampler (one buffer per channel) */
+	float *history[PCM_OUTPUT_CHANNELS];
+	size_t history_frames;
+	size_t history_capacity;
+
+	/** \brief The interleaved output of the resampler */
+	float *resampled;
+
+	int16_t *out;
+	size_t out_capacity;
+
+	/** \brief `true` if the buffers are locked in memory (see pcm_converter_lock()) */
+	bool locked;
+};
+
+static inline int16_t clip_s16(int32_t value) {
+	if(value >  INT16_MAX) return INT16_MAX;
+	if(value <  INT16_MIN) return INT16_MIN;
+	return value;
+}
+
+void pcm_gain_s16(int16_t *samples, size_t count, float gain) {
+	const int32_t gain_q = (int32_t) (gain * (1 << GAIN_FRAC_BITS));
+
+	const v8s32 vgain = { gain_q, gain_q, gain_q, gain_q, gain_q, gain_q, gain_q, gain_q };
+	const v8s32 vmax  = { INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX };
+	const v8s32 vmin  = { INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN };
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		v8s16 in;
+		memcpy(&in, &samples[i], sizeof(in));
+
+		v8s32 wide = __builtin_convertvector(in, v8s32);
+		wide = (wide * vgain) >> GAIN_FRAC_BITS;
+
+		// clip: comparisons yield -1 (all bits set) for `true`
+		v8s32 above = wide > vmax;
+		v8s32 below = wide < vmin;
+		wide = (wide & ~above) | (vmax & above);
+		wide = (wide & ~below) | (vmin & below);
+
+		v8s16 out = __builtin_convertvector(wide, v8s16);
+		memcpy(&samples[i], &out, sizeof(out));
+	}
+
+	// the remaining (less than 8) samples
+	for(; i < count; i++) {
+		samples[i] = clip_s16((samples[i] * gain_q) >> GAIN_FRAC_BITS);
+	}
+}
+
+void pcm_gain_f32(float *samples, size_t count, float gain) {
+	const v8f32 vgain = { gain, gain, gain, gain, gain, gain, gain, gain };
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		v8f32 v;
+		memcpy(&v, &samples[i], sizeof(v));
+		v *= vgain;
+		memcpy(&samples[i], &v, sizeof(v));
+	}
+
+	for(; i < count; i++) {
+		samples[i] *= gain;
+	}
+}
+
+void pcm_s16_to_f32(const int16_t *in, float *out, size_t count) {
+	const float scale = 1.0f / 32768.0f;
+	const v8f32 vscale = { scale, scale, scale, scale, scale, scale, scale, scale };
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		v8s16 v;
+		memcpy(&v, &in[i], sizeof(v));
+
+		v8f32 f = __builtin_convertvector(v, v8f32) * vscale;
+		memcpy(&out[i], &f, sizeof(f));
+	}
+
+	for(; i < count; i++) {
+		out[i] = in[i] * scale;
+	}
+}
+
+void pcm_f32_to_s16(const float *in, int16_t *out, size_t count) {
+	const v8f32 vscale = { 32768.0f, 32768.0f, 32768.0f, 32768.0f, 32768.0f, 32768.0f, 32768.0f, 32768.0f };
+	const v8f32 vmax   = { INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX, INT16_MAX };
+	const v8f32 vmin   = { INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN, INT16_MIN };
+
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		v8f32 f;
+		memcpy(&f, &in[i], sizeof(f));
+		f *= vscale;
+
+		// clip before converting, the conversion of out-of-range values is undefined
+		// (comparisons yield -1 for `true`, casts between vectors of the same size reinterpret the bits)
+		v8s32 above = f > vmax;
+		v8s32 below = f < vmin;
+		v8s32 bits  = (v8s32) f;
+		bits = (bits & ~above) | ((v8s32) vmax & above);
+		bits = (bits & ~below) | ((v8s32) vmin & below);
+
+		v8s16 v = __builtin_convertvector(__builtin_convertvector((v8f32) bits, v8s32), v8s16);
+		memcpy(&out[i], &v, sizeof(v));
+	}
+
+	for(; i < count; i++) {
+		float f = in[i] * 32768.0f;
+		if(f > INT16_MAX) f = INT16_MAX;
+		if(f < INT16_MIN) f = INT16_MIN;
+		out[i] = (int16_t) f;
+	}
+}
+
+void pcm_mono_to_stereo_s16(const int16_t *in, int16_t *out, size_t frames) {
+	size_t i = 0;
+	for(; i + 8 <= frames; i += 8) {
+		v8u16 v;
+		memcpy(&v, &in[i], sizeof(v));
+
+		// each 32 bit word holds the sample twice, which is the interleaved stereo frame (regardless of the byte order)
+		v8u32 w = __builtin_convertvector(v, v8u32);
+		w |= w << 16;
+		memcpy(&out[2 * i], &w, sizeof(w));
+	}
+
+	for(; i < frames; i++) {
+		out[2 * i]     = in[i];
+		out[2 * i + 1] = in[i];
+	}
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b) {
+	while(b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/** \brief The modified bessel function of the first kind (order 0), as required by the kaiser window */
+static double bessel_i0(double x) {
+	double sum  = 1.0;
+	double term = 1.0;
+	for(unsigned int k = 1; k < 32; k++) {
+		const double f = x / (2.0 * k);
+		term *= f * f;
+		sum  += term;
+	}
+	return sum;
+}
+
+/** \brief Compute the coefficients of the polyphase filter
+ *
+ *  The filter is a kaiser windowed sinc, its cutoff is placed below the nyquist frequency of the lower rate.
+ *  Phase `p` contains the filter delayed by `p / phases` input samples, each phase is normalized to unity gain.
+ */
+static void resampler_compute_coeffs(float *coeffs, unsigned int phases, unsigned int step) {
+	const double cutoff = 0.5 * RESAMPLER_CUTOFF * (phases < step ? (double) phases / step : 1.0);
+	const double half   = RESAMPLER_TAPS / 2;
+	const double i0beta = bessel_i0(RESAMPLER_KAISER_BETA);
+
+	for(unsigned int p = 0; p < phases; p++) {
+		float *phase = &coeffs[p * RESAMPLER_TAPS];
+
+		double sum = 0;
+		for(unsigned int j = 0; j < RESAMPLER_TAPS; j++) {
+			// distance (in input samples) between tap `j` and the output sample
+			const double t = (half - 1 - j) + (double) p / phases;
+
+			const double x    = 2.0 * cutoff * t;
+			const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+
+			const double r      = t / half;
+			const double window = r * r < 1.0 ? bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - r * r)) / i0beta : 0.0;
+
+			phase[j] = 2.0 * cutoff * sinc * window;
+			sum += phase[j];
+		}
+
+		for(unsigned int j = 0; j < RESAMPLER_TAPS; j++) {
+			phase[j] /= sum;
+		}
+	}
+}
+
+static inline float dot_taps(const float *coeffs, const float *samples) {
+	v8f32 acc = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for(unsigned int j = 0; j < RESAMPLER_TAPS; j += 8) {
+		v8f32 c, x;
+		memcpy(&c, &coeffs[j],  sizeof(c));
+		memcpy(&x, &samples[j], sizeof(x));
+		acc += c * x;
+	}
+	return acc[0] + acc[1] + acc[2] + acc[3] + acc[4] + acc[5] + acc[6] + acc[7];
+}
+
+/** \brief Run the resampler on the samples within the history
+ *
+ *  Consumed samples are removed from the history, keeping RESAMPLER_TAPS - 1 samples of context at most.
+ *
+ *  \return The number of (interleaved) frames written to `converter->resampled`
+ */
+static size_t resampler_run(struct pcm_converter *converter) {
+	size_t pos    = 0;
+	size_t frames = 0;
+
+	while(pos + RESAMPLER_TAPS <= converter->history_frames) {
+		const float *coeffs = &converter->coeffs[converter->phase * RESAMPLER_TAPS];
+
+		for(unsigned int c = 0; c < PCM_OUTPUT_CHANNELS; c++) {
+			converter->resampled[PCM_OUTPUT_CHANNELS * frames + c] = dot_taps(coeffs, &converter->history[c][pos]);
+		}
+		frames++;
+
+		converter->phase += converter->step;
+		pos              += converter->phase / converter->phases;
+		converter->phase %= converter->phases;
+	}
+
+	converter->history_frames -= pos;
+	for(unsigned int c = 0; c < PCM_OUTPUT_CHANNELS; c++) {
+		memmove(converter->history[c], &converter->history[c][pos], converter->history_frames * sizeof(float));
+	}
+
+	return frames;
+}
+
+/** \brief The number of bytes of the pages occupied by a buffer of `size` bytes (at least one page) */
+static size_t converter_pages(size_t size) {
+	const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+	return size ? (size + page_size - 1) / page_size * page_size : page_size;
+}
+
+/** \brief Allocate a zeroed buffer of the converter (or the converter itself), locked in memory if `locked`
+ *
+ *  mlock() works on whole pages and does not nest: each buffer occupies pages of its own, otherwise unlocking one
+ *  buffer would unlock any other buffer sharing a page with it.
+ *
+ *  \return The buffer, `NULL` on failure
+ */
+static void* converter_alloc(bool locked, size_t size) {
+	const size_t pages = converter_pages(size);
+
+	void *ptr;
+	const int err = posix_memalign(&ptr, (size_t) sysconf(_SC_PAGESIZE), pages);
+	if(err) {
+		_err("posix_memalign(%zu): %s", pages, strerror(err));
+		return NULL;
+	}
+
+	if(locked && mlock(ptr, pages)) {
+		_err("mlock: %s", strerror(errno));
+		free(ptr);
+		return NULL;
+	}
+
+	memset(ptr, 0, pages);
+	return ptr;
+}
+
+/** \brief Free a buffer allocated by converter_alloc() */
+static void converter_free(bool locked, void *ptr, size_t size) {
+	if(!ptr) return;
+
+	if(locked) {
+		munlock(ptr, converter_pages(size));
+	}
+	free(ptr);
+}
+
+/** \brief realloc() a buffer of the converter, keeping it locked in memory if the converter is locked
+ *
+ *  \return The buffer, `NULL` on failure (`ptr` is left unmodified)
+ */
+static void* converter_realloc(struct pcm_converter *converter, void *ptr, size_t old_size, size_t size) {
+	if(ptr && converter_pages(size) <= converter_pages(old_size)) {
+		return ptr;
+	}
+
+	void *new_ptr = converter_alloc(converter->locked, size);
+	if(!new_ptr) return NULL;
+
+	if(ptr) {
+		memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+	}
+	converter_free(converter->locked, ptr, old_size);
+	return new_ptr;
+}
+
+/** \brief Grow the buffers of the converter to handle `frames` additional input frames */
+static bool converter_reserve(struct pcm_converter *converter, size_t frames) {
+	const size_t history_frames = converter->phases ? converter->history_frames + frames : 0;
+	size_t out_frames = 0;
+	if(converter->phases) {
+		out_frames = history_frames * converter->phases / converter->step + 1;
+	} else if(1 == converter->in_channels) {
+		out_frames = frames;
+	}
+
+	if(history_frames > converter->history_capacity) {
+		for(unsigned int c = 0; c < PCM_OUTPUT_CHANNELS; c++) {
+			float *history = converter_realloc(converter, converter->history[c], converter->history_capacity * sizeof(float), history_frames * sizeof(float));
+			if(!history) return false;
+			converter->history[c] = history;
+		}
+		converter->history_capacity = history_frames;
+	}
+
+	if(out_frames > converter->out_capacity) {
+		int16_t *out = converter_realloc(converter, converter->out, PCM_OUTPUT_CHANNELS * converter->out_capacity * sizeof(int16_t), PCM_OUTPUT_CHANNELS * out_frames * sizeof(int16_t));
+		if(!out) return false;
+		converter->out = out;
+
+		if(converter->phases) {
+			float *resampled = converter_realloc(converter, converter->resampled, PCM_OUTPUT_CHANNELS * converter->out_capacity * sizeof(float), PCM_OUTPUT_CHANNELS * out_frames * sizeof(float));
+			if(!resampled) return false;
+			converter->resampled = resampled;
+		}
+		converter->out_capacity = out_frames;
+	}
+
+	return true;
+}
+
+struct pcm_converter* pcm_converter_create(unsigned int in_rate, unsigned int in_channels, unsigned int out_rate) {
+	if(!in_rate || !out_rate || (1 != in_channels && 2 != in_channels)) {
+		_log("unsupported input: %uHz, %u channels", in_rate, in_channels);
+		return NULL;
+	}
+
+	struct pcm_converter *converter = converter_alloc(false, sizeof(struct pcm_converter));
+	if(!converter) return NULL;
+
+	converter->in_channels = in_channels;
+	converter->gain        = 1.0f;
+
+	if(in_rate != out_rate) {
+		const unsigned int div = gcd(in_rate, out_rate);
+		converter->phases = out_rate / div;
+		converter->step   = in_rate  / div;
+
+		if(converter->phases > RESAMPLER_MAX_PHASES) {
+			_log("cannot resample from %uHz to %uHz: ratio %u/%u too complex", in_rate, out_rate, converter->phases, converter->step);
+			free(converter);
+			return NULL;
+		}
+
+		converter->coeffs = converter_alloc(false, converter->phases * RESAMPLER_TAPS * sizeof(float));
+		if(!converter->coeffs) {
+			free(converter);
+			return NULL;
+		}
+		resampler_compute_coeffs(converter->coeffs, converter->phases, converter->step);
+
+		if(!converter_reserve(converter, RESAMPLER_TAPS)) {
+			pcm_converter_destroy(converter);
+			return NULL;
+		}
+		pcm_converter_reset(converter);
+
+		_log("resampling %uHz -> %uHz (%u phases, step %u)", in_rate, out_rate, converter->phases, converter->step);
+	}
+
+	return converter;
+}
+
+void pcm_converter_set_gain(struct pcm_converter *converter, float gain) {
+	converter->gain = gain;
+}
+
+size_t pcm_converter_process(struct pcm_converter *converter, int16_t *in, size_t in_bytes, int16_t **out) {
+	const size_t frames = in_bytes / (converter->in_channels * sizeof(int16_t));
+	const bool   gain   = 1.0f < converter->gain || 1.0f > converter->gain;
+
+	if(!converter_reserve(converter, frames)) {
+		*out = NULL;
+		return 0;
+	}
+
+	// no resampling required: at most the channels have to be duplicated
+	if(!converter->phases) {
+		int16_t *samples = in;
+		if(1 == converter->in_channels) {
+			pcm_mono_to_stereo_s16(in, converter->out, frames);
+			samples = converter->out;
+		}
+
+		if(gain) {
+			pcm_gain_s16(samples, PCM_OUTPUT_CHANNELS * frames, converter->gain);
+		}
+
+		*out = samples;
+		return PCM_OUTPUT_CHANNELS * frames * sizeof(int16_t);
+	}
+
+	// append the input to the (planar) history
+	float *left  = &converter->history[0][converter->history_frames];
+	float *right = &converter->history[1][converter->history_frames];
+	if(1 == converter->in_channels) {
+		pcm_s16_to_f32(in, left, frames);
+		memcpy(right, left, frames * sizeof(float));
+	} else {
+		const float scale = 1.0f / 32768.0f;
+		for(size_t i = 0; i < frames; i++) {
+			left[i]  = in[2 * i]     * scale;
+			right[i] = in[2 * i + 1] * scale;
+		}
+	}
+	converter->history_frames += frames;
+
+	const size_t out_frames = resampler_run(converter);
+
+	if(gain) {
+		pcm_gain_f32(converter->resampled, PCM_OUTPUT_CHANNELS * out_frames, converter->gain);
+	}
+	pcm_f32_to_s16(converter->resampled, converter->out, PCM_OUTPUT_CHANNELS * out_frames);
+
+	*out = converter->out;
+	return PCM_OUTPUT_CHANNELS * out_frames * sizeof(int16_t);
+}
+
+void pcm_converter_reset(struct pcm_converter *converter) {
+	if(!converter->phases) return;
+
+	// prime the history with silence, placing the first output sample at the first input sample
+	converter->history_frames = RESAMPLER_TAPS / 2 - 1;
+	converter->phase          = 0;
+	for(unsigned int c = 0; c < PCM_OUTPUT_CHANNELS; c++) {
+		memset(converter->history[c], 0, converter->history_frames * sizeof(float));
+	}
+}
+
+/** \brief The buffers of the converter (including the converter itself), as allocated by converter_alloc() */
+struct converter_buffer {
+	void  *ptr;
+	size_t size;
+};
+
+/** \brief Get the buffers of the converter
+ *
+ *  \return The number of buffers written to `buffers`
+ */
+static size_t converter_buffers(struct pcm_converter *converter, struct converter_buffer buffers[6]) {
+	const struct converter_buffer all[] = {
+		{ converter->history[0], converter->history_capacity * sizeof(float) },
+		{ converter->history[1], converter->history_capacity * sizeof(float) },
+		{ converter->coeffs,     converter->phases * RESAMPLER_TAPS * sizeof(float) },
+		{ converter->resampled,  PCM_OUTPUT_CHANNELS * converter->out_capacity * sizeof(float) },
+		{ converter->out,        PCM_OUTPUT_CHANNELS * converter->out_capacity * sizeof(int16_t) },
+		{ converter,             sizeof(struct pcm_converter) }
+	};
+
+	size_t count = 0;
+	for(size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++) {
+		if(all[i].ptr) {
+			buffers[count++] = all[i];
+		}
+	}
+	return count;
+}
+
+bool pcm_converter_lock(struct pcm_converter *converter) {
+	if(converter->locked) return true;
+
+	struct converter_buffer buffers[6];
+	const size_t count = converter_buffers(converter, buffers);
+
+	for(size_t i = 0; i < count; i++) {
+		if(mlock(buffers[i].ptr, converter_pages(buffers[i].size))) {
+			_err("mlock: %s", strerror(errno));
+
+			// no buffer shares a page with another one: unlocking the ones locked already leaves nothing locked
+			while(i--) {
+				munlock(buffers[i].ptr, converter_pages(buffers[i].size));
+			}
+			return false;
+		}
+	}
+
+	converter->locked = true;
+	return true;
+}
+
+void pcm_converter_destroy(struct pcm_converter *converter) {
+	if(!converter) return;
+
+	struct converter_buffer buffers[6];
+	const size_t count  = converter_buffers(converter, buffers);
+	const bool   locked = converter->locked;
+
+	// the converter itself is the last one
+	for(size_t i = 0; i < count; i++) {
+		converter_free(locked, buffers[i].ptr, buffers[i].size);
+	}
+}
@@ -0,0 +1,136 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file pcm.h
+ *  \brief Processing of decoded PCM samples
+ *
+ *  The kernels use GCC's vector extensions, such that they are vectorized independent of
+ *  the optimization level used.
+ */
+
+#ifndef _PCM_H
+	#define _PCM_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	#include <stdint.h>                     // for int16_t
+	//\endcond
+
+	/** \brief The number of channels of the output (see pcm_converter_create()) */
+	#define PCM_OUTPUT_CHANNELS 2
+
+	/** \brief The maximum gain supported by pcm_gain_s16() (+18dB) */
+	#define PCM_GAIN_MAX 7.9
+
+	/** \brief Apply a gain to signed 16 bit samples (in place), clipping at the limits of int16_t
+	 *
+	 *  \param samples  The samples to modify
+	 *  \param count    The number of samples (*not* frames)
+	 *  \param gain     The linear gain, in `[0; PCM_GAIN_MAX]`
+	 */
+	void pcm_gain_s16(int16_t *samples, size_t count, float gain);
+
+	/** \brief Apply a gain to 32 bit float samples (in place)
+	 *
+	 *  \param samples  The samples to modify
+	 *  \param count    The number of samples (*not* frames)
+	 *  \param gain     The linear gain
+	 */
+	void pcm_gain_f32(float *samples, size_t count, float gain);
+
+	/** \brief Convert signed 16 bit samples to float samples in `[-1; 1)`
+	 *
+	 *  \param in     The samples to convert
+	 *  \param out    The buffer receiving the converted samples
+	 *  \param count  The number of samples
+	 */
+	void pcm_s16_to_f32(const int16_t *in, float *out, size_t count);
+
+	/** \brief Convert float samples to signed 16 bit samples, clipping at the limits of int16_t
+	 *
+	 *  \param in     The samples to convert
+	 *  \param out    The buffer receiving the converted samples
+	 *  \param count  The number of samples
+	 */
+	void pcm_f32_to_s16(const float *in, int16_t *out, size_t count);
+
+	/** \brief Duplicate the single channel of mono samples to both channels of stereo
+	 *
+	 *  \param in      The mono samples
+	 *  \param out     The buffer receiving `2 * frames` (interleaved) samples
+	 *  \param frames  The number of frames
+	 */
+	void pcm_mono_to_stereo_s16(const int16_t *in, int16_t *out, size_t frames);
+
+	/** \brief Converts decoded samples of any (supported) format to the single output format
+	 *
+	 *  The output format is fixed for the whole session: signed 16 bit, stereo, at a given rate.
+	 *  Samples of any other rate are converted using a polyphase resampler.
+	 */
+	struct pcm_converter;
+
+	/** \brief Create a converter
+	 *
+	 *  \param in_rate      The rate of the input
+	 *  \param in_channels  The number of channels of the input (1 or 2)
+	 *  \param out_rate     The rate of the output
+	 *  \return             The converter, `NULL` if the conversion is not supported
+	 */
+	struct pcm_converter* pcm_converter_create(unsigned int in_rate, unsigned int in_channels, unsigned int out_rate);
+
+	/** \brief Set the gain applied while converting
+	 *
+	 *  \param converter  The converter
+	 *  \param gain       The linear gain, in `[0; PCM_GAIN_MAX]`
+	 */
+	void pcm_converter_set_gain(struct pcm_converter *converter, float gain);
+
+	/** \brief Convert samples
+	 *
+	 *  If no conversion is required the input samples are modified in place and returned.
+	 *
+	 *  \param converter  The converter
+	 *  \param in         The interleaved signed 16 bit input samples
+	 *  \param in_bytes   The number of bytes in `in`
+	 *  \param out        Set to the buffer containing the output (valid until the next call)
+	 *  \return           The number of bytes in `out`
+	 */
+	size_t pcm_converter_process(struct pcm_converter *converter, int16_t *in, size_t in_bytes, int16_t **out);
+
+	/** \brief Discard the history of the converter (e.g. after seeking)
+	 *
+	 *  \param converter  The converter
+	 */
+	void pcm_converter_reset(struct pcm_converter *converter);
+
+	/** \brief Lock the buffers of the converter in memory (including any buffer grown later on)
+	 *
+	 *  Avoids page faults while converting, for instance in a realtime playback thread.
+	 *
+	 *  \param converter  The converter
+	 *  \return           `true` on success, `false` if `mlock` failed (e.g. due to `RLIMIT_MEMLOCK`), leaving no buffer locked
+	 */
+	bool pcm_converter_lock(struct pcm_converter *converter);
+
+	/** \brief Destroy the converter
+	 *
+	 *  \param converter  The converter to destroy (may be `NULL`)
+	 */
+	void pcm_converter_destroy(struct pcm_converter *converter);
+#endif /* _PCM_H */
@@ -21,25 +21,38 @@
 #include "sound.h"
 
 //\cond
-#include <assert.h>
 #include <errno.h>                      // for errno
+#include <math.h>                       // for pow, sqrt
 #include <pthread.h>                    // for pthread_create, etc
+#include <sched.h>                      // for sched_param, SCHED_FIFO, CPU_SET, etc
 #include <semaphore.h>                  // for sem_post, sem_wait, etc
 #include <stddef.h>                     // for NULL, size_t
+#include <stdio.h>                      // for snprintf
+#include <stdint.h>                     // for int16_t, intptr_t
 #include <stdlib.h>                     // for free, atexit
-#include <string.h>                     // for memcpy, strerror
-#include <sys/types.h>                  // for off_t, ssize_t
-#include <unistd.h>                     // for SEEK_SET, SEEK_CUR, etc
+#include <string.h>                     // for strerror, memcpy
+#include <sys/mman.h>                   // for mlock
+#include <sys/resource.h>               // for getrusage, setpriority
+#include <sys/syscall.h>                // for SYS_gettid
+#include <sys/types.h>                  // for off_t
+#include <time.h>                       // for clock_gettime, timespec
+#include <unistd.h>                     // for syscall
 //\endcond
 
 #include <mpg123.h>                     // for mpg123_strerror, etc
 
 #include "audio/ao_module.h"            // for ao_module_load, etc
-#include "cache.h"                      // for cache_track_get, etc
-#include "config.h"                     // for config_get_equalizer
+#include "cache.h"                      // for cache_track_get, cache_writer_open, etc
+#include "config.h"                     // for config_get_audio_module, etc
+#include "decoder.h"                    // for decoder_open, etc
 #include "downloader.h"                 // for download_state, etc
 #include "helper.h"                     // for lmalloc
+#include "hls.h"                        // for hls_stream_open, hls_stream_interrupt, etc
 #include "log.h"                        // for _log
+#include "loudness.h"                   // for loudness_init, loudness_queue
+#include "memcache.h"                   // for memcache_get, memcache_put, etc
+#include "pcm.h"                        // for pcm_converter_create, etc
+#include "soundcloud.h"                 // for soundcloud_get_hls_url
 #include "state.h"                      // for state_set_volume
 #include "track.h"                      // for track, etc
 
@@ -47,16 +60,22 @@ static char *aos[] = {"audio/alsa.so", "audio/ao.so", NULL};
 
 #define SEEKPOS_NONE ((unsigned int) ~0)
 
-static audio_init_t          audio_init          = NULL;
-static audio_set_format_t    audio_set_format    = NULL;
-static audio_get_volume_t    audio_get_volume    = NULL;
-static audio_change_volume_t audio_change_volume = NULL;
-static audio_play_t          audio_play          = NULL;
+/** \brief The length (in ms) of the windows the throughput of a download is sampled in */
+#define JITTER_WINDOW_MS 250
 
-struct io_handle {
-	size_t                 position;       //< the current position
-	struct download_state *download_state; //< contains the maximum (currently possible) position
-};
+/** \brief The pre-roll is increased up to this factor (of the configured pre-roll) for slow or varying downloads */
+#define JITTER_MAX_FACTOR 4.0
+
+/** \brief Playback stalls (and rebuffers) if less than this number of ms is buffered ahead of the decoder */
+#define JITTER_LOW_WATERMARK_MS 250
+
+/** \brief The bitrate (in bit/s) assumed if the header of the first frame cannot be parsed */
+#define JITTER_DEFAULT_BITRATE 128000
+
+/** \brief The nice value of the playback thread, if the configured realtime scheduler is not permitted */
+#define PLAYBACK_FALLBACK_NICE -10
+
+static struct ao_module ao = { NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
 static sem_t sem_stopped;
 static pthread_t thread_play; // thread decoding and playing downloaded data
@@ -70,134 +89,474 @@ static volatile bool         terminate   = false;
 
 static struct download_state *state = NULL;
 
-static void (*time_callback)(int);
+/** \brief The data of the current track, if served from the memory cache (released by sound_stop()) */
+static char *state_memcache = NULL;
+
+/** \brief The mapping of the current track, if served from the cache on disk */
+static struct mmapped_file state_mapped = { .data = NULL };
+
+/** \brief `true` if the current track is to be streamed via HLS (instead of reading from `state`) */
+static bool play_hls = false;
+
+/** \brief The hls_stream of the current track (if any), protected by `hls_mutex`, interrupted by sound_stop() */
+static struct hls_stream *hls_current = NULL;
+static pthread_mutex_t    hls_mutex   = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief The gain applied to the samples of the current track (normalization) */
+static float playback_gain = 1.0;
+
+/** \brief The rate of the output, set once on playback of the first track (0 until then) */
+static unsigned int output_rate = 0;
+
+/** \brief The throughput of the current download
+ *
+ *  The throughput is sampled in windows of JITTER_WINDOW_MS (by the downloading thread), its mean and variance
+ *  are updated using Welford's online algorithm. Only the chunks of `source` are sampled: a download of another
+ *  track (p.x. one still running after skipping it) does not affect the statistics.
+ */
+static struct {
+	pthread_mutex_t mutex;
+	const struct download_state *source; ///< the download sampled, `NULL` if none
+	bool            sampling;     ///< `true` once the first chunk of `source` started the first window
+	struct timespec window_start;
+	size_t          window_bytes; ///< bytes_recvd at the start of the current window
+	size_t          samples;      ///< the number of windows sampled
+	double          mean;         ///< the mean throughput (in bytes/s)
+	double          m2;           ///< the sum of the squared differences from the mean
+} throughput = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/** \brief The state of the jitter buffer of the current track (only accessed by the playback thread) */
+struct jitter_buffer {
+	unsigned int bitrate;     ///< the estimated bitrate (in bit/s), 0 if not yet known
+	size_t       audio_start; ///< the offset of the first frame (behind an ID3v2 tag)
+	bool         buffering;   ///< `true` if decoding waits for the buffer to fill
+	unsigned int stalls;      ///< the number of times playback stalled
+};
+
+/** \brief The values of an equalizer, handed over to the playback thread as a whole */
+struct equalizer {
+	double bands[EQUALIZER_SIZE];
+};
+
+/** \brief The equalizer set most recently via sound_set_equalizer() (only accessed by the caller of sound_set_equalizer*(),
+ *         the playback thread only uses the copies published via `equalizer_pending`) */
+static double equalizer_bands[EQUALIZER_SIZE];
+
+/** \brief The equalizer published for the playback thread, but not yet applied (`NULL` if there is none) */
+static struct equalizer *equalizer_pending = NULL;
+
+/** \brief The equalizer applied by the playback thread (only accessed by the playback thread) */
+static struct equalizer *equalizer_active = NULL;
+
+/** \brief Converts the decoded samples of the current track to the format of the output */
+static struct pcm_converter *converter = NULL;
+
+static void (*done_callback)(void);
 
 static void sound_finalize(void);
 
-static void _io_await_recvd_size(struct download_state *dlstat, size_t recvd) {
-	bool io_have_data = false;
-	do {
-		pthread_mutex_lock(&dlstat->io_mutex);
-		io_have_data = (recvd < dlstat->bytes_recvd);
-		if(!io_have_data) {
-			pthread_cond_wait(&dlstat->io_cond, &dlstat->io_mutex);
-			io_have_data = (recvd < dlstat->bytes_recvd);
-		}
-		pthread_mutex_unlock(&dlstat->io_mutex);
-	} while(!io_have_data);
+static double ms_between(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / (1000.0 * 1000.0);
 }
 
-static ssize_t _io_read(void *_iohandle, void *mpg123buffer, size_t count) {
-	struct io_handle *iohandle    = (struct io_handle*) _iohandle;
-	struct download_state *dlstat = iohandle->download_state;
-
-	size_t bytes_copied = 0;
-	if(iohandle->position >= dlstat->bytes_total - 4096) {
-		size_t bytes_available = dlstat->bytes_total - iohandle->position;
-		bytes_copied = count < bytes_available ? count : bytes_available;
+/** \brief Drop the statistics sampled so far and start sampling another download (`throughput.mutex` held)
+ *
+ *  \param source  The download to sample from now on, `NULL` to stop sampling
+ */
+static void throughput_clear(const struct download_state *source) {
+	throughput.source       = source;
+	throughput.sampling     = false;
+	throughput.window_bytes = 0;
+	throughput.samples      = 0;
+	throughput.mean         = 0;
+	throughput.m2           = 0;
+}
 
-		memcpy(mpg123buffer, &dlstat->buffer[iohandle->position], bytes_copied);
-		iohandle->position += bytes_copied;
-	} else {
-		_io_await_recvd_size(dlstat, iohandle->position + count);
+/** \brief Start sampling the download of the track to play, dropping the statistics of the previous one
+ *
+ *  \param source  The download
+ */
+static void throughput_reset(const struct download_state *source) {
+	pthread_mutex_lock(&throughput.mutex);
+	throughput_clear(source);
+	pthread_mutex_unlock(&throughput.mutex);
+}
 
-		size_t bytes_available = 0;
-		if(dlstat->bytes_recvd > iohandle->position) {
-			bytes_available = dlstat->bytes_recvd - iohandle->position;
-		}
-		bytes_copied = count < bytes_available ? count : bytes_available;
+/** \brief Stop sampling a download, unless sampling another one already (p.x. the one of the next track)
+ *
+ *  \param source  The download
+ */
+static void throughput_stop(const struct download_state *source) {
+	pthread_mutex_lock(&throughput.mutex);
+	if(source == throughput.source) {
+		throughput_clear(NULL);
+	}
+	pthread_mutex_unlock(&throughput.mutex);
+}
 
-		memcpy(mpg123buffer, &dlstat->buffer[iohandle->position], bytes_copied);
-		iohandle->position += bytes_copied;
+/** \brief Sample the throughput of a download (called for each chunk received)
+ *
+ *  \param source       The download, ignored unless it is the one sampled (see throughput_reset())
+ *  \param bytes_recvd  The number of bytes received in total
+ */
+static void throughput_sample(const struct download_state *source, size_t bytes_recvd) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	pthread_mutex_lock(&throughput.mutex);
+	if(source != throughput.source) {
+		pthread_mutex_unlock(&throughput.mutex);
+		return;
 	}
 
-	if(bytes_copied < count) {
-		_log("WARNING: %zu bytes at position %zu requested, but can only deliver %zu bytes", count, iohandle->position, bytes_copied);
+	// the first window starts with the first chunk received since the reset
+	if(!throughput.sampling) {
+		throughput.sampling     = true;
+		throughput.window_start = now;
+		throughput.window_bytes = bytes_recvd;
+		pthread_mutex_unlock(&throughput.mutex);
+		return;
 	}
 
-	return bytes_copied;
+	const double elapsed = ms_between(&throughput.window_start, &now);
+	if(elapsed >= JITTER_WINDOW_MS) {
+		const double sample = (bytes_recvd - throughput.window_bytes) * 1000.0 / elapsed;
+
+		throughput.samples++;
+		const double delta = sample - throughput.mean;
+		throughput.mean += delta / throughput.samples;
+		throughput.m2   += delta * (sample - throughput.mean);
+
+		throughput.window_start = now;
+		throughput.window_bytes = bytes_recvd;
+	}
+	pthread_mutex_unlock(&throughput.mutex);
 }
 
-static off_t _io_seek(void *_iohandle, off_t offset, int whence) {
-	struct io_handle *iohandle    = (struct io_handle*) _iohandle;
-	struct download_state *dlstat = iohandle->download_state;
-
-	// downloading needs to be started at least, as we need to know the bytes available in total
-	_io_await_recvd_size(dlstat, 0);
-
-	size_t abs_offset = 0;
-	switch(whence) {
-		case SEEK_SET: assert(offset >= 0);  abs_offset = offset; break;
-		case SEEK_CUR: abs_offset = iohandle->position  + offset; break;
-		case SEEK_END: abs_offset = dlstat->bytes_total + offset; break;
-		default: {
-			_err("invalid value for whence: %i", whence);
-			return (off_t) -1;
-		}
+/** \brief Estimate the bitrate of a MP3 from the header of its first frame
+ *
+ *  A leading ID3v2 tag is skipped. If the header is invalid (or uses the `free` bitrate) JITTER_DEFAULT_BITRATE is assumed.
+ *
+ *  \param data         The beginning of the MP3
+ *  \param size         The number of bytes available in `data`
+ *  \param bitrate      Set to the bitrate (in bit/s)
+ *  \param audio_start  Set to the offset of the first frame
+ *  \return             `true` on success, `false` if more data is required
+ */
+static bool mp3_estimate_bitrate(const unsigned char *data, size_t size, unsigned int *bitrate, size_t *audio_start) {
+	static const unsigned short kbps[][15] = {
+		{ 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 }, // MPEG 1, layer I
+		{ 0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384 }, // MPEG 1, layer II
+		{ 0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320 }, // MPEG 1, layer III
+		{ 0, 32, 48, 56,  64,  80,  96, 112, 128, 144, 160, 176, 192, 224, 256 }, // MPEG 2/2.5, layer I
+		{ 0,  8, 16, 24,  32,  40,  48,  56,  64,  80,  96, 112, 128, 144, 160 }  // MPEG 2/2.5, layer II & III
+	};
+
+	size_t offset = 0;
+	if(size < 10) return false;
+	if('I' == data[0] && 'D' == data[1] && '3' == data[2]) {
+		// the size of the tag is stored as syncsafe integer (7 bits per byte), excluding the header (and footer)
+		offset = 10 + ((data[6] & 0x7f) << 21 | (data[7] & 0x7f) << 14 | (data[8] & 0x7f) << 7 | (data[9] & 0x7f));
+		if(data[5] & 0x10) offset += 10;
 	}
 
-	if(abs_offset > dlstat->bytes_total) {
-		_err("cannot seek to %zu, only have at max. %zu bytes", abs_offset, dlstat->bytes_total);
-		return (off_t) -1;
+	if(size < offset + 4) return false;
+	*audio_start = offset;
+	*bitrate     = JITTER_DEFAULT_BITRATE;
+
+	const unsigned char *header = &data[offset];
+	const unsigned int version = (header[1] >> 3) & 0x03; // 3: MPEG 1, 2: MPEG 2, 0: MPEG 2.5
+	const unsigned int layer   = (header[1] >> 1) & 0x03; // 3: layer I, 2: layer II, 1: layer III
+	const unsigned int index   = header[2] >> 4;
+
+	if(0xff != header[0] || 0xe0 != (header[1] & 0xe0) || 1 == version || !layer || !index || 15 == index) {
+		_log("no valid frame header at offset %zu, assuming %ukbit/s", offset, JITTER_DEFAULT_BITRATE / 1000);
+		return true;
 	}
 
-	iohandle->position = abs_offset;
-	return abs_offset;
-}
+	const unsigned int table = (3 == version) ? 3 - layer : (3 == layer ? 3 : 4);
+	*bitrate = kbps[table][index] * 1000;
 
-static void _io_cleanup(void *iohandle) {
-	free(iohandle);
-	_log("cleanup called");
+	return true;
 }
 
-/** \brief Reinitialize libmpg123
+/** \brief Returns the number of bytes to buffer ahead of the decoder before playback starts/resumes
  *
- *  \return  A pointer to the new handle (or NULL in case of failure)
+ *  The configured pre-roll is increased if the throughput of the download varies (by its coefficient of variation)
+ *  and if the download is slower than playback, up to JITTER_MAX_FACTOR.
+ *
+ *  \param bitrate  The bitrate of the track (in bit/s)
  */
-static mpg123_handle* mpg123_init_playback(struct download_state *download_state) {
-	mpg123_handle *mh = mpg123_new(NULL, NULL);
-	if(!mh) {
-		_err("mpg123_new");
-		return NULL;
+static size_t jitter_preroll_bytes(unsigned int bitrate) {
+	const double consumption = bitrate / 8.0; // bytes/s
+	const double base        = config_get_jitter_preroll();
+	double preroll = base;
+
+	pthread_mutex_lock(&throughput.mutex);
+	if(throughput.samples >= 2 && throughput.mean > 0) {
+		const double stddev = sqrt(throughput.m2 / (throughput.samples - 1));
+		preroll *= 1.0 + stddev / throughput.mean;
+
+		if(throughput.mean < consumption) {
+			preroll *= consumption / throughput.mean;
+		}
 	}
+	pthread_mutex_unlock(&throughput.mutex);
 
-	if(MPG123_OK != mpg123_replace_reader_handle(mh, _io_read, _io_seek, _io_cleanup)) {
-		_err("mpg123_replace_reader_handle: %s", mpg123_strerror(mh));
-		return NULL;
+	if(preroll > base * JITTER_MAX_FACTOR) {
+		preroll = base * JITTER_MAX_FACTOR;
 	}
 
-	struct io_handle *iohandle = lmalloc( sizeof(struct io_handle) );
-	iohandle->position       = 0;
-	iohandle->download_state = download_state;
+	return preroll * consumption;
+}
 
-	if(MPG123_OK != mpg123_open_handle(mh, iohandle)) {
-		_err("mpg123_open_handle: %s", mpg123_strerror(mh));
-		free(iohandle);
-		return NULL;
+/** \brief Wait for the download, until enough data is buffered ahead of the decoder
+ *
+ *  Playback starts only if the pre-roll (see jitter_preroll_bytes()) is buffered. If less than
+ *  JITTER_LOW_WATERMARK_MS are buffered while playing, playback stalls until the pre-roll is buffered again.
+ *  Avoids blocking the reader (and thereby stuttering) on every single frame.
+ *
+ *  \param jitter   The jitter buffer of the current track
+ *  \param decoder  The decoder of the current track
+ *  \return         `true` if decoding may continue, `false` if waiting was interrupted (stop, seek, ...)
+ */
+static bool jitter_buffer_fill(struct jitter_buffer *jitter, struct decoder *decoder) {
+	struct download_state *dlstat = decoder->state;
+
+	// a hls_stream prefetches its segments on its own
+	if(!dlstat || config_get_jitter_preroll() <= 0) {
+		return true;
 	}
 
-	if(MPG123_OK != mpg123_param(mh, MPG123_FLAGS, MPG123_QUIET, 0.0)) {
-		_err("mpg123_param: %s", mpg123_strerror(mh));
-		free(iohandle);
-		return NULL;
+	while(!terminate && !stopped && SEEKPOS_NONE == seek_to_pos) {
+		pthread_mutex_lock(&dlstat->io_mutex);
+		const size_t recvd = dlstat->bytes_recvd;
+		const size_t total = dlstat->bytes_total;
+		const bool   ready = (NULL != dlstat->buffer);
+		pthread_mutex_unlock(&dlstat->io_mutex);
+
+		// download finished (or file from cache): nothing to wait for
+		if(total && recvd >= total) {
+			jitter->buffering = false;
+			return true;
+		}
+
+		if(ready && !jitter->bitrate && mp3_estimate_bitrate((unsigned char*) dlstat->buffer, recvd, &jitter->bitrate, &jitter->audio_start)) {
+			_log("estimated bitrate: %ukbit/s", jitter->bitrate / 1000);
+		}
+
+		if(jitter->bitrate) {
+			size_t position = decoder_input_position(decoder);
+			if(position < jitter->audio_start) {
+				position = jitter->audio_start;
+			}
+			const size_t ahead = recvd > position ? recvd - position : 0;
+
+			if(!jitter->buffering) {
+				if(ahead * 8 * 1000 >= (size_t) jitter->bitrate * JITTER_LOW_WATERMARK_MS) {
+					return true;
+				}
+
+				jitter->buffering = true;
+				jitter->stalls++;
+				_log("playback stalled (%zu bytes buffered), rebuffering", ahead);
+			}
+
+			const size_t preroll = jitter_preroll_bytes(jitter->bitrate);
+			if(ahead >= preroll) {
+				_log("buffered %zu bytes (%.1fs), starting playback", ahead, ahead * 8.0 / jitter->bitrate);
+				jitter->buffering = false;
+				return true;
+			}
+		}
+
+		// wait for the next chunk (but check for stop/seek regularly)
+		struct timespec timeout;
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_nsec += JITTER_WINDOW_MS * 1000l * 1000l;
+		if(timeout.tv_nsec >= 1000l * 1000l * 1000l) {
+			timeout.tv_sec++;
+			timeout.tv_nsec -= 1000l * 1000l * 1000l;
+		}
+
+		pthread_mutex_lock(&dlstat->io_mutex);
+		if(dlstat->bytes_recvd == recvd) {
+			pthread_cond_timedwait(&dlstat->io_cond, &dlstat->io_mutex, &timeout);
+		}
+		pthread_mutex_unlock(&dlstat->io_mutex);
 	}
 
-	// set the new values for the equalizer obtained from configuration
-	for(int i = 0; i < EQUALIZER_SIZE; i++) {
-		mpg123_eq(mh, MPG123_LR, i, config_get_equalizer(i));
+	return false;
+}
+
+/** \brief Called by the cache writer once a downloaded track is stored to the cache (or storing it failed)
+ *
+ *  Keeps the complete track in memory as well: copying it is left to the writer thread, which just read all of it.
+ */
+static void cache_done_callback(struct track *track, const char *buffer, size_t size, bool success) {
+	if(buffer) {
+		memcache_put(track, buffer, size);
 	}
 
-	return mh;
+	if(success) {
+		track->flags |= FLAG_CACHED;
+
+		if(config_get_normalize()) {
+			loudness_queue(track);
+		}
+	}
 }
 
+/** \brief Called by the download thread for each chunk received
+ *
+ *  The chunks are written through to the cache by the cache writer, never blocking the download thread on I/O.
+ */
 static void io_callback(struct download_state *dlstate) {
 	struct track *track = dlstate->track;
 
+	// the track is incomplete: do not leave the writer waiting for the remaining data
+	if(dlstate->failed) {
+		if(dlstate->cache_writer) {
+			cache_writer_abort(dlstate->cache_writer);
+			dlstate->cache_writer = NULL;
+		}
+		return;
+	}
+
+	throughput_sample(dlstate, dlstate->bytes_recvd);
+
+	if(!dlstate->cache_writer_opened && dlstate->buffer) {
+		dlstate->cache_writer_opened = true;
+		dlstate->cache_writer = cache_writer_open(track, dlstate->buffer, dlstate->bytes_total, cache_done_callback);
+	}
+
+	if(dlstate->cache_writer) {
+		cache_writer_append(dlstate->cache_writer, dlstate->bytes_recvd);
+	}
+
 	if(dlstate->bytes_recvd == dlstate->bytes_total) {
-		_log("download of `%s` is finished, saving track to cache", track->name);
-		if(cache_track_save(track, (void*) dlstate->buffer, dlstate->bytes_recvd)) {
-			track->flags |= FLAG_CACHED;
+		_log("download of `%s` is finished", track->name);
+		dlstate->cache_writer = NULL;
+	}
+}
+
+/** \brief Apply a pending equalizer to the decoder (if any)
+ *
+ *  Called by the playback thread between two frames, taking the pending equalizer is a single pointer swap.
+ *
+ *  \param decoder  The decoder of the current track
+ *  \param opened   `true` if the decoder was just opened: the active equalizer is applied even if none is pending
+ */
+static void equalizer_update(struct decoder *decoder, bool opened) {
+	struct equalizer *pending = __atomic_exchange_n(&equalizer_pending, NULL, __ATOMIC_ACQ_REL);
+	if(pending) {
+		free(equalizer_active);
+		equalizer_active = pending;
+	}
+
+	if(equalizer_active && (pending || opened)) {
+		decoder_set_equalizer(decoder, equalizer_active->bands);
+	}
+}
+
+/** \brief Apply the configured scheduling policy, CPU affinity and memory locking to the playback thread
+ *
+ *  Called by the playback thread itself. Failing to apply any of these is not fatal: the playback
+ *  thread falls back to a nice value (if a realtime policy is not permitted) or to the defaults.
+ *
+ *  The playback thread is the output thread as well: it writes the samples via `ao.audio_play()`, which
+ *  blocks until the output accepts them. The only thread of an output module, the volume watcher of
+ *  the ALSA module, is left as it is: it only reacts to changes of the mixer and is not part of the
+ *  path of the samples, running it under a realtime policy would just take time from the playback.
+ */
+static void sound_setup_thread(void) {
+	const int policy = config_get_playback_policy();
+	if(SCHED_OTHER != policy) {
+		int priority = config_get_playback_priority();
+		if(priority < sched_get_priority_min(policy)) priority = sched_get_priority_min(policy);
+		if(priority > sched_get_priority_max(policy)) priority = sched_get_priority_max(policy);
+
+		struct sched_param param = { .sched_priority = priority };
+		int err = pthread_setschedparam(pthread_self(), policy, &param);
+		if(err) {
+			_log("pthread_setschedparam(%s, %i): %s, using nice value instead", SCHED_FIFO == policy ? "SCHED_FIFO" : "SCHED_RR", priority, strerror(err));
+			if(setpriority(PRIO_PROCESS, syscall(SYS_gettid), PLAYBACK_FALLBACK_NICE)) {
+				_log("setpriority(%i): %s, using default priority", PLAYBACK_FALLBACK_NICE, strerror(errno));
+			}
+		} else {
+			_log("playback thread: %s, priority %i", SCHED_FIFO == policy ? "SCHED_FIFO" : "SCHED_RR", priority);
+		}
+	}
+
+	if(config_get_playback_cpu_count()) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for(size_t i = 0; i < config_get_playback_cpu_count(); i++) {
+			const int cpu = config_get_playback_cpu(i);
+			if(0 <= cpu && cpu < CPU_SETSIZE) {
+				CPU_SET(cpu, &cpus);
+			} else {
+				_err("invalid cpu %i for playback thread", cpu);
+			}
 		}
+
+		int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if(err) {
+			_err("pthread_setaffinity_np: %s", strerror(err));
+		}
+	}
+
+	// the stack is limited to PLAYBACK_STACK_SIZE if it is to be locked (see sound_init())
+	if(config_get_playback_mlock()) {
+		pthread_attr_t attr;
+		void  *stack;
+		size_t stack_size;
+		if(!pthread_getattr_np(pthread_self(), &attr)) {
+			if(!pthread_attr_getstack(&attr, &stack, &stack_size) && mlock(stack, stack_size)) {
+				_err("mlock: %s", strerror(errno));
+			}
+			pthread_attr_destroy(&attr);
+		}
+	}
+}
+
+/** \brief Open the hls_stream of `track` and make it interruptible by sound_stop()
+ *
+ *  \param track  The track to stream
+ *  \return       The stream, `NULL` in case of failure
+ */
+static struct hls_stream* sound_open_hls(struct track *track) {
+	char *url = soundcloud_get_hls_url(track);
+	if(!url) {
+		_err("no hls playlist for `%s`", track->name);
+		return NULL;
+	}
+
+	struct hls_stream *stream = hls_stream_open(url);
+	free(url);
+
+	if(stream) {
+		pthread_mutex_lock(&hls_mutex);
+		hls_current = stream;
+		// sound_stop() sets `stopped` prior to looking at `hls_current`
+		if(stopped || terminate) {
+			hls_stream_interrupt(stream);
+		}
+		pthread_mutex_unlock(&hls_mutex);
+	}
+
+	return stream;
+}
+
+/** \brief Log the page faults taken by the calling thread since `start`
+ *
+ *  \param start  The usage of the calling thread at the start of the playback
+ *  \param secs   The number of seconds played since `start`
+ */
+static void sound_log_faults(const struct rusage *start, unsigned int secs) {
+	struct rusage now;
+	if(!getrusage(RUSAGE_THREAD, &now)) {
+		_log("playback start: %ld major, %ld minor page faults within %us", now.ru_majflt - start->ru_majflt, now.ru_minflt - start->ru_minflt, secs);
 	}
 }
 
@@ -207,6 +566,8 @@ static void io_callback(struct download_state *dlstate) {
 *  \return NULL   Unused return value, required due to pthread interface
 */
 static void* _thread_play_function(void *unused UNUSED) {
+	sound_setup_thread();
+
 	do {
 		_log("waiting for playback");
 		sem_wait(&sem_play);
@@ -216,76 +577,180 @@ static void* _thread_play_function(void *unused UNUSED) {
 			return NULL;
 		}
 
-		mpg123_handle *mh = mpg123_init_playback(state);
+		// sound_play() of the next track (within done_callback()) replaces `state_mapped` and `state`
+		const struct mmapped_file mapped = state_mapped;
+		const struct download_state *source = state;
+
+		// instrument the start of the playback: the page faults taken by this thread within the first seconds
+		struct rusage usage_start;
+		bool report_faults = !getrusage(RUSAGE_THREAD, &usage_start);
+		unsigned int start_pos = ~0;
+
+		struct hls_stream *hls = NULL;
+		struct decoder *decoder;
+		if(play_hls) {
+			hls     = sound_open_hls(state->track);
+			decoder = hls ? decoder_open_hls(hls, NULL) : NULL;
+		} else {
+			decoder = decoder_open(state, reader_callback, NULL, false);
+		}
 
 		unsigned int last_reported_pos = ~0;
 
-		bool playback_done = false;
+		// the converter only handles signed 16 bit input
+		bool playback_done = !decoder || !decoder_set_encoding(decoder, MPG123_ENC_SIGNED_16);
+
+		if(decoder) {
+			equalizer_update(decoder, true);
+		}
 
 		size_t done;
-		off_t frame_offset;
 		unsigned char *audio = NULL;
 
+		struct jitter_buffer jitter = { .bitrate = 0, .audio_start = 0, .buffering = true, .stalls = 0 };
+
 		while(!terminate && !stopped && !playback_done) {
-			int err = mpg123_decode_frame(mh, &frame_offset, &audio, &done);
+			// do seeking to specified position if required
+			if(SEEKPOS_NONE != seek_to_pos) {
+				// do not play the samples queued before seeking
+				if(decoder_seek(decoder, seek_to_pos)) {
+					// read the data following the new position in the background, instead of faulting page by page
+					file_advise_willneed(mapped, decoder_input_position(decoder), FILE_WILLNEED_SIZE);
+
+					if(ao.audio_drop) {
+						ao.audio_drop();
+					}
+					if(converter) {
+						pcm_converter_reset(converter);
+					}
+				}
+
+				// reset seek_to_pos to avoid seeking multiple times
+				seek_to_pos = SEEKPOS_NONE;
+			}
+
+			equalizer_update(decoder, false);
+
+			if(!jitter_buffer_fill(&jitter, decoder)) {
+				continue;
+			}
+
+			int err = decoder_decode_frame(decoder, &audio, &done);
 			switch(err) {
 				case MPG123_NEW_FORMAT: {
 					int channels, encoding;
 					long rate;
 
-					mpg123_getformat(mh, &rate, &channels, &encoding);
-					audio_set_format(encoding, rate, channels);
+					mpg123_getformat(decoder->mh, &rate, &channels, &encoding);
+
+					// the output is configured once, any format of the input is converted to the format of the output
+					if(!output_rate) {
+						output_rate = config_get_output_rate() ? config_get_output_rate() : (unsigned int) rate;
+						_log("configuring output: %uHz, %u channels", output_rate, PCM_OUTPUT_CHANNELS);
+						if(!ao.audio_set_format(MPG123_ENC_SIGNED_16, output_rate, PCM_OUTPUT_CHANNELS)) {
+							// configure the output again for the next track
+							_err("cannot configure the output to %uHz, %u channels", output_rate, PCM_OUTPUT_CHANNELS);
+							output_rate = 0;
+							playback_done = true;
+							done_callback();
+							break;
+						}
+					}
+
+					pcm_converter_destroy(converter);
+					converter = pcm_converter_create(rate, channels, output_rate);
+					if(!converter) {
+						_err("cannot convert %liHz, %i channels to the format of the output", rate, channels);
+						playback_done = true;
+						done_callback();
+						break;
+					}
+					pcm_converter_set_gain(converter, playback_gain);
+					if(config_get_playback_mlock()) {
+						pcm_converter_lock(converter);
+					}
 					break;
 				}
 
-				case MPG123_OK:
-					audio_play(audio, done);
+				case MPG123_OK: {
+					int16_t *samples;
+					size_t bytes = pcm_converter_process(converter, (int16_t*) audio, done, &samples);
+					if(bytes) {
+						ao.audio_play(samples, bytes);
+					}
 
-					unsigned int current_pos = (unsigned int) (mpg123_tpf(mh) * mpg123_tellframe(mh));
-					// only report position of playback if it has changed
-					// meant to reduce the number of redraws possibly issued by time_callback
+					// publish the position, the tui samples it on its own (never block on drawing here)
+					unsigned int current_pos = decoder_position(decoder);
 					if(current_pos != last_reported_pos) {
 						last_reported_pos = current_pos;
 
-						time_callback(current_pos);
+						// sampled here (once per second) to be shown along with the time
+						struct audio_stats output_stats;
+						if(sound_get_output_stats(&output_stats)) {
+							state_set_output_stats(output_stats.xruns, output_stats.delay_ms);
+						}
 						state_set_current_time(current_pos);
 					}
+
+					if(~0u == start_pos) {
+						start_pos = current_pos;
+					}
+					if(report_faults && current_pos >= start_pos + PLAYBACK_START_SECS) {
+						sound_log_faults(&usage_start, current_pos - start_pos);
+						report_faults = false;
+					}
 					break;
+				}
 
 				case MPG123_DONE:
 					playback_done = true;
-					time_callback(-1);
+					// an interrupted hls_stream ends prematurely, but the playback is not done
+					if(!stopped && !terminate) {
+						done_callback();
+					}
 					break;
 
 				default:
 					_err("mpg123_decode_frame: %i - %s", err, mpg123_plain_strerror(err));
 					break;
 			}
+		}
 
-			// do seeking to specified position if required
-			if(SEEKPOS_NONE != seek_to_pos) {
-				off_t target_frame_off = mpg123_timeframe(mh, seek_to_pos);
-				if(0 > target_frame_off) {
-					_err("cannot get offset for time %us: %s", seek_to_pos, mpg123_strerror(mh));
-				} else {
-					_log("requested seek to %us, frame at %zi", seek_to_pos, target_frame_off);
-					if(0 > mpg123_seek_frame(mh, target_frame_off, SEEK_SET)) {
-						_err("mpg123_seek_frame: %s", mpg123_strerror(mh));
-					}
-				}
+		if(report_faults && ~0u != start_pos) {
+			sound_log_faults(&usage_start, last_reported_pos > start_pos ? last_reported_pos - start_pos : 0);
+		}
 
-				// reset seek_to_pos to avoid seeking multiple times
-				seek_to_pos = SEEKPOS_NONE;
-			}
+		decoder_close(decoder);
+
+		if(hls) {
+			pthread_mutex_lock(&hls_mutex);
+			hls_current = NULL;
+			pthread_mutex_unlock(&hls_mutex);
+
+			hls_stream_close(hls);
+		}
+
+		pcm_converter_destroy(converter);
+		converter = NULL;
+
+		if(jitter.stalls) {
+			_log("playback stalled %u times", jitter.stalls);
 		}
 
-		if(mh) {
-			mpg123_close(mh);
-			mpg123_delete(mh);
+		// the download of the track may continue, but it does not feed the jitter buffer of the next track
+		throughput_stop(source);
+
+		struct audio_stats stats;
+		if(sound_get_output_stats(&stats)) {
+			_log("output: %u xruns, delay: %ums (period: %lu, buffer: %lu frames)", stats.xruns, stats.delay_ms, stats.period_size, stats.buffer_size);
 		}
-		mh = NULL;
 
 		if(stopped) {
+			// pausing should be audible immediately (but do not cut the end of a track finished regularly)
+			if(ao.audio_drop && !playback_done) {
+				ao.audio_drop();
+			}
+
 			sem_post(&sem_stopped);
 		}
 	} while(!terminate);
@@ -293,25 +758,45 @@ static void* _thread_play_function(void *unused UNUSED) {
 	return NULL;
 }
 
-bool sound_init(void (*_time_callback)(int)) {
+bool sound_init(void (*_done_callback)(void)) {
+	// use the soundsystem requested by the user, if any
+	char *module = config_get_audio_module();
+	if(module) {
+		char lib[256];
+		snprintf(lib, sizeof(lib), "audio/%s.so", module);
+		if(!ao_module_load(lib, &ao)) {
+			_err("failed to load the configured soundsystem `%s`, probing the available ones", module);
+		}
+	}
+
 	// find the correct soundsystem to use
-	for(unsigned int i = 0; aos[i]; i++) {
-		if(ao_module_load(aos[i], &audio_init, &audio_play, &audio_set_format, &audio_get_volume, &audio_change_volume))
+	for(unsigned int i = 0; !ao.audio_init && aos[i]; i++) {
+		if(ao_module_load(aos[i], &ao))
 			break;
 	}
 
-	if(!audio_init) {
+	if(!ao.audio_init) {
 		_err("failed to load any soundsystem");
 		return false;
 	}
 
-	time_callback = _time_callback;
+	done_callback = _done_callback;
+
+	memcache_init(config_get_memory_cache_size());
 
-	audio_init();
-	if(audio_get_volume)
-		state_set_volume(audio_get_volume());
+	// handed over to the playback thread like any other equalizer (played without one if malloc fails)
+	sound_set_equalizer(config_get_equalizer_preset(""));
+
+	ao.audio_init();
+	if(ao.audio_get_volume)
+		state_set_volume(ao.audio_get_volume());
 
 	mpg123_init();
+	decoder_init();
+
+	if(config_get_normalize()) {
+		loudness_init();
+	}
 
 	if(sem_init(&sem_play, 0, 0)) {
 		_err("sem_init: %s", strerror(errno));
@@ -320,7 +805,18 @@ bool sound_init(void (*_time_callback)(int)) {
 
 	sem_init(&sem_stopped, 0, 0);
 
-	pthread_create(&thread_play, NULL, _thread_play_function, NULL);
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	if(config_get_playback_mlock()) {
+		pthread_attr_setstacksize(&attr, PLAYBACK_STACK_SIZE);
+	}
+
+	int err = pthread_create(&thread_play, &attr, _thread_play_function, NULL);
+	pthread_attr_destroy(&attr);
+	if(err) {
+		_err("pthread_create: %s", strerror(err));
+		return false;
+	}
 
 	if(atexit(sound_finalize)) {
 		_err("atexit: %s", strerror(errno));
@@ -330,11 +826,46 @@ bool sound_init(void (*_time_callback)(int)) {
 }
 
 int sound_change_volume(off_t delta) {
-	if(!audio_change_volume) {
+	if(!ao.audio_change_volume) {
 		return -1;
 	}
 
-	return audio_change_volume(delta);
+	return ao.audio_change_volume(delta);
+}
+
+bool sound_set_equalizer(const double *bands) {
+	struct equalizer *eq = lmalloc(sizeof(struct equalizer));
+	if(!eq) {
+		return false;
+	}
+
+	memcpy(eq->bands, bands, sizeof(eq->bands));
+	memcpy(equalizer_bands, bands, sizeof(equalizer_bands));
+
+	// replaces an equalizer not yet taken by the playback thread
+	free(__atomic_exchange_n(&equalizer_pending, eq, __ATOMIC_ACQ_REL));
+
+	return true;
+}
+
+bool sound_set_equalizer_band(unsigned int band, double value) {
+	if(band >= EQUALIZER_SIZE) {
+		return false;
+	}
+
+	double bands[EQUALIZER_SIZE];
+	memcpy(bands, equalizer_bands, sizeof(bands));
+	bands[band] = value;
+
+	return sound_set_equalizer(bands);
+}
+
+bool sound_get_output_stats(struct audio_stats *stats) {
+	if(!ao.audio_get_stats) {
+		return false;
+	}
+
+	return ao.audio_get_stats(stats);
 }
 
 static void sound_finalize(void) {
@@ -343,10 +874,19 @@ static void sound_finalize(void) {
 	_log("waiting for threads to terminate...");
 
 	_log("thread_play...");
+	pthread_mutex_lock(&hls_mutex);
+	if(hls_current) {
+		hls_stream_interrupt(hls_current);
+	}
+	pthread_mutex_unlock(&hls_mutex);
 	sem_post(&sem_play);
 	pthread_join(thread_play, NULL);
 
+	free(equalizer_active);
+	free(equalizer_pending);
+
 	// cleanup libmpg123
+	decoder_finalize();
 	mpg123_exit();
 
 	ao_module_unload();
@@ -362,6 +902,13 @@ bool sound_stop(void) {
 
 	stopped = true;
 
+	// do not wait for the segments of a hls_stream
+	pthread_mutex_lock(&hls_mutex);
+	if(hls_current) {
+		hls_stream_interrupt(hls_current);
+	}
+	pthread_mutex_unlock(&hls_mutex);
+
 	// if stop() is called by the thread doing the playback,
 	// for instance caused by the `time_callback`, then we may not block
 	if(pthread_self() != thread_play) {
@@ -374,6 +921,12 @@ bool sound_stop(void) {
 	}
 	state = NULL;
 
+	if(state_memcache) {
+		memcache_release(state_memcache);
+		state_memcache = NULL;
+	}
+	state_mapped.data = NULL;
+
 	stopped = false;
 
 	return true;
@@ -388,9 +941,48 @@ bool sound_play(struct track *track) {
 	if(state) sound_stop();
 
 	seek_to_pos = (0 != track->current_position) ? track->current_position : SEEKPOS_NONE;
+	state_set_current_time(track->current_position);
+
+	playback_gain = 1.0;
+	if(config_get_normalize()) {
+		double loudness;
+		if(cache_track_get_loudness(track, &loudness)) {
+			playback_gain = pow(10.0, (config_get_normalize_target() - loudness) / 20.0);
+			if(playback_gain > PCM_GAIN_MAX) {
+				playback_gain = PCM_GAIN_MAX;
+			}
+			_log("normalizing '%s': %.2f LUFS, gain: %.3f", track->name, loudness, playback_gain);
+		}
+	}
+
+	// look up the memory cache first, then the cache on disk and finally fall back to the network
+	size_t memcache_size;
+	char *memcache_data = memcache_get(track, &memcache_size);
+
+	struct memcache_stats mcstats;
+	memcache_get_stats(&mcstats);
+	_log("memory cache %s for '%s' (%zu hits, %zu misses, %zu tracks, %zu bytes)", memcache_data ? "hit" : "miss", track->name, mcstats.hits, mcstats.misses, mcstats.entries, mcstats.bytes);
+
+	struct mmapped_file cache_track = { .data = NULL };
+	if(!memcache_data) {
+		cache_track = cache_track_get(track);
+	}
+
+	if(memcache_data) {
+		struct download_state *mstate = downloader_create_state(track);
+		if(!mstate) {
+			memcache_release(memcache_data);
+			return false;
+		}
 
-	struct mmapped_file cache_track = cache_track_get(track);
-	if(cache_track.data) {
+		mstate->bytes_recvd = memcache_size;
+		mstate->bytes_total = memcache_size;
+		mstate->buffer      = memcache_data;
+
+		state          = mstate;
+		state_memcache = memcache_data;
+		play_hls       = false;
+	} else if(cache_track.data) {
 		_log("using file from cache for '%s' by '%s'", track->name, track->username);
 
 		struct download_state *cstate = downloader_create_state(track);
@@ -400,14 +992,26 @@ bool sound_play(struct track *track) {
 
 		cstate->bytes_recvd = cache_track.size;
 		cstate->bytes_total = cache_track.size;
-		cstate->buffer      = cache_track.data;
+		cstate->buffer      = (char*) (intptr_t) cache_track.data;
+
+		state        = cstate;
+		state_mapped = cache_track;
+		play_hls     = false;
+	} else if(config_get_hls()) {
+		_log("streaming '%s' by '%s' via hls", track->name, track->username);
 
-		state = cstate;
+		state = downloader_create_state(track);
+		if(!state) {
+			return false;
+		}
+		play_hls = true;
 	} else {
+		play_hls = false;
 		state = downloader_queue_buffer(track, io_callback);
 		if(!state) {
 			return false;
 		}
+		throughput_reset(state);
 	}
 	sem_post(&sem_play);
 
@@ -23,6 +23,7 @@
 	#include <stdbool.h>                    // for bool
 	#include <sys/types.h>
 	//\endcond
+	#include "audio/ao_module.h"            // for audio_stats
 	#include "track.h"
 
 	/** \brief Global initialization of sound.
@@ -30,10 +31,12 @@
 	 *  This function is required to be called prior to the first call sound_play() and does several internal
 	 *  initializations.
 	 *
-	 *  \param time_callback  callback function receiving the elapsed seconds as parameter
+	 *  The position of the playback is published via state_set_current_time().
+	 *
+	 *  \param done_callback  callback function called (by the playback thread) once playback of a track is done
 	 *  \return               true in case of success, false otherwise
 	 */
-	bool sound_init(void (*time_callback)(int));
+	bool sound_init(void (*done_callback)(void));
 
 	/** \brief Start playback of track
 	 *
@@ -59,6 +62,31 @@
 	 */
 	int sound_change_volume(off_t delta);
 
+	/** \brief Set the equalizer
+	 *
+	 *  The equalizer is applied to the currently playing track (starting with the next frame decoded),
+	 *  and to all tracks played afterwards.
+	 *
+	 *  \param bands  The EQUALIZER_SIZE factors, `1.0` denotes `no change in volume`
+	 *  \return       `true` on success, `false` otherwise
+	 */
+	bool sound_set_equalizer(const double *bands) ATTR(nonnull);
+
+	/** \brief Set a single band of the equalizer, keeping the remaining bands
+	 *
+	 *  \param band   The band to set, in `[0; EQUALIZER_SIZE)`
+	 *  \param value  The new factor of the band
+	 *  \return       `true` on success, `false` otherwise (e.g. invalid band)
+	 */
+	bool sound_set_equalizer_band(unsigned int band, double value);
+
+	/** \brief Get the statistics of the output (xruns, delay, ...)
+	 *
+	 *  \param stats  The struct to write the statistics to
+	 *  \return       `true` on success, `false` if the AO module does not support statistics
+	 */
+	bool sound_get_output_stats(struct audio_stats *stats);
+
 	/** \brief Stop playback of current track
 	 *
 	 *  \return true in case of success, false otherwise
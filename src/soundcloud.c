@@ -38,93 +38,121 @@
 #include "url.h"                        // for url, url_destroy, etc
 #include "network/tls.h"
 #include "config.h"
+#include "descstore.h"                  // for descstore_put
 #include "state.h"
+#include "strpool.h"                    // for strpool_intern, strpool_unref
 #include "yajl_helper.h"                // for yajl_helper_get_string, etc
 
 #define CLIENTID_GET    "client_id="SC_API_KEY
 #define GET_RQ_FULL     "https://api.soundcloud.com/users/%s/tracks.json?limit=200&linked_partitioning=1&"CLIENTID_GET
 #define GET_RQ_SUBSCRIB "https://api.soundcloud.com/users/%s/followings.json?"CLIENTID_GET
+#define GET_RQ_STREAMS  "https://api.soundcloud.com/tracks/%i/streams?"CLIENTID_GET
 
 struct track_list* soundcloud_get_stream(void) {
 	state_set_status(cline_default, "Info: Connecting to soundcloud.com");
 	struct network_conn *nwc = tls_connect(SERVER_NAME, SERVER_PORT);
 
-	const size_t lists_size = config_get_subscribe_count() + 1;
-	struct track_list *lists[lists_size];
-	lists[lists_size - 1] = NULL;
+	struct track_list *lists[config_get_subscribe_count() + 1];
+	size_t list_count = 0;
 
 	char status_msg[1024];
 	for(size_t i = 0; i < config_get_subscribe_count(); i++) {
 		snprintf(status_msg, sizeof(status_msg), "Info: Retrieving %zu/%zu lists from soundcloud.com: "F_BOLD"%s"F_RESET, i, config_get_subscribe_count(), config_get_subscribe(i));
 		state_set_status(cline_default, status_msg);
 
-		lists[i] = soundcloud_get_entries(nwc, config_get_subscribe(i));
+		struct track_list *user_list = soundcloud_get_entries(nwc, config_get_subscribe(i));
+		if(user_list) {
+			lists[list_count++] = user_list;
+		}
 	}
+	lists[list_count] = NULL;
 	state_set_status(cline_default, "Info: Merging lists");
 
 	if(nwc) {
 		nwc->disconnect(nwc);
 	}
 
+	// each list is sorted already (most recent track first), see soundcloud_get_entries()
 	BENCH_START(MP)
-	struct track_list* list = track_list_merge(lists);
-	track_list_sort(list);
+	struct track_list* list = track_list_merge_sorted(lists);
 	BENCH_STOP(MP, "Merging playlists")
 
+	for(size_t i = 0; i < list_count; i++) {
+		track_list_destroy(lists[i], false);
+	}
+	return list;
+}
+
+struct track_list* soundcloud_get_stream_update(void) {
+	struct network_conn *nwc = tls_connect(SERVER_NAME, SERVER_PORT);
+	if(!nwc) {
+		return NULL;
+	}
+
+	struct track_list *lists[config_get_subscribe_count() + 1];
+	size_t list_count = 0;
+
+	bool success = true;
 	for(size_t i = 0; i < config_get_subscribe_count(); i++) {
-		if(lists[i]) {
-			track_list_destroy(lists[i], false);
+		struct track_list *user_list = soundcloud_get_new_entries(nwc, config_get_subscribe(i));
+		if(user_list) {
+			lists[list_count++] = user_list;
+		} else {
+			success = false;
 		}
 	}
+	lists[list_count] = NULL;
+
+	nwc->disconnect(nwc);
+
+	// the new tracks of a user are retrieved once only: keep the ones retrieved, even if any other user failed
+	struct track_list *list = track_list_merge_sorted(lists);
+	if(!success) {
+		_err("failed to retrieve the new tracks of %zu/%zu users", config_get_subscribe_count() - list_count, config_get_subscribe_count());
+	}
+
+	for(size_t i = 0; i < list_count; i++) {
+		track_list_destroy(lists[i], false);
+	}
 	return list;
 }
 
-/** \brief Parse a single part of a response from soundcloud.com
- *
- *  \param [in]  resp  The response to be parsed (expected to be valid JSON)
- *  \param [out] href  A pointer to a string containing the URL of the subsequent http request
- *  \returns           A list containing all the tracks from `resp` or `NULL` if an allocation failes
- */
-static struct track_list* parse_single_response(char *resp, char **href) {
+bool soundcloud_parse_response(char *resp, char **href, struct track_list_builder *builder) {
 	// in case any allocation failes we do not have any reference
 	*href = NULL;
 
 	yajl_val node = yajl_helper_parse(resp);
-	if(!node) return NULL;
-
-	struct track_list *list = lcalloc(1, sizeof(struct track_list));
-	if(!list) {
-		yajl_tree_free(node);
-		return NULL;
-	}
+	if(!node) return false;
 
 	yajl_val array = yajl_helper_get_array(node, "collection", NULL);
 	if(array) {
-		list->count = array->u.array.len;
-		list->entries = lcalloc(list->count + 1, sizeof(struct track));
-		if(!list->entries) {
-			free(list);
-			yajl_tree_free(node);
-			return NULL;
-		}
-
 		for(size_t i = 0; i < array->u.array.len; i++) {
+			struct track *track = track_list_builder_add(builder);
+			if(!track) {
+				yajl_tree_free(node);
+				return false;
+			}
 
-			list->entries[i].name          = yajl_helper_get_string(array->u.array.values[i], "title",         NULL);
-			list->entries[i].stream_url    = yajl_helper_get_string(array->u.array.values[i], "stream_url",    NULL);
-			list->entries[i].download_url  = yajl_helper_get_string(array->u.array.values[i], "download_url",  NULL);
-			list->entries[i].permalink_url = yajl_helper_get_string(array->u.array.values[i], "permalink_url", NULL);
-			list->entries[i].username      = yajl_helper_get_string(array->u.array.values[i], "user", "username");
-			list->entries[i].description   = yajl_helper_get_string(array->u.array.values[i], "description",   NULL);
+			track->name          = yajl_helper_get_interned(array->u.array.values[i], "title",         NULL);
+			track->stream_url    = yajl_helper_get_interned(array->u.array.values[i], "stream_url",    NULL);
+			track->download_url  = yajl_helper_get_interned(array->u.array.values[i], "download_url",  NULL);
+			track->permalink_url = yajl_helper_get_interned(array->u.array.values[i], "permalink_url", NULL);
+			track->username      = yajl_helper_get_interned(array->u.array.values[i], "user", "username");
 
-			list->entries[i].user_id       = yajl_helper_get_int   (array->u.array.values[i], "user", "id");
-			list->entries[i].track_id      = yajl_helper_get_int   (array->u.array.values[i], "id", NULL);
+			track->user_id       = yajl_helper_get_int     (array->u.array.values[i], "user", "id");
+			track->track_id      = yajl_helper_get_int     (array->u.array.values[i], "id", NULL);
 
-			list->entries[i].duration      = yajl_helper_get_int   (array->u.array.values[i], "duration", NULL) / 1000;
+			// the description is kept in memory only if it cannot be stored
+			const char *description = yajl_helper_peek_string(array->u.array.values[i], "description", NULL);
+			if(!descstore_put(track->track_id, description)) {
+				track->description = yajl_helper_get_interned(array->u.array.values[i], "description", NULL);
+			}
+
+			track->duration      = yajl_helper_get_int     (array->u.array.values[i], "duration", NULL) / 1000;
 
-			list->entries[i].url_count     = URL_COUNT_UNINITIALIZED;
+			track->url_count     = URL_COUNT_UNINITIALIZED;
 
-			char *date_str = yajl_helper_get_string(array->u.array.values[i], "created_at", NULL);
+			const char *date_str = yajl_helper_peek_string(array->u.array.values[i], "created_at", NULL);
 			if(date_str) {
 				struct tm ctime = { 0 };
 				char *remaining = strptime(date_str, "%Y/%m/%d %H:%M:%S %z", &ctime);
@@ -132,18 +160,17 @@ static struct track_list* parse_single_response(char *resp, char **href) {
 					_err("strptime: %s", (NULL == remaining ? "have remaining string" : strerror(errno)));
 				}
 
-				list->entries[i].created_at = mktime(&ctime);
-				free(date_str);
+				track->created_at = mktime(&ctime);
 			}
 
-			list->entries[i].flags |= FLAG_NEW;
+			track->flags |= FLAG_NEW;
 		}
 	}
 
 	*href = yajl_helper_get_string(node, "next_href", NULL);
 
 	yajl_tree_free(node);
-	return list;
+	return true;
 }
 
 struct subscription* soundcloud_get_subscriptions(char *user) {
@@ -184,31 +211,87 @@ struct subscription* soundcloud_get_subscriptions(char *user) {
 	return list;
 }
 
-struct track_list* soundcloud_get_entries(struct network_conn *nwc, char *user) {
-	assert(NULL != nwc  && "nwc may not be null here");
-	assert(NULL != user && "user may not be null here");
+/** \brief The creation time of the most recent track known per user (see soundcloud_get_new_entries()) */
+struct soundcloud_newest {
+	const char *user;                ///< The user, interned (see strpool.h)
+	time_t      created_at;
+	struct soundcloud_newest *next;
+};
+
+static struct soundcloud_newest *newest = NULL;
+
+static void soundcloud_finalize(void) {
+	while(newest) {
+		struct soundcloud_newest *next = newest->next;
+		strpool_unref(newest->user);
+		free(newest);
+		newest = next;
+	}
+}
 
-	char *cache_path = config_get_cache_path();
-	char cache_file[strlen(cache_path) + 1 + strlen(CACHE_LIST_FOLDER) + 1 + strlen(user) + strlen(CACHE_LIST_EXT) + 1];
-	sprintf(cache_file, "%s/"CACHE_LIST_FOLDER"/%s"CACHE_LIST_EXT, cache_path, user);
-	struct track_list* cache_tracks = jspf_read(cache_file);
+static struct soundcloud_newest* soundcloud_find_newest(const char *user) {
+	// the entries hold a reference to their user: the string interned stays valid if found
+	char *interned = strpool_intern(user);
+	struct soundcloud_newest *entry = newest;
+	while(entry && interned != entry->user) {
+		entry = entry->next;
+	}
+	strpool_unref(interned);
+	return entry;
+}
+
+/** \brief Remember the creation time of the most recent track of `list` (if more recent than the one known) for `user` */
+static void soundcloud_set_newest(const char *user, struct track_list *list) {
+	struct soundcloud_newest *entry = soundcloud_find_newest(user);
+	if(!entry) {
+		entry = lcalloc(1, sizeof(struct soundcloud_newest));
+		if(!entry) {
+			return;
+		}
+
+		if(!newest && atexit(soundcloud_finalize)) {
+			_err("atexit: %s", strerror(errno));
+		}
+
+		entry->user = strpool_intern(user);
+		entry->next = newest;
+		newest = entry;
+	}
 
+	for(size_t i = 0; i < list->count; i++) {
+		if(TRACK(list, i)->created_at > entry->created_at) {
+			entry->created_at = TRACK(list, i)->created_at;
+		}
+	}
+}
+
+/** \brief The name of the file caching the tracks of `user`, allocated via malloc */
+static char* soundcloud_cache_file(const char *user) {
+	return smprintf("%s/"CACHE_LIST_FOLDER"/%s"CACHE_LIST_EXT, config_get_cache_path(), user);
+}
+
+/** \brief Request the tracks of `user` created after `created_after` (0: all tracks), adding them to a list being built
+ *
+ *  \return `true` on success, `false` otherwise (the tracks of the pages received before are added nevertheless)
+ */
+static bool soundcloud_fetch(struct network_conn *nwc, const char *user, time_t created_after, struct track_list_builder *builder) {
 	char created_at_from_string[256] = { 0 };
-	if(cache_tracks->count) {
-		time_t t = cache_tracks->entries[0].created_at + 1;
+	if(created_after) {
+		time_t t = created_after + 1;
 
 		strftime(created_at_from_string, sizeof(created_at_from_string), "%Y-%m-%d%%20%T", localtime(&t)); // TODO: localtime!?
 		//_log("most recent track created at %s (user: `%s`)", created_at_from_string, user);
 	}
 
-	struct track_list *list = NULL;
 	char request_url[strlen(GET_RQ_FULL) + strlen(user) + 256 + strlen(created_at_from_string) + 1];
-	if(cache_tracks->count) {
+	if(created_after) {
 		sprintf(request_url, GET_RQ_FULL"&created_at[from]=%s", user, created_at_from_string);
 	} else {
 		sprintf(request_url, GET_RQ_FULL, user);
 	}
 
+	bool success = true;
+
 	char *href = request_url;
 	do {
 		struct url *u = url_parse_string(href);
@@ -225,46 +308,117 @@ struct track_list* soundcloud_get_entries(struct network_conn *nwc, char *user)
 
 		if(!resp) { // check if communication succeeded (sc.com down / no network)
 			_err("communication failed");
-
-			track_list_destroy(list, true);
-			list = NULL;
+			success = false;
 		} else if(200 != resp->http_status) { // check HTTP-status code
 			_err("server returned unexpected http status code %i", resp->http_status);
 			_err("make sure the user you subscribed to is valid!");
-
-			track_list_destroy(list, true);
-			list = NULL;
-		} else {
-			struct track_list *next_part = parse_single_response(resp->body, &href);
-
-			if(list) {
-				track_list_append(list, next_part);
-			} else {
-				list = next_part;
-			}
+			success = false;
+		} else if(!soundcloud_parse_response(resp->body, &href, builder)) {
+			_err("failed to parse response");
+			success = false;
 		}
 
 		http_response_destroy(resp);
 	} while(href);
 
-	_log("%4zu/%4zu tracks from cache/soundcloud.com for %s", cache_tracks->count, list ? list->count : 0, user);
+	return success;
+}
+
+struct track_list* soundcloud_get_entries(struct network_conn *nwc, char *user) {
+	assert(NULL != nwc  && "nwc may not be null here");
+	assert(NULL != user && "user may not be null here");
+
+	char *cache_file = soundcloud_cache_file(user);
+	if(!cache_file) {
+		return NULL;
+	}
+
+	// new tracks are appended to the cache (see jspf_append()): the most recent ones are not necessarily read first
+	struct track_list* cache_tracks = jspf_read(cache_file);
+	track_list_sort(cache_tracks);
+
+	// all pages are parsed into the very same region, followed by the tracks from the cache
+	struct track_list_builder builder = { .region = NULL };
+	const bool success = soundcloud_fetch(nwc, user, cache_tracks->count ? cache_tracks->entries[0].created_at : 0, &builder);
+	const size_t received = builder.count;
+
+	_log("%4zu/%4zu tracks from cache/soundcloud.com for %s", cache_tracks->count, success ? received : 0, user);
 
 	/* only return the tracks received from the cache in case of an error in the request to soundcloud.com */
-	if(!list) {
-		return cache_tracks;
+	struct track_list *result = NULL;
+	if(success && track_list_builder_append(&builder, cache_tracks)) {
+		result = track_list_builder_finish(&builder);
 	}
 
-	struct track_list *lists[] = {list, cache_tracks, NULL};
-	struct track_list *result = track_list_merge(lists);
+	if(!result) {
+		track_list_builder_discard(&builder);
+		soundcloud_set_newest(user, cache_tracks);
+		free(cache_file);
+		return cache_tracks;
+	}
 
-	track_list_destroy(list, false);
 	track_list_destroy(cache_tracks, false);
 
-	jspf_write(cache_file, result);
+	// only the tracks received are written, unless the cache cannot be appended to (p.x. as there is none yet)
+	struct track_list received_tracks = { .count = received, .entries = result->entries };
+	if(!jspf_append(cache_file, &received_tracks)) {
+		jspf_write(cache_file, result);
+	}
+
+	soundcloud_set_newest(user, result);
+	free(cache_file);
 
 	return result;
 }
 
+struct track_list* soundcloud_get_new_entries(struct network_conn *nwc, char *user) {
+	char *cache_file = soundcloud_cache_file(user);
+	if(!cache_file) {
+		return NULL;
+	}
+
+	// the tracks of a user not retrieved before (p.x. due to a failing request) are requested starting after the ones cached
+	if(!soundcloud_find_newest(user)) {
+		struct track_list *cache_tracks = jspf_read(cache_file);
+		if(cache_tracks) {
+			soundcloud_set_newest(user, cache_tracks);
+			track_list_destroy(cache_tracks, true);
+		}
+	}
+	struct soundcloud_newest *known = soundcloud_find_newest(user);
+
+	struct track_list_builder builder = { .region = NULL };
+	if(!soundcloud_fetch(nwc, user, known ? known->created_at : 0, &builder)) {
+		track_list_builder_discard(&builder);
+		free(cache_file);
+		return NULL;
+	}
+
+	struct track_list *list = track_list_builder_finish(&builder);
+	if(list) {
+		// created_at[from] is not exact (see soundcloud_fetch()): drop any track known already
+		size_t count = 0;
+		for(size_t i = 0; i < list->count; i++) {
+			if(!known || list->entries[i].created_at > known->created_at) {
+				list->entries[count++] = list->entries[i];
+			} else {
+				track_destroy(&list->entries[i]);
+			}
+		}
+		list->count = count;
+
+		_log("%4zu new tracks from soundcloud.com for %s", list->count, user);
+
+		if(!jspf_append(cache_file, list)) {
+			_err("failed to append to the cache of %s: %s", user, jspf_error());
+		}
+		soundcloud_set_newest(user, list);
+	}
+	free(cache_file);
+
+	return list;
+}
+
 struct http_response* soundcloud_connect_track(struct track *track, char *range) {
 	char request[strlen(track->stream_url) + 1 + strlen(CLIENTID_GET) + 1];
 	sprintf(request, "%s?"CLIENTID_GET, track->stream_url);
@@ -287,3 +441,38 @@ struct http_response* soundcloud_connect_track(struct track *track, char *range)
 
 	return resp;
 }
+
+char* soundcloud_get_hls_url(struct track *track) {
+	char request_url[strlen(GET_RQ_STREAMS) + 32 + 1];
+	sprintf(request_url, GET_RQ_STREAMS, track->track_id);
+
+	struct url *u = url_parse_string(request_url);
+	if(!u) {
+		return NULL;
+	}
+
+	if(!url_connect(u)) {
+		url_destroy(u);
+		return NULL;
+	}
+
+	struct http_response *resp = http_request_get(u->nwc, u->request, u->host);
+	struct network_conn *nwc = (resp && resp->nwc) ? resp->nwc : u->nwc;
+
+	char *hls_url = NULL;
+	if(!resp) {
+		_err("communication failed");
+	} else if(200 != resp->http_status) {
+		_err("server returned unexpected http status code %i", resp->http_status);
+	} else {
+		yajl_val node = yajl_helper_parse(resp->body);
+		hls_url = yajl_helper_get_string(node, "hls_mp3_128_url", NULL);
+		yajl_tree_free(node);
+	}
+
+	http_response_destroy(resp);
+	nwc->disconnect(nwc);
+	url_destroy(u);
+
+	return hls_url;
+}
@@ -44,6 +44,19 @@
 	 */
 	struct track_list* soundcloud_get_stream(void);
 
+	/** \brief Retrieve the tracks of all users specified in sctc.conf, created after the ones retrieved before
+	 *
+	 *  Only the tracks not retrieved by soundcloud_get_stream() (or any previous call) are requested, see
+	 *  soundcloud_get_new_entries(). The tracks of users failing to respond are missing: they are requested once again
+	 *  by the next call.
+	 *
+	 *  \return  A `track_list` containing the new tracks (sorted by creation time, the most recent track first), or `NULL`
+	 *           in case of failure (failed allocation / connection)
+	 *
+	 *  \see `track_list_destroy()`
+	 */
+	struct track_list* soundcloud_get_stream_update(void);
+
 	/** \brief Retrieve all tracks for a specific user using the provided network connection
 	 *
 	 *  Retrieve a `track_list` containing all tracks from the specified users stream.
@@ -51,6 +64,7 @@
 	 *  amount of transfered data and speedup the execution.
 	 *
 	 *  The network connection `nwc` may be reused afterwards, it is neither closed nor freed.
+	 *  The tracks are sorted by creation time, the most recent track first.
 	 *
 	 *  The `track_list` returned is allocated via `malloc` and therefore needs to be freed / passed to `track_list_destroy()`.
 	 *
@@ -62,6 +76,28 @@
 	 */
 	struct track_list* soundcloud_get_entries(struct network_conn *nwc, char *user) ATTR(nonnull);
 
+	/** \brief Retrieve the tracks of a specific user created after the most recent one retrieved before
+	 *
+	 *  The most recent track retrieved before is the one retrieved by soundcloud_get_entries() or any previous call
+	 *  (or, if there is none, the most recent one cached). The tracks are appended to the cache (see jspf_append()).
+	 *
+	 *  \param nwc   The network connection to be used, *must not be `NULL`*
+	 *  \param user  The user to fetch the new tracks for, *must not be `NULL`*
+	 *  \return      A (possibly empty) `track_list`, sorted by creation time, or `NULL` in case of failure
+	 *
+	 *  \see `track_list_destroy()`
+	 */
+	struct track_list* soundcloud_get_new_entries(struct network_conn *nwc, char *user) ATTR(nonnull);
+
+	/** \brief Parse a single part (page) of a response from soundcloud.com, adding the tracks to a list being built
+	 *
+	 *  \param [in]  resp     The response to be parsed (expected to be valid JSON)
+	 *  \param [out] href     A pointer to a string containing the URL of the subsequent http request, `NULL` if there is none
+	 *  \param       builder  The builder receiving the tracks
+	 *  \return               `true` on success, `false` if parsing or an allocation failed
+	 */
+	bool soundcloud_parse_response(char *resp, char **href, struct track_list_builder *builder) ATTR(nonnull);
+
 	/** \brief Connect to the stream associated to a specific track
 	 *
 	 *  Establishes a network connection to a tracks `stream_url`.
@@ -74,6 +110,13 @@
 	 */
 	struct http_response* soundcloud_connect_track(struct track *track, char *range);
 
+	/** \brief Get the URL of the HLS playlist (MP3, 128kbit/s) of a specific track
+	 *
+	 *  \param track  The track to get the playlist for, *must not be `NULL`*
+	 *  \return       The URL (allocated via malloc), or `NULL` in case of failure
+	 */
+	char* soundcloud_get_hls_url(struct track *track) ATTR(nonnull);
+
 	/** \brief Get a list of subscriptions for a specific user
 	 *
 	 *  \param user  The user to retrieve the subscriptions for
@@ -31,18 +31,25 @@
 //\cond
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 //\endcond
 
 #include "helper.h"
 #include "log.h"
+#include "trigram.h"
+#include "view.h"
 
 void (*callbacks[callback_event_size])(void) = {NULL};
 static void state_finalize(void);
 
 #define CALL_CALLBACK(EVT) { if(callbacks[EVT]) {callbacks[EVT]();} }
 
+/** \brief The size of the input (including the terminating null byte) */
+#define STATE_INPUT_SIZE 128
+
 static unsigned int _volume;
 
 unsigned int state_get_volume(void) { return _volume; }
@@ -143,6 +150,16 @@ static struct track_list_state {
 
 static size_t _current_list = 0; ///< the index in lists of the currently displayed list (default: 0)
 
+/** \brief Protects the entries of the lists along with the positions within these (see state_lock_lists()) */
+static pthread_mutex_t lists_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief The former entries of the lists moved by state_prepend_list(), released on exit */
+static struct track **retired       = NULL;
+static size_t         retired_count = 0;
+
+void state_lock_lists(void)   { pthread_mutex_lock(&lists_mutex);   }
+void state_unlock_lists(void) { pthread_mutex_unlock(&lists_mutex); }
+
 size_t state_get_current_list(void)     { return _current_list; }
 size_t state_get_current_selected(void) { return lists[_current_list].selected; }
 size_t state_get_current_position(void) { return lists[_current_list].position; }
@@ -173,6 +190,11 @@ void state_add_list(struct track_list *_list) {
 	lists[pos].old_selected = 0;
 	lists[pos].position     = 0;
 
+	// build the index used for searching in the background
+	if(!trigram_index_create(_list)) {
+		_err("failed to create the trigram index of `%s`", _list->name);
+	}
+
 	CALL_CALLBACK(cbe_tabs_modified);
 }
 
@@ -194,6 +216,9 @@ static struct current_playback {
 	size_t list;
 	size_t track;
 	size_t time;
+	bool         stats_valid; ///< `true` once the output statistics were published (see state_set_output_stats())
+	unsigned int xruns;
+	unsigned int delay_ms;
 } current_playback = {.list = (size_t) ~0l, .track = (size_t) ~0l, .time = (size_t) 0l};
 
 void state_set_current_playback(size_t list, size_t track) {
@@ -201,11 +226,117 @@ void state_set_current_playback(size_t list, size_t track) {
 	current_playback.track = track;
 }
 
-void state_set_current_time(size_t time) { current_playback.time = time; }
+// the time is published by the playback thread and sampled by the tui thread, without any locking
+void state_set_current_time(size_t time) { __atomic_store_n(&current_playback.time, time, __ATOMIC_RELAXED); }
 
 size_t state_get_current_playback_list(void)  { return current_playback.list;  }
 size_t state_get_current_playback_track(void) { return current_playback.track; }
-size_t state_get_current_playback_time(void)  { return current_playback.time;  }
+size_t state_get_current_playback_time(void)  { return __atomic_load_n(&current_playback.time, __ATOMIC_RELAXED); }
+
+// like the time, a value of one of the statistics may be drawn along with an older value of the other one
+void state_set_output_stats(unsigned int xruns, unsigned int delay_ms) {
+	__atomic_store_n(&current_playback.xruns,       xruns,    __ATOMIC_RELAXED);
+	__atomic_store_n(&current_playback.delay_ms,    delay_ms, __ATOMIC_RELAXED);
+	__atomic_store_n(&current_playback.stats_valid, true,     __ATOMIC_RELEASE);
+}
+
+bool state_get_output_stats(unsigned int *xruns, unsigned int *delay_ms) {
+	if(!__atomic_load_n(&current_playback.stats_valid, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+	*xruns    = __atomic_load_n(&current_playback.xruns,    __ATOMIC_RELAXED);
+	*delay_ms = __atomic_load_n(&current_playback.delay_ms, __ATOMIC_RELAXED);
+	return true;
+}
+
+/** \brief Make room for `count` entries in front of a list, moving its entries (requires `lists_mutex`)
+ *
+ *  The tracks are referenced all over the place (the downloads, the cache, the playback, ...): the former entries
+ *  are kept until exiting, such that these references stay valid. The reference tracks of the other lists are
+ *  redirected to the new entries.
+ */
+static bool state_reserve_front(struct track_list *target, size_t count) {
+	struct track **retired_new = lrealloc(retired, (retired_count + 1) * sizeof(struct track*));
+	if(!retired_new) {
+		return false;
+	}
+	retired = retired_new;
+
+	struct track *from = target->entries;
+	if(!track_list_reserve_front(target, count, &retired[retired_count])) {
+		return false;
+	}
+	retired_count++;
+
+	for(size_t i = 0; i < MAX_LISTS; i++) {
+		if(lists[i].list && target != lists[i].list) {
+			track_list_href_move(lists[i].list, from, target->count, target->entries);
+		}
+	}
+
+	_log("moved the %zu entries of `%s` to make room for %zu new ones", target->count, target->name, count);
+	return true;
+}
+
+bool state_prepend_list(size_t list, struct track_list *source) {
+	if(list >= MAX_LISTS || !lists[list].list) return false;
+
+	struct track_list *target = lists[list].list;
+
+	pthread_mutex_lock(&lists_mutex);
+	const bool success = (source->count <= target->headroom || state_reserve_front(target, source->count + STREAM_REFRESH_HEADROOM))
+	                  && track_list_prepend(target, source);
+	if(success) {
+		lists[list].selected     += source->count;
+		lists[list].old_selected += source->count;
+		lists[list].position     += source->count;
+
+		if(list == current_playback.list) {
+			current_playback.track += source->count;
+		}
+	}
+	pthread_mutex_unlock(&lists_mutex);
+
+	if(success && list == _current_list) {
+		CALL_CALLBACK(cbe_list_modified);
+	}
+	return success;
+}
+
+void state_update_view(size_t list) {
+	if(list >= MAX_LISTS || !lists[list].list || !lists[list].list->view) return;
+
+	struct track_list_state *state = &lists[list];
+	struct track_list *view = state->list;
+
+	pthread_mutex_lock(&lists_mutex);
+
+	// the tracks selected and playing, their positions are changed by entries inserted in front of them
+	struct track *selected = state->selected < view->count ? TRACK(view, state->selected) : NULL;
+	struct track *playing  = list == current_playback.list && current_playback.track < view->count ? TRACK(view, current_playback.track) : NULL;
+
+	if(!view_update(view)) {
+		pthread_mutex_unlock(&lists_mutex);
+		return;
+	}
+
+	size_t pos;
+	if(selected && view_find(view, selected, &pos)) {
+		// keep the selected track at the same line
+		const size_t line = state->selected > state->position ? state->selected - state->position : 0;
+		state->position     = pos > line ? pos - line : 0;
+		state->selected     = pos;
+		state->old_selected = pos;
+	}
+	if(playing && view_find(view, playing, &pos)) {
+		current_playback.track = pos;
+	}
+	pthread_mutex_unlock(&lists_mutex);
+
+	if(list == _current_list) {
+		CALL_CALLBACK(cbe_list_modified);
+	}
+}
 
 /**************
 * STATUS LINE *
@@ -224,6 +355,12 @@ void state_set_status(enum color color, char *text) {
 	CALL_CALLBACK(cbe_statusbar_modified);
 }
 
+void state_set_input(const char *text) {
+	snprintf(_input, STATE_INPUT_SIZE, "%s", text);
+
+	CALL_CALLBACK(cbe_input_modified);
+}
+
 char*      state_get_status_text(void)  { return status_line.text;  }
 enum color state_get_status_color(void) { return status_line.color; }
 
@@ -237,7 +374,7 @@ void state_register_callback(enum callback_event evt, void (*cb)(void)) {
 }
 
 bool state_init(void) {
-	_input = lcalloc(128, sizeof(char));
+	_input = lcalloc(STATE_INPUT_SIZE, sizeof(char));
 
 	if(atexit(state_finalize)) {
 		_log("atexit: %s", strerror(errno));
@@ -252,6 +389,13 @@ bool state_init(void) {
  *  Do not use any state_* after calling this function.
  */
 static void state_finalize(void) {
+	for(size_t i = 0; i < retired_count; i++) {
+		free(retired[i]);
+	}
+	free(retired);
+
 	free(_input);
-	rcs_unref(_title_text);
+	if(_title_text) {
+		rcs_unref(_title_text);
+	}
 }
@@ -107,6 +107,15 @@
 	char*              state_get_input(void);
 	struct command*    state_get_commands(void);
 	size_t             state_get_current_playback_time(void);
+
+	/** \brief Get the statistics of the output, as published via state_set_output_stats()
+	 *
+	 *  \param xruns     Set to the number of underruns recovered from
+	 *  \param delay_ms  Set to the delay (in ms)
+	 *  \return          `true` if statistics were published, `false` if the output does not report any
+	 */
+	bool               state_get_output_stats(unsigned int *xruns, unsigned int *delay_ms);
+
 	size_t             state_get_tb_old_pos(void);
 	size_t             state_get_tb_pos(void);
 	size_t             state_get_old_selected(void);
@@ -192,6 +201,44 @@
 	 */
 	void state_set_current_selected(size_t selected);
 
+	/** \brief Insert (copies of) all entries of a list in front of a list (see track_list_prepend())
+	 *
+	 *  Shifts the selection, the position and the current playback by the number of entries inserted, along with
+	 *  inserting these (see state_lock_lists()): the same tracks stay selected (and playing).
+	 *  Once the room in front of the list is used up, new room is reserved (see STREAM_REFRESH_HEADROOM).
+	 *
+	 *  \param list    The id of the list
+	 *  \param source  The list to insert, not modified
+	 *  \return        `true` on success, `false` otherwise (the list is left unmodified)
+	 *
+	 *  \remark Triggers `cbe_list_modified` if `list` is the currently visible list
+	 *  \see `state_register_callback()`
+	 *  \see `enum callback_event`
+	 */
+	bool state_prepend_list(size_t list, struct track_list *source) ATTR(nonnull);
+
+	/** \brief Lock the entries of the lists, along with the positions within these (the selection, the current playback)
+	 *
+	 *  Required by threads other than the one modifying the lists (p.x. for drawing, or switching to the next track).
+	 *  Do not trigger any callback while holding the lock: the tui thread takes it for drawing the lists.
+	 */
+	void state_lock_lists(void);
+
+	/** \brief Unlock the entries of the lists (see state_lock_lists()) */
+	void state_unlock_lists(void);
+
+	/** \brief Add the entries added to the base of a view since its last update to the view (see view_update())
+	 *
+	 *  Keeps the same tracks selected (and playing). Does nothing if `list` is no view.
+	 *
+	 *  \param list  The id of the list
+	 *
+	 *  \remark Triggers `cbe_list_modified` if `list` is the currently visible list (and entries were added)
+	 *  \see `state_register_callback()`
+	 *  \see `enum callback_event`
+	 */
+	void state_update_view(size_t list);
+
 	/** \brief Set the current repeat state
 	 *
 	 *  \param repeat  The new repeat state
@@ -223,7 +270,19 @@
 	 */
 	void state_set_status(enum color color, char *text);
 
+	/** \brief Set the text shown as input
+	 *
+	 *  \param text  The new input, truncated to the size of the input (must not be `NULL`)
+	 *
+	 *  \remark Triggers `cbe_input_modified`
+	 *  \see `state_register_callback()`
+	 *  \see `enum callback_event`
+	 */
+	void state_set_input(const char *text) ATTR(nonnull);
+
 	/** \brief Set the current playback time (of the current track)
+	 *
+	 *  Lock-free, the time is published by the playback thread and sampled by the tui thread on its own schedule.
 	 *
 	 *  \param time  The time
 	 *
@@ -233,6 +292,19 @@
 	 */
 	void state_set_current_time(size_t time);
 
+	/** \brief Set the statistics of the output (see struct audio_stats), shown along with the time
+	 *
+	 *  Lock-free like state_set_current_time(), published by the playback thread.
+	 *
+	 *  \param xruns     The number of underruns recovered from
+	 *  \param delay_ms  The delay (in ms) until a sample written now is audible
+	 *
+	 *  \remark Triggers **nothing**
+	 *  \see `state_register_callback()`
+	 *  \see `enum callback_event`
+	 */
+	void state_set_output_stats(unsigned int xruns, unsigned int delay_ms);
+
 	void state_set_sugg_selected(size_t selected);
 
 	void state_set_tb          (char *title, char *text);
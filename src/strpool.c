@@ -0,0 +1,341 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file strpool.c
+ *  \brief Implementation of the string pool
+ *
+ *  The strings are appended to blocks of STRPOOL_BLOCK_SIZE bytes, strings larger than a quarter of a block
+ *  get a block of their own. Each string is preceded by a header holding the number of references to it:
+ *  strpool_ref() and strpool_unref() modify it atomically, without taking the lock (unless releasing the last
+ *  reference). An open-addressing hash table (linear probing) is used to find strings interned before.
+ *
+ *  A string whose last reference was released is never referenced again: strpool_intern() replaces it by a new
+ *  copy, the one releasing the last reference removes it. The memory of a string released is not reused: a block
+ *  is freed (or, if strings are still appended to it, emptied) as soon as the last of its strings is released.
+ *  The strings of a list are usually appended one after another, such that destroying the list frees most of the
+ *  blocks holding them.
+ */
+
+#include "_hard_config.h"
+#include "strpool.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <stdbool.h>                    // for bool
+#include <stddef.h>                     // for offsetof
+#include <stdint.h>                     // for uint32_t, uintptr_t
+#include <stdlib.h>                     // for free, atexit
+#include <string.h>                     // for memcpy, memcmp, strerror
+//\endcond
+
+#include "helper.h"                     // for lmalloc, lcalloc
+#include "log.h"                        // for _log
+
+/** \brief The number of bytes of a (regular) block */
+#define STRPOOL_BLOCK_SIZE ( 64 * 1024 )
+
+/** \brief The minimum number of slots of the hash table */
+#define STRPOOL_MIN_CAPACITY 1024
+
+struct strpool_block {
+	struct strpool_block *next;
+	struct strpool_block *prev;
+	size_t size;     ///< The number of bytes available in `data`
+	size_t used;     ///< The number of bytes used
+	size_t strings;  ///< The number of strings within the block not released yet
+	char   data[];
+};
+
+/** \brief The header preceding each interned string */
+struct strpool_header {
+	struct strpool_block *block; ///< The block holding the string
+	uint32_t refs;               ///< The number of references to the string (accessed atomically)
+	uint32_t hash;
+	uint32_t length;
+	bool     listed;             ///< `true` while the string is found via the hash table (requires `mutex`)
+	char     str[];
+};
+
+struct strpool_slot {
+	uint32_t hash;
+	struct strpool_header *header; ///< The header of the interned string, `NULL` marks an empty slot
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief The blocks, the first one being the one strings are appended to */
+static struct strpool_block *blocks = NULL;
+
+static struct strpool_slot *slots = NULL;
+static size_t capacity = 0;  ///< The number of slots (a power of two, at least twice the number of strings)
+
+static struct strpool_stats stats = { .strings = 0 };
+
+static void strpool_finalize(void);
+
+/** \brief FNV-1a hash of a string, also determining its length */
+static uint32_t strpool_hash(const char *str, size_t *length) {
+	uint32_t hash = 2166136261u;
+	const unsigned char *c = (const unsigned char*) str;
+	for(; *c; c++) {
+		hash = (hash ^ *c) * 16777619u;
+	}
+	*length = (size_t) ((const char*) c - str);
+	return hash;
+}
+
+/** \brief The header of an interned string (the reference count is modified even for a string passed as `const`) */
+static struct strpool_header* strpool_header(const char *str) {
+	return (struct strpool_header*) (uintptr_t) (str - offsetof(struct strpool_header, str));
+}
+
+/** \brief Find the slot holding `str` or the empty slot it belongs to (requires `mutex`) */
+static struct strpool_slot* strpool_find(struct strpool_slot *table, size_t table_capacity, const char *str, uint32_t hash, size_t length) {
+	size_t slot = hash & (table_capacity - 1);
+	while(table[slot].header) {
+		const struct strpool_header *header = table[slot].header;
+		if(hash == table[slot].hash && length == header->length && !memcmp(header->str, str, length)) {
+			break;
+		}
+		slot = (slot + 1) & (table_capacity - 1);
+	}
+	return &table[slot];
+}
+
+/** \brief Double the capacity of the hash table, allocating it initially (requires `mutex`)
+ *
+ *  \return `true` on success, `false` otherwise (the table is left unmodified)
+ */
+static bool strpool_grow(void) {
+	const size_t new_capacity = capacity ? 2 * capacity : STRPOOL_MIN_CAPACITY;
+	struct strpool_slot *new_slots = lcalloc(new_capacity, sizeof(struct strpool_slot));
+	if(!new_slots) {
+		return false;
+	}
+
+	// the strings are distinct: each one is inserted into the first empty slot
+	for(size_t i = 0; i < capacity; i++) {
+		if(slots[i].header) {
+			size_t slot = slots[i].hash & (new_capacity - 1);
+			while(new_slots[slot].header) {
+				slot = (slot + 1) & (new_capacity - 1);
+			}
+			new_slots[slot] = slots[i];
+		}
+	}
+
+	if(!slots && atexit(strpool_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	free(slots);
+	slots    = new_slots;
+	capacity = new_capacity;
+	return true;
+}
+
+/** \brief Copy a string (preceded by its header) into a block (requires `mutex`)
+ *
+ *  \return The header of the copy (holding a single reference), `NULL` in case of a failing malloc
+ */
+static struct strpool_header* strpool_store(const char *str, size_t length, uint32_t hash) {
+	const size_t align = _Alignof(struct strpool_header);
+	const size_t size  = (offsetof(struct strpool_header, str) + length + 1 + align - 1) & ~(align - 1);
+
+	struct strpool_block *block = blocks;
+	if(!block || block->size - block->used < size) {
+		const bool dedicated = (size > STRPOOL_BLOCK_SIZE / 4);
+		const size_t block_size = dedicated ? size : STRPOOL_BLOCK_SIZE;
+
+		block = lmalloc(sizeof(struct strpool_block) + block_size);
+		if(!block) {
+			return NULL;
+		}
+		block->size    = block_size;
+		block->used    = 0;
+		block->strings = 0;
+
+		// keep appending to the current block if the new one is filled by this string anyway
+		struct strpool_block *prev = (dedicated && blocks) ? blocks : NULL;
+		block->prev = prev;
+		block->next = prev ? prev->next : blocks;
+		if(block->next) {
+			block->next->prev = block;
+		}
+		if(prev) {
+			prev->next = block;
+		} else {
+			blocks = block;
+		}
+		stats.blocks++;
+	}
+
+	struct strpool_header *header = (struct strpool_header*) &block->data[block->used];
+	header->block  = block;
+	header->refs   = 1;
+	header->hash   = hash;
+	header->length = (uint32_t) length;
+	header->listed = true;
+	memcpy(header->str, str, length + 1);
+
+	block->used += size;
+	block->strings++;
+
+	stats.strings++;
+	stats.bytes += length + 1;
+	return header;
+}
+
+/** \brief Remove a slot from the hash table, moving the slots following it as required by linear probing (requires `mutex`) */
+static void strpool_remove(size_t slot) {
+	slots[slot].header->listed = false;
+
+	const size_t mask = capacity - 1;
+	for(size_t next = (slot + 1) & mask; slots[next].header; next = (next + 1) & mask) {
+		// the slot `next` may fill the gap unless the slot its string belongs to lies (cyclically) within (slot, next]
+		const size_t home = slots[next].hash & mask;
+		if(((next - home) & mask) >= ((next - slot) & mask)) {
+			slots[slot] = slots[next];
+			slot = next;
+		}
+	}
+	slots[slot].header = NULL;
+}
+
+/** \brief Release a string within a block, freeing the block once empty (requires `mutex`) */
+static void strpool_block_release(struct strpool_header *header) {
+	struct strpool_block *block = header->block;
+
+	stats.strings--;
+	stats.bytes -= header->length + 1;
+
+	if(--block->strings) {
+		return;
+	}
+
+	// the block strings are appended to is kept (and reused from its start)
+	if(block == blocks) {
+		block->used = 0;
+		return;
+	}
+
+	if(block->prev) {
+		block->prev->next = block->next;
+	}
+	if(block->next) {
+		block->next->prev = block->prev;
+	}
+	free(block);
+	stats.blocks--;
+}
+
+/** \brief Add a reference to a string, unless its last reference was released already */
+static bool strpool_ref_alive(struct strpool_header *header) {
+	uint32_t refs = __atomic_load_n(&header->refs, __ATOMIC_RELAXED);
+	while(refs) {
+		if(__atomic_compare_exchange_n(&header->refs, &refs, refs + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+char* strpool_intern(const char *str) {
+	if(!str) {
+		return NULL;
+	}
+
+	size_t length;
+	const uint32_t hash = strpool_hash(str, &length);
+	if(length > UINT32_MAX) {
+		return NULL;
+	}
+
+	char *interned = NULL;
+
+	pthread_mutex_lock(&mutex);
+	stats.requests++;
+	if(2 * (stats.strings + 1) <= capacity || strpool_grow()) {
+		struct strpool_slot *slot = strpool_find(slots, capacity, str, hash, length);
+
+		// a string released meanwhile is about to be removed by strpool_unref(): replace it by a new copy
+		if(slot->header && !strpool_ref_alive(slot->header)) {
+			strpool_remove((size_t) (slot - slots));
+			slot = strpool_find(slots, capacity, str, hash, length);
+		}
+
+		if(!slot->header && (slot->header = strpool_store(str, length, hash))) {
+			slot->hash = hash;
+		}
+		interned = slot->header ? slot->header->str : NULL;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return interned;
+}
+
+char* strpool_ref(char *str) {
+	if(str) {
+		__atomic_add_fetch(&strpool_header(str)->refs, 1, __ATOMIC_RELAXED);
+	}
+	return str;
+}
+
+void strpool_unref(const char *str) {
+	if(!str) {
+		return;
+	}
+
+	struct strpool_header *header = strpool_header(str);
+	if(__atomic_sub_fetch(&header->refs, 1, __ATOMIC_ACQ_REL)) {
+		return;
+	}
+
+	// the last reference: nobody else refers to the string, strpool_intern() does not hand it out anymore
+	pthread_mutex_lock(&mutex);
+	if(header->listed) {
+		size_t slot = header->hash & (capacity - 1);
+		while(slots[slot].header != header) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		strpool_remove(slot);
+	}
+	strpool_block_release(header);
+	pthread_mutex_unlock(&mutex);
+}
+
+void strpool_get_stats(struct strpool_stats *_stats) {
+	pthread_mutex_lock(&mutex);
+	*_stats = stats;
+	pthread_mutex_unlock(&mutex);
+}
+
+static void strpool_finalize(void) {
+	_log("string pool: %zu strings (%zukB in %zu blocks) for %zu requests", stats.strings, stats.bytes / 1024, stats.blocks, stats.requests);
+
+	while(blocks) {
+		struct strpool_block *next = blocks->next;
+		free(blocks);
+		blocks = next;
+	}
+
+	free(slots);
+	slots    = NULL;
+	capacity = 0;
+}
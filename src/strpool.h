@@ -0,0 +1,71 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file strpool.h
+ *  \brief Interning of the strings describing tracks
+ *
+ *  Equal strings (usernames, but also titles and URLs of tracks contained in several lists) are stored
+ *  only once, within large blocks instead of separate allocations. Interned strings are never modified.
+ *
+ *  Each string is reference counted: strpool_intern() and strpool_ref() add a reference, strpool_unref()
+ *  releases one, the string is freed once the last one is released. Adding or releasing a reference takes
+ *  constant time (the number of references precedes the string), which requires the string to be interned. A list holds a reference to each string
+ *  of its entries (see track.h), such that destroying a list frees the strings not used by any other list.
+ *  The remaining strings are freed on exit.
+ */
+
+#ifndef _STRPOOL_H
+	#define _STRPOOL_H
+
+	//\cond
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	struct strpool_stats {
+		size_t strings;  ///< The number of distinct strings held
+		size_t bytes;    ///< The number of bytes occupied by the strings (including the terminating null bytes)
+		size_t blocks;   ///< The number of blocks allocated
+		size_t requests; ///< The number of calls to strpool_intern() (with a string other than `NULL`)
+	};
+
+	/** \brief Intern a string
+	 *
+	 *  \param str  The string, `NULL` is passed through
+	 *  \return     The interned string (not to be modified, pass to strpool_unref() if no longer needed), `NULL` in case of a failing malloc
+	 */
+	char* strpool_intern(const char *str);
+
+	/** \brief Add a reference to an interned string
+	 *
+	 *  \param str  An interned string holding a reference (see strpool_intern()), ignored if `NULL`
+	 *  \return     `str`
+	 */
+	char* strpool_ref(char *str);
+
+	/** \brief Release a reference to an interned string, freeing the string if it was the last one
+	 *
+	 *  \param str  An interned string (see strpool_intern()), ignored if `NULL`
+	 */
+	void strpool_unref(const char *str);
+
+	/** \brief Get the statistics of the pool
+	 *
+	 *  \param stats  The struct to write the statistics to
+	 */
+	void strpool_get_stats(struct strpool_stats *stats);
+#endif /* _STRPOOL_H */
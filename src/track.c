@@ -23,6 +23,7 @@
 //\cond
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 //\endcond
@@ -30,6 +31,149 @@
 #include "log.h"
 #include "track.h"
 #include "helper.h"
+#include "strpool.h"
+#include "trigram.h"
+#include "view.h"
+
+/** \brief The minimum number of slots of a track_index */
+#define TRACK_INDEX_MIN_CAPACITY 64
+
+/** \brief The minimum number of entries allocated when growing a list (or a track_list_builder) */
+#define TRACK_LIST_MIN_CAPACITY 64
+
+struct track_index_slot {
+	uint32_t key; ///< The hash of the permalink or the track_id
+	uint32_t pos; ///< The position of the entry + 1, 0 marks an empty slot
+};
+
+/** \brief An open-addressing hash index (linear probing), keyed on permalink and track_id
+ *
+ *  The slots store positions (instead of pointers), such that reallocating `entries` does not
+ *  invalidate the index. Entries are never removed from the index: deleting (or reordering) entries
+ *  rebuilds it.
+ */
+struct track_index {
+	size_t capacity;                     ///< The number of slots of each table (a power of two, at least twice `count`)
+	size_t count;                        ///< The number of entries (from the start of the list) indexed
+	struct track_index_slot *permalinks; ///< The table keyed on the permalink
+	struct track_index_slot *track_ids;  ///< The table keyed on the track_id
+};
+
+/** \brief FNV-1a hash of a permalink */
+static uint32_t track_index_hash(const char *permalink) {
+	uint32_t hash = 2166136261u;
+	for(const unsigned char *c = (const unsigned char*) permalink; *c; c++) {
+		hash = (hash ^ *c) * 16777619u;
+	}
+	return hash;
+}
+
+/** \brief The slot a key is searched at first (mixing the bits, as track_ids are anything but random) */
+static size_t track_index_bucket(const struct track_index *index, uint32_t key) {
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+	return key & (index->capacity - 1);
+}
+
+static void track_index_insert(struct track_index_slot *table, const struct track_index *index, uint32_t key, size_t pos) {
+	size_t slot = track_index_bucket(index, key);
+	while(table[slot].pos) {
+		slot = (slot + 1) & (index->capacity - 1);
+	}
+	table[slot].key = key;
+	table[slot].pos = (uint32_t) (pos + 1);
+}
+
+static void track_index_destroy(struct track_list *list) {
+	if(list->index) {
+		free(list->index->permalinks);
+		free(list->index->track_ids);
+		free(list->index);
+		list->index = NULL;
+	}
+}
+
+/** \brief Replace the tables by empty ones, large enough for `count` entries
+ *
+ *  \return `true` on success, `false` otherwise (the index is left unmodified)
+ */
+static bool track_index_resize(struct track_index *index, size_t count) {
+	size_t capacity = TRACK_INDEX_MIN_CAPACITY;
+	while(capacity < 2 * count) {
+		capacity *= 2;
+	}
+
+	struct track_index_slot *permalinks = lcalloc(capacity, sizeof(struct track_index_slot));
+	struct track_index_slot *track_ids  = lcalloc(capacity, sizeof(struct track_index_slot));
+	if(!permalinks || !track_ids || count > UINT32_MAX) {
+		free(permalinks);
+		free(track_ids);
+		return false;
+	}
+
+	free(index->permalinks);
+	free(index->track_ids);
+	index->permalinks = permalinks;
+	index->track_ids  = track_ids;
+	index->capacity   = capacity;
+	index->count      = 0;
+
+	return true;
+}
+
+/** \brief Add the entries not indexed yet, growing (and rebuilding) the tables if required
+ *
+ *  Drops the index if growing it fails: lookups fall back to searching linearly.
+ */
+static void track_index_update(struct track_list *list) {
+	struct track_index *index = list->index;
+	if(!index) {
+		return;
+	}
+
+	if(2 * list->count > index->capacity && !track_index_resize(index, list->count)) {
+		track_index_destroy(list);
+		return;
+	}
+
+	// insert in order of the positions: probing yields the first of several equal entries first
+	for(; index->count < list->count; index->count++) {
+		const struct track *track = TRACK(list, index->count);
+		if(track->permalink_url) {
+			track_index_insert(index->permalinks, index, track_index_hash(track->permalink_url), index->count);
+		}
+		track_index_insert(index->track_ids, index, (uint32_t) track->track_id, index->count);
+	}
+}
+
+/** \brief Rebuild the index from scratch, required once entries are removed or reordered */
+static void track_index_rebuild(struct track_list *list) {
+	if(list->index) {
+		memset(list->index->permalinks, 0, list->index->capacity * sizeof(struct track_index_slot));
+		memset(list->index->track_ids,  0, list->index->capacity * sizeof(struct track_index_slot));
+		list->index->count = 0;
+
+		track_index_update(list);
+	}
+}
+
+bool track_list_index(struct track_list *list) {
+	if(!list->index) {
+		list->index = lcalloc(1, sizeof(struct track_index));
+		if(!list->index) {
+			return false;
+		}
+
+		if(!track_index_resize(list->index, list->count)) {
+			track_index_destroy(list);
+			return false;
+		}
+	}
+
+	track_index_rebuild(list);
+	return NULL != list->index;
+}
 
 struct track_list* track_list_create(char *name) {
 	struct track_list *list = lcalloc(1, sizeof(struct track_list));
@@ -40,23 +184,172 @@ struct track_list* track_list_create(char *name) {
 	return list;
 }
 
-// TODO: improve memory management, might be slow that way
-bool track_list_add(struct track_list *list, struct track *track) {
-	struct track *tracks = lrealloc(list->entries, (list->count + 1) * sizeof(struct track));
-	if(!tracks) return false;
+/** \brief Add a reference to each string of the normal tracks among `count` entries (see strpool.h)
+ *
+ *  Each list holds a reference to the strings of its entries: required whenever entries are copied into a list.
+ */
+static void track_ref_strings(struct track *entries, size_t count) {
+	for(size_t i = 0; i < count; i++) {
+		struct track *track = &entries[i];
+		if(track->name) {
+			strpool_ref(track->name);
+			strpool_ref(track->stream_url);
+			strpool_ref(track->permalink_url);
+			strpool_ref(track->download_url);
+			strpool_ref(track->username);
+			strpool_ref(track->description);
+		}
+	}
+}
+
+/** \brief Release the references held to the strings of the normal tracks among `count` entries */
+static void track_unref_strings(struct track *entries, size_t count) {
+	for(size_t i = 0; i < count; i++) {
+		struct track *track = &entries[i];
+		if(track->name) {
+			strpool_unref(track->name);
+			strpool_unref(track->stream_url);
+			strpool_unref(track->permalink_url);
+			strpool_unref(track->download_url);
+			strpool_unref(track->username);
+			strpool_unref(track->description);
+		}
+	}
+}
+
+/** \brief The capacity to grow to, such that `count` entries fit (doubling the current one) */
+static size_t track_list_grow_capacity(size_t capacity, size_t count) {
+	capacity = capacity ? 2 * capacity : TRACK_LIST_MIN_CAPACITY;
+	return capacity < count ? count : capacity;
+}
+
+/** \brief The members of an entry read by track_list_sort(), stored apart from the entries (and their strings)
+ *
+ *  Sorting these touches a fraction of the memory sorting the entries does, and does not follow the `href` of
+ *  reference tracks.
+ */
+struct track_hot {
+	time_t   created_at;
+	uint32_t pos;        ///< The position of the entry within the list
+};
+
+/** \brief The creation times of all entries of a list, sorted by track_list_sort() */
+struct track_list_hot {
+	size_t count;
+	struct track_hot *entries;
+};
+
+/** \brief Fill a hot view with the entries of a list
+ *
+ *  \return `true` on success, `false` in case of a failing malloc
+ */
+static bool track_hot_fill(struct track_list_hot *hot, struct track_list *list) {
+	hot->entries = list->count <= UINT32_MAX ? lmalloc((list->count ? list->count : 1) * sizeof(struct track_hot)) : NULL;
+	if(!hot->entries) {
+		return false;
+	}
+
+	for(hot->count = 0; hot->count < list->count; hot->count++) {
+		hot->entries[hot->count] = (struct track_hot) {
+			.created_at = TRACK(list, hot->count)->created_at,
+			.pos        = (uint32_t) hot->count
+		};
+	}
+	return true;
+}
+
+/** \brief Make sure `count` entries fit into the entries of a list
+ *
+ *  \return `true` on success, `false` otherwise (the list is left unmodified)
+ */
+static bool track_list_reserve(struct track_list *list, size_t count) {
+	if(count <= list->capacity) {
+		return true;
+	}
+
+	const size_t capacity = track_list_grow_capacity(list->capacity, count);
+
+	struct track *entries = lrealloc(list->entries ? list->entries - list->headroom : NULL, (list->headroom + capacity) * sizeof(struct track));
+	if(!entries) {
+		return false;
+	}
+
+	list->entries  = entries + list->headroom;
+	list->capacity = capacity;
+	return true;
+}
+
+bool track_list_reserve_front(struct track_list *list, size_t count, struct track **former) {
+	const size_t capacity = track_list_grow_capacity(0, list->count);
+
+	struct track *base = lmalloc((count + capacity) * sizeof(struct track));
+	if(!base) {
+		return false;
+	}
+
+	if(list->count) {
+		memcpy(&base[count], list->entries, list->count * sizeof(struct track));
+	}
+	struct track *allocation = list->entries ? list->entries - list->headroom : NULL;
+
+	// release the former entries only once the new ones are published (the tui thread may draw the list at any time)
+	list->entries  = &base[count];
+	list->capacity = capacity;
+	list->headroom = count;
+
+	if(former) {
+		*former = allocation;
+	} else {
+		free(allocation);
+	}
+	return true;
+}
+
+bool track_list_prepend(struct track_list *target, struct track_list *source) {
+	if(source->count > target->headroom) {
+		return false;
+	}
+
+	// fill in the entries before publishing them: the tui thread may draw the list at any time
+	struct track *entries = target->entries - source->count;
+	if(source->count) {
+		memcpy(entries, source->entries, source->count * sizeof(struct track));
+		track_ref_strings(entries, source->count);
+	}
 
-	memcpy(&tracks[list->count], track, sizeof(struct track));
+	target->headroom  -= source->count;
+	target->capacity  += source->count;
+	target->entries    = entries;
+	target->prepended += source->count;
+	target->count     += source->count;
 
-	list->entries = tracks;
+	track_index_rebuild(target);
+	trigram_index_rebuild(target);
+
+	return true;
+}
+
+bool track_list_add(struct track_list *list, struct track *track) {
+	if(!track_list_reserve(list, list->count + 1)) return false;
+
+	memcpy(&list->entries[list->count], track, sizeof(struct track));
+	track_ref_strings(&list->entries[list->count], 1);
 	list->count++;
 
+	track_index_update(list);
+
 	return true;
 }
 
 bool track_list_del(struct track_list *list, size_t track_id) {
-	memmove(&list->entries[track_id], &list->entries[track_id + 1], (list->count - track_id) * sizeof(struct track));
+	track_unref_strings(&list->entries[track_id], 1);
+	memmove(&list->entries[track_id], &list->entries[track_id + 1], (list->count - track_id - 1) * sizeof(struct track));
 	list->count--;
 
+	track_index_rebuild(list);
+	trigram_index_del(list, track_id);
+	view_base_del(list, track_id);
+
 	return true;
 }
 
@@ -70,45 +363,354 @@ static int entry_compare(const void *v1, const void *v2) {
 	return difftime(e2->created_at, e1->created_at);
 }
 
-struct track_list* track_list_merge(struct track_list **lists) {
+/** \brief Make sure `count` entries fit into the region of a builder
+ *
+ *  \return `true` on success, `false` otherwise (the builder is left unmodified)
+ */
+static bool track_list_builder_reserve(struct track_list_builder *builder, size_t count) {
+	if(count <= builder->capacity) {
+		return true;
+	}
+
+	const size_t capacity = track_list_grow_capacity(builder->capacity, count);
+
+	struct track *region = lrealloc(builder->region, capacity * sizeof(struct track));
+	if(!region) {
+		return false;
+	}
+
+	builder->region   = region;
+	builder->capacity = capacity;
+	return true;
+}
+
+struct track* track_list_builder_add(struct track_list_builder *builder) {
+	if(!track_list_builder_reserve(builder, builder->count + 1)) {
+		return NULL;
+	}
+
+	struct track *track = &builder->region[builder->count++];
+	memset(track, 0, sizeof(struct track));
+	return track;
+}
+
+bool track_list_builder_append(struct track_list_builder *builder, struct track_list *source) {
+	if(!track_list_builder_reserve(builder, builder->count + source->count)) {
+		return false;
+	}
+
+	if(source->count) {
+		memcpy(&builder->region[builder->count], source->entries, source->count * sizeof(struct track));
+		track_ref_strings(&builder->region[builder->count], source->count);
+	}
+	builder->count += source->count;
+	return true;
+}
+
+struct track_list* track_list_builder_finish(struct track_list_builder *builder) {
 	struct track_list *list = lcalloc(1, sizeof(struct track_list));
-	if(!list) return NULL;
+	if(!list) {
+		return NULL;
+	}
+
+	if(builder->count) {
+		// shrink the region to the entries used (usually in place)
+		struct track *shrunk = lrealloc(builder->region, builder->count * sizeof(struct track));
+		if(shrunk) {
+			builder->region   = shrunk;
+			builder->capacity = builder->count;
+		}
+
+		list->entries  = builder->region;
+		list->capacity = builder->capacity;
+	} else {
+		free(builder->region);
+	}
+	list->count = builder->count;
+
+	builder->region   = NULL;
+	builder->count    = 0;
+	builder->capacity = 0;
+	return list;
+}
+
+void track_list_builder_discard(struct track_list_builder *builder) {
+	if(builder->region) {
+		track_unref_strings(builder->region, builder->count);
+	}
+	free(builder->region);
+	builder->region   = NULL;
+	builder->count    = 0;
+	builder->capacity = 0;
+}
 
-	list->count = 0;
-	for(int i = 0; lists[i]; i++) {
-		list->count += lists[i]->count;
+struct track_list* track_list_merge(struct track_list **lists) {
+	struct track_list_builder builder = { .region = NULL };
+
+	size_t count = 0;
+	for(size_t i = 0; lists[i]; i++) {
+		count += lists[i]->count;
 	}
 
-	list->entries = lmalloc(list->count * sizeof(struct track));
+	if(!track_list_builder_reserve(&builder, count)) {
+		return NULL;
+	}
 
-	size_t pos = 0;
+	bool indexed = false;
 	for(size_t i = 0; lists[i]; i++) {
-		memcpy(&(list->entries[pos]), lists[i]->entries, lists[i]->count * sizeof(struct track));
-		pos += lists[i]->count;
+		track_list_builder_append(&builder, lists[i]);
+		indexed |= (NULL != lists[i]->index);
+	}
+
+	struct track_list *list = track_list_builder_finish(&builder);
+	if(indexed) {
+		track_list_index(list);
+	}
+
+	return list;
+}
+
+/** \brief A position within one of the lists merged by track_list_merge_sorted() */
+struct track_list_cursor {
+	time_t created_at;       ///< The creation time of the track at `pos`
+	size_t order;            ///< The position of `list` within the lists merged, ordering tracks created at the same time
+	struct track_list *list;
+	size_t pos;
+};
+
+/** \brief `true` if the current track of `c1` precedes the one of `c2` (the more recently created one first) */
+static inline bool track_list_cursor_precedes(const struct track_list_cursor *c1, const struct track_list_cursor *c2) {
+	return c1->created_at != c2->created_at ? c1->created_at > c2->created_at : c1->order < c2->order;
+}
+
+/** \brief Move the cursor at `pos` down the (binary) heap, until its track precedes the ones of its children */
+static void track_list_cursor_sift_down(struct track_list_cursor *heap, size_t size, size_t pos) {
+	const struct track_list_cursor cursor = heap[pos];
+	for(size_t child; (child = 2 * pos + 1) < size; pos = child) {
+		if(child + 1 < size && track_list_cursor_precedes(&heap[child + 1], &heap[child])) {
+			child++;
+		}
+		if(!track_list_cursor_precedes(&heap[child], &cursor)) {
+			break;
+		}
+		heap[pos] = heap[child];
+	}
+	heap[pos] = cursor;
+}
+
+static bool track_list_is_sorted(struct track_list *list) {
+	for(size_t i = 1; i < list->count; i++) {
+		if(TRACK(list, i - 1)->created_at < TRACK(list, i)->created_at) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** \brief Add `track_id` to a set of track_ids (the table `track_ids` of an index)
+ *
+ *  \return `true` if added, `false` if the set contains `track_id` already
+ */
+static bool track_index_add_id(struct track_index *index, int track_id) {
+	size_t slot = track_index_bucket(index, (uint32_t) track_id);
+	for(; index->track_ids[slot].pos; slot = (slot + 1) & (index->capacity - 1)) {
+		if((uint32_t) track_id == index->track_ids[slot].key) {
+			return false;
+		}
+	}
+	index->track_ids[slot].key = (uint32_t) track_id;
+	index->track_ids[slot].pos = 1;
+	return true;
+}
+
+struct track_list* track_list_merge_sorted(struct track_list **lists) {
+	size_t list_count = 0;
+	size_t count = 0;
+	bool indexed = false;
+	for(; lists[list_count]; list_count++) {
+		count   += lists[list_count]->count;
+		indexed |= (NULL != lists[list_count]->index);
+
+		if(!track_list_is_sorted(lists[list_count])) {
+			_log("list `%s` is not sorted, sorting before merging", lists[list_count]->name ? lists[list_count]->name : "");
+			track_list_sort(lists[list_count]);
+		}
+	}
+
+	// the track_ids merged are kept in a set (only the table `track_ids` is used), such that duplicates are detected in constant time
+	struct track_list_builder builder = { .region = NULL };
+	struct track_index seen = { .capacity = 0 };
+	struct track_list_cursor *heap = lmalloc((list_count ? list_count : 1) * sizeof(struct track_list_cursor));
+	if(!heap || !track_index_resize(&seen, count) || !track_list_builder_reserve(&builder, count)) {
+		free(seen.permalinks);
+		free(seen.track_ids);
+		free(heap);
+		track_list_builder_discard(&builder);
+		return NULL;
+	}
+
+	size_t heap_size = 0;
+	for(size_t i = 0; i < list_count; i++) {
+		if(lists[i]->count) {
+			heap[heap_size++] = (struct track_list_cursor) { .created_at = TRACK(lists[i], 0)->created_at, .order = i, .list = lists[i], .pos = 0 };
+		}
+	}
+	for(size_t i = heap_size / 2; i-- > 0; ) {
+		track_list_cursor_sift_down(heap, heap_size, i);
+	}
+
+	size_t duplicates = 0;
+	while(heap_size) {
+		struct track_list_cursor *first = &heap[0];
+		const int track_id = TRACK(first->list, first->pos)->track_id;
+
+		// track_id 0 denotes a track_id not known (p.x. from an outdated cache), such tracks are never dropped
+		if(!track_id || track_index_add_id(&seen, track_id)) {
+			memcpy(&builder.region[builder.count], &first->list->entries[first->pos], sizeof(struct track));
+			track_ref_strings(&builder.region[builder.count++], 1);
+		} else {
+			duplicates++;
+		}
+
+		if(++first->pos < first->list->count) {
+			first->created_at = TRACK(first->list, first->pos)->created_at;
+		} else {
+			heap[0] = heap[--heap_size];
+		}
+		if(heap_size) {
+			track_list_cursor_sift_down(heap, heap_size, 0);
+		}
 	}
+	free(heap);
+	free(seen.permalinks);
+	free(seen.track_ids);
 
+	_log("merged %zu lists: %zu tracks, %zu duplicates dropped", list_count, builder.count, duplicates);
+
+	struct track_list *list = track_list_builder_finish(&builder);
+	if(indexed) {
+		track_list_index(list);
+	}
 	return list;
 }
 
+/** \brief The byte of the sort key of an entry at `shift`: ascending keys order the most recent track first */
+static inline unsigned int track_hot_digit(const struct track_hot *hot, unsigned int shift) {
+	const uint64_t key = ~((uint64_t) hot->created_at ^ ((uint64_t) 1 << 63));
+	return (unsigned int) (key >> shift) & 0xff;
+}
+
+/** \brief Sort the entries of a hot view by creation time (the most recent track first)
+ *
+ *  A LSD radix sort, byte by byte (skipping the bytes all entries share): stable, such that tracks created at the
+ *  same time keep their order.
+ *
+ *  \return `true` on success, `false` otherwise (the view is left unmodified)
+ */
+static bool track_hot_sort(struct track_list_hot *hot) {
+	struct track_hot *buffer = lmalloc((hot->count ? hot->count : 1) * sizeof(struct track_hot));
+	if(!buffer) {
+		return false;
+	}
+
+	struct track_hot *src = hot->entries;
+	struct track_hot *dst = buffer;
+	for(unsigned int shift = 0; shift < 64 && hot->count; shift += 8) {
+		size_t offsets[256] = { 0 };
+		for(size_t i = 0; i < hot->count; i++) {
+			offsets[track_hot_digit(&src[i], shift)]++;
+		}
+		if(hot->count == offsets[track_hot_digit(&src[0], shift)]) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for(size_t digit = 0; digit < 256; digit++) {
+			const size_t count = offsets[digit];
+			offsets[digit] = offset;
+			offset += count;
+		}
+
+		for(size_t i = 0; i < hot->count; i++) {
+			dst[offsets[track_hot_digit(&src[i], shift)]++] = src[i];
+		}
+
+		struct track_hot *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// keep whichever buffer holds the result
+	free(dst);
+	hot->entries = src;
+	return true;
+}
+
 void track_list_sort(struct track_list *list) {
-	qsort(list->entries, list->count, sizeof(struct track), entry_compare);
+	// sort the (small) entries of a hot view instead of the tracks, each track is moved once afterwards
+	struct track_list_hot temp = { .count = 0 };
+	struct track_list_hot *hot = &temp;
+	if(!track_hot_fill(hot, list) || !track_hot_sort(hot)) {
+		free(hot->entries);
+		qsort(list->entries, list->count, sizeof(struct track), entry_compare);
+		track_index_rebuild(list);
+		trigram_index_rebuild(list);
+		view_base_rebuild(list);
+		return;
+	}
+
+	// the entry at `hot->entries[i].pos` belongs to position i: move the entries cycle by cycle
+	for(size_t i = 0; i < list->count; i++) {
+		if(i == hot->entries[i].pos) {
+			continue;
+		}
+
+		const struct track first = list->entries[i];
+		size_t pos = i;
+		while(i != hot->entries[pos].pos) {
+			const size_t from = hot->entries[pos].pos;
+			list->entries[pos] = list->entries[from];
+			hot->entries[pos].pos = (uint32_t) pos;
+			pos = from;
+		}
+		list->entries[pos] = first;
+		hot->entries[pos].pos = (uint32_t) pos;
+	}
+
+	free(hot->entries);
+	track_index_rebuild(list);
+	trigram_index_rebuild(list);
+	view_base_rebuild(list);
 }
 
 bool track_list_append(struct track_list *target, struct track_list *source) {
-	struct track *new_entries = lrealloc(target->entries, (target->count + source->count) * sizeof(struct track));
-	if(!new_entries) return false;
-
-	target->entries = new_entries;
+	if(!track_list_reserve(target, target->count + source->count)) return false;
 
-	memcpy(&target->entries[target->count], &source->entries[0], source->count * sizeof(struct track));
+	if(source->count) {
+		memcpy(&target->entries[target->count], &source->entries[0], source->count * sizeof(struct track));
+		track_ref_strings(&target->entries[target->count], source->count);
+	}
 
 	target->count += source->count;
 
+	track_index_update(target);
+
 	return true;
 }
 
-// TODO: speed!
 struct track* track_list_get(struct track_list *list, char *permalink) {
+	struct track_index *index = list->index;
+	if(index) {
+		const uint32_t hash = track_index_hash(permalink);
+		for(size_t slot = track_index_bucket(index, hash); index->permalinks[slot].pos; slot = (slot + 1) & (index->capacity - 1)) {
+			const size_t pos = index->permalinks[slot].pos - 1;
+			if(hash == index->permalinks[slot].key && !strcmp(TRACK(list, pos)->permalink_url, permalink)) {
+				return &list->entries[pos];
+			}
+		}
+		return NULL;
+	}
+
 	for(size_t i = 0; i < list->count; i++) {
 		if(!strcmp(TRACK(list, i)->permalink_url, permalink)) {
 			return &list->entries[i];
@@ -117,6 +719,26 @@ struct track* track_list_get(struct track_list *list, char *permalink) {
 	return NULL;
 }
 
+struct track* track_list_get_by_id(struct track_list *list, int track_id) {
+	struct track_index *index = list->index;
+	if(index) {
+		for(size_t slot = track_index_bucket(index, (uint32_t) track_id); index->track_ids[slot].pos; slot = (slot + 1) & (index->capacity - 1)) {
+			const size_t pos = index->track_ids[slot].pos - 1;
+			if((uint32_t) track_id == index->track_ids[slot].key && track_id == TRACK(list, pos)->track_id) {
+				return &list->entries[pos];
+			}
+		}
+		return NULL;
+	}
+
+	for(size_t i = 0; i < list->count; i++) {
+		if(track_id == TRACK(list, i)->track_id) {
+			return &list->entries[i];
+		}
+	}
+	return NULL;
+}
+
 void track_list_href_to(struct track_list *list, struct track_list *target) {
 	for(size_t i = 0; i < target->count; i++) {
 		struct track *strack = track_list_get(list, TRACK(target, i)->permalink_url);
@@ -130,15 +752,23 @@ void track_list_href_to(struct track_list *list, struct track_list *target) {
 	}
 }
 
+void track_list_href_move(struct track_list *list, const struct track *from, size_t count, struct track *to) {
+	if(list->view) {
+		return;
+	}
+
+	for(size_t i = 0; i < list->count; i++) {
+		struct track *entry = &list->entries[i];
+		if(!entry->name && entry->href >= from && entry->href < from + count) {
+			entry->href = to + (entry->href - from);
+		}
+	}
+}
+
 void track_destroy(struct track *track) {
+	// the strings are interned (see strpool.h): release them, the URLs extracted from the description are owned by the track
+	track_unref_strings(track, 1);
 	if(track->name) {
-		free(track->name);
-		free(track->download_url);
-		free(track->stream_url);
-		free(track->permalink_url);
-		free(track->username);
-		free(track->description);
-
 		if(track->urls) {
 			for(size_t i = 0; i < track->url_count; i++) {
 				free(track->urls[i]);
@@ -151,13 +781,22 @@ void track_destroy(struct track *track) {
 void track_list_destroy(struct track_list *list, bool free_trackdata) {
 	if(!list) return;
 
+	// a view does not own the tracks of its base (it is empty afterwards)
+	view_destroy(list);
+
 	if(free_trackdata) {
 		for(size_t i = 0; i < list->count; i++) {
 			track_destroy(&list->entries[i]);
 		}
+	} else {
+		track_unref_strings(list->entries, list->count);
 	}
 
-	free(list->entries);
+	track_index_destroy(list);
+	trigram_index_destroy(list);
+	if(list->capacity) {
+		free(list->entries - list->headroom);
+	}
 	free(list->name);
 	free(list);
 }
@@ -168,18 +807,10 @@ void track_list_dump_mem_usage(struct track_list *list) {
 
 	mem += strlen(list->name) + 1;
 
-	for(size_t i = 0; i < list->count; i++) {
-		struct track *track = &list->entries[i];
-		if(track->name) {
-			mem += strlen(track->name) + 1;
+	// the strings are shared among the lists: report the pool as a whole
+	struct strpool_stats stats;
+	strpool_get_stats(&stats);
 
-			if(track->stream_url)    mem += strlen(track->stream_url)    + 1;
-			if(track->permalink_url) mem += strlen(track->permalink_url) + 1;
-			if(track->download_url)  mem += strlen(track->download_url)  + 1;
-			if(track->username)      mem += strlen(track->username)      + 1;
-			if(track->description)   mem += strlen(track->description)   + 1;
-		}
-	}
-	_log("List `%s` occupies %zukB", list->name, mem / 1024);
+	_log("List `%s` occupies %zukB, the string pool %zukB (%zu strings for %zu requests)", list->name, mem / 1024, stats.bytes / 1024, stats.strings, stats.requests);
 }
 #endif
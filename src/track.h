@@ -51,9 +51,12 @@
 	/// this track is currently being downloaded
 	#define FLAG_DOWNLOADING 32
 
+	/// this track was played (since starting SCTC)
+	#define FLAG_PLAYED      64
+
 	#define URL_COUNT_UNINITIALIZED ( (size_t) -1 )
 
-	#define TRACK(LST, ID) (LST->entries[ID].name ? &LST->entries[ID] : LST->entries[ID].href)
+	#define TRACK(LST, ID) track_list_entry(LST, ID)
 
 	/** \brief The basic datastructure representing a single track
 	 *
@@ -71,6 +74,11 @@
 	 *      the actual data.
 	 *      \warning For a reference track, you must not try to access any members, except from
 	 *               `name` (which is `NULL`) and `href` (a valid ptr to a normal track)
+	 *
+	 *  The strings of a normal track (`name`, the URLs, `username` and `description`) are interned (see strpool.h):
+	 *  they are shared with other tracks and must not be modified. Each list holds a reference to the strings of
+	 *  its entries: copying entries into a list via track_list_*() adds one, removing or destroying them releases it.
+	 *  Entries added via track_list_builder_add() are filled in with the references returned by strpool_intern().
 	 */
 	struct track {
 		char   *name; ///< the tracks name
@@ -86,7 +94,7 @@
 
 				char   *download_url; ///< The URL pointing to the download. Might be NULL, if the uploader does not provide a download.
 				char   *username; ///< The username
-				char   *description;
+				char   *description; ///< The description, `NULL` if there is none or if it is kept in the store (see descstore_get())
 				time_t created_at;
 				int    duration; ///< duration in seconds
 				int    user_id;
@@ -102,12 +110,96 @@
 		};
 	};
 
+	struct track_index;
+	struct trigram_index;
+	struct view_filter;
+
+	/** \brief A view: the positions of the entries of another list (the base) matching a filter, in some order
+	 *
+	 *  The positions are relative to the entries of the base at the time of the last update: the entries prepended
+	 *  to the base since then are not part of the view, but shift the positions (see track_list_entry()).
+	 *  See view.h for creating and updating views.
+	 */
+	struct track_list_view {
+		struct track_list *base;       ///< The list viewed, `NULL` once destroyed (the view is empty then)
+		uint32_t *positions;           ///< The positions of the entries within the base, one per entry of the view
+		size_t capacity;               ///< The number of positions allocated
+		size_t covered;                ///< The number of entries of the base considered by the last update
+		size_t prepended;              ///< `prepended` of the base at the time of the last update
+		struct view_filter *filter;    ///< The filter (and the order) of the view
+		struct track_list *next;       ///< The next view of the same base (see track_list.views)
+	};
+
 	struct track_list {
 		char   *name;
-		size_t count;
+		size_t count;                  ///< The number of entries (the number of positions for a view)
+		size_t capacity;           ///< The number of entries allocated (starting at `entries`)
+		size_t headroom;           ///< The number of entries allocated in front of `entries` (see track_list_reserve_front())
 		struct track *entries;
+		struct track_index *index; ///< The (optional) hash index of the entries, `NULL` if the list is not indexed (see track_list_index())
+		struct trigram_index *trigram; ///< The (optional) trigram index of the entries, `NULL` if there is none (see trigram.h)
+		size_t prepended;              ///< The number of entries prepended since creating the list (see track_list_prepend())
+		struct track_list_view *view;  ///< `NULL` for a list holding entries, the view for a view (`entries` is `NULL` then)
+		struct track_list *views;      ///< The views of this list, `NULL` if there are none
+	};
+
+	/** \brief Get the (normal) track at a position of a list, resolving views and reference tracks
+	 *
+	 *  \param list  The list
+	 *  \param pos   The position, less than `list->count`
+	 *  \return      The track
+	 */
+	static inline struct track* track_list_entry(const struct track_list *list, size_t pos) {
+		const struct track_list_view *view = list->view;
+		struct track *entry = view
+		                    ? &view->base->entries[view->positions[pos] + (view->base->prepended - view->prepended)]
+		                    : &list->entries[pos];
+		return entry->name ? entry : entry->href;
+	}
+
+	/** \brief Builds a single track_list, appending the entries to a growing region
+	 *
+	 *  Initialize using `{ .region = NULL }`. Once finished, the region holds the entries of the list: these are
+	 *  allocated apart from the list, such that adding entries later on grows them like those of any other list.
+	 */
+	struct track_list_builder {
+		struct track *region;             ///< The entries added, `NULL` until the first one is added
+		size_t count;                     ///< The number of entries added
+		size_t capacity;                  ///< The number of entries fitting into the region
 	};
 
+	/** \brief Add a new (zeroed) entry to the list being built
+	 *
+	 *  The pointer returned is valid until the next call to any track_list_builder_*() function.
+	 *
+	 *  \param builder  The builder
+	 *  \return         The new entry, `NULL` in case of a failing malloc
+	 */
+	struct track* track_list_builder_add(struct track_list_builder *builder) ATTR(nonnull);
+
+	/** \brief Append (copies of) all entries of a list to the list being built
+	 *
+	 *  \param builder  The builder
+	 *  \param source   The list to append, not modified
+	 *  \return         `true` on success, `false` otherwise
+	 */
+	bool track_list_builder_append(struct track_list_builder *builder, struct track_list *source) ATTR(nonnull);
+
+	/** \brief Finish building: shrink the region to the entries added and turn it into a list
+	 *
+	 *  The builder is reset and may be used for building another list.
+	 *
+	 *  \param builder  The builder
+	 *  \return         The list (without a name), pass to track_list_destroy() if no longer needed, `NULL` in case of a failing malloc
+	 */
+	struct track_list* track_list_builder_finish(struct track_list_builder *builder) ATTR(nonnull);
+
+	/** \brief Drop the list being built
+	 *
+	 *  \param builder  The builder
+	 */
+	void track_list_builder_discard(struct track_list_builder *builder) ATTR(nonnull);
+
 	struct track_list* track_list_create(char *name) ATTR(nonnull);
 
 	/** \brief Add a single track to an existing track_list
@@ -117,6 +209,30 @@
 	 */
 	bool track_list_add(struct track_list *list, struct track *track);
 
+	/** \brief Make room for prepending up to `count` entries (see track_list_prepend())
+	 *
+	 *  Moves the entries to a new allocation: call before handing out pointers to any of them, or keep the former
+	 *  entries (passing `former`) until no pointer to them is left.
+	 *  The headroom is allocated, but not touched: it does not occupy any memory until used.
+	 *
+	 *  \param list    The list
+	 *  \param count   The number of entries to make room for
+	 *  \param former  `NULL` to release the former entries, otherwise receives their allocation (pass to free() once no longer referenced)
+	 *  \return        `true` on success, `false` otherwise (the list is left unmodified)
+	 */
+	bool track_list_reserve_front(struct track_list *list, size_t count, struct track **former) ATTR(nonnull(1));
+
+	/** \brief Insert (copies of) all entries of a list in front of the entries of another list
+	 *
+	 *  The entries of `target` are not moved: pointers to them stay valid (in contrast to positions, which are
+	 *  shifted by `source->count`). Requires the room reserved by track_list_reserve_front().
+	 *
+	 *  \param target  The list receiving the entries
+	 *  \param source  The list to prepend, not modified
+	 *  \return        `true` on success, `false` if the room left in front of `target` is insufficient
+	 */
+	bool track_list_prepend(struct track_list *target, struct track_list *source) ATTR(nonnull);
+
 	/** \brief Merge an array of track_lists
 	 *
 	 *  The resulting list is not sorted, entries from all lists are simply concatinated.
@@ -128,7 +244,23 @@
 	 */
 	struct track_list* track_list_merge(struct track_list **lists);
 
+	/** \brief Merge an array of track_lists sorted by creation time (the most recent track first), dropping duplicates
+	 *
+	 *  Takes O(n log k) for n tracks within k lists, using a single allocation for the entries. Tracks sharing
+	 *  a track_id with a track merged before are dropped (tracks with track_id 0 are always kept), tracks created
+	 *  at the same time are ordered by the position of their list within `lists`.
+	 *  A list not sorted is sorted (in place) before merging. The lists are not modified otherwise, the struct
+	 *  tracks' members are not duplicated (see track_list_merge()).
+	 *
+	 *  \param lists  A NULL-terminated array containing the track_lists to be merged into one
+	 *  \return       A new (sorted) list, indexed if any of the merged lists is, `NULL` in case of a failing malloc
+	 */
+	struct track_list* track_list_merge_sorted(struct track_list **lists) ATTR(nonnull);
+
 	/** \brief Sort a track_list by creation time
+	 *
+	 *  Radix sorts a compact copy of the creation times (and positions) and moves each entry once afterwards,
+	 *  taking O(n) for n tracks. Tracks created at the same time keep their order.
 	 *
 	 *  \param list  The list to be sorted
 	 */
@@ -141,24 +273,57 @@
 	bool track_list_append(struct track_list *target, struct track_list *source);
 
 	/** \brief Check if list contains a track, identified by its permalink and return it
+	 *
+	 *  Takes constant time if the list is indexed, linear time otherwise.
 	 *
 	 *  \param list       The list to search in
 	 *  \param permalink  The permalink to use for searching
-	 *  \return           The track, if found, `NULL` otherwise
+	 *  \return           The (first) track, if found, `NULL` otherwise
 	 */
 	struct track* track_list_get(struct track_list *list, char *permalink);
 
+	/** \brief Check if list contains a track, identified by its track_id and return it
+	 *
+	 *  Takes constant time if the list is indexed, linear time otherwise.
+	 *
+	 *  \param list      The list to search in
+	 *  \param track_id  The track_id to use for searching
+	 *  \return          The (first) track, if found, `NULL` otherwise
+	 */
+	struct track* track_list_get_by_id(struct track_list *list, int track_id);
+
+	/** \brief Attach a hash index (keyed on permalink and track_id) to a list
+	 *
+	 *  The index is kept up to date by track_list_add(), track_list_append(), track_list_del() and
+	 *  track_list_sort(), a list created by track_list_merge() is indexed if any of the merged lists is.
+	 *  Modifying `entries` (or `count`) directly requires calling track_list_index() again.
+	 *
+	 *  \param list  The list to index
+	 *  \return      `true` on success, `false` otherwise (the list stays usable, but is not indexed)
+	 */
+	bool track_list_index(struct track_list *list) ATTR(nonnull);
+
 	/** \brief Free the memory occupied by a track_list.
 	 *
 	 *  Do not use the list after calling this function. Do not use any of the tracks within the list if `free_trackdata` is set to true.
+	 *  The references to the strings of the entries are released in any case (see struct track).
 	 *  When NULL is passed nothing happens.
 	 *
 	 *  \param list            the list to free
-	 *  \param free_trackdata  if true every single track within the list will be freed too
+	 *  \param free_trackdata  if true every single track within the list will be freed too (see track_destroy())
 	 */
 	void track_list_destroy(struct track_list *list, bool free_trackdata);
 
 	void track_list_href_to(struct track_list *list, struct track_list *target);
+
+	/** \brief Redirect the reference tracks of a list referring to moved entries (see track_list_reserve_front())
+	 *
+	 *  \param list   The list containing reference tracks, views are skipped
+	 *  \param from   The former location of the entries
+	 *  \param count  The number of entries moved
+	 *  \param to     The new location of the entries
+	 */
+	void track_list_href_move(struct track_list *list, const struct track *from, size_t count, struct track *to) ATTR(nonnull);
 	bool track_list_del(struct track_list *list, size_t track_id);
 	void track_destroy(struct track *track);
 
@@ -0,0 +1,738 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file trigram.c
+ *  \brief Implementation of the trigram index
+ *
+ *  The postings of a build are stored as a single array of positions, sorted by trigram and position (produced by
+ *  radix sorting (trigram, position) pairs). Positions refer to the entries at the time of the snapshot: entries
+ *  deleted since are recorded (sorted) and skipped, the positions of the remaining ones are shifted accordingly.
+ */
+
+#include "_hard_config.h"
+#include "trigram.h"
+
+//\cond
+#include <errno.h>                      // for errno
+#include <pthread.h>                    // for pthread_mutex_lock, etc
+#include <semaphore.h>                  // for sem_post, sem_wait, etc
+#include <stdint.h>                     // for uint32_t, uint64_t
+#include <stdlib.h>                     // for free, qsort, atexit
+#include <string.h>                     // for memmove, strcasestr, strlen
+//\endcond
+
+#include "descstore.h"                  // for descstore_read
+#include "helper.h"                     // for lmalloc, lcalloc, lrealloc
+#include "log.h"                        // for _log, _err
+#include "strpool.h"                    // for strpool_ref, strpool_unref
+
+/** \brief The number of tracks added or deleted since the snapshot, starting a rebuild of the index */
+#define TRIGRAM_REBUILD_THRESHOLD 4096
+
+/** \brief The postings of a single build */
+struct trigram_postings {
+	size_t    count;     ///< The number of entries (from the start of the list) indexed at the time of the snapshot
+	size_t    key_count; ///< The number of distinct trigrams
+	uint32_t *keys;      ///< The trigrams, sorted
+	uint32_t *offsets;   ///< The positions of `keys[i]` are `positions[offsets[i]]` to `positions[offsets[i + 1] - 1]`
+	uint32_t *positions;
+};
+
+struct trigram_index {
+	pthread_mutex_t mutex;
+	unsigned int refs;                ///< The number of references: the list and the pending build (if any)
+	unsigned int generation;          ///< Incremented once entries are moved: a build of an older generation is dropped
+	bool building;                    ///< A build is pending
+	struct trigram_postings *built;   ///< The result of the last build, not adopted yet
+
+	/* not guarded by mutex: owned by the thread modifying the list */
+	struct trigram_postings *postings; ///< The postings in use, `NULL` if none
+	size_t *deleted;                  ///< The (snapshot) positions of the entries deleted since the snapshot, sorted
+	size_t  deleted_count;
+	size_t  deleted_capacity;
+};
+
+/** \brief The strings of an entry, taken on creating a snapshot (holding a reference to each, see strpool.h) */
+struct trigram_source {
+	const char *name;
+	const char *username;
+	const char *description;
+	int         track_id;
+};
+
+/** \brief A snapshot of a list, to be indexed */
+struct trigram_job {
+	struct trigram_index  *index;
+	unsigned int           generation;
+	size_t                 count;
+	struct trigram_source *sources;
+	struct trigram_job    *next;
+};
+
+static void trigram_finalize(void);
+
+static bool index_descriptions = false;
+
+static pthread_t thread_trigram;
+static bool      thread_trigram_valid = false;
+
+static sem_t have_job;
+static sem_t sem_job_queue;
+
+static struct trigram_job *head = NULL;
+static struct trigram_job *tail = NULL;
+
+static volatile bool terminate = false;
+
+/** \brief Case-fold a single byte (ASCII only, matching strcasestr()) */
+static inline uint32_t trigram_fold(char c) {
+	return (uint32_t) (unsigned char) (('A' <= c && c <= 'Z') ? c - 'A' + 'a' : c);
+}
+
+/** \brief A growing array of trigrams */
+struct trigram_keys {
+	uint32_t *keys;
+	size_t    count;
+	size_t    capacity;
+};
+
+/** \brief Append the trigrams of a string
+ *
+ *  \return `true` on success, `false` in case of a failing malloc
+ */
+static bool trigram_keys_add(struct trigram_keys *keys, const char *str) {
+	if(!str) {
+		return true;
+	}
+
+	const size_t len = strlen(str);
+	if(len < 3) {
+		return true;
+	}
+
+	if(keys->count + len - 2 > keys->capacity) {
+		const size_t capacity = 2 * (keys->count + len);
+		uint32_t *grown = lrealloc(keys->keys, capacity * sizeof(uint32_t));
+		if(!grown) {
+			return false;
+		}
+		keys->keys     = grown;
+		keys->capacity = capacity;
+	}
+
+	uint32_t key = trigram_fold(str[0]) << 8 | trigram_fold(str[1]);
+	for(size_t i = 2; i < len; i++) {
+		key = (key << 8 | trigram_fold(str[i])) & 0xFFFFFF;
+		keys->keys[keys->count++] = key;
+	}
+	return true;
+}
+
+static int trigram_key_compare(const void *v1, const void *v2) {
+	const uint32_t k1 = *(const uint32_t*) v1;
+	const uint32_t k2 = *(const uint32_t*) v2;
+	return (k1 > k2) - (k1 < k2);
+}
+
+/** \brief Sort the trigrams and drop the duplicates */
+static void trigram_keys_unique(struct trigram_keys *keys) {
+	if(keys->count < 2) {
+		return;
+	}
+
+	qsort(keys->keys, keys->count, sizeof(uint32_t), trigram_key_compare);
+
+	size_t unique = 1;
+	for(size_t i = 1; i < keys->count; i++) {
+		if(keys->keys[i] != keys->keys[unique - 1]) {
+			keys->keys[unique++] = keys->keys[i];
+		}
+	}
+	keys->count = unique;
+}
+
+static void trigram_postings_destroy(struct trigram_postings *postings) {
+	if(postings) {
+		free(postings->keys);
+		free(postings->offsets);
+		free(postings->positions);
+		free(postings);
+	}
+}
+
+/** \brief Stable radix sort of (trigram << 32 | position) pairs by trigram (24 bits, 8 bits per pass)
+ *
+ *  \return The array holding the sorted pairs (either `pairs` or `temp`)
+ */
+static uint64_t* trigram_pairs_sort(uint64_t *pairs, uint64_t *temp, size_t count) {
+	for(unsigned int shift = 32; shift < 56; shift += 8) {
+		size_t offsets[256] = { 0 };
+		for(size_t i = 0; i < count; i++) {
+			offsets[(pairs[i] >> shift) & 0xFF]++;
+		}
+
+		size_t sum = 0;
+		for(size_t digit = 0; digit < 256; digit++) {
+			const size_t digit_count = offsets[digit];
+			offsets[digit] = sum;
+			sum += digit_count;
+		}
+
+		for(size_t i = 0; i < count; i++) {
+			temp[offsets[(pairs[i] >> shift) & 0xFF]++] = pairs[i];
+		}
+
+		uint64_t *swap = pairs;
+		pairs = temp;
+		temp  = swap;
+	}
+	return pairs;
+}
+
+/** \brief Build the postings of a snapshot
+ *
+ *  \return The postings, `NULL` in case of a failing malloc (or if terminating)
+ */
+static struct trigram_postings* trigram_build(const struct trigram_source *sources, size_t count) {
+	struct trigram_keys keys  = { .keys = NULL };
+	uint64_t *pairs  = NULL;
+	size_t pair_count    = 0;
+	size_t pair_capacity = 0;
+
+	// a single buffer for all of the descriptions read
+	char  *buffer      = NULL;
+	size_t buffer_size = 0;
+
+	for(size_t i = 0; i < count && !terminate; i++) {
+		keys.count = 0;
+
+		bool success = trigram_keys_add(&keys, sources[i].name) && trigram_keys_add(&keys, sources[i].username);
+		if(success && index_descriptions) {
+			struct track track = { .name = "", .description = (char*) (intptr_t) sources[i].description, .track_id = sources[i].track_id };
+			success = trigram_keys_add(&keys, descstore_read(&track, &buffer, &buffer_size));
+		}
+		trigram_keys_unique(&keys);
+
+		if(success && pair_count + keys.count > pair_capacity) {
+			const size_t capacity = 2 * (pair_count + keys.count);
+			uint64_t *grown = lrealloc(pairs, capacity * sizeof(uint64_t));
+			if(grown) {
+				pairs         = grown;
+				pair_capacity = capacity;
+			}
+			success = (NULL != grown);
+		}
+
+		if(!success) {
+			free(buffer);
+			free(keys.keys);
+			free(pairs);
+			return NULL;
+		}
+
+		for(size_t j = 0; j < keys.count; j++) {
+			pairs[pair_count++] = (uint64_t) keys.keys[j] << 32 | i;
+		}
+	}
+	free(buffer);
+	free(keys.keys);
+
+	struct trigram_postings *postings = lcalloc(1, sizeof(struct trigram_postings));
+	uint64_t *temp = lmalloc((pair_count ? pair_count : 1) * sizeof(uint64_t));
+	if(terminate || !postings || !temp) {
+		free(temp);
+		free(pairs);
+		free(postings);
+		return NULL;
+	}
+
+	uint64_t *sorted = trigram_pairs_sort(pairs, temp, pair_count);
+
+	size_t key_count = 0;
+	for(size_t i = 0; i < pair_count; i++) {
+		key_count += (!i || (sorted[i] >> 32) != (sorted[i - 1] >> 32));
+	}
+
+	postings->count     = count;
+	postings->key_count = key_count;
+	postings->keys      = lmalloc((key_count ? key_count : 1) * sizeof(uint32_t));
+	postings->offsets   = lmalloc((key_count + 1) * sizeof(uint32_t));
+	postings->positions = lmalloc((pair_count ? pair_count : 1) * sizeof(uint32_t));
+	if(postings->keys && postings->offsets && postings->positions) {
+		size_t key = 0;
+		for(size_t i = 0; i < pair_count; i++) {
+			if(!i || (sorted[i] >> 32) != (sorted[i - 1] >> 32)) {
+				postings->keys[key]    = (uint32_t) (sorted[i] >> 32);
+				postings->offsets[key] = (uint32_t) i;
+				key++;
+			}
+			postings->positions[i] = (uint32_t) sorted[i];
+		}
+		postings->offsets[key_count] = (uint32_t) pair_count;
+	} else {
+		trigram_postings_destroy(postings);
+		postings = NULL;
+	}
+
+	free(pairs);
+	free(temp);
+	return postings;
+}
+
+/** \brief Drop a reference to an index, freeing it once unreferenced */
+static void trigram_index_unref(struct trigram_index *index) {
+	pthread_mutex_lock(&index->mutex);
+	const bool unreferenced = !--index->refs;
+	pthread_mutex_unlock(&index->mutex);
+
+	if(unreferenced) {
+		trigram_postings_destroy(index->built);
+		trigram_postings_destroy(index->postings);
+		free(index->deleted);
+		pthread_mutex_destroy(&index->mutex);
+		free(index);
+	}
+}
+
+/** \brief Release the strings of a snapshot and free it */
+static void trigram_job_destroy(struct trigram_job *job) {
+	for(size_t i = 0; i < job->count; i++) {
+		strpool_unref(job->sources[i].name);
+		strpool_unref(job->sources[i].username);
+		strpool_unref(job->sources[i].description);
+	}
+	free(job->sources);
+	free(job);
+}
+
+/** \brief Build the index of a snapshot and publish it (unless the entries were moved meanwhile) */
+static void trigram_job_execute(struct trigram_job *job) {
+	struct trigram_postings *postings = trigram_build(job->sources, job->count);
+
+	pthread_mutex_lock(&job->index->mutex);
+	if(postings && job->generation == job->index->generation && job->index->refs > 1) {
+		trigram_postings_destroy(job->index->built);
+		job->index->built = postings;
+		postings = NULL;
+	}
+	job->index->building = false;
+	pthread_mutex_unlock(&job->index->mutex);
+
+	trigram_postings_destroy(postings);
+	trigram_index_unref(job->index);
+	trigram_job_destroy(job);
+}
+
+static struct trigram_job* trigram_dequeue(void) {
+	sem_wait(&sem_job_queue);
+	struct trigram_job *job = head;
+	head = job->next;
+
+	if(job == tail) {
+		tail = NULL;
+	}
+	sem_post(&sem_job_queue);
+
+	return job;
+}
+
+/** \brief Take a snapshot of a list and build its index (in the background, if started)
+ *
+ *  \return `true` on success, `false` in case of a failing malloc
+ */
+static bool trigram_schedule(struct track_list *list) {
+	struct trigram_index *index = list->trigram;
+
+	struct trigram_job *job = lcalloc(1, sizeof(struct trigram_job));
+	struct trigram_source *sources = lmalloc((list->count ? list->count : 1) * sizeof(struct trigram_source));
+	if(!job || !sources || list->count > UINT32_MAX) {
+		free(job);
+		free(sources);
+		return false;
+	}
+
+	for(size_t i = 0; i < list->count; i++) {
+		const struct track *track = TRACK(list, i);
+		sources[i] = (struct trigram_source) {
+			.name        = strpool_ref(track->name),
+			.username    = strpool_ref(track->username),
+			.description = strpool_ref(track->description),
+			.track_id    = track->track_id
+		};
+	}
+
+	pthread_mutex_lock(&index->mutex);
+	index->refs++;
+	index->building = true;
+	job->generation = index->generation;
+	pthread_mutex_unlock(&index->mutex);
+
+	job->index   = index;
+	job->count   = list->count;
+	job->sources = sources;
+
+	if(!thread_trigram_valid) {
+		trigram_job_execute(job);
+		return true;
+	}
+
+	sem_wait(&sem_job_queue);
+	if(tail) {
+		tail->next = job;
+	} else {
+		head = job;
+	}
+	tail = job;
+	sem_post(&sem_job_queue);
+
+	sem_post(&have_job);
+	return true;
+}
+
+/** \brief Adopt the result of a finished build
+ *
+ *  \return `true` if a build is pending, `false` otherwise
+ */
+static bool trigram_adopt(struct trigram_index *index) {
+	pthread_mutex_lock(&index->mutex);
+	struct trigram_postings *built = index->built;
+	index->built = NULL;
+	const bool building = index->building;
+	pthread_mutex_unlock(&index->mutex);
+
+	if(built) {
+		trigram_postings_destroy(index->postings);
+		index->postings      = built;
+		index->deleted_count = 0;
+	}
+	return building;
+}
+
+bool trigram_index_create(struct track_list *list) {
+	if(list->trigram) {
+		return true;
+	}
+
+	struct trigram_index *index = lcalloc(1, sizeof(struct trigram_index));
+	if(!index) {
+		return false;
+	}
+
+	pthread_mutex_init(&index->mutex, NULL);
+	index->refs   = 1;
+	list->trigram = index;
+
+	if(!trigram_schedule(list)) {
+		trigram_index_destroy(list);
+		return false;
+	}
+	return true;
+}
+
+void trigram_index_destroy(struct track_list *list) {
+	if(list->trigram) {
+		trigram_index_unref(list->trigram);
+		list->trigram = NULL;
+	}
+}
+
+/** \brief The number of entries deleted at (snapshot) positions before `orig` */
+static size_t trigram_deleted_before(const struct trigram_index *index, size_t orig) {
+	size_t lo = 0;
+	size_t hi = index->deleted_count;
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if(index->deleted[mid] < orig) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/** \brief The (snapshot) position of the entry at position `pos`, which needs to be covered by the postings */
+static size_t trigram_orig_pos(const struct trigram_index *index, size_t pos) {
+	size_t orig = pos;
+	for(size_t i = 0; i < index->deleted_count && index->deleted[i] <= orig; i++) {
+		orig++;
+	}
+	return orig;
+}
+
+/** \brief The number of entries (from the start of the list) covered by the postings */
+static size_t trigram_indexed_count(const struct trigram_index *index) {
+	return index->postings ? index->postings->count - index->deleted_count : 0;
+}
+
+void trigram_index_del(struct track_list *list, size_t pos) {
+	struct trigram_index *index = list->trigram;
+	if(!index) {
+		return;
+	}
+
+	// a snapshot taken before does not know about the entry being deleted: drop it
+	pthread_mutex_lock(&index->mutex);
+	if(index->building) {
+		index->generation++;
+	}
+	pthread_mutex_unlock(&index->mutex);
+	trigram_adopt(index);
+
+	if(pos >= trigram_indexed_count(index)) {
+		return;
+	}
+
+	if(index->deleted_count == index->deleted_capacity) {
+		const size_t capacity = index->deleted_capacity ? 2 * index->deleted_capacity : 64;
+		size_t *grown = lrealloc(index->deleted, capacity * sizeof(size_t));
+		if(!grown) {
+			// the postings cannot be kept consistent
+			trigram_index_rebuild(list);
+			return;
+		}
+		index->deleted          = grown;
+		index->deleted_capacity = capacity;
+	}
+
+	const size_t orig = trigram_orig_pos(index, pos);
+	const size_t at   = trigram_deleted_before(index, orig);
+	memmove(&index->deleted[at + 1], &index->deleted[at], (index->deleted_count - at) * sizeof(size_t));
+	index->deleted[at] = orig;
+	index->deleted_count++;
+}
+
+void trigram_index_rebuild(struct track_list *list) {
+	struct trigram_index *index = list->trigram;
+	if(!index) {
+		return;
+	}
+
+	pthread_mutex_lock(&index->mutex);
+	index->generation++;
+	trigram_postings_destroy(index->built);
+	index->built = NULL;
+	pthread_mutex_unlock(&index->mutex);
+
+	trigram_postings_destroy(index->postings);
+	index->postings      = NULL;
+	index->deleted_count = 0;
+
+	if(!trigram_schedule(list)) {
+		_err("failed to rebuild the trigram index of `%s`", list->name);
+	}
+}
+
+bool trigram_track_matches(struct track *track, const char *query, char **buffer, size_t *buffer_size) {
+	if((track->name && strcasestr(track->name, query)) || (track->username && strcasestr(track->username, query))) {
+		return true;
+	}
+
+	if(!index_descriptions) {
+		return false;
+	}
+
+	const char *description = descstore_read(track, buffer, buffer_size);
+	return description && strcasestr(description, query);
+}
+
+/** \brief Search the entries from `start` to `end` (both included) linearly */
+static bool trigram_find_linear(struct track_list *list, const char *query, size_t start, size_t end, bool down, size_t *pos) {
+	char  *buffer      = NULL;
+	size_t buffer_size = 0;
+
+	bool found = false;
+	for(size_t i = start; down ? i <= end : i >= end; down ? i++ : i--) {
+		if(trigram_track_matches(TRACK(list, i), query, &buffer, &buffer_size)) {
+			*pos  = i;
+			found = true;
+			break;
+		}
+		if(!down && !i) {
+			break;
+		}
+	}
+	free(buffer);
+	return found;
+}
+
+/** \brief Find the positions of a trigram within the postings
+ *
+ *  \return The number of positions, stored at `*positions`
+ */
+static size_t trigram_lookup(const struct trigram_postings *postings, uint32_t key, const uint32_t **positions) {
+	const uint32_t *found = bsearch(&key, postings->keys, postings->key_count, sizeof(uint32_t), trigram_key_compare);
+	if(!found) {
+		return 0;
+	}
+
+	const size_t i = (size_t) (found - postings->keys);
+	*positions = &postings->positions[postings->offsets[i]];
+	return postings->offsets[i + 1] - postings->offsets[i];
+}
+
+/** \brief `true` if the (sorted) positions contain `orig` */
+static bool trigram_positions_contain(const uint32_t *positions, size_t count, uint32_t orig) {
+	return NULL != bsearch(&orig, positions, count, sizeof(uint32_t), trigram_key_compare);
+}
+
+/** \brief Search the entries covered by the postings, starting at `start` (which needs to be covered as well) */
+static bool trigram_find_indexed(struct track_list *list, const char *query, size_t start, bool down, size_t *pos) {
+	const struct trigram_index *index = list->trigram;
+
+	struct trigram_keys keys = { .keys = NULL };
+	if(!trigram_keys_add(&keys, query)) {
+		// searching linearly does not require any memory
+		free(keys.keys);
+		return trigram_find_linear(list, query, start, down ? trigram_indexed_count(index) - 1 : 0, down, pos);
+	}
+	trigram_keys_unique(&keys);
+
+	// the entries containing the least frequent trigram are candidates, any other trigram is checked per candidate
+	const uint32_t *lists[keys.count];
+	size_t counts[keys.count];
+	size_t shortest = 0;
+	for(size_t i = 0; i < keys.count; i++) {
+		counts[i] = trigram_lookup(index->postings, keys.keys[i], &lists[i]);
+		if(counts[i] < counts[shortest]) {
+			shortest = i;
+		}
+	}
+
+	const size_t key_count = keys.count;
+	free(keys.keys);
+	if(!counts[shortest]) {
+		return false;
+	}
+
+	// the first candidate at (or beyond) `start`
+	const uint32_t *candidates = lists[shortest];
+	const size_t    orig_start = trigram_orig_pos(index, start);
+	size_t lo = 0;
+	size_t hi = counts[shortest];
+	while(lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if(candidates[mid] < orig_start || (!down && candidates[mid] == orig_start)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	char  *buffer      = NULL;
+	size_t buffer_size = 0;
+
+	bool found = false;
+	for(size_t c = lo; down ? c < counts[shortest] : c > 0; down ? c++ : c--) {
+		const uint32_t orig = candidates[down ? c : c - 1];
+
+		const size_t deleted = trigram_deleted_before(index, orig);
+		if(deleted < index->deleted_count && orig == index->deleted[deleted]) {
+			continue;
+		}
+
+		bool contained = true;
+		for(size_t i = 0; i < key_count && contained; i++) {
+			contained = (i == shortest) || trigram_positions_contain(lists[i], counts[i], orig);
+		}
+
+		// the trigrams are contained, but not necessarily in the same order
+		if(contained && trigram_track_matches(TRACK(list, orig - deleted), query, &buffer, &buffer_size)) {
+			*pos  = orig - deleted;
+			found = true;
+			break;
+		}
+	}
+	free(buffer);
+	return found;
+}
+
+bool trigram_index_find(struct track_list *list, const char *query, size_t start, bool down, size_t *pos) {
+	if(start >= list->count) {
+		return false;
+	}
+
+	struct trigram_index *index = list->trigram;
+	if(!index || strlen(query) < 3) {
+		return trigram_find_linear(list, query, start, down ? list->count - 1 : 0, down, pos);
+	}
+
+	// too many changes since the snapshot: rebuild, still using the postings until the rebuild completes
+	if(!trigram_adopt(index)) {
+		const size_t added = list->count - trigram_indexed_count(index);
+		if(!index->postings || added + index->deleted_count > TRIGRAM_REBUILD_THRESHOLD) {
+			trigram_schedule(list);
+		}
+	}
+
+	// entries added after the snapshot are not covered by the postings
+	const size_t indexed = trigram_indexed_count(index);
+	if(down) {
+		return (start < indexed && trigram_find_indexed(list, query, start, true, pos))
+		    || trigram_find_linear(list, query, start > indexed ? start : indexed, list->count - 1, true, pos);
+	}
+	return (start >= indexed && trigram_find_linear(list, query, start, indexed, false, pos))
+	    || (indexed && trigram_find_indexed(list, query, start < indexed ? start : indexed - 1, false, pos));
+}
+
+static void* _thread_trigram_function(void *unused UNUSED) {
+	while(!terminate) {
+		sem_wait(&have_job);
+		if(terminate) return NULL;
+
+		trigram_job_execute(trigram_dequeue());
+	}
+
+	return NULL;
+}
+
+bool trigram_init(bool descriptions) {
+	index_descriptions = descriptions;
+
+	if(sem_init(&have_job, 0, 0) || sem_init(&sem_job_queue, 0, 1)) {
+		_err("sem_init: %s", strerror(errno));
+		return false;
+	}
+
+	int err = pthread_create(&thread_trigram, NULL, _thread_trigram_function, NULL);
+	if(err) {
+		_err("pthread_create: %s", strerror(err));
+		return false;
+	}
+	thread_trigram_valid = true;
+
+	if(atexit(trigram_finalize)) {
+		_err("atexit: %s", strerror(errno));
+	}
+
+	return true;
+}
+
+static void trigram_finalize(void) {
+	terminate = true;
+
+	sem_post(&have_job);
+	pthread_join(thread_trigram, NULL);
+
+	while(head) {
+		trigram_job_destroy(trigram_dequeue());
+	}
+
+	sem_destroy(&have_job);
+	sem_destroy(&sem_job_queue);
+}
@@ -0,0 +1,100 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/** \file trigram.h
+ *  \brief Trigram index of the tracks of a list, used for searching
+ *
+ *  Maps each trigram (three consecutive bytes, case-folded) of the title, the username and (optionally) the
+ *  description of a track to the positions of the tracks containing it. A search for a string of at least three
+ *  bytes only considers the tracks containing all of its trigrams, instead of comparing against each track.
+ *
+ *  The index is built by a background thread from a snapshot of the strings of a list. Tracks added afterwards
+ *  are searched linearly, tracks deleted are skipped, until a rebuild (started once there are too many of either)
+ *  completes. Tracks moved (p.x. by sorting) require a rebuild, searching linearly meanwhile.
+ *  All functions (except trigram_init()) are to be called by the thread modifying the list.
+ */
+
+#ifndef _TRIGRAM_H
+	#define _TRIGRAM_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+	#include "track.h"                      // for track_list
+
+	/** \brief Start the background thread building the indexes
+	 *
+	 *  Until started, indexes are built synchronously.
+	 *
+	 *  \param descriptions  `true` if the descriptions are to be indexed (and searched)
+	 *  \return              `true` on success, `false` otherwise
+	 */
+	bool trigram_init(bool descriptions);
+
+	/** \brief Create the index of a list and start building it (does nothing if the list is indexed already)
+	 *
+	 *  \param list  The list
+	 *  \return      `true` on success, `false` in case of a failing malloc (the list is searched linearly)
+	 */
+	bool trigram_index_create(struct track_list *list) ATTR(nonnull);
+
+	/** \brief Destroy the index of a list (if any), an unfinished build is dropped
+	 *
+	 *  \param list  The list
+	 */
+	void trigram_index_destroy(struct track_list *list) ATTR(nonnull);
+
+	/** \brief Update the index of a list (if any) after an entry was removed
+	 *
+	 *  \param list  The list
+	 *  \param pos   The position of the entry removed
+	 */
+	void trigram_index_del(struct track_list *list, size_t pos) ATTR(nonnull);
+
+	/** \brief Rebuild the index of a list (if any) after its entries were moved
+	 *
+	 *  \param list  The list
+	 */
+	void trigram_index_rebuild(struct track_list *list) ATTR(nonnull);
+
+	/** \brief Find the next track whose title, username or description contains a string (case-insensitive)
+	 *
+	 *  \param list   The list to search in
+	 *  \param query  The string to search for
+	 *  \param start  The position to start searching at (the track at `start` is included)
+	 *  \param down   `true` for searching towards the end of the list, `false` for searching towards the start
+	 *  \param pos    Receives the position of the track found
+	 *  \return       `true` if a track was found, `false` otherwise
+	 */
+	bool trigram_index_find(struct track_list *list, const char *query, size_t start, bool down, size_t *pos) ATTR(nonnull);
+
+	/** \brief Check whether a single track matches a string, just like trigram_index_find() does
+	 *
+	 *  The description is only checked if the descriptions are indexed (see trigram_init()).
+	 *
+	 *  \param track        The track
+	 *  \param query        The string to search for
+	 *  \param buffer       Receives the description read (see descstore_read()), pass to free() once done checking
+	 *  \param buffer_size  The size of `*buffer`
+	 *  \return             `true` if the title, the username or the description contain `query` (case-insensitive)
+	 */
+	bool trigram_track_matches(struct track *track, const char *query, char **buffer, size_t *buffer_size) ATTR(nonnull);
+#endif /* _TRIGRAM_H */
@@ -52,9 +52,17 @@
 
 #define TIME_BUFFER_SIZE 64
 
+/** \brief The interval (in ms) the position of the playback is sampled at
+ *
+ *  The playback thread only publishes the time (see state_set_current_time()), it never waits for drawing.
+ */
+#define POSITION_INTERVAL_MS 250
+
 static void tui_track_print_line(struct track* entry, bool selected, int line);
 
 static void tui_track_list_print(void);
+static bool tui_track_line_visible(int line);
+static void tui_update_position(void);
 static size_t tui_track_focus(void);
 static void tui_update_suggestion_list(void);
 
@@ -64,6 +72,7 @@ static void tui_update_textbox(bool items_modified);
 static void tui_draw_title_line(void);
 static void tui_draw_tab_bar(void);
 static void tui_draw_status_line(void);
+static void tui_draw_time(void);
 
 static void tui_finalize(void);
 
@@ -84,9 +93,33 @@ static sem_t sem_wait_action;
 
 static enum tui_action_kind action;
 
+/** \brief Wait for the next action, but at most POSITION_INTERVAL_MS
+ *
+ *  \return `true` if there is an action to handle, `false` on timeout (or interruption)
+ */
+static bool tui_wait_action(void) {
+	struct timespec timeout;
+	clock_gettime(CLOCK_REALTIME, &timeout);
+
+	timeout.tv_nsec += POSITION_INTERVAL_MS * 1000l * 1000l;
+	if(timeout.tv_nsec >= 1000l * 1000l * 1000l) {
+		timeout.tv_sec++;
+		timeout.tv_nsec -= 1000l * 1000l * 1000l;
+	}
+
+	return !sem_timedwait(&sem_have_action, &timeout);
+}
+
 static void* _thread_tui_function(void *unused UNUSED) {
 	do {
-		sem_wait(&sem_have_action);
+		if(!tui_wait_action()) {
+			// no action: time to sample the position of the playback
+			state_lock_lists();
+			tui_update_position();
+			state_unlock_lists();
+			continue;
+		}
+
 		if(whole_redraw_required) {
 			whole_redraw_required = false;
 
@@ -96,7 +129,9 @@ static void* _thread_tui_function(void *unused UNUSED) {
 
 			tui_draw_title_line();  // redraw the title line
 			tui_draw_tab_bar();     // redraw the tab bar
+			state_lock_lists();
 			tui_track_list_print(); // redraw the track_list
+			state_unlock_lists();
 
 			if(state_get_tb_title()) {
 				tui_update_textbox(false);
@@ -108,14 +143,7 @@ static void* _thread_tui_function(void *unused UNUSED) {
 			switch(action) {
 				case none: break; // FIXME
 
-				case set_sbar_time: {
-					char time_buffer[TIME_BUFFER_SIZE];
-					int time_len = snprint_ftime(time_buffer, TIME_BUFFER_SIZE, state_get_current_playback_time());
-					hc_print_mv(stdscr, COLS - time_len, 0, F_COLOR"%s", time_buffer, sbar_default);
-
-					refresh();
-					break;
-				}
+				case set_sbar_time:          tui_draw_time();              break;
 
 				case input_modify_text:
 					hc_print_mv(stdscr, 1, LINES - 1, F_COLOR"%s"F_COLOR" "F_COLOR"%0*c", 
@@ -123,7 +151,12 @@ static void* _thread_tui_function(void *unused UNUSED) {
 						/* colors */ cline_default, inp_cursor, cline_default);
 					break;
 
-				case update_list:            tui_track_list_print();       break;
+				case update_list:
+					state_lock_lists();
+					tui_track_list_print();
+					state_unlock_lists();
+					break;
+
 				case titlebar_modified:      tui_draw_title_line();        break;
 				case tabbar_modified:        tui_draw_tab_bar();           break;
 				case textbox_modified:       tui_update_textbox(false);    break;
@@ -132,8 +165,10 @@ static void* _thread_tui_function(void *unused UNUSED) {
 				case statusbar_modified:     tui_draw_status_line();       break;
 
 				case list_modified:
+					state_lock_lists();
 					tui_track_focus();
 					tui_track_list_print();
+					state_unlock_lists();
 					break;
 
 				case redraw: // TODO
@@ -153,6 +188,66 @@ static void* _thread_tui_function(void *unused UNUSED) {
 	return NULL;
 }
 
+/** \brief Draw the time of the playback to the right end of the titleline, preceded by the statistics of the output (if any) */
+static void tui_draw_time(void) {
+	char time_buffer[TIME_BUFFER_SIZE];
+	int time_len = 0;
+
+	unsigned int xruns, delay_ms;
+	if(state_get_output_stats(&xruns, &delay_ms)) {
+		time_len = snprintf(time_buffer, TIME_BUFFER_SIZE, "xruns: %u  delay: %4ums  ", xruns, delay_ms);
+		if(time_len < 0 || time_len >= TIME_BUFFER_SIZE) {
+			time_len = 0;
+		}
+	}
+	time_len += snprint_ftime(time_buffer + time_len, TIME_BUFFER_SIZE - time_len, state_get_current_playback_time());
+	hc_print_mv(stdscr, COLS - time_len, 0, F_COLOR"%s", time_buffer, sbar_default);
+}
+
+/** \brief Redraw the currently playing track and the time, if their visible progress changed
+ *
+ *  Called regularly (every POSITION_INTERVAL_MS) by the tui thread.
+ *  Nothing is drawn if neither the time (in seconds) nor the number of characters marked as played changed.
+ */
+static void tui_update_position(void) {
+	static size_t last_time   = ~0;
+	static size_t last_played = ~0;
+
+	const size_t list_id  = state_get_current_playback_list();
+	const size_t track_id = state_get_current_playback_track();
+
+	struct track_list *list = state_get_list(list_id);
+	if(!list || track_id >= list->count) {
+		return;
+	}
+
+	struct track *entry = TRACK(list, track_id);
+	if(!(entry->flags & FLAG_PLAYING)) {
+		return;
+	}
+
+	const size_t time   = state_get_current_playback_time();
+	const size_t played = entry->duration ? time * COLS / entry->duration : 0;
+	if(time == last_time && played == last_played) {
+		return;
+	}
+	last_time   = time;
+	last_played = played;
+
+	tui_draw_time();
+
+	// redraw the line of the track, if it is visible at all
+	const size_t first_track = state_get_current_position();
+	if(list_id == state_get_current_list() && track_id >= first_track && track_id - first_track < (size_t) (LINES - 4)) {
+		const int line = track_id - first_track + 2;
+		if(tui_track_line_visible(line)) {
+			tui_track_print_line(entry, track_id == state_get_current_selected(), line);
+		}
+	}
+
+	refresh();
+}
+
 /** \brief Draw the titleline */
 static void tui_draw_title_line(void) {
 	struct rc_string *title = state_get_title_text();
@@ -322,9 +417,12 @@ static void tui_track_print_line(struct track* entry, bool selected, int line) {
 	else if(entry->flags & FLAG_PAUSED) hc_print(stdscr, F_BOLD F_COLOR"="F_RESET, tline_status );
 	else                                hc_print(stdscr, F_COLOR" ",               tline_default);
 
+	// the position of the playing track is published by the playback thread
+	const unsigned int position = (entry->flags & FLAG_PLAYING) ? state_get_current_playback_time() : entry->current_position;
+
 	size_t played_chars = 0;
-	if(entry->current_position) {
-		float rel = (float)entry->current_position / entry->duration;
+	if(position) {
+		float rel = (float)position / entry->duration;
 		played_chars = rel * COLS;
 	}
 
@@ -335,13 +433,13 @@ static void tui_track_print_line(struct track* entry, bool selected, int line) {
 	played_chars = tui_track_print_played(played_chars, selected, tline_user,    tline_user_played,    tline_user_selected,    " by %s", entry->username);
 	played_chars = tui_track_print_played(played_chars, selected, tline_default, tline_default_played, tline_default_selected, "%0*c",   COLS - wcsps(entry->name) - wcsps(entry->username) - 4 - date_buffer_used - 8 - 11 - 12, ' ');
 
-	if(entry->current_position) {
+	if(position) {
 		char time_buffer[TIME_BUFFER_SIZE];
-		int time_len = snprint_ftime(time_buffer, TIME_BUFFER_SIZE, entry->current_position);
+		int time_len = snprint_ftime(time_buffer, TIME_BUFFER_SIZE, position);
 
 		played_chars = tui_track_print_played(played_chars, selected, tline_ctime, tline_ctime_played, tline_ctime_selected, "%0*c%s", 12 - time_len, ' ', time_buffer);
 	}
-	played_chars = tui_track_print_played(played_chars, selected, tline_default, tline_default_played, tline_default_selected, "%0*c", (0 != entry->current_position ? 0 : 12) + 3, ' ');
+	played_chars = tui_track_print_played(played_chars, selected, tline_default, tline_default_played, tline_default_selected, "%0*c", (0 != position ? 0 : 12) + 3, ' ');
 
 	played_chars = tui_track_print_played(played_chars, selected, tline_default, tline_default_played, tline_default_selected, "%s%s%s",
 		(FLAG_CACHED     & entry->flags) ? "C"      : " ",
@@ -353,6 +451,16 @@ static void tui_track_print_line(struct track* entry, bool selected, int line) {
 	tui_track_print_played(played_chars, selected, tline_default, tline_default_played, tline_time_selected, "%0*c%s", 9 - time_len, ' ', time_buffer);
 }
 
+/** \brief Check whether a line of the track_list is covered by a textbox or the suggestion list
+ *
+ *  \param line  The line on the screen
+ *  \return      `true` if the line is visible, `false` if it is covered
+ */
+static bool tui_track_line_visible(int line) {
+	return ((line < 4 || line > LINES - 4)                || !textbox_window.win)   // do not draw over a textbox
+	&&     (line < LINES - SUGGESTION_LIST_HEIGHT - 1 || !suggestion_window );   // do not draw over the suggestion list
+}
+
 /** \brief Draw the current track_list at the current position to the screen
  *
  *  Only lines not covered by a textbox or the suggestion list are drawn.
@@ -367,8 +475,7 @@ static void tui_track_list_print(void) {
 
 	const size_t first_track = state_get_current_position();
 	for(int y = 2; y < LINES - 2; y++) {
-		if( ((y < 4 || y > LINES - 4)                || !textbox_window.win)     // do not draw over a textbox
-		&&   (y < LINES - SUGGESTION_LIST_HEIGHT - 1 || !suggestion_window ) ) { // do not draw over the suggestion list
+		if(tui_track_line_visible(y)) {
 
 			const size_t this_track = first_track + y - 2;
 
@@ -459,6 +566,7 @@ static void tui_callback_titlebar_modified(void)     { tui_submit_action(titleba
 static void tui_callback_statusbar_modified(void)    { tui_submit_action(statusbar_modified);     }
 static void tui_callback_list_modified(void)         { tui_submit_action(list_modified);          }
 static void tui_callback_sugg_modified(void)         { tui_submit_action(sugg_modified);          }
+static void tui_callback_input_modified(void)        { tui_submit_action(input_modify_text);      }
 
 /* signal handler, exectued in case of resize of terminal
    to avoid race conditions no drawing is done here */
@@ -557,6 +665,7 @@ bool tui_init(void) {
 	state_register_callback(cbe_statusbar_modified,     tui_callback_statusbar_modified   );
 	state_register_callback(cbe_list_modified,          tui_callback_list_modified        );
 	state_register_callback(cbe_sugg_modified,          tui_callback_sugg_modified        );
+	state_register_callback(cbe_input_modified,         tui_callback_input_modified       );
 
 	int err = pthread_create(&thread_tui, NULL, _thread_tui_function, NULL);
 	if(err) {
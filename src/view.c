@@ -0,0 +1,440 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/** \file view.c
+ *  \brief Filtered (and sorted) views of track_lists (see view.h)
+ *
+ *  The positions of a view are kept in its order, entries with the same key (any entries, if the order of the
+ *  base is kept) ordered by their position. Prepending entries to the base shifts all positions alike, deleting
+ *  entries from the base shifts the positions behind, neither of which affects the order: the entries added to
+ *  the base are merged into the view, without sorting the view again.
+ */
+
+//\cond
+#include <stdbool.h>                    // for bool, true, false
+#include <stdint.h>                     // for uint32_t, int64_t, UINT32_MAX, SIZE_MAX
+#include <stdlib.h>                     // for free, qsort
+#include <string.h>                     // for strcasestr, strchr, strtok_r
+#include <time.h>                       // for strptime, mktime, time_t
+//\endcond
+
+#include "view.h"
+#include "helper.h"                     // for lmalloc, lstrdup, parse_time_to_sec, etc
+#include "log.h"                        // for _log, _err
+#include "track.h"                      // for track_list, track, TRACK, etc
+#include "trigram.h"                    // for trigram_index_del, trigram_index_rebuild
+
+/** \brief The minimum number of positions allocated when growing a view */
+#define VIEW_MIN_CAPACITY 64
+
+/** \brief The date format of `since` and `until` */
+#define VIEW_DATE_FORMAT "%Y-%m-%d"
+
+/** \brief A new entry of the base, sorted before merging it into a view */
+struct view_entry {
+	int64_t  key;
+	uint32_t pos;
+};
+
+static bool view_parse_date(const char *str, time_t *date) {
+	struct tm tm = { .tm_isdst = -1 };
+	const char *remaining = strptime(str, VIEW_DATE_FORMAT, &tm);
+	if(!remaining || *remaining) {
+		return false;
+	}
+
+	*date = mktime(&tm);
+	return (time_t) -1 != *date;
+}
+
+/** \brief Parse a term of the form `<name>=<value>` */
+static bool view_parse_value(const char *name, char *value, struct view_filter *filter) {
+	if(streq("user", name)) {
+		free(filter->user);
+		filter->user = lstrdup(value);
+		return NULL != filter->user;
+	} else if(streq("since", name)) {
+		return view_parse_date(value, &filter->since);
+	} else if(streq("until", name)) {
+		// include the whole day
+		if(!view_parse_date(value, &filter->until)) {
+			return false;
+		}
+		filter->until += 24 * 60 * 60 - 1;
+		return true;
+	} else if(streq("min", name)) {
+		filter->min_duration = parse_time_to_sec(value);
+		return INVALID_TIME != filter->min_duration;
+	} else if(streq("max", name)) {
+		filter->max_duration = parse_time_to_sec(value);
+		return INVALID_TIME != filter->max_duration;
+	} else if(streq("sort", name)) {
+		if(streq("newest", value)) {
+			filter->order = view_order_newest;
+		} else if(streq("oldest", value)) {
+			filter->order = view_order_oldest;
+		} else if(streq("longest", value)) {
+			filter->order = view_order_longest;
+		} else if(streq("shortest", value)) {
+			filter->order = view_order_shortest;
+		} else {
+			return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+static bool view_parse_term(char *term, struct view_filter *filter) {
+	char *value = strchr(term, '=');
+	if(value) {
+		*value = '\0';
+		const bool valid = view_parse_value(term, value + 1, filter);
+		*value = '=';
+		return valid;
+	}
+
+	if(streq("cached", term)) {
+		filter->cached = true;
+	} else if(streq("unplayed", term)) {
+		filter->unplayed = true;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+char* view_filter_parse(char *spec, struct view_filter *filter) {
+	*filter = (struct view_filter) { .user = NULL, .order = view_order_base };
+
+	char *saveptr = NULL;
+	for(char *term = strtok_r(spec, " \t", &saveptr); term; term = strtok_r(NULL, " \t", &saveptr)) {
+		if(!view_parse_term(term, filter)) {
+			return term;
+		}
+	}
+	return NULL;
+}
+
+void view_filter_clear(struct view_filter *filter) {
+	free(filter->user);
+	filter->user = NULL;
+}
+
+static bool view_matches(const struct view_filter *filter, const struct track *track) {
+	if(filter->user && (!track->username || !strcasestr(track->username, filter->user))) {
+		return false;
+	}
+	if((filter->since && track->created_at < filter->since) || (filter->until && track->created_at > filter->until)) {
+		return false;
+	}
+	const unsigned int duration = track->duration > 0 ? (unsigned int) track->duration : 0;
+	if(duration < filter->min_duration || (filter->max_duration && duration > filter->max_duration)) {
+		return false;
+	}
+	if(filter->cached && !(track->flags & FLAG_CACHED)) {
+		return false;
+	}
+	if(filter->unplayed && ((track->flags & (FLAG_PLAYED | FLAG_PLAYING | FLAG_PAUSED)) || track->current_position)) {
+		return false;
+	}
+	return true;
+}
+
+/** \brief The key the entries of a view are sorted by (ascending), 0 if the order of the base is kept */
+static int64_t view_key(enum view_order order, const struct track *track) {
+	switch(order) {
+		case view_order_base:     return 0;
+		case view_order_newest:   return -(int64_t) track->created_at;
+		case view_order_oldest:   return  (int64_t) track->created_at;
+		case view_order_longest:  return -(int64_t) track->duration;
+		case view_order_shortest: return  (int64_t) track->duration;
+		default:                  return 0;
+	}
+}
+
+static int view_entry_compare(const void *v1, const void *v2) {
+	const struct view_entry *e1 = (const struct view_entry*) v1;
+	const struct view_entry *e2 = (const struct view_entry*) v2;
+
+	if(e1->key != e2->key) {
+		return e1->key < e2->key ? -1 : 1;
+	}
+	return e1->pos < e2->pos ? -1 : (e1->pos > e2->pos);
+}
+
+/** \brief Make sure `count` positions fit into a view
+ *
+ *  \return `true` on success, `false` otherwise (the view is left unmodified)
+ */
+static bool view_reserve(struct track_list_view *view, size_t count) {
+	if(count <= view->capacity) {
+		return true;
+	}
+
+	size_t capacity = view->capacity ? 2 * view->capacity : VIEW_MIN_CAPACITY;
+	if(capacity < count) {
+		capacity = count;
+	}
+
+	uint32_t *positions = lrealloc(view->positions, capacity * sizeof(uint32_t));
+	if(!positions) {
+		return false;
+	}
+
+	view->positions = positions;
+	view->capacity  = capacity;
+	return true;
+}
+
+/** \brief Collect the matching entries within `[from, to)` of the base */
+static size_t view_collect(const struct track_list_view *view, size_t from, size_t to, struct view_entry *entries) {
+	size_t count = 0;
+	for(size_t i = from; i < to; i++) {
+		const struct track *track = TRACK(view->base, i);
+		if(view_matches(view->filter, track)) {
+			entries[count++] = (struct view_entry) { .key = view_key(view->filter->order, track), .pos = (uint32_t) i };
+		}
+	}
+	return count;
+}
+
+/** \brief Merge the entries added to the base since the last update into a view
+ *
+ *  \param list   The view
+ *  \param added  Receives `true` if any entry was added, `false` otherwise
+ *  \return       `true` on success, `false` in case of a failing malloc (the view is left unmodified)
+ */
+static bool view_merge(struct track_list *list, bool *added) {
+	struct track_list_view *view = list->view;
+	struct track_list *base = view->base;
+
+	*added = false;
+	if(!base) {
+		return true;
+	}
+
+	// new entries in front of (prepended) and behind (added) the entries considered so far
+	const size_t front = base->prepended - view->prepended;
+	const size_t back  = front + view->covered;
+	if(!front && back == base->count) {
+		return true;
+	}
+	if(base->count > UINT32_MAX) {
+		return false;
+	}
+
+	struct view_entry *entries = lmalloc((front + base->count - back) * sizeof(struct view_entry));
+	if(!entries) {
+		return false;
+	}
+
+	size_t count = view_collect(view, 0, front, entries);
+	count += view_collect(view, back, base->count, &entries[count]);
+	if(view_order_base != view->filter->order) {
+		qsort(entries, count, sizeof(struct view_entry), view_entry_compare);
+	}
+
+	if(!front && view_order_base == view->filter->order) {
+		// the common case: entries appended to the base are appended to the view
+		if(!view_reserve(view, list->count + count)) {
+			free(entries);
+			return false;
+		}
+
+		for(size_t i = 0; i < count; i++) {
+			view->positions[list->count + i] = entries[i].pos;
+		}
+		view->covered = base->count;
+		list->count  += count;
+	} else {
+		uint32_t *positions = lmalloc((list->count + count ? list->count + count : 1) * sizeof(uint32_t));
+		if(!positions) {
+			free(entries);
+			return false;
+		}
+
+		// merge the entries (sorted) into the positions (sorted and shifted by the entries prepended)
+		size_t j = 0, k = 0;
+		for(size_t i = 0; i < list->count; i++) {
+			const uint32_t pos = view->positions[i] + (uint32_t) front;
+			const struct view_entry current = { .key = view_key(view->filter->order, TRACK(base, pos)), .pos = pos };
+
+			while(j < count && view_entry_compare(&entries[j], &current) < 0) {
+				positions[k++] = entries[j++].pos;
+			}
+			positions[k++] = pos;
+		}
+		while(j < count) {
+			positions[k++] = entries[j++].pos;
+		}
+
+		// publish the positions along with the shift: the tui thread may draw the view at any time
+		uint32_t *old = view->positions;
+		list->count     = 0;
+		view->positions = positions;
+		view->capacity  = k ? k : 1;
+		view->prepended = base->prepended;
+		view->covered   = base->count;
+		list->count     = k;
+		free(old);
+
+		if(count) {
+			trigram_index_rebuild(list);
+		}
+	}
+
+	free(entries);
+	*added = count > 0;
+	return true;
+}
+
+struct track_list* view_create(struct track_list *base, struct view_filter *filter, char *name) {
+	if(base->view) {
+		base = base->view->base;
+		if(!base) {
+			return NULL;
+		}
+	}
+
+	struct track_list *list = track_list_create(name);
+	struct track_list_view *view = lcalloc(1, sizeof(struct track_list_view));
+	struct view_filter *copy = lmalloc(sizeof(struct view_filter));
+	if(!list || !view || !copy) {
+		track_list_destroy(list, false);
+		free(view);
+		free(copy);
+		return NULL;
+	}
+
+	*copy = *filter;
+	filter->user = NULL;
+
+	view->base      = base;
+	view->prepended = base->prepended;
+	view->filter    = copy;
+	view->next      = base->views;
+	base->views     = list;
+	list->view      = view;
+
+	bool added;
+	if(!view_merge(list, &added)) {
+		track_list_destroy(list, false);
+		return NULL;
+	}
+
+	_log("view `%s`: %zu of %zu entries of `%s`", list->name, list->count, base->count, base->name);
+	return list;
+}
+
+bool view_update(struct track_list *list) {
+	bool added = false;
+	if(list->view && !view_merge(list, &added)) {
+		_err("failed to update view `%s`", list->name);
+	}
+	return added;
+}
+
+bool view_find(struct track_list *list, const struct track *track, size_t *pos) {
+	for(size_t i = 0; i < list->count; i++) {
+		if(track == TRACK(list, i)) {
+			*pos = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void view_base_del(struct track_list *base, size_t pos) {
+	for(struct track_list *list = base->views; list; list = list->view->next) {
+		struct track_list_view *view = list->view;
+
+		const size_t front = base->prepended - view->prepended;
+		if(pos < front) {
+			// an entry not considered yet: one entry less to shift by
+			view->prepended++;
+			continue;
+		}
+		if(pos >= front + view->covered) {
+			continue;
+		}
+
+		// each entry of the base is part of a view at most once
+		const uint32_t removed = (uint32_t) (pos - front);
+		size_t count = 0, removed_at = SIZE_MAX;
+		for(size_t i = 0; i < list->count; i++) {
+			if(removed == view->positions[i]) {
+				removed_at = i;
+			} else {
+				view->positions[count++] = view->positions[i] - (view->positions[i] > removed);
+			}
+		}
+		view->covered--;
+		list->count = count;
+
+		if(SIZE_MAX != removed_at) {
+			trigram_index_del(list, removed_at);
+		}
+	}
+}
+
+void view_base_rebuild(struct track_list *base) {
+	for(struct track_list *list = base->views; list; list = list->view->next) {
+		struct track_list_view *view = list->view;
+
+		list->count     = 0;
+		view->covered   = 0;
+		view->prepended = base->prepended;
+		view_update(list);
+
+		// a view keeping the order of the base is filled in place, without rebuilding its trigram index
+		if(view_order_base == view->filter->order) {
+			trigram_index_rebuild(list);
+		}
+	}
+}
+
+void view_destroy(struct track_list *list) {
+	struct track_list_view *view = list->view;
+	if(view) {
+		if(view->base) {
+			struct track_list **link = &view->base->views;
+			while(*link != list) {
+				link = &(*link)->view->next;
+			}
+			*link = view->next;
+		}
+
+		list->count = 0;
+		list->view  = NULL;
+		view_filter_clear(view->filter);
+		free(view->filter);
+		free(view->positions);
+		free(view);
+	}
+
+	while(list->views) {
+		struct track_list *other = list->views;
+		list->views = other->view->next;
+
+		other->count = 0;
+		other->view->base = NULL;
+		other->view->next = NULL;
+	}
+}
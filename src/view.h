@@ -0,0 +1,134 @@
+/*
+	SCTC - the soundcloud.com client
+	Copyright (C) 2015   Christian Eichler
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+/** \file view.h
+ *  \brief Views: filtered (and sorted) lists of the entries of another list, without copying the entries
+ *
+ *  A view is a track_list holding the positions of the matching entries of its base list (see struct
+ *  track_list_view) instead of entries. It is accessed via TRACK() like any other list and shown as a tab.
+ *
+ *  Views are updated lazily: entries added to the base (prepended or appended) are considered by the next
+ *  view_update(), entries deleted from the base are removed from its views right away. The flags (p.x. `cached`
+ *  or `unplayed`) are evaluated once per entry, when it is added to the view.
+ *  All functions are to be called by the thread modifying the lists.
+ */
+
+#ifndef _VIEW_H
+	#define _VIEW_H
+
+	//\cond
+	#include <stdbool.h>                    // for bool
+	#include <stddef.h>                     // for size_t
+	#include <time.h>                       // for time_t
+	//\endcond
+
+	#include "_hard_config.h"               // for ATTR
+	#include "track.h"                      // for track_list
+
+	/** \brief The order of the entries of a view */
+	enum view_order {
+		view_order_base,    ///< The order of the base list
+		view_order_newest,  ///< The most recent track first
+		view_order_oldest,  ///< The oldest track first
+		view_order_longest, ///< The longest track first
+		view_order_shortest ///< The shortest track first
+	};
+
+	/** \brief The predicates an entry of the base list needs to satisfy (all of them) to be part of a view */
+	struct view_filter {
+		char         *user;         ///< A part of the username (case-insensitive), `NULL` for any user
+		time_t        since;        ///< The earliest creation time, 0 for any
+		time_t        until;        ///< The latest creation time, 0 for any
+		unsigned int  min_duration; ///< The minimum duration in seconds
+		unsigned int  max_duration; ///< The maximum duration in seconds, 0 for any
+		bool          cached;       ///< Only tracks within the cache
+		bool          unplayed;     ///< Only tracks not played (or paused) yet
+		enum view_order order;
+	};
+
+	/** \brief Parse a filter from a string of space-separated terms
+	 *
+	 *  Known terms are `user=<part of name>`, `since=<YYYY-MM-DD>`, `until=<YYYY-MM-DD>` (both included),
+	 *  `min=<duration>`, `max=<duration>` (see parse_time_to_sec()), `cached`, `unplayed` and
+	 *  `sort={newest,oldest,longest,shortest}`.
+	 *
+	 *  \param spec    The string, split into terms
+	 *  \param filter  Receives the filter, pass to view_filter_clear() if no longer needed (even if parsing fails)
+	 *  \return        `NULL` on success, the (first) invalid term (within `spec`) otherwise
+	 */
+	char* view_filter_parse(char *spec, struct view_filter *filter) ATTR(nonnull);
+
+	/** \brief Free the memory occupied by the members of a filter
+	 *
+	 *  \param filter  The filter
+	 */
+	void view_filter_clear(struct view_filter *filter) ATTR(nonnull);
+
+	/** \brief Create a view of a list
+	 *
+	 *  Takes O(n) for n entries of the base (O(n log n) if sorted). The view is a list of its own: pass it
+	 *  to track_list_destroy() if no longer needed, which does not affect the base.
+	 *
+	 *  \param base    The list viewed, the base of `base` if it is a view itself
+	 *  \param filter  The filter, the members are moved to the view (the filter is cleared)
+	 *  \param name    The name of the view
+	 *  \return        The view, `NULL` in case of a failing malloc
+	 */
+	struct track_list* view_create(struct track_list *base, struct view_filter *filter, char *name) ATTR(nonnull);
+
+	/** \brief Add the entries added to the base since the last update (if any) to a view
+	 *
+	 *  Takes O(k) for k new entries if the view keeps the order of the base and the entries were added at
+	 *  the end of the base, O(n + k log k) for n entries of the view otherwise.
+	 *
+	 *  \param list  The view (does nothing for lists which are no views)
+	 *  \return      `true` if entries were added (positions within the view may have changed), `false` otherwise
+	 */
+	bool view_update(struct track_list *list) ATTR(nonnull);
+
+	/** \brief Find the position of a track within a list
+	 *
+	 *  \param list   The list
+	 *  \param track  The (normal) track, as returned by TRACK()
+	 *  \param pos    Receives the position of the track, if found
+	 *  \return       `true` if the track was found, `false` otherwise
+	 */
+	bool view_find(struct track_list *list, const struct track *track, size_t *pos) ATTR(nonnull);
+
+	/** \brief Update the views of a list after an entry was removed from it
+	 *
+	 *  \param base  The list
+	 *  \param pos   The position of the entry removed
+	 */
+	void view_base_del(struct track_list *base, size_t pos) ATTR(nonnull);
+
+	/** \brief Rebuild the views of a list after its entries were moved
+	 *
+	 *  \param base  The list
+	 */
+	void view_base_rebuild(struct track_list *base) ATTR(nonnull);
+
+	/** \brief Detach a view from its base (and free it) or the views of a list from it, before destroying the list
+	 *
+	 *  Views of a list destroyed stay valid, but are empty.
+	 *
+	 *  \param list  The list (a view or any other list)
+	 */
+	void view_destroy(struct track_list *list) ATTR(nonnull);
+#endif /* _VIEW_H */
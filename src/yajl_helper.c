@@ -27,6 +27,7 @@
 #include "yajl_helper.h"
 #include "helper.h"
 #include "log.h"
+#include "strpool.h"
 
 static yajl_val yajl_helper_get_val(yajl_val parent, const char *path1, const char *path2, yajl_type type) {
 	assert(path1 && "no path if provided at all");
@@ -35,13 +36,18 @@ static yajl_val yajl_helper_get_val(yajl_val parent, const char *path1, const ch
 	return yajl_tree_get(parent, path, type);
 }
 
-char* yajl_helper_get_string(yajl_val parent, const char *path1, const char *path2) {
+const char* yajl_helper_peek_string(yajl_val parent, const char *path1, const char *path2) {
 	yajl_val val = yajl_helper_get_val(parent, path1, path2, yajl_t_string);
-	if(val) {
-		char *str = YAJL_GET_STRING(val);
-		if(str) return lstrdup(str);
-	}
-	return NULL; 
+	return val ? YAJL_GET_STRING(val) : NULL;
+}
+
+char* yajl_helper_get_string(yajl_val parent, const char *path1, const char *path2) {
+	const char *str = yajl_helper_peek_string(parent, path1, path2);
+	return str ? lstrdup(str) : NULL;
+}
+
+char* yajl_helper_get_interned(yajl_val parent, const char *path1, const char *path2) {
+	return strpool_intern(yajl_helper_peek_string(parent, path1, path2));
 }
 
 int yajl_helper_get_int(yajl_val parent, const char *path1, const char *path2) {
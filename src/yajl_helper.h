@@ -23,6 +23,13 @@
 
 	yajl_val yajl_helper_parse(const char *data);
 	char*    yajl_helper_get_string(yajl_val parent, const char *path1, const char *path2);
+
+	/** \brief Like yajl_helper_get_string(), but returns the string held by `parent` (valid until `parent` is freed) instead of a copy */
+	const char* yajl_helper_peek_string(yajl_val parent, const char *path1, const char *path2);
+
+	/** \brief Like yajl_helper_get_string(), but returns an interned string (see strpool.h), which must not be freed */
+	char*    yajl_helper_get_interned(yajl_val parent, const char *path1, const char *path2);
+
 	int      yajl_helper_get_int   (yajl_val parent, const char *path1, const char *path2);
 	yajl_val yajl_helper_get_array (yajl_val parent, const char *path1, const char *path2);
 #endif
@@ -0,0 +1,123 @@
+#include "aio.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_helper.h"
+
+#include "../src/aio.h"
+
+#define BLOCK_COUNT 32
+#define BLOCK_SIZE  (64 * 1024)
+#define FILE_SIZE   (3 * 1024 * 1024 + 17)
+
+static bool write_file_done;
+static bool write_file_success;
+
+static void write_file_callback(void *ctx, bool success) {
+	(void) ctx;
+	write_file_success = success;
+	__atomic_store_n(&write_file_done, true, __ATOMIC_RELEASE);
+}
+
+/** \brief Write a file via aio_write_file() and compare its contents afterwards */
+static bool write_and_compare(const char *path, const char *data, size_t size) {
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if(0 > fd) {
+		return false;
+	}
+
+	write_file_done = false;
+	if(!aio_write_file(fd, 0, data, size, write_file_callback, NULL)) {
+		return false;
+	}
+	for(size_t i = 0; i < 5000 && !__atomic_load_n(&write_file_done, __ATOMIC_ACQUIRE); i++) {
+		usleep(1000);
+	}
+	if(!write_file_done || !write_file_success) {
+		return false;
+	}
+
+	char *read_back = malloc(size + 1);
+	FILE *fh = fopen(path, "r");
+	bool equal = fh && read_back && (size == fread(read_back, 1, size + 1, fh)) && !memcmp(read_back, data, size);
+	if(fh) fclose(fh);
+	free(read_back);
+
+	return equal;
+}
+
+bool test_aio() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\naio.o");
+
+	char path[] = "/tmp/sctc_test_aio_XXXXXX";
+	int fd = mkstemp(path);
+
+	char *data = malloc(FILE_SIZE);
+	for(size_t i = 0; i < FILE_SIZE; i++) data[i] = (char) (i * 7 + i / 4096);
+
+	TEST_FUNC_START(aio_write_file)
+		TEST_RES( 0 <= fd && data );
+
+		// not initialized yet: written synchronously
+		TEST_RES( write_and_compare(path, data, FILE_SIZE) );
+
+		TEST_RES( aio_init() );
+		TEST_RES( write_and_compare(path, data, FILE_SIZE) );
+		TEST_RES( write_and_compare(path, data, 0) );
+	TEST_FUNC_END();
+
+	fprintf(stderr, " (%s)", aio_backend());
+
+	struct aio_request  requests[BLOCK_COUNT];
+	struct aio_request *batch[BLOCK_COUNT];
+
+	TEST_FUNC_START(aio_submit_wait)
+		// write the blocks in reverse order, read them in order
+		for(size_t i = 0; i < BLOCK_COUNT; i++) {
+			size_t block = BLOCK_COUNT - 1 - i;
+			requests[i] = (struct aio_request) { .op = aio_op_write, .fd = fd, .data = &data[block * BLOCK_SIZE], .size = BLOCK_SIZE, .offset = block * BLOCK_SIZE };
+			batch[i] = &requests[i];
+		}
+		TEST_RES( !ftruncate(fd, 0) );
+		TEST_RES( aio_submit_wait(batch, BLOCK_COUNT) );
+
+		bool complete = true;
+		for(size_t i = 0; i < BLOCK_COUNT; i++) complete &= (BLOCK_SIZE == requests[i].result);
+		TEST_RES( complete );
+
+		requests[0] = (struct aio_request) { .op = aio_op_fdatasync, .fd = fd };
+		TEST_RES( aio_submit_wait(batch, 1) );
+
+		char *read_back = calloc(BLOCK_COUNT, BLOCK_SIZE);
+		for(size_t i = 0; i < BLOCK_COUNT; i++) {
+			requests[i] = (struct aio_request) { .op = aio_op_read, .fd = fd, .buffer = &read_back[i * BLOCK_SIZE], .size = BLOCK_SIZE, .offset = i * BLOCK_SIZE };
+		}
+		TEST_RES( read_back && aio_submit_wait(batch, BLOCK_COUNT) );
+		TEST_RES( read_back && !memcmp(read_back, data, BLOCK_COUNT * BLOCK_SIZE) );
+		free(read_back);
+
+		// reading from a file opened write-only fails
+		int wronly = open(path, O_WRONLY);
+		char buffer[16];
+		requests[0] = (struct aio_request) { .op = aio_op_read, .fd = wronly, .buffer = buffer, .size = sizeof(buffer) };
+		TEST_RES( !aio_submit_wait(batch, 1) && 0 > requests[0].result );
+		close(wronly);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(aio_file_readahead)
+		TEST_RES( aio_file_readahead(fd, 0, 0) );
+		TEST_RES( !aio_file_readahead(-1, 0, 0) );
+	TEST_FUNC_END();
+
+	close(fd);
+	unlink(path);
+	free(data);
+
+	TEST_END();
+}
@@ -0,0 +1,106 @@
+#include "descstore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test_helper.h"
+
+#include "../src/_hard_config.h"
+#include "../src/descstore.h"
+
+#define DESCRIPTION_COUNT 4000
+
+bool test_descstore() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\ndescstore.o");
+
+	char folder[] = "/tmp/sctc_test_descstore_XXXXXX";
+	char buffer[256];
+
+	TEST_FUNC_START(descstore_put)
+		TEST_RES( !descstore_put(1, "not initialized") );
+		TEST_RES( mkdtemp(folder) && descstore_init(folder) );
+
+		TEST_RES( !descstore_put(0, "no track_id") );
+		TEST_RES( !descstore_put(1, NULL) );
+
+		// exceeds the buffer: some of the descriptions are written before being read
+		bool stored = true;
+		for(int i = 1; i <= DESCRIPTION_COUNT; i++) {
+			snprintf(buffer, sizeof(buffer), "The description of track %d, see https://soundcloud.com/user%d/track%d", i, i, i);
+			stored &= descstore_put(i, buffer);
+		}
+		TEST_RES( stored );
+
+		// the description stored first is kept
+		TEST_RES( descstore_put(1, "another description") );
+		TEST_RES( descstore_put(DESCRIPTION_COUNT + 1, "") );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(descstore_get)
+		bool equal = true;
+		for(int i = 1; i <= DESCRIPTION_COUNT; i += 97) {
+			struct track track = { .name = "track", .track_id = i };
+			snprintf(buffer, sizeof(buffer), "The description of track %d, see https://soundcloud.com/user%d/track%d", i, i, i);
+			char *description = descstore_get(&track);
+			equal &= description && !strcmp(description, buffer);
+			free(description);
+		}
+		TEST_RES( equal );
+
+		struct track empty = { .name = "track", .track_id = DESCRIPTION_COUNT + 1 };
+		char *description = descstore_get(&empty);
+		TEST_RES( description && !strcmp("", description) );
+		free(description);
+
+		// neither stored nor kept in memory
+		struct track unknown = { .name = "track", .track_id = DESCRIPTION_COUNT + 2 };
+		TEST_RES( !descstore_get(&unknown) );
+
+		// kept in memory
+		struct track inline_desc = { .name = "track", .track_id = DESCRIPTION_COUNT + 3, .description = "in memory" };
+		description = descstore_get(&inline_desc);
+		TEST_RES( description && !strcmp("in memory", description) );
+		free(description);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(descstore_read)
+		char  *read_buffer = NULL;
+		size_t read_size   = 0;
+
+		// the buffer is reused across calls
+		bool equal = true;
+		for(int i = 1; i <= DESCRIPTION_COUNT; i += 89) {
+			struct track track = { .name = "track", .track_id = i };
+			snprintf(buffer, sizeof(buffer), "The description of track %d, see https://soundcloud.com/user%d/track%d", i, i, i);
+			const char *description = descstore_read(&track, &read_buffer, &read_size);
+			equal &= description == read_buffer && !strcmp(description, buffer);
+		}
+		TEST_RES( equal );
+
+		struct track unknown = { .name = "track", .track_id = DESCRIPTION_COUNT + 2 };
+		TEST_RES( !descstore_read(&unknown, &read_buffer, &read_size) );
+
+		struct track inline_desc = { .name = "track", .track_id = DESCRIPTION_COUNT + 3, .description = "in memory" };
+		TEST_RES( inline_desc.description == descstore_read(&inline_desc, &read_buffer, &read_size) );
+		free(read_buffer);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(descstore_get_stats)
+		struct descstore_stats stats;
+		descstore_get_stats(&stats);
+		TEST_RES( DESCRIPTION_COUNT + 1 == stats.descriptions );
+		TEST_RES( stats.bytes > DESCRIPTION_COUNT * strlen("The description of track ") );
+	TEST_FUNC_END();
+
+	snprintf(buffer, sizeof(buffer), "%s/%s", folder, CACHE_DESCRIPTION_DATA);
+	unlink(buffer);
+	snprintf(buffer, sizeof(buffer), "%s/%s", folder, CACHE_DESCRIPTION_INDEX);
+	unlink(buffer);
+	rmdir(folder);
+
+	TEST_END();
+}
@@ -0,0 +1,226 @@
+#include "hls.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "test_helper.h"
+
+#include "../src/hls.h"
+
+#define SEGMENT_COUNT 12
+#define SEGMENT_SIZE(I) (20000 + 1000 * (I))
+#define SEGMENT_BYTE(I, J) ((char) ((I) * 31 + (J) * 7))
+
+/** \brief A minimal HTTP/1.1 server (keep-alive) serving a generated playlist and its segments */
+static int server_fd;
+static unsigned short server_port;
+static size_t segment_requests[SEGMENT_COUNT];
+static size_t connection_count;
+
+static char* server_playlist(void) {
+	static char playlist[4096];
+	size_t pos = sprintf(playlist, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:10\n");
+	for(size_t i = 0; i < SEGMENT_COUNT; i++) {
+		// mix directory-relative and host-relative URLs
+		pos += sprintf(&playlist[pos], (i % 2) ? "#EXTINF:10.0,\nseg%zu.mp3\n" : "#EXTINF:10.0,\r\n/hls/seg%zu.mp3\r\n", i);
+	}
+	sprintf(&playlist[pos], "#EXT-X-ENDLIST\n");
+	return playlist;
+}
+
+static void server_send(int fd, const char *status, const char *body, size_t size) {
+	char header[256];
+	int len = snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Length: %zu\r\n\r\n", status, size);
+	send(fd, header, len, MSG_NOSIGNAL);
+	if(size) send(fd, body, size, MSG_NOSIGNAL);
+}
+
+static void* server_connection(void *_fd) {
+	int fd = (int) (intptr_t) _fd;
+
+	char request[1024];
+	size_t length = 0;
+	ssize_t ret;
+	while(0 < (ret = recv(fd, &request[length], sizeof(request) - length - 1, 0))) {
+		length += ret;
+		request[length] = '\0';
+
+		char *end;
+		while( (end = strstr(request, "\r\n\r\n")) ) {
+			char path[256] = "";
+			sscanf(request, "GET %255s", path);
+
+			size_t index;
+			if(!strcmp(path, "/hls/master.m3u8")) {
+				const char *master = "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=128000\nlist.m3u8\n";
+				server_send(fd, "200 OK", master, strlen(master));
+			} else if(!strcmp(path, "/hls/list.m3u8")) {
+				char *playlist = server_playlist();
+				server_send(fd, "200 OK", playlist, strlen(playlist));
+			} else if(1 == sscanf(path, "/hls/seg%zu.mp3", &index) && index < SEGMENT_COUNT) {
+				__atomic_add_fetch(&segment_requests[index], 1, __ATOMIC_RELAXED);
+
+				char *segment = malloc(SEGMENT_SIZE(index));
+				for(size_t j = 0; j < SEGMENT_SIZE(index); j++) segment[j] = SEGMENT_BYTE(index, j);
+				server_send(fd, "200 OK", segment, SEGMENT_SIZE(index));
+				free(segment);
+			} else {
+				server_send(fd, "404 Not Found", NULL, 0);
+			}
+
+			length -= (end + 4 - request);
+			memmove(request, end + 4, length + 1);
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static void* server_accept(void *unused) {
+	(void) unused;
+
+	int fd;
+	while(0 <= (fd = accept(server_fd, NULL, NULL))) {
+		__atomic_add_fetch(&connection_count, 1, __ATOMIC_RELAXED);
+
+		pthread_t thread;
+		pthread_create(&thread, NULL, server_connection, (void*) (intptr_t) fd);
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+static bool server_start(void) {
+	struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+	socklen_t addr_len = sizeof(addr);
+
+	server_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(0 > server_fd
+	|| bind(server_fd, (struct sockaddr*) &addr, sizeof(addr))
+	|| listen(server_fd, 16)
+	|| getsockname(server_fd, (struct sockaddr*) &addr, &addr_len)) {
+		return false;
+	}
+	server_port = ntohs(addr.sin_port);
+
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, server_accept, NULL)) {
+		return false;
+	}
+	pthread_detach(thread);
+	return true;
+}
+
+static void server_reset_stats(void) {
+	for(size_t i = 0; i < SEGMENT_COUNT; i++) segment_requests[i] = 0;
+	connection_count = 0;
+}
+
+/** \brief Read the stream until its end and compare the data to segments `first` to SEGMENT_COUNT - 1 */
+static bool read_and_compare(struct hls_stream *stream, size_t first) {
+	size_t segment = first;
+	size_t offset  = 0;
+
+	char buffer[7000];
+	ssize_t ret;
+	while(0 < (ret = hls_stream_read(stream, buffer, sizeof(buffer)))) {
+		for(ssize_t j = 0; j < ret; j++) {
+			if(segment >= SEGMENT_COUNT || buffer[j] != SEGMENT_BYTE(segment, offset)) {
+				return false;
+			}
+
+			if(++offset == SEGMENT_SIZE(segment)) {
+				segment++;
+				offset = 0;
+			}
+		}
+	}
+
+	return 0 == ret && SEGMENT_COUNT == segment;
+}
+
+bool test_hls() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nhls.o");
+
+	TEST_FUNC_START(hls_playlist_parse)
+		struct hls_playlist *playlist = hls_playlist_parse("http://example.com/a/b.m3u8?x=/y", server_playlist());
+		TEST_RES( playlist );
+		TEST_RES( playlist && SEGMENT_COUNT == playlist->count && !playlist->variant );
+		TEST_RES( playlist && 10.0 * SEGMENT_COUNT == playlist->duration && 30.0 == playlist->segments[3].start );
+		TEST_RES( playlist && !strcmp(playlist->segments[0].url, "http://example.com/hls/seg0.mp3") );
+		TEST_RES( playlist && !strcmp(playlist->segments[1].url, "http://example.com/a/seg1.mp3") );
+		TEST_RES( playlist && 0 == hls_playlist_segment_at(playlist, 9.9) && 7 == hls_playlist_segment_at(playlist, 70.0) );
+		TEST_RES( playlist && SEGMENT_COUNT - 1 == hls_playlist_segment_at(playlist, 1e6) );
+		hls_playlist_destroy(playlist);
+
+		TEST_RES( !hls_playlist_parse("http://example.com/", "<html></html>") );
+	TEST_FUNC_END();
+
+	char url[64];
+	TEST_FUNC_START(hls_stream_read)
+		TEST_RES( server_start() );
+		server_reset_stats();
+		snprintf(url, sizeof(url), "http://127.0.0.1:%u/hls/master.m3u8", server_port);
+
+		struct hls_stream *stream = hls_stream_open(url);
+		TEST_RES( stream );
+		if(stream) {
+			TEST_RES( SEGMENT_COUNT == hls_stream_playlist(stream)->count );
+			TEST_RES( read_and_compare(stream, 0) );
+			hls_stream_close(stream);
+		}
+
+		// each segment is requested exactly once, using (far) less connections than requests
+		bool once = true;
+		for(size_t i = 0; i < SEGMENT_COUNT; i++) once &= (1 == segment_requests[i]);
+		TEST_RES( once );
+		TEST_RES( connection_count < SEGMENT_COUNT );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(hls_stream_seek)
+		server_reset_stats();
+		snprintf(url, sizeof(url), "http://127.0.0.1:%u/hls/list.m3u8", server_port);
+
+		struct hls_stream *stream = hls_stream_open(url);
+		TEST_RES( stream );
+		if(stream) {
+			TEST_RES( !hls_stream_seek(stream, SEGMENT_COUNT) );
+			TEST_RES( hls_stream_seek(stream, 7) );
+			TEST_RES( read_and_compare(stream, 7) );
+			hls_stream_close(stream);
+		}
+
+		// the segments skipped are never downloaded
+		TEST_RES( !segment_requests[4] && !segment_requests[5] && !segment_requests[6] );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(hls_stream_interrupt)
+		snprintf(url, sizeof(url), "http://127.0.0.1:%u/hls/list.m3u8", server_port);
+
+		struct hls_stream *stream = hls_stream_open(url);
+		TEST_RES( stream );
+		if(stream) {
+			char buffer[16];
+			hls_stream_interrupt(stream);
+			TEST_RES( 0 == hls_stream_read(stream, buffer, sizeof(buffer)) );
+			hls_stream_close(stream);
+		}
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(hls_stream_open)
+		snprintf(url, sizeof(url), "http://127.0.0.1:%u/hls/missing.m3u8", server_port);
+		TEST_RES( !hls_stream_open(url) );
+	TEST_FUNC_END();
+
+	TEST_END();
+}
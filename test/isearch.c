@@ -0,0 +1,132 @@
+#include "isearch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/isearch.h"
+#include "../src/state.h"
+#include "../src/strpool.h"
+#include "../src/track.h"
+#include "../src/trigram.h"
+
+#define TRACK_COUNT 5000
+
+static char names[TRACK_COUNT][32];
+static char usernames[6][16] = { "alice", "alicia", "bob", "carol", "Carolyn", "dave" };
+
+/** \brief The track expected to be selected: the first hit following `origin`, `origin` if none */
+static size_t expected(struct track_list *list, const char *query, size_t origin) {
+	if(!*query) {
+		return origin;
+	}
+
+	for(size_t i = origin + 1; i < list->count; i++) {
+		struct track *track = TRACK(list, i);
+		if(strcasestr(track->name, query) || strcasestr(track->username, query)) {
+			return i;
+		}
+	}
+	return origin;
+}
+
+/** \brief Submit queries one after another (each extending or shortening the previous one), checking each hit */
+static bool check_queries(struct track_list *list, size_t origin, const char **queries, size_t count) {
+	isearch_start(list, origin);
+	for(size_t i = 0; i < count; i++) {
+		isearch_update(queries[i]);
+		if(expected(list, queries[i], origin) != state_get_current_selected() || strcmp(queries[i], state_get_input())) {
+			fprintf(stderr, " (`%s` selects %zu instead of %zu)", queries[i], state_get_current_selected(), expected(list, queries[i], origin));
+			isearch_finish(false);
+			return false;
+		}
+	}
+	isearch_finish(true);
+	return true;
+}
+
+bool test_isearch() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nisearch.o");
+
+	state_init();
+
+	struct track_list *list = track_list_create("test");
+	for(size_t i = 0; i < TRACK_COUNT; i++) {
+		snprintf(names[i], sizeof(names[i]), "Track %zu", i);
+		struct track track = {
+			.name     = strpool_intern(names[i]),
+			.username = strpool_intern(usernames[(i * 7) % 6]),
+			.track_id = (int) i + 1
+		};
+		track_list_add(list, &track);
+	}
+
+	const char *extending[] = { "a", "al", "ali", "alic", "alici", "alicia", "alic", "a", "" };
+	const char *names_q[]   = { "t", "tr", "TRACK 4", "track 42", "track 421", "track 4213", "track 42", "carolyn", "x" };
+
+	TEST_FUNC_START(isearch_update)
+		// not started yet: the queries are matched synchronously, the hits of a query are reused by extending it
+		TEST_RES( check_queries(list, 0, extending, sizeof(extending) / sizeof(extending[0])) );
+		TEST_RES( check_queries(list, 4000, names_q, sizeof(names_q) / sizeof(names_q[0])) );
+		TEST_RES( check_queries(list, TRACK_COUNT - 1, names_q, sizeof(names_q) / sizeof(names_q[0])) );
+
+		// the hits of another search are not reused
+		const char *other[] = { "carol" };
+		TEST_RES( check_queries(list, 10, other, 1) );
+		TEST_RES( check_queries(list, 2000, other, 1) );
+
+		// the first query of a search is matched via the trigram index (if any), just like search-next does
+		TEST_RES( trigram_index_create(list) && list->trigram );
+		TEST_RES( check_queries(list, 10, other, 1) );
+		TEST_RES( check_queries(list, 4000, names_q, sizeof(names_q) / sizeof(names_q[0])) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(isearch_finish)
+		isearch_start(list, 123);
+		isearch_update("track 4");
+		TEST_RES( 123 != state_get_current_selected() );
+		isearch_finish(false);
+		TEST_RES( 123 == state_get_current_selected() );
+
+		isearch_start(list, 123);
+		isearch_update("track 4");
+		isearch_finish(true);
+		TEST_RES( expected(list, "track 4", 123) == state_get_current_selected() );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(isearch_init)
+		TEST_RES( isearch_init() );
+
+		// matched in the background: queries may be cancelled by the next one, accepting waits for the last one
+		bool equal = true;
+		for(size_t origin = 0; origin < TRACK_COUNT; origin += 731) {
+			isearch_start(list, origin);
+			for(size_t i = 0; i < sizeof(names_q) / sizeof(names_q[0]) - 3; i++) {
+				isearch_update(names_q[i]);
+			}
+			isearch_finish(true);
+			equal &= expected(list, "track 4213", origin) == state_get_current_selected();
+		}
+		TEST_RES( equal );
+
+		// cancelling restores the track selected before
+		bool restored = true;
+		for(size_t origin = 0; origin < TRACK_COUNT; origin += 731) {
+			isearch_start(list, origin);
+			for(size_t i = 0; i < sizeof(extending) / sizeof(extending[0]) - 1; i++) {
+				isearch_update(extending[i]);
+			}
+			isearch_finish(false);
+			restored &= origin == state_get_current_selected();
+		}
+		TEST_RES( restored );
+	TEST_FUNC_END();
+
+	track_list_destroy(list, false);
+
+	TEST_END();
+}
@@ -0,0 +1,55 @@
+#include "loudness.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test_helper.h"
+
+#include "../src/loudness.h"
+
+#define RATE 48000
+
+/** \brief Feed `secs` seconds of a 1kHz sine at `level` dBFS (on both channels) to the meter
+ */
+static void feed_sine(struct loudness_meter *meter, unsigned int secs, double level) {
+	const double amplitude = pow(10.0, level / 20.0) * 32767;
+
+	int16_t frame[2 * 1152];
+	size_t pos = 0;
+	for(size_t f = 0; f < (size_t) secs * RATE / 1152; f++) {
+		for(size_t i = 0; i < 1152; i++, pos++) {
+			frame[2 * i] = frame[2 * i + 1] = (int16_t) lrint(amplitude * sin(2 * M_PI * 1000 * pos / RATE));
+		}
+		loudness_meter_add_s16(meter, frame, 1152);
+	}
+}
+
+bool test_loudness() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nloudness.o");
+
+	TEST_FUNC_START(loudness_meter_integrated)
+		// EBU Tech 3341, test case 1: -23 dBFS sine -> -23 LUFS (+-0.1)
+		struct loudness_meter *meter = loudness_meter_create(RATE, 2);
+		feed_sine(meter, 20, -23);
+		TEST_RES( fabs(loudness_meter_integrated(meter) + 23) < 0.1 );
+		loudness_meter_destroy(meter);
+
+		// quiet parts are gated (relative gate at -10 LU)
+		meter = loudness_meter_create(RATE, 2);
+		feed_sine(meter, 20, -23);
+		feed_sine(meter, 20, -60);
+		feed_sine(meter, 20, -23);
+		TEST_RES( fabs(loudness_meter_integrated(meter) + 23) < 0.1 );
+		loudness_meter_destroy(meter);
+
+		// silence does not pass the absolute gate
+		meter = loudness_meter_create(RATE, 2);
+		feed_sine(meter, 5, -200);
+		TEST_RES( LOUDNESS_SILENCE == loudness_meter_integrated(meter) );
+		loudness_meter_destroy(meter);
+	TEST_FUNC_END();
+
+	TEST_END();
+}
@@ -0,0 +1,3 @@
+#include <stdbool.h>
+
+bool test_loudness();
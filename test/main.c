@@ -9,6 +9,17 @@
 #include "plain.h"
 #include "tls.h"
 #include "http.h"
+#include "loudness.h"
+#include "pcm.h"
+#include "hls.h"
+#include "memcache.h"
+#include "aio.h"
+#include "track.h"
+#include "strpool.h"
+#include "descstore.h"
+#include "trigram.h"
+#include "view.h"
+#include "isearch.h"
 
 #define BUFFER_SIZE 1024 * 512
 
@@ -24,6 +35,17 @@ int main(int argc, char **argv) {
 	if(!test_plain())  failed_tcs++;
 	if(!test_tls())    failed_tcs++;
 	if(!test_http())   failed_tcs++;
+	if(!test_loudness()) failed_tcs++;
+	if(!test_pcm())      failed_tcs++;
+	if(!test_hls())      failed_tcs++;
+	if(!test_memcache()) failed_tcs++;
+	if(!test_aio())      failed_tcs++;
+	if(!test_track())    failed_tcs++;
+	if(!test_strpool())  failed_tcs++;
+	if(!test_descstore()) failed_tcs++;
+	if(!test_trigram())   failed_tcs++;
+	if(!test_view())      failed_tcs++;
+	if(!test_isearch())   failed_tcs++;
 
 	if(failed_tcs) {
 		fprintf(stderr, "\n\nRESULT: FOUND ERRORS IN %lu MODULES\n", failed_tcs);
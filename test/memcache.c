@@ -0,0 +1,61 @@
+#include "memcache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/memcache.h"
+#include "../src/track.h"
+
+bool test_memcache() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nmemcache.o");
+
+	struct track tracks[3] = {
+		{ .user_id = 1, .track_id = 10 },
+		{ .user_id = 1, .track_id = 11 },
+		{ .user_id = 2, .track_id = 10 }
+	};
+	char data[3][1000];
+	for(size_t i = 0; i < 3; i++) memset(data[i], 'a' + i, sizeof(data[i]));
+
+	size_t size;
+	struct memcache_stats stats;
+
+	memcache_init(2500);
+
+	TEST_FUNC_START(memcache_put)
+		TEST_RES( memcache_put(&tracks[0], data[0], sizeof(data[0])) );
+		TEST_RES( memcache_put(&tracks[1], data[1], sizeof(data[1])) );
+		TEST_RES( !memcache_put(&tracks[2], data[2], 3000) );
+
+		memcache_get_stats(&stats);
+		TEST_RES( 2 == stats.entries && 2000 == stats.bytes );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(memcache_get)
+		char *got = memcache_get(&tracks[0], &size);
+		TEST_RES( got && sizeof(data[0]) == size && !memcmp(got, data[0], size) );
+		TEST_RES( !memcache_get(&tracks[2], &size) );
+
+		// tracks[1] is the least recently used one now and is evicted
+		TEST_RES( memcache_put(&tracks[2], data[2], sizeof(data[2])) );
+		TEST_RES( !memcache_get(&tracks[1], &size) );
+
+		// tracks[0] is referenced: evicting tracks[2] is not sufficient
+		TEST_RES( !memcache_put(&tracks[1], data[1], 2000) );
+		TEST_RES( memcache_get(&tracks[0], &size) == got );
+
+		memcache_release(got);
+		memcache_release(got);
+		TEST_RES( memcache_put(&tracks[1], data[1], 2000) );
+		TEST_RES( !memcache_get(&tracks[0], &size) );
+
+		memcache_get_stats(&stats);
+		TEST_RES( 2 == stats.hits && 3 == stats.misses && 3 == stats.evictions && 1 == stats.entries );
+	TEST_FUNC_END();
+
+	TEST_END();
+}
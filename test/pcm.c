@@ -0,0 +1,125 @@
+#include "pcm.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/pcm.h"
+
+#define FRAME_SIZE 1152
+
+/** \brief The number of kB locked in memory by this process (see VmLck in /proc/self/status) */
+static size_t locked_kb(void) {
+	FILE *status = fopen("/proc/self/status", "r");
+	if(!status) return 0;
+
+	char line[128];
+	size_t kb = 0;
+	while(fgets(line, sizeof(line), status) && 1 != sscanf(line, "VmLck: %zu kB", &kb));
+	fclose(status);
+	return kb;
+}
+
+/** \brief Resample one second of a sine (`freq` Hz, amplitude 16000) and compare the output to the ideal sine at the output rate
+ *
+ *  \return The signal to noise ratio (in dB) of the (left channel of the) output
+ */
+static double resample_sine(unsigned int in_rate, unsigned int channels, unsigned int out_rate, double freq, size_t *out_frames, bool lock) {
+	struct pcm_converter *converter = pcm_converter_create(in_rate, channels, out_rate);
+	if(!converter) return 0;
+	if(lock && !pcm_converter_lock(converter)) {
+		pcm_converter_destroy(converter);
+		return 0;
+	}
+
+	int16_t *output = malloc(2 * 2 * out_rate * sizeof(int16_t));
+	int16_t input[2 * FRAME_SIZE];
+
+	*out_frames = 0;
+	for(size_t pos = 0; pos < in_rate; pos += FRAME_SIZE) {
+		const size_t frames = (in_rate - pos < FRAME_SIZE) ? in_rate - pos : FRAME_SIZE;
+		for(size_t i = 0; i < frames; i++) {
+			for(unsigned int c = 0; c < channels; c++) {
+				input[channels * i + c] = (int16_t) lrint(16000 * sin(2 * M_PI * freq * (pos + i) / in_rate));
+			}
+		}
+
+		int16_t *samples;
+		size_t bytes = pcm_converter_process(converter, input, channels * frames * sizeof(int16_t), &samples);
+		memcpy(&output[2 * *out_frames], samples, bytes);
+		*out_frames += bytes / (2 * sizeof(int16_t));
+	}
+
+	// skip the edges, the output is expected to be aligned to the input
+	double noise = 0;
+	for(size_t i = 1000; i < out_rate - 1000; i++) {
+		const double error = output[2 * i] - 16000 * sin(2 * M_PI * freq * i / out_rate);
+		noise += error * error;
+	}
+
+	free(output);
+	pcm_converter_destroy(converter);
+
+	return 10 * log10((16000.0 * 16000.0 / 2) / (noise / (out_rate - 2000)));
+}
+
+bool test_pcm() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\npcm.o");
+
+	TEST_FUNC_START(pcm_mono_to_stereo_s16)
+		int16_t mono[19], stereo[2 * 19];
+		for(int i = 0; i < 19; i++) mono[i] = (i - 9) * 1000;
+		pcm_mono_to_stereo_s16(mono, stereo, 19);
+
+		bool equal = true;
+		for(int i = 0; i < 19; i++) equal &= (mono[i] == stereo[2 * i] && mono[i] == stereo[2 * i + 1]);
+		TEST_RES( equal );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(pcm_f32_to_s16)
+		float in[11] = { -2.0, -1.0, -0.5, 0, 0.5, 0.999, 1.0, 2.0, 0.25, -0.25, 0 };
+		int16_t out[11];
+		pcm_f32_to_s16(in, out, 11);
+		TEST_RES( INT16_MIN == out[0] && INT16_MIN == out[1] && -16384 == out[2] && 0 == out[3] && 16384 == out[4] );
+		TEST_RES( INT16_MAX == out[6] && INT16_MAX == out[7] && 8192 == out[8] && -8192 == out[9] );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(pcm_converter_process)
+		size_t frames;
+		TEST_RES( resample_sine(44100, 2, 48000, 1000, &frames, false) > 70 );
+		TEST_RES( frames > 47900 && frames <= 48000 );
+		TEST_RES( resample_sine(48000, 2, 44100, 1000, &frames, false) > 70 );
+		TEST_RES( resample_sine(22050, 1, 44100,  440, &frames, false) > 70 );
+		TEST_RES( resample_sine(44100, 1, 44100,  440, &frames, false) > 70 );
+		TEST_RES( 44100 == frames );
+
+		// unsupported input
+		TEST_RES( NULL == pcm_converter_create(44100, 6, 48000) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(pcm_converter_lock)
+		// buffers grown while locked are locked as well, destroying the converter unlocks all of them
+		const size_t locked_before = locked_kb();
+		struct pcm_converter *converter = pcm_converter_create(44100, 2, 48000);
+		TEST_RES( converter && pcm_converter_lock(converter) );
+		TEST_RES( locked_kb() > locked_before );
+
+		int16_t *silence = calloc(2 * 16 * FRAME_SIZE, sizeof(int16_t));
+		int16_t *samples;
+		TEST_RES( pcm_converter_process(converter, silence, 2 * 16 * FRAME_SIZE * sizeof(int16_t), &samples) );
+		free(silence);
+		pcm_converter_destroy(converter);
+		TEST_RES( locked_before == locked_kb() );
+
+		size_t frames;
+		TEST_RES( resample_sine(44100, 2, 48000, 1000, &frames, true) > 70 );
+		TEST_RES( locked_before == locked_kb() );
+	TEST_FUNC_END();
+
+	TEST_END();
+}
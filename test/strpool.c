@@ -0,0 +1,150 @@
+#include "strpool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/strpool.h"
+
+#define STRING_COUNT 20000
+
+#define THREAD_COUNT     4
+#define THREAD_ITERATIONS 20000
+
+/** \brief Intern, reference and release a few strings over and over, racing with the other threads doing so */
+static void* intern_release(void *result) {
+	bool *equal = result;
+
+	char buffer[32];
+	for(size_t i = 0; i < THREAD_ITERATIONS; i++) {
+		snprintf(buffer, sizeof(buffer), "shared%zu", i % 4);
+		char *interned = strpool_intern(buffer);
+		*equal &= interned && !strcmp(interned, buffer);
+		strpool_unref(strpool_ref(interned));
+		strpool_unref(interned);
+	}
+	return NULL;
+}
+
+bool test_strpool() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nstrpool.o");
+
+	TEST_FUNC_START(strpool_intern)
+		TEST_RES( !strpool_intern(NULL) );
+
+		char buffer[64];
+		strcpy(buffer, "username");
+		char *first = strpool_intern(buffer);
+		strcpy(buffer, "username");
+		TEST_RES( first && !strcmp(first, "username") && first != buffer );
+		TEST_RES( first == strpool_intern(buffer) );
+		TEST_RES( first != strpool_intern("username2") && first != strpool_intern("") );
+
+		// growing the table keeps the strings (and their addresses) interned before
+		char **strings = malloc(STRING_COUNT * sizeof(char*));
+		for(size_t i = 0; i < STRING_COUNT; i++) {
+			snprintf(buffer, sizeof(buffer), "https://soundcloud.com/user%zu/track", i);
+			strings[i] = strpool_intern(buffer);
+		}
+		bool equal = true;
+		for(size_t i = 0; i < STRING_COUNT; i++) {
+			snprintf(buffer, sizeof(buffer), "https://soundcloud.com/user%zu/track", i);
+			equal &= (strings[i] == strpool_intern(buffer) && !strcmp(strings[i], buffer));
+		}
+		TEST_RES( equal );
+		TEST_RES( first == strpool_intern("username") );
+		free(strings);
+
+		// a string larger than a block
+		size_t size = 256 * 1024;
+		char *large = malloc(size + 1);
+		memset(large, 'x', size);
+		large[size] = '\0';
+		char *interned = strpool_intern(large);
+		TEST_RES( interned && strlen(interned) == size && interned == strpool_intern(large) );
+		free(large);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(strpool_get_stats)
+		struct strpool_stats stats;
+		strpool_get_stats(&stats);
+		TEST_RES( STRING_COUNT + 4 == stats.strings );
+		TEST_RES( stats.requests > stats.strings );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(strpool_unref)
+		struct strpool_stats before;
+		strpool_get_stats(&before);
+
+		// a string is freed once the last reference is released
+		char *released = strpool_intern("released");
+		TEST_RES( released == strpool_ref(released) && released == strpool_intern("released") );
+		strpool_unref(released);
+		strpool_unref(released);
+		TEST_RES( !strpool_ref(NULL) );
+		strpool_unref(NULL);
+
+		struct strpool_stats stats;
+		strpool_get_stats(&stats);
+		TEST_RES( before.strings + 1 == stats.strings && !strcmp("released", released) );
+		strpool_unref(released);
+		strpool_get_stats(&stats);
+		TEST_RES( before.strings == stats.strings && before.bytes == stats.bytes );
+
+		// the blocks emptied are freed, the strings left are still found
+		char buffer[64];
+		char **strings = malloc(STRING_COUNT * sizeof(char*));
+		for(size_t i = 0; i < STRING_COUNT; i++) {
+			snprintf(buffer, sizeof(buffer), "https://soundcloud.com/released%zu/track", i);
+			strings[i] = strpool_intern(buffer);
+		}
+		strpool_get_stats(&stats);
+		TEST_RES( stats.blocks > before.blocks + 1 );
+
+		for(size_t i = 0; i < STRING_COUNT; i++) {
+			strpool_unref(strings[i]);
+		}
+		free(strings);
+		strpool_get_stats(&stats);
+		TEST_RES( before.strings == stats.strings && before.bytes == stats.bytes && stats.blocks <= before.blocks + 1 );
+
+		bool found = true;
+		for(size_t i = 0; i < STRING_COUNT; i += 97) {
+			snprintf(buffer, sizeof(buffer), "https://soundcloud.com/user%zu/track", i);
+			char *interned = strpool_intern(buffer);
+			found &= !strcmp(interned, buffer);
+			strpool_unref(interned);
+		}
+		strpool_get_stats(&stats);
+		TEST_RES( found && before.strings == stats.strings );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(strpool_ref)
+		struct strpool_stats before;
+		strpool_get_stats(&before);
+
+		// references are added and released without the lock, the last one released races with interning anew
+		pthread_t threads[THREAD_COUNT];
+		bool results[THREAD_COUNT];
+		for(size_t i = 0; i < THREAD_COUNT; i++) {
+			results[i] = true;
+			pthread_create(&threads[i], NULL, intern_release, &results[i]);
+		}
+		bool equal = true;
+		for(size_t i = 0; i < THREAD_COUNT; i++) {
+			pthread_join(threads[i], NULL);
+			equal &= results[i];
+		}
+
+		struct strpool_stats stats;
+		strpool_get_stats(&stats);
+		TEST_RES( equal && before.strings == stats.strings && before.bytes == stats.bytes );
+	TEST_FUNC_END();
+
+	TEST_END();
+}
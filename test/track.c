@@ -0,0 +1,246 @@
+#include "track.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/track.h"
+#include "../src/strpool.h"
+
+#define TRACK_COUNT 1000
+
+static char permalinks[TRACK_COUNT][32];
+
+static struct track test_track_create(size_t i) {
+	// the strings of the entries of a list are interned (see strpool.h)
+	struct track track = { .name = strpool_intern("name") };
+	track.permalink_url = strpool_intern(permalinks[i]);
+	track.track_id      = (int) (i * 64);
+	track.created_at    = (time_t) i;
+	return track;
+}
+
+/** \brief Check each track is found (at its position) using the index and no other one is */
+static bool check_lookups(struct track_list *list) {
+	for(size_t i = 0; i < list->count; i++) {
+		struct track *track = TRACK(list, i);
+		if(track_list_get(list, track->permalink_url) != &list->entries[i]
+		|| track_list_get_by_id(list, track->track_id) != &list->entries[i]) {
+			return false;
+		}
+	}
+	return !track_list_get(list, "missing") && !track_list_get_by_id(list, 1);
+}
+
+bool test_track() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\ntrack.o");
+
+	for(size_t i = 0; i < TRACK_COUNT; i++) {
+		snprintf(permalinks[i], sizeof(permalinks[i]), "https://sc.com/u/t%zu", i);
+	}
+
+	struct track_list *list = track_list_create("test");
+
+	TEST_FUNC_START(track_list_index)
+		for(size_t i = 0; i < TRACK_COUNT / 2; i++) {
+			struct track track = test_track_create(i);
+			track_list_add(list, &track);
+		}
+		TEST_RES( check_lookups(list) );
+
+		TEST_RES( track_list_index(list) );
+		TEST_RES( check_lookups(list) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_add)
+		for(size_t i = TRACK_COUNT / 2; i < TRACK_COUNT - 100; i++) {
+			struct track track = test_track_create(i);
+			track_list_add(list, &track);
+		}
+		TEST_RES( TRACK_COUNT - 100 == list->count );
+		TEST_RES( check_lookups(list) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_append)
+		struct track_list *source = track_list_create("source");
+		for(size_t i = TRACK_COUNT - 100; i < TRACK_COUNT; i++) {
+			struct track track = test_track_create(i);
+			track_list_add(source, &track);
+		}
+		TEST_RES( track_list_append(list, source) );
+		TEST_RES( TRACK_COUNT == list->count );
+		TEST_RES( check_lookups(list) );
+		track_list_destroy(source, false);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_del)
+		track_list_del(list, 0);
+		track_list_del(list, 500);
+		TEST_RES( TRACK_COUNT - 2 == list->count );
+		TEST_RES( check_lookups(list) );
+		TEST_RES( !track_list_get(list, permalinks[0]) && !track_list_get_by_id(list, 0) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_sort)
+		track_list_sort(list);
+		TEST_RES( TRACK_COUNT - 1 == list->entries[0].created_at );
+		TEST_RES( check_lookups(list) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_sort_stable)
+		struct track_list *stable = track_list_create("stable");
+		for(size_t i = 0; i < 300; i++) {
+			struct track track = test_track_create(i);
+			track.created_at = (time_t) (i % 3) - 1;
+			track_list_add(stable, &track);
+		}
+
+		// tracks created at the same time keep their order
+		track_list_sort(stable);
+		bool sorted = true;
+		for(size_t i = 0; i < 300; i++) {
+			const size_t expected = (2 - i / 100) + 3 * (i % 100);
+			sorted &= stable->entries[i].track_id == (int) (expected * 64);
+		}
+		TEST_RES( sorted && check_lookups(stable) );
+
+		track_list_destroy(stable, false);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_merge)
+		// the first of several equal entries is found
+		struct track_list *lists[] = { list, list, NULL };
+		struct track_list *merged = track_list_merge(lists);
+		TEST_RES( merged && merged->index );
+		TEST_RES( merged && track_list_get(merged, permalinks[1]) == &merged->entries[list->count - 1] );
+		TEST_RES( merged && track_list_get_by_id(merged, 64) == &merged->entries[list->count - 1] );
+		track_list_destroy(merged, false);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_merge_sorted)
+		// three sorted lists (most recent first), sharing some tracks, one of them empty
+		struct track_list *sources[] = { track_list_create("a"), track_list_create("b"), track_list_create("c"), NULL };
+		for(size_t i = 300; i > 0; i--) {
+			struct track track = test_track_create(i);
+			if(0 == i % 3 || 0 == i % 5) track_list_add(sources[0], &track);
+			if(0 == i % 2 || 0 == i % 5) track_list_add(sources[1], &track);
+		}
+
+		track_list_index(sources[1]);
+		struct track_list *merged = track_list_merge_sorted(sources);
+		TEST_RES( merged && merged->index );
+
+		// every track of either list exactly once, most recent first
+		size_t expected = 0;
+		for(size_t i = 1; i <= 300; i++) {
+			if(0 == i % 2 || 0 == i % 3 || 0 == i % 5) expected++;
+		}
+		bool sorted = true;
+		for(size_t i = 1; merged && i < merged->count; i++) {
+			sorted &= (merged->entries[i - 1].created_at > merged->entries[i].created_at);
+		}
+		TEST_RES( merged && expected == merged->count && sorted );
+		TEST_RES( merged && check_lookups(merged) );
+		track_list_destroy(merged, false);
+
+		// an unsorted list is sorted before merging
+		struct track_list *reversed = track_list_create("reversed");
+		for(size_t i = 0; i < 100; i++) {
+			struct track track = test_track_create(i);
+			track_list_add(reversed, &track);
+		}
+		struct track_list *unsorted[] = { reversed, NULL };
+		merged = track_list_merge_sorted(unsorted);
+		TEST_RES( merged && 100 == merged->count && 99 == merged->entries[0].created_at && 0 == merged->entries[99].created_at );
+		track_list_destroy(merged, false);
+		track_list_destroy(reversed, false);
+
+		for(size_t i = 0; sources[i]; i++) {
+			track_list_destroy(sources[i], false);
+		}
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_builder_finish)
+		struct track_list_builder builder = { .region = NULL };
+		for(size_t i = 0; i < 100; i++) {
+			struct track *track = track_list_builder_add(&builder);
+			if(track) *track = test_track_create(i);
+		}
+		TEST_RES( track_list_builder_append(&builder, list) );
+
+		struct track_list *built = track_list_builder_finish(&builder);
+		TEST_RES( built && 100 + list->count == built->count && !builder.region );
+		TEST_RES( built && built->count == built->capacity && 99 == built->entries[99].created_at );
+		TEST_RES( built && list->entries[0].track_id == built->entries[100].track_id );
+
+		// adding to a finished list grows its entries
+		struct track track = test_track_create(0);
+		TEST_RES( built && track_list_add(built, &track) && built->capacity > built->count );
+		TEST_RES( built && 99 == built->entries[99].created_at && 0 == built->entries[built->count - 1].created_at );
+		track_list_destroy(built, false);
+
+		// as does reserving room in front of them
+		for(size_t i = 0; i < 100; i++) {
+			struct track *added = track_list_builder_add(&builder);
+			if(added) *added = test_track_create(i);
+		}
+		built = track_list_builder_finish(&builder);
+		TEST_RES( built && track_list_reserve_front(built, 10, NULL) && 10 == built->headroom && built->capacity >= 100 );
+		TEST_RES( built && 0 == built->entries[0].created_at && 99 == built->entries[99].created_at );
+		track_list_destroy(built, false);
+
+		built = track_list_builder_finish(&builder);
+		TEST_RES( built && 0 == built->count );
+		track_list_destroy(built, false);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(track_list_prepend)
+		struct track_list *stream = track_list_create("stream");
+		struct track_list *update = track_list_create("update");
+		for(size_t i = 0; i < 500; i++) {
+			struct track track = test_track_create(499 - i);
+			track_list_add(stream, &track);
+		}
+		for(size_t i = 0; i < 100; i++) {
+			struct track track = test_track_create(599 - i);
+			track_list_add(update, &track);
+		}
+		TEST_RES( track_list_index(stream) && track_list_reserve_front(stream, 100, NULL) && 100 == stream->headroom );
+
+		// the entries are not moved, the index is rebuilt
+		struct track *first = &stream->entries[0];
+		TEST_RES( track_list_prepend(stream, update) && 0 == stream->headroom && 600 == stream->count );
+		TEST_RES( &stream->entries[100] == first && 599 == stream->entries[0].created_at );
+		TEST_RES( stream->index && check_lookups(stream) );
+		TEST_RES( !track_list_prepend(stream, update) && 600 == stream->count );
+
+		// growing reallocates the room in front along with the entries
+		struct track track = test_track_create(600);
+		TEST_RES( track_list_add(stream, &track) && 599 == stream->entries[0].created_at && check_lookups(stream) );
+
+		// making room again moves the entries: the former ones are kept, the reference tracks redirected
+		struct track_list *refs = track_list_create("refs");
+		struct track ref = { .name = NULL, .href = &stream->entries[42] };
+		track_list_add(refs, &ref);
+
+		struct track *former = NULL;
+		struct track *from   = stream->entries;
+		TEST_RES( track_list_reserve_front(stream, 100, &former) && former && 100 == stream->headroom );
+		track_list_href_move(refs, from, stream->count, stream->entries);
+		TEST_RES( &stream->entries[42] == refs->entries[0].href && 557 == from[42].created_at );
+		TEST_RES( track_list_prepend(stream, update) && 701 == stream->count && 599 == stream->entries[0].created_at );
+		free(former);
+
+		track_list_destroy(refs, false);
+		track_list_destroy(update, false);
+		track_list_destroy(stream, false);
+	TEST_FUNC_END();
+
+	track_list_destroy(list, false);
+
+	TEST_END();
+}
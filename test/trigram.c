@@ -0,0 +1,99 @@
+#include "trigram.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/strpool.h"
+#include "../src/track.h"
+#include "../src/trigram.h"
+
+#define TRACK_COUNT 5000
+
+static char names[TRACK_COUNT][48];
+static char usernames[TRACK_COUNT][16];
+
+static const char *queries[] = { "Track 12", "mix", "MIX 4", "user7", "r7 - ", "live at", "no match", "ck", "7", NULL };
+
+/** \brief Compare trigram_index_find() to searching linearly, starting at each position */
+static bool check_find(struct track_list *list) {
+	for(size_t q = 0; queries[q]; q++) {
+		for(size_t start = 0; start < list->count; start += 7) {
+			for(int down = 0; down <= 1; down++) {
+				size_t expected = SIZE_MAX;
+				for(size_t i = start; i < list->count; down ? i++ : i--) {
+					if(strcasestr(TRACK(list, i)->name, queries[q]) || strcasestr(TRACK(list, i)->username, queries[q])) {
+						expected = i;
+						break;
+					}
+				}
+
+				size_t found = SIZE_MAX;
+				if(!trigram_index_find(list, queries[q], start, down, &found)) {
+					found = SIZE_MAX;
+				}
+				if(found != expected) {
+					fprintf(stderr, " (`%s` from %zu: %zu instead of %zu)", queries[q], start, found, expected);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool test_trigram() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\ntrigram.o");
+
+	struct track_list *list = track_list_create("test");
+	for(size_t i = 0; i < TRACK_COUNT; i++) {
+		snprintf(names[i], sizeof(names[i]), "Track %zu - %s", i, (i % 3) ? "Mix 4" : "live at home");
+		snprintf(usernames[i], sizeof(usernames[i]), "user%zu", i % 100);
+	}
+
+	TEST_FUNC_START(trigram_index_create)
+		for(size_t i = 0; i < TRACK_COUNT / 2; i++) {
+			struct track track = { .name = strpool_intern(names[i]), .username = strpool_intern(usernames[i]), .created_at = (time_t) (i % 50) };
+			track_list_add(list, &track);
+		}
+		TEST_RES( check_find(list) );
+
+		TEST_RES( trigram_index_create(list) );
+		TEST_RES( check_find(list) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(trigram_index_find)
+		// entries added afterwards are searched linearly
+		for(size_t i = TRACK_COUNT / 2; i < TRACK_COUNT; i++) {
+			struct track track = { .name = strpool_intern(names[i]), .username = strpool_intern(usernames[i]), .created_at = (time_t) (i % 50) };
+			track_list_add(list, &track);
+		}
+		TEST_RES( check_find(list) );
+
+		for(size_t i = 0; i < 200; i++) {
+			track_list_del(list, (i * 37) % list->count);
+		}
+		TEST_RES( check_find(list) );
+
+		TEST_RES( !trigram_index_find(list, "track", list->count, true, &(size_t) { 0 }) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(trigram_index_rebuild)
+		track_list_sort(list);
+		TEST_RES( check_find(list) );
+
+		TEST_RES( trigram_init(false) );
+		track_list_sort(list);
+		TEST_RES( check_find(list) );
+		track_list_del(list, 0);
+		TEST_RES( check_find(list) );
+	TEST_FUNC_END();
+
+	track_list_destroy(list, false);
+
+	TEST_END();
+}
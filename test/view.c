@@ -0,0 +1,175 @@
+#include "view.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_helper.h"
+
+#include "../src/track.h"
+#include "../src/strpool.h"
+#include "../src/view.h"
+
+#define TRACK_COUNT 3000
+
+static char names[2 * TRACK_COUNT][32];
+static char usernames[10][16] = { "alice", "bob", "carol", "dave", "eve", "frank", "grace", "heidi", "ivan", "judy" };
+
+static struct track make_track(size_t i) {
+	snprintf(names[i], sizeof(names[i]), "Track %zu", i);
+	return (struct track) {
+		.name       = strpool_intern(names[i]),
+		.username   = strpool_intern(usernames[i % 10]),
+		.created_at = (time_t) (1000000 + (i * 7919) % 5000),
+		.duration   = (int) ((i * 104729) % 600),
+		.track_id   = (int) i + 1,
+		.flags      = (i % 3) ? 0 : FLAG_CACHED
+	};
+}
+
+static bool matches(const struct view_filter *filter, const struct track *track) {
+	const unsigned int duration = (unsigned int) track->duration;
+	return (!filter->user || strcasestr(track->username, filter->user))
+	    && (!filter->since || track->created_at >= filter->since)
+	    && (!filter->until || track->created_at <= filter->until)
+	    && duration >= filter->min_duration && (!filter->max_duration || duration <= filter->max_duration)
+	    && (!filter->cached || (track->flags & FLAG_CACHED));
+}
+
+/** \brief Compare a view to filtering (and sorting) its base from scratch */
+static bool check_view(struct track_list *view, const struct view_filter *filter) {
+	struct track_list *base = view->view->base;
+
+	size_t expected = 0;
+	for(size_t i = 0; i < base->count; i++) {
+		expected += matches(filter, TRACK(base, i));
+	}
+	if(expected != view->count) {
+		fprintf(stderr, " (%zu entries instead of %zu)", view->count, expected);
+		return false;
+	}
+
+	for(size_t i = 0; i < view->count; i++) {
+		if(!matches(filter, TRACK(view, i))) {
+			fprintf(stderr, " (entry %zu does not match)", i);
+			return false;
+		}
+	}
+
+	for(size_t i = 1; i < view->count; i++) {
+		const struct track *prev = TRACK(view, i - 1);
+		const struct track *cur  = TRACK(view, i);
+		if(prev == cur
+		|| (view_order_longest == filter->order && prev->duration < cur->duration)
+		|| (view_order_oldest  == filter->order && prev->created_at > cur->created_at)) {
+			fprintf(stderr, " (entry %zu out of order)", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool test_view() {
+	TEST_INIT();
+
+	fprintf(stderr, "\n\nview.o");
+
+	struct track_list *list = track_list_create("test");
+	for(size_t i = 0; i < TRACK_COUNT; i++) {
+		struct track track = make_track(TRACK_COUNT + i);
+		track_list_add(list, &track);
+	}
+
+	struct view_filter filter_user, filter_longest, filter_oldest;
+	char spec_user[]    = "user=A cached";
+	char spec_longest[] = "min=1:00 max=8:00 sort=longest";
+	char spec_oldest[]  = "sort=oldest";
+	char spec_invalid[] = "cached sort=random";
+
+	struct track_list *view_user, *view_longest, *view_oldest;
+
+	TEST_FUNC_START(view_filter_parse)
+		TEST_RES( !view_filter_parse(spec_user, &filter_user) );
+		TEST_RES( filter_user.cached && !strcmp("A", filter_user.user) );
+		TEST_RES( !view_filter_parse(spec_longest, &filter_longest) );
+		TEST_RES( 60 == filter_longest.min_duration && 480 == filter_longest.max_duration );
+		TEST_RES( !view_filter_parse(spec_oldest, &filter_oldest) );
+
+		struct view_filter filter_invalid;
+		const char *invalid = view_filter_parse(spec_invalid, &filter_invalid);
+		TEST_RES( invalid && !strcmp("sort=random", invalid) );
+		view_filter_clear(&filter_invalid);
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(view_create)
+		// the members of the filters are moved to the views, keep the originals for checking
+		struct view_filter moved_user = filter_user, moved_longest = filter_longest, moved_oldest = filter_oldest;
+		view_user    = view_create(list, &moved_user, "user");
+		view_longest = view_create(list, &moved_longest, "longest");
+		view_oldest  = view_create(view_user, &moved_oldest, "oldest");
+		TEST_RES( view_user && view_longest && view_oldest );
+		TEST_RES( !moved_user.user && list == view_oldest->view->base );
+
+		TEST_RES( check_view(view_user, &filter_user) );
+		TEST_RES( check_view(view_longest, &filter_longest) );
+		TEST_RES( check_view(view_oldest, &filter_oldest) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(view_update)
+		// views are not updated until asked to, but keep referring to the same tracks
+		const int first = TRACK(view_longest, 0)->track_id;
+
+		struct track_list *update = track_list_create("update");
+		for(size_t i = 0; i < TRACK_COUNT; i++) {
+			struct track track = make_track(i);
+			track_list_add(update, &track);
+		}
+		TEST_RES( track_list_reserve_front(list, update->count, NULL) );
+		TEST_RES( track_list_prepend(list, update) );
+		track_list_destroy(update, false);
+		for(size_t i = 0; i < 100; i++) {
+			struct track track = make_track(TRACK_COUNT + i);
+			track_list_add(list, &track);
+		}
+		TEST_RES( first == TRACK(view_longest, 0)->track_id );
+
+		TEST_RES( view_update(view_user) );
+		TEST_RES( view_update(view_longest) );
+		TEST_RES( view_update(view_oldest) );
+		TEST_RES( !view_update(view_user) );
+		TEST_RES( check_view(view_user, &filter_user) );
+		TEST_RES( check_view(view_longest, &filter_longest) );
+		TEST_RES( check_view(view_oldest, &filter_oldest) );
+
+		size_t pos;
+		TEST_RES( view_find(view_longest, track_list_get_by_id(list, first), &pos) && first == TRACK(view_longest, pos)->track_id );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(view_base_del)
+		for(size_t i = 0; i < 500; i++) {
+			track_list_del(list, (i * 37) % list->count);
+		}
+		TEST_RES( check_view(view_user, &filter_user) );
+		TEST_RES( check_view(view_longest, &filter_longest) );
+		TEST_RES( check_view(view_oldest, &filter_oldest) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(view_base_rebuild)
+		track_list_sort(list);
+		TEST_RES( check_view(view_user, &filter_user) );
+		TEST_RES( check_view(view_longest, &filter_longest) );
+		TEST_RES( check_view(view_oldest, &filter_oldest) );
+	TEST_FUNC_END();
+
+	TEST_FUNC_START(view_destroy)
+		track_list_destroy(view_longest, true);
+		TEST_RES( check_view(view_user, &filter_user) );
+
+		track_list_destroy(list, false);
+		TEST_RES( !view_user->count && !view_oldest->count && !view_update(view_user) );
+		track_list_destroy(view_user, false);
+		track_list_destroy(view_oldest, false);
+	TEST_FUNC_END();
+
+	TEST_END();
+}